@@ -30,13 +30,23 @@
 #include <kernwin.hpp>
 #include <auto.hpp>
 #include <ua.hpp>
+#include <segment.hpp>
+#include <fpro.h>
 
-#include <time.h>
+#include <stdarg.h>
 #include <list>
 #include <set>
+#include <map>
 
 #include "ppc2c_engine.hpp"
 #include "ppc2c_handlers.hpp"
+#include "ppc2c_structure.hpp"
+#include "ppc2c_constprop.hpp"
+#include "ppc2c_altivec.hpp"
+#include "ppc2c_profile.hpp"
+#include "ppc2c_dedup.hpp"
+#include "ppc2c_masks.hpp"
+#include "ppc2c_ir.hpp"
 
 static list<Function> functions;
 
@@ -45,10 +55,6 @@ static list<Function> functions;
 
 #if 1
 
-#define MASK32_ALLSET	0xFFFFFFFF
-#define MASK64_ALLSET	0xFFFFFFFFFFFFFFFFULL
-
-
 #define G_STR_SIZE	256
 char g_mnem[G_STR_SIZE];
 char g_opnd_s0[G_STR_SIZE];
@@ -76,29 +82,7 @@ unsigned int GenerateMask32(int MB, int ME)
       return 0;
     }
 	
-  unsigned int mask = 0;
-  if(MB < ME+1)
-    {
-      // normal mask
-      for(int i=MB; i<=ME; i=i+1)
-        {
-          mask = mask | (1<<(31-i));
-        }
-    }
-  else if(MB == ME+1)
-    {
-      // all mask bits set
-      mask = MASK32_ALLSET;
-    }
-  else if(MB > ME+1)
-    {
-      // split mask
-      unsigned int mask_lo = GenerateMask32(0, ME);
-      unsigned int mask_hi = GenerateMask32(MB, 31);
-      mask = mask_lo | mask_hi;
-    }
-	
-  return mask;
+  return mask32_table[MB][ME];
 }
 
 // generates the mask between MaskBegin(MB) and MaskEnd(ME) inclusive
@@ -112,97 +96,99 @@ unsigned long long GenerateMask64(int MB, int ME)
       return 0;
     }
 	
-  unsigned long long mask = 0;
-  if(MB < ME+1)
-    {
-      // normal mask
-      for(int i=MB; i<=ME; i=i+1)
-        {
-          mask = mask | (unsigned long long)(1ULL<<(63-i));
-        }
-    }
-  else if(MB == ME+1)
+  return mask64_table[MB][ME];
+}
+
+// writes the mask like "%s%X" would, with the 0x prefix from 0xA on
+void GenerateMaskString(char* buff, unsigned long long mask)
+{
+  char digits[20];
+  int i = sizeof(digits);
+  bool prefix = mask >= 0xA;
+	
+  digits[--i] = 0;
+  do
     {
-      // all mask bits set
-      mask = MASK64_ALLSET;
-    }
-  else if(MB > ME+1)
+      digits[--i] = "0123456789ABCDEF"[mask & 0xF];
+      mask >>= 4;
+    } while(mask != 0);
+  if(prefix)
     {
-      // split mask
-      unsigned long long mask_lo = GenerateMask64(0, ME);
-      unsigned long long mask_hi = GenerateMask64(MB, 63);
-      mask = mask_lo | mask_hi;
+      digits[--i] = 'x';
+      digits[--i] = '0';
     }
-	
-  return mask;
+  qstrncpy(buff, digits + i, sizeof(digits) - i);
 }
 
 // generate string showing rotation or shifting within instruction
 // returns:	true if string requires brackets if a mask is used, ie: (r4 << 2) & 0xFF
-bool GenerateRotate32(char* buff, int buffSize, const char* src, int leftShift, int rightShift, unsigned int& mask)
+bool GenerateRotate(char* buff, int buffSize, const char* src, int leftShift, int rightShift, RotateIdiom idiom)
 {
-  // work out "rotate" part of the instruction
-  if(	leftShift== 0 && rightShift==32 ||
-        leftShift==32 && rightShift== 0 )
+  switch(idiom)
     {
-      qsnprintf(buff, buffSize, "%s", src);
+    case ROTATE_IDIOM_NONE:
+      qstrncpy(buff, src, buffSize);
       return false;
-    }
-	
-  if(((MASK32_ALLSET<<leftShift ) & mask) == 0)
-    {
-      // right shift only
-      if((MASK32_ALLSET>>rightShift) == mask)
-        mask = MASK32_ALLSET;
+    case ROTATE_IDIOM_RIGHT_SHIFT:
       qsnprintf(buff, buffSize, "%s >> %d", src, rightShift);
-    }
-  else if(((MASK32_ALLSET>>rightShift) & mask) == 0)
-    {
-      // left shift only
-      if((MASK32_ALLSET<<leftShift) == mask)
-        mask = MASK32_ALLSET;
+      break;
+    case ROTATE_IDIOM_LEFT_SHIFT:
       qsnprintf(buff, buffSize, "%s << %d", src, leftShift);
-    }
-  else
-    {
-      // shift both ways
+      break;
+    default:
       qsnprintf(buff, buffSize, "(%s << %d) | (%s >> %d)", src, leftShift, src, rightShift);
+      break;
     }
   return true;
 }
 
-// generate string showing rotation or shifting within instruction
-// returns:	true if string requires brackets if a mask is used, ie: (r4 << 2) & 0xFF
-bool GenerateRotate64(char* buff, int buffSize, const char* src, int leftShift, int rightShift, unsigned long long& mask)
+// shifts and masks with one bit-field, which are most of the rlwinm and
+// rldic* found in code, are looked up instead of built from a rotate string
+bool GenerateShiftMask(char* buff, int buffSize, int leftShift, int rightShift,
+                       RotateIdiom idiom, const char* mask_str)
 {
-  // work out "rotate" part of the instruction
-  if(	leftShift== 0 && rightShift==64 ||
-        leftShift==64 && rightShift== 0 )
+  if(mask_str == NULL)
     {
-      // no rotation
-      qsnprintf(buff, buffSize, "%s", src);
-      return false;
-    }
-	
-  if(((MASK64_ALLSET<<leftShift ) & mask) == 0)
-    {
-      // right shift only
-      if((MASK64_ALLSET>>rightShift) == mask)
-        mask = MASK64_ALLSET;
-      qsnprintf(buff, buffSize, "%s >> %d", src, rightShift);
-    }
-  else if(((MASK64_ALLSET>>rightShift) & mask) == 0)
-    {
-      // left shift only
-      if((MASK64_ALLSET<<leftShift) == mask)
-        mask = MASK64_ALLSET;
-      qsnprintf(buff, buffSize, "%s << %d", src, leftShift);
+      switch(idiom)
+        {
+        case ROTATE_IDIOM_NONE:
+          qsnprintf(buff, buffSize, "%s = %s", g_RA, g_RS);
+          return true;
+        case ROTATE_IDIOM_RIGHT_SHIFT:
+          qsnprintf(buff, buffSize, "%s = %s >> %d", g_RA, g_RS, rightShift);
+          return true;
+        case ROTATE_IDIOM_LEFT_SHIFT:
+          qsnprintf(buff, buffSize, "%s = %s << %d", g_RA, g_RS, leftShift);
+          return true;
+        default:
+          break;
+        }
     }
   else
     {
-      // shift both ways
-      qsnprintf(buff, buffSize, "(%s << %d) | (%s >> %d)", src, leftShift, src, rightShift);
+      switch(idiom)
+        {
+        case ROTATE_IDIOM_NONE:
+          qsnprintf(buff, buffSize, "%s = %s & %s", g_RA, g_RS, mask_str);
+          return true;
+        case ROTATE_IDIOM_RIGHT_SHIFT:
+          qsnprintf(buff, buffSize, "%s = (%s >> %d) & %s", g_RA, g_RS, rightShift, mask_str);
+          return true;
+        case ROTATE_IDIOM_LEFT_SHIFT:
+          qsnprintf(buff, buffSize, "%s = (%s << %d) & %s", g_RA, g_RS, leftShift, mask_str);
+          return true;
+        default:
+          break;
+        }
     }
+	
+  // rotate both ways
+  char rot_str[G_STR_SIZE];
+  GenerateRotate(rot_str, sizeof(rot_str), g_RS, leftShift, rightShift, idiom);
+  if(mask_str == NULL)
+    qsnprintf(buff, buffSize, "%s = %s", g_RA, rot_str);
+  else
+    qsnprintf(buff, buffSize, "%s = (%s) & %s", g_RA, rot_str, mask_str);
   return true;
 }
 
@@ -236,7 +222,7 @@ bool Rotate_iMask32(ea_t ea, char* buff, int buffSize,
 	
   // generate mask string
   char mask_str[G_STR_SIZE];
-  qsnprintf(mask_str, sizeof(mask_str), "%s%X", (mask<0xA)?"":"0x", mask);
+  GenerateMaskString(mask_str, mask);
 	
   // generate the resultant string
   qsnprintf(buff, buffSize, "%s = (%s) & %s", g_RA, rot_str, mask_str);
@@ -258,30 +244,16 @@ bool iRotate_iMask32(ea_t ea, char* buff, int buffSize,
 	
   // work out "rotate" part of the instruction
   // if all mask bits are set, then no need to use the mask
-  char rot_str[G_STR_SIZE];
-  bool brackets = GenerateRotate32(rot_str, sizeof(rot_str), g_RS, leftRotate, 32-leftRotate, mask);
+  RotateIdiom idiom = rotate_idiom32(leftRotate, mask);
   if(mask == MASK32_ALLSET)
-    {
-      //		if(brackets)
-      //			qsnprintf(buff, buffSize, "%s = (u32)(%s)", g_RA, rot_str);
-      //		else
-      //			qsnprintf(buff, buffSize, "%s = (u32)%s", g_RA, rot_str);
-      qsnprintf(buff, buffSize, "%s = %s", g_RA, rot_str);
-      return true;
-    }
-	
-  //	MASK32_ALLSET << leftRotate
+    return GenerateShiftMask(buff, buffSize, leftRotate, 32-leftRotate, idiom, NULL);
 	
   // generate mask string
   char mask_str[G_STR_SIZE];
-  qsnprintf(mask_str, sizeof(mask_str), "%s%X", (mask<0xA)?"":"0x", mask);
+  GenerateMaskString(mask_str, mask);
 	
   // generate the resultant string
-  if(brackets)
-    qsnprintf(buff, buffSize, "%s = (%s) & %s", g_RA, rot_str, mask_str);
-  else
-    qsnprintf(buff, buffSize, "%s = %s & %s", g_RA, rot_str, mask_str);
-  return true;
+  return GenerateShiftMask(buff, buffSize, leftRotate, 32-leftRotate, idiom, mask_str);
 }
 
 // insert immediate rotate and immediate mask
@@ -301,16 +273,14 @@ bool insert_iRotate_iMask32(ea_t ea, char* buff, int buffSize,
   // if all mask bits are set, then no need to use the mask
   char rot_str[G_STR_SIZE];
   unsigned int rot_mask = mask;
-  bool brackets = GenerateRotate32(rot_str, sizeof(rot_str), g_RS, leftRotate, 32-leftRotate, rot_mask);
+  RotateIdiom idiom = rotate_idiom32(leftRotate, rot_mask);
+  bool brackets = GenerateRotate(rot_str, sizeof(rot_str), g_RS, leftRotate, 32-leftRotate, idiom);
 	
   // generate mask strings
   char mask_str[G_STR_SIZE];
-  qsnprintf(mask_str, sizeof(mask_str), "%s%X", (mask<0xA)?"":"0x", mask);
+  GenerateMaskString(mask_str, mask);
   char rot_mask_str[G_STR_SIZE];
-  qsnprintf(rot_mask_str, sizeof(rot_mask_str), "%s%X", (rot_mask<0xA)?"":"0x", rot_mask);
-  //	unsigned int not_mask = ~mask;
-  //	char not_mask_str[G_STR_SIZE];
-  //	qsnprintf(not_mask_str, sizeof(not_mask_str), "%s%X", (not_mask<0xA)?"":"0x", not_mask);
+  GenerateMaskString(rot_mask_str, rot_mask);
 	
   // generate the resultant string
   if(mask == MASK32_ALLSET)
@@ -388,10 +358,7 @@ bool Rotate_iMask64(ea_t ea, char* buff, int buffSize,
 	
   // generate mask string
   char mask_str[G_STR_SIZE];
-  if(mask>>32 == 0)
-    qsnprintf(mask_str, sizeof(mask_str), "%s%X", (mask<0xA)?"":"0x", (unsigned long)mask);
-  else
-    qsnprintf(mask_str, sizeof(mask_str), "%s%X%08X", (mask<0xA)?"":"0x", (unsigned long)(mask>>32), (unsigned long)mask);
+  GenerateMaskString(mask_str, mask);
 	
   // generate the resultant string
   qsnprintf(buff, buffSize, "%s = (%s) & %s", g_RA, rot_str, mask_str);
@@ -413,27 +380,16 @@ bool iRotate_iMask64(ea_t ea, char* buff, int buffSize,
 	
   // work out "rotate" part of the instruction
   // if all mask bits are set, then no need to use the mask
-  char rot_str[G_STR_SIZE];
-  bool brackets = GenerateRotate64(rot_str, sizeof(rot_str), g_RS, leftRotate, 64-leftRotate, mask);
+  RotateIdiom idiom = rotate_idiom64(leftRotate, mask);
   if(mask == MASK64_ALLSET)
-    {
-      qsnprintf(buff, buffSize, "%s = %s", g_RA, rot_str);
-      return true;
-    }
+    return GenerateShiftMask(buff, buffSize, leftRotate, 64-leftRotate, idiom, NULL);
 	
   // generate mask string
   char mask_str[G_STR_SIZE];
-  if(mask>>32 == 0)
-    qsnprintf(mask_str, sizeof(mask_str), "%s%X", (mask<0xA)?"":"0x", (unsigned long)mask);
-  else
-    qsnprintf(mask_str, sizeof(mask_str), "%s%X%08X", (mask<0xA)?"":"0x", (unsigned long)(mask>>32), (unsigned long)mask);
+  GenerateMaskString(mask_str, mask);
 	
   // generate the resultant string
-  if(brackets)
-    qsnprintf(buff, buffSize, "%s = (%s) & %s", g_RA, rot_str, mask_str);
-  else
-    qsnprintf(buff, buffSize, "%s = %s & %s", g_RA, rot_str, mask_str);
-  return true;
+  return GenerateShiftMask(buff, buffSize, leftRotate, 64-leftRotate, idiom, mask_str);
 }
 
 // insert immediate rotate and immediate mask
@@ -453,25 +409,14 @@ bool insert_iRotate_iMask64(ea_t ea, char* buff, int buffSize,
   // if all mask bits are set, then no need to use the mask
   char rot_str[G_STR_SIZE];
   unsigned long long rot_mask = mask;
-  bool brackets = GenerateRotate64(rot_str, sizeof(rot_str), g_RS, leftRotate, 64-leftRotate, rot_mask);
+  RotateIdiom idiom = rotate_idiom64(leftRotate, rot_mask);
+  bool brackets = GenerateRotate(rot_str, sizeof(rot_str), g_RS, leftRotate, 64-leftRotate, idiom);
 	
   // generate mask string
   char mask_str[G_STR_SIZE];
-  if(mask>>32 == 0)
-    qsnprintf(mask_str, sizeof(mask_str), "%s%X", (mask<0xA)?"":"0x", (unsigned long)mask);
-  else
-    qsnprintf(mask_str, sizeof(mask_str), "%s%X%08X", (mask<0xA)?"":"0x", (unsigned long)(mask>>32), (unsigned long)mask);
+  GenerateMaskString(mask_str, mask);
   char rot_mask_str[G_STR_SIZE];
-  if(rot_mask>>32 == 0)
-    qsnprintf(rot_mask_str, sizeof(rot_mask_str), "%s%X", (rot_mask<0xA)?"":"0x", (unsigned long)rot_mask);
-  else
-    qsnprintf(rot_mask_str, sizeof(rot_mask_str), "%s%X%08X", (rot_mask<0xA)?"":"0x", (unsigned long)(rot_mask>>32), (unsigned long)rot_mask);
-  //	unsigned long long not_mask = ~mask;
-  //	char not_mask_str[G_STR_SIZE];
-  //	if(not_mask>>32 == 0)
-  //		qsnprintf(not_mask_str, sizeof(not_mask_str), "%s%X", (not_mask<0xA)?"":"0x", (unsigned long)not_mask);
-  //	else
-  //		qsnprintf(not_mask_str, sizeof(not_mask_str), "%s%X%08X", (not_mask<0xA)?"":"0x", (unsigned long)(not_mask>>32), (unsigned long)not_mask);
+  GenerateMaskString(rot_mask_str, rot_mask);
 	
   // generate the resultant string
   if(mask == MASK64_ALLSET)
@@ -1128,7 +1073,7 @@ bool sldi(ea_t ea, char* buff, int buffSize)
   g_MB = 0;
   g_ME = 63-n;
 	
-  return gen_rldimi(ea, buff, buffSize, g_SH, g_MB, g_ME);
+  return gen_rldicr(ea, buff, buffSize, g_SH, g_MB, g_ME);
 }
 
 bool srdi(ea_t ea, char* buff, int buffSize)
@@ -1143,63 +1088,42 @@ bool srdi(ea_t ea, char* buff, int buffSize)
   g_MB = n;
   g_ME = 63;
 	
-  return gen_rldimi(ea, buff, buffSize, g_SH, g_MB, g_ME);
+  return gen_rldicl(ea, buff, buffSize, g_SH, g_MB, g_ME);
 }
 
 
 
+// the helpers above print the registers as they get them, so IDA's %r3
+// is converted to the r3 of the runtime like the other handlers do
+static void copy_operand(char* buff, int buffSize, const string &opnd)
+{
+  if(opnd.length() > 0 && opnd[0] == '%')
+    qstrncpy(buff, string(Register(opnd)).c_str(), buffSize);
+  else
+    qstrncpy(buff, opnd.c_str(), buffSize);
+}
+
 // try to do as much work in this function as possible in order to 
 // simplify each "instruction" handling function
-bool PPCAsm2C(ea_t ea, char* buff, int buffSize)
-{
-
-	// make sure address is valid and that it points to the start of an instruction
-	if(ea == BADADDR)
-		return false;
-	if( !isCode(get_flags_novalue(ea)) )
-		return false;
-	*buff = 0;
-	
-	// get instruction mnemonic
-	if( !ua_mnem(ea, g_mnem, sizeof(g_mnem)) )
-		return false;
-	tag_remove(g_mnem, g_mnem, sizeof(g_mnem));
-	char* ptr = (char*)qstrstr(g_mnem, ".");
-	if(ptr) *ptr = 0;
-	
-	// get instruction operand strings
-	// IDA only natively supports 3 operands
-	*g_opnd_s0 = 0;
-	ua_outop2(ea, g_opnd_s0, sizeof(g_opnd_s0), 0);
-	tag_remove(g_opnd_s0, g_opnd_s0, sizeof(g_opnd_s0));
-	
-	*g_opnd_s1 = 0;
-	ua_outop2(ea, g_opnd_s1, sizeof(g_opnd_s1), 1);
-	tag_remove(g_opnd_s1, g_opnd_s1, sizeof(g_opnd_s1));
-	
-	*g_opnd_s2 = 0;
-	ua_outop2(ea, g_opnd_s2, sizeof(g_opnd_s2), 2);
-	tag_remove(g_opnd_s2, g_opnd_s2, sizeof(g_opnd_s2));
-	
-	// use some string manipulation to extract additional operands
-	// when more than 3 operands are used
-	*g_opnd_s4 = 0;
-	*g_opnd_s3 = 0;
-	const char* comma1 = qstrstr(g_opnd_s2, ",");
-	if(comma1 != NULL)
-	{
-		// operand-3 exists
-		qstrncpy(g_opnd_s3, comma1+1, sizeof(g_opnd_s3));
-		g_opnd_s2[comma1-g_opnd_s2] = 0;
-		
-		const char* comma2 = qstrstr(comma1+1, ",");
-		if(comma2 != NULL)
-		{
-			// operand-4 exists
-			qstrncpy(g_opnd_s4, comma2+1, sizeof(g_opnd_s4));
-			g_opnd_s3[comma2-(comma1+1)] = 0;
-		}
-	}
+// the mnemonic and operand strings are the ones parse_instruction got
+// from IDA, so this works on an imported IR as well
+bool PPCAsm2C(Instruction &ins, char* buff, int buffSize)
+{
+	ea_t ea = ins.address;
+
+	if(ins.type != INSTRUCTION_TYPE_INSTRUCTION)
+		return false;
+	*buff = 0;
+	
+	// get instruction mnemonic, without its "."
+	qstrncpy(g_mnem, ins.name.c_str(), sizeof(g_mnem));
+	
+	// get instruction operand strings, already split in 5
+	copy_operand(g_opnd_s0, sizeof(g_opnd_s0), ins.operands[0]);
+	copy_operand(g_opnd_s1, sizeof(g_opnd_s1), ins.operands[1]);
+	copy_operand(g_opnd_s2, sizeof(g_opnd_s2), ins.operands[2]);
+	copy_operand(g_opnd_s3, sizeof(g_opnd_s3), ins.operands[3]);
+	copy_operand(g_opnd_s4, sizeof(g_opnd_s4), ins.operands[4]);
 
   // below is a list of supported instructions
   if(		qstrcmp(g_mnem, "bc")==0 )		return bc(		ea, buff, buffSize);
@@ -1271,68 +1195,121 @@ has_function(ea_t address)
 	return false;
 }
 
-static bool
-has_instruction(Function &func, ea_t address)
+static char buffer[1024];
+
+/* Comments of the function being parsed, read in a single walk over the
+ * flags of its range instead of two lookups at every instruction */
+static map<ea_t, string> comments;
+static map<ea_t, string> rpt_comments;
+
+static bool idaapi
+has_comment (flags_t F, void *ud)
 {
-	list<Instruction>::iterator it;
-	for (it = func.instructions.begin(); it != func.instructions.end(); it++) {
-		if ((*it).address == address)
-			return true;
-	}
+  return has_cmt(F);
+}
 
-	return false;
+static void
+read_comments (Function &func)
+{
+  ProfileScope metadata(PHASE_METADATA);
+  ea_t ea = func.address;
+
+  comments.clear();
+  rpt_comments.clear();
+  if (!has_cmt(get_flags_novalue(ea)))
+    ea = nextthat(ea, func.end_address, has_comment);
+  for (; ea != BADADDR; ea = nextthat(ea, func.end_address, has_comment)) {
+    if (get_cmt(ea, false, buffer, sizeof(buffer)) != -1)
+      comments[ea] = buffer;
+    if (get_cmt(ea, true, buffer, sizeof(buffer)) != -1)
+      rpt_comments[ea] = buffer;
+  }
 }
 
-static char buffer[1024];
+static void
+add_comment (Function &func, ea_t ea, const char *text)
+{
+  Instruction comment;
 
-static bool
-parse_instruction (Function &func, ea_t ea)
+  comment.address = ea;
+  comment.type = INSTRUCTION_TYPE_COMMENT;
+  comment.name = text;
+  func.instructions.push_back(comment);
+}
+
+/* Names and comments become labels and comments in the C code. The flags
+ * tell which addresses have any, which is almost none of them */
+static void
+parse_metadata (Function &func, ea_t ea, flags_t F)
 {
-  Instruction ins;
+  map<ea_t, string>::iterator it;
 
-  // make sure address is valid and that it points to the start of an instruction
-  if(ea == BADADDR)
-    return false;
-  if( !isCode(get_flags_novalue(ea)) )
-    return false;
+  if (!has_any_name(F) && !has_cmt(F))
+    return;
 
+  ProfileScope metadata(PHASE_METADATA);
 
-  if (get_name(ea, ea, buffer, sizeof(buffer)) != NULL) {
+  if (has_any_name(F) && get_name(ea, ea, buffer, sizeof(buffer)) != NULL) {
 	Instruction label;
 	label.address = ea;
 	label.type = INSTRUCTION_TYPE_LABEL;
     label.name = buffer;
     func.instructions.push_back(label);
   }
-  if (get_cmt(ea, false, buffer, sizeof(buffer)) != -1) {
-	Instruction comment;
-    comment.address = ea;
-    comment.type = INSTRUCTION_TYPE_COMMENT;
-    comment.name = buffer;
-    func.instructions.push_back(comment);
-  }
-  if (get_cmt(ea, true, buffer, sizeof(buffer)) != -1) {
-	Instruction rpt_comment;
-    rpt_comment.address = ea;
-	rpt_comment.type = INSTRUCTION_TYPE_COMMENT;
-    rpt_comment.name = buffer;
-    func.instructions.push_back(rpt_comment);
+  if (!has_cmt(F))
+    return;
+  if (ea >= func.address && ea < func.end_address) {
+    it = comments.find(ea);
+    if (it != comments.end())
+      add_comment(func, ea, it->second.c_str());
+    it = rpt_comments.find(ea);
+    if (it != rpt_comments.end())
+      add_comment(func, ea, it->second.c_str());
+  } else {
+    // Function chunks out of the range weren't read with the rest
+    if (get_cmt(ea, false, buffer, sizeof(buffer)) != -1)
+      add_comment(func, ea, buffer);
+    if (get_cmt(ea, true, buffer, sizeof(buffer)) != -1)
+      add_comment(func, ea, buffer);
   }
+}
+
+static bool
+parse_instruction (Function &func, ea_t ea)
+{
+  Instruction ins;
+
+  // make sure address is valid and that it points to the start of an instruction
+  if(ea == BADADDR)
+    return false;
+  flags_t F = get_flags_novalue(ea);
+  if( !isCode(F) )
+    return false;
+
 
+  parse_metadata(func, ea, F);
+
+  ProfileScope operands(PHASE_OPERANDS);
   // get instruction mnemonic
   if( !ua_mnem(ea, buffer, sizeof(buffer)) )
     return false;
   tag_remove(buffer, buffer, sizeof(buffer));
-  
-  // Some mnemonics are wrong, let's fix them.
-  ua_ana0(ea);
-  if(cmd.itype == 13 && (cmd.auxpref & 8)) {
-    // fix mnemonic for "bl"
-	qstrncpy(buffer, "bl", sizeof(buffer));
-  } else if(cmd.itype == 320 && cmd.auxpref == 0x500) {
-    // fix mnemonic for "blr"
-	qstrncpy(buffer, "blr", sizeof(buffer));
-  }
+  
+  // Some mnemonics are wrong, let's fix them.
+  ua_ana0(ea);
+  ins.word = get_long(ea);
+  for (int i = 0; i < UA_MAXOP; i++) {
+	ins.ops[i].type = cmd.Operands[i].type;
+	ins.ops[i].reg = cmd.Operands[i].reg;
+	ins.ops[i].value = cmd.Operands[i].type == o_imm ? cmd.Operands[i].value : cmd.Operands[i].addr;
+  }
+  if(cmd.itype == 13 && (cmd.auxpref & 8)) {
+    // fix mnemonic for "bl"
+	qstrncpy(buffer, "bl", sizeof(buffer));
+  } else if(cmd.itype == 320 && cmd.auxpref == 0x500) {
+    // fix mnemonic for "blr"
+	qstrncpy(buffer, "blr", sizeof(buffer));
+  }
 
   ins.type = INSTRUCTION_TYPE_INSTRUCTION;
   ins.address = ea;
@@ -1393,6 +1370,7 @@ parse_instruction (Function &func, ea_t ea)
   /*DEBUG ("Instruction at %a is : '%s' - '%s' - '%s' - '%s' - '%s' - '%s'\n", ea, ins.name.c_str(),
        ins.operands[0].c_str(), ins.operands[1].c_str(), ins.operands[2].c_str(), ins.operands[3].c_str(), ins.operands[4].c_str());*/
   func.instructions.push_back(ins);
+  profile_count(COUNTER_INSTRUCTIONS);
 
   return true;
 }
@@ -1403,6 +1381,7 @@ parse_function (ea_t address, bool recursive = true)
 	func_t* p_func = NULL;
 	bool success = true;
 	Function func;
+	ProfileScope cfg(PHASE_CFG);
 
 	p_func = get_func(address);
 	if(p_func == NULL) {
@@ -1423,7 +1402,7 @@ parse_function (ea_t address, bool recursive = true)
 	set<ea_t> instructions;
 	set<ea_t>::iterator iter1;
 	set<ea_t>::iterator iter2;
-	set<ea_t> calls;
+	set<ea_t> &calls = func.calls;
 	bool modified = true;
 
 	//_Export_sysPrxForUser_sys_time_get_system_time
@@ -1459,32 +1438,42 @@ break_loop2:
 		}
 	}
 
+	read_comments(func);
 	for (iter1 = instructions.begin(); success && iter1 != instructions.end(); iter1++) {
 		ea = *iter1;
 		//DEBUG("Looping instruction list : %a\n", ea);
 		success &= parse_instruction(func, ea);
+		if (!success)
+			break;
+		Instruction &ins = func.instructions.back();
 		for (bool ok = xb.first_from(ea, XREF_ALL); ok && xb.iscode; ok = xb.next_from()) {
 			//DEBUG("Third xref from %a to %a : %s (%d)\n", xb.from, xb.to, xb.type == fl_F? "Flow" : xb.type == fl_JN? "Jump near" : xb.type == fl_JF ? "Jump far" : xb.type == fl_CN ? "Call near" : xb.type == fl_CF ? "Call far" : "unknown flow", xb.type);
-			if (xb.type == fl_F && has_instruction(func, xb.to)) {
-				Instruction flow;
-				
-				flow.address = ea;
-				flow.type = INSTRUCTION_TYPE_FLOW;
-				if (get_name(xb.to, xb.to, buffer, sizeof(buffer)) != NULL) {
-					flow.name = buffer;
-					//DEBUG ("Flow goes to %s\n", flow.name.c_str());
-				} else {
-					ERROR ("Flow expected to have a label at %a\n", xb.to);
-				}
-				func.instructions.push_back(flow);
-			}
+			if (xb.type == fl_F)
+				ins.flow = true;
+			if (xb.type == fl_JN || xb.type == fl_JF)
+				ins.target = xb.to;
 			if (xb.type == fl_CN || xb.type == fl_CF)
 				calls.insert(xb.to);
 		}
+		// The lowering only sees the tables, not the database
+		if (get_branch_type(ins) == BRANCH_INDIRECT) {
+			JumpTable table;
+			if (read_jump_table(ea, table))
+				func.tables[ea] = table;
+		}
 	}
 
 	if (success) {
+		ea_t toc = get_function_toc(func.address);
+		// Identical bodies are only lowered once
+		if (find_duplicate(func, toc)) {
+			profile_count(COUNTER_ALIASES);
+		} else {
+			ProfileScope lowering(PHASE_LOWERING);
+			propagate_constants(func, toc);
+		}
 		functions.push_back(func);
+		profile_count(COUNTER_FUNCTIONS);
 		if (recursive) {
 			set<ea_t>::iterator it;
 			for (it = calls.begin(); success && it != calls.end(); it++) {
@@ -1498,107 +1487,409 @@ break_loop2:
 	return success;
 }
 
-#define OUTPUT msg
+/* Everything printed goes through here so emission gets its own timer */
+static int
+output (const char *format, ...)
+{
+	ProfileScope emission(PHASE_EMISSION);
+	va_list va;
+	const char *c;
+	int len;
+
+	va_start(va, format);
+	len = vmsg(format, va);
+	va_end(va);
+	if (len > 0)
+		profile_count(COUNTER_BYTES, len);
+	// Arguments are single statements, the lines are in the format
+	for (c = format; *c; c++)
+		if (*c == '\n')
+			profile_count(COUNTER_LINES);
+
+	return len;
+}
+
+#define OUTPUT output
 
 static void
 generate_prototype (Function &func)
 {
-	OUTPUT("%s %s (", func.ret ? "uint64" : "void", func.name.c_str());
-	for (int i = 0; i < func.arguments; i++)
-		OUTPUT ("uint64t arg%d%s", i+1, i == func.arguments-1 ? "" : ", ");
-	OUTPUT(")");
+	// Arguments and return value travel in the register file
+	OUTPUT("void %s (ppc_context_t *ctx)", c_identifier(func.name).c_str());
+}
+
+static void
+generate_result (Instruction &ins, HandlerResult &result, Instruction &inline_comment, int indent)
+{
+	if (!result.c_code.empty()) {
+	  OUTPUT ("%*s%s%s\n",
+			ins.type == INSTRUCTION_TYPE_INSTRUCTION ? indent : 0, "",
+			code_arena.c_str(result.c_code),
+			inline_comment.type != INSTRUCTION_TYPE_NONE? ("; // " + inline_comment.name).c_str() : ";");
+	} else if (inline_comment.type != INSTRUCTION_TYPE_NONE) {
+		OUTPUT("%*s// %s\n", indent, "", inline_comment.name.c_str());
+	}
+	inline_comment.type = INSTRUCTION_TYPE_NONE;
 }
 
 static bool
-generate_functions ()
+generate_instruction (Function &func, Instruction &ins, Instruction &inline_comment, int indent)
 {
-	list<Function>::iterator it;
-	for (it = functions.begin(); it != functions.end(); it++) {
-		Function func = *it;
-		list<Instruction>::iterator iter;
-		Instruction inline_comment;
+	int i;
+	if (ins.dead || ins.folded != "") {
+		// Constant propagation already worked out the result
+		if (!ins.dead)
+			OUTPUT ("%*s%s%s\n", indent, "", ins.folded.c_str(),
+				inline_comment.type != INSTRUCTION_TYPE_NONE? (" // " + inline_comment.name).c_str() : "");
+		else if (inline_comment.type != INSTRUCTION_TYPE_NONE)
+			OUTPUT("%*s// %s\n", indent, "", inline_comment.name.c_str());
+		inline_comment.type = INSTRUCTION_TYPE_NONE;
+		return true;
+	}
+	for (i = 0; instruction_set[i].instruction; i++) {
+		if (instruction_set[i].type == ins.type &&
+			ins.name == instruction_set[i].instruction) {
+			HandlerResult result;
+			size_t start = code_arena.mark();
+			if (!instruction_set[i].check_operands (ins)) {
+				ERROR ("Assertion : Wrong number of operands for instruction : %s\n", ins.name.c_str());
+				DEBUG("Wrong number of args : %s%s%s%s%s%s\n",
+					ins.name.c_str(),
+					ins.operands[0] != ""? (" " + ins.operands[0]).c_str() : "",
+					ins.operands[1] != ""? (" " + ins.operands[1]).c_str() : "",
+					ins.operands[2] != ""? (" " + ins.operands[2]).c_str() : "",
+					ins.operands[3] != ""? (" " + ins.operands[3]).c_str() : "",
+					ins.operands[4] != ""? (" " + ins.operands[4]).c_str() : "");
+				return false;
+			}
+			instruction_set[i].handler (func, ins, &result);
+			result.c_code = code_arena.slice(start);
+			generate_result (ins, result, inline_comment, indent);
+			break;
+		}
+	}
+	if (instruction_set[i].instruction == NULL && is_vector_instruction (ins)) {
+		HandlerResult result;
+		size_t start = code_arena.mark();
+		if (!handle_vector (func, ins, &result))
+			return false;
+		result.c_code = code_arena.slice(start);
+		generate_result (ins, result, inline_comment, indent);
+	} else if (instruction_set[i].instruction == NULL) {
+		//ERROR ("Error: Unknown instruction : %s\n", ins.name.c_str());
+		//return false;
+		OUTPUT ("%*s/* Unknown instruction : %s%s%s%s%s%s */\n", indent, "",
+			ins.name.c_str(),
+			ins.operands[0] != ""? (" " + ins.operands[0]).c_str() : "",
+			ins.operands[1] != ""? (" " + ins.operands[1]).c_str() : "",
+			ins.operands[2] != ""? (" " + ins.operands[2]).c_str() : "",
+			ins.operands[3] != ""? (" " + ins.operands[3]).c_str() : "",
+			ins.operands[4] != ""? (" " + ins.operands[4]).c_str() : "");
+		profile_count(COUNTER_UNKNOWN);
+		coverage_unknown(ins);
 		inline_comment.type = INSTRUCTION_TYPE_NONE;
+	}
+	return true;
+}
 
-		generate_prototype(func);
-		OUTPUT ("\n{\n");
-		OUTPUT ("  uint64_t LR, *sp, *rtoc, r0, r1, r2, r3, r4, r5, r6,\n");
-		OUTPUT ("      r7, r8, r9, r10, r11, r12, r13, r14, r15, r16,\n");
-		OUTPUT ("      r17, r18, r19, r20, r21, r22, r23, r24, r25, r26,\n");
-		OUTPUT ("      r27, r28, r29, r30, r31, r32;\n\n");
-
-		for (iter = func.instructions.begin(); iter != func.instructions.end(); iter++) {
-			Instruction ins = *iter;
-			switch (ins.type) {
-			case INSTRUCTION_TYPE_COMMENT:
-				OUTPUT ("  /* %s */\n", ins.name.c_str());
-				break;
-			case INSTRUCTION_TYPE_INLINE_COMMENT:
-				inline_comment = ins;
-				break;
-			case INSTRUCTION_TYPE_LABEL:
-				if (ins.name != func.name)
-					OUTPUT ("  %s:\n", ins.name.c_str());
+static bool
+generate_block (Function &func, BasicBlock &block, int indent)
+{
+	list<Instruction>::iterator iter;
+	Instruction inline_comment;
+	vector<string> spills;
+	size_t i;
+	inline_comment.type = INSTRUCTION_TYPE_NONE;
+
+	if (block.goto_target)
+		OUTPUT ("%*s%s:\n", indent - 2, "", block.label.c_str());
+
+	// Compares of the blocks before reach this one through CR
+	reset_conditions (block.live_conditions, block.call_conditions);
+
+	for (iter = block.begin; iter != block.end; iter++) {
+		Instruction &ins = *iter;
+		switch (ins.type) {
+		case INSTRUCTION_TYPE_COMMENT:
+			OUTPUT ("%*s/* %s */\n", indent, "", ins.name.c_str());
+			break;
+		case INSTRUCTION_TYPE_INLINE_COMMENT:
+			inline_comment = ins;
+			break;
+		case INSTRUCTION_TYPE_LABEL:
+			break;
+		case INSTRUCTION_TYPE_PREPROCESSOR:
+		case INSTRUCTION_TYPE_INSTRUCTION:
+			// Branches are expressed by the structure around the block
+			if (&ins == block.branch) {
+				if (inline_comment.type != INSTRUCTION_TYPE_NONE)
+					OUTPUT("%*s// %s\n", indent, "", inline_comment.name.c_str());
+				inline_comment.type = INSTRUCTION_TYPE_NONE;
 				break;
-			case INSTRUCTION_TYPE_PREPROCESSOR:
-			case INSTRUCTION_TYPE_INSTRUCTION:
-				{
-					int i;
-					for (i = 0; instruction_set[i].instruction; i++) {
-						if (instruction_set[i].type == ins.type &&
-							ins.name == instruction_set[i].instruction) {
-							HandlerResult result;
-							if (!instruction_set[i].check_operands (ins)) {
-								ERROR ("Assertion : Wrong number of operands for instruction : %s\n", ins.name.c_str());
-								DEBUG("Wrong number of args : %s%s%s%s%s%s\n",
-									ins.name.c_str(),
-									ins.operands[0] != ""? (" " + ins.operands[0]).c_str() : "",
-									ins.operands[1] != ""? (" " + ins.operands[1]).c_str() : "",
-									ins.operands[2] != ""? (" " + ins.operands[2]).c_str() : "",
-									ins.operands[3] != ""? (" " + ins.operands[3]).c_str() : "",
-									ins.operands[4] != ""? (" " + ins.operands[4]).c_str() : "");
-								return false;
-							}
-							instruction_set[i].handler (func, ins, &result);
-
-							if (result.c_code != "") {
-							  OUTPUT ("%s%s%s\n",
-									ins.type == INSTRUCTION_TYPE_INSTRUCTION ? "  " : "",
-									result.c_code.c_str(),
-									inline_comment.type != INSTRUCTION_TYPE_NONE? ("; // " + inline_comment.name).c_str() : ";");
-							} else if (inline_comment.type != INSTRUCTION_TYPE_NONE) {
-								OUTPUT("  // %s\n", inline_comment.name.c_str());
-							}
-							inline_comment.type = INSTRUCTION_TYPE_NONE;
-							break;
-						}
-					}
-					if (instruction_set[i].instruction == NULL) {
-						//ERROR ("Error: Unknown instruction : %s\n", ins.name.c_str());
-						//return false;
-						OUTPUT ("  /* Unknown instruction : %s%s%s%s%s%s */\n",
-							ins.name.c_str(),
-							ins.operands[0] != ""? (" " + ins.operands[0]).c_str() : "",
-							ins.operands[1] != ""? (" " + ins.operands[1]).c_str() : "",
-							ins.operands[2] != ""? (" " + ins.operands[2]).c_str() : "",
-							ins.operands[3] != ""? (" " + ins.operands[3]).c_str() : "",
-							ins.operands[4] != ""? (" " + ins.operands[4]).c_str() : "");
-					}
+			}
+			spills.clear ();
+			spill_conditions (ins, spills);
+			for (i = 0; i < spills.size(); i++)
+				OUTPUT ("%*s%s\n", indent, "", spills[i].c_str());
+			if (!generate_instruction (func, ins, inline_comment, indent))
+				return false;
+			break;
+		default:
+			ERROR ("Error: Unexpected instruction type\n");
+			return false;
+		}
+	}
+
+	spills.clear ();
+	flush_conditions (block.branch, spills);
+	for (i = 0; i < spills.size(); i++)
+		OUTPUT ("%*s%s\n", indent, "", spills[i].c_str());
+	return true;
+}
+
+/* Returns the single statement a jump node is printed as, or an empty string
+ * if it needs more than one */
+static string
+jump_statement (Function &func, vector<BasicBlock> &blocks, Node &node)
+{
+	switch (node.type) {
+	case NODE_BREAK:
+		return "break;";
+	case NODE_CONTINUE:
+		return "continue;";
+	case NODE_GOTO:
+		return "goto " + blocks[node.block].label + ";";
+	case NODE_RETURN:
+		if (node.block != BLOCK_NONE && blocks[node.block].type == BRANCH_INDIRECT)
+			return "PPC2C_TAILCALL_INDIRECT (ctx, CTR);";
+		if (node.block != BLOCK_NONE && blocks[node.block].taken == BLOCK_EXIT &&
+			(blocks[node.block].type == BRANCH_ALWAYS || blocks[node.block].type == BRANCH_CONDITIONAL)) {
+			// Tail call, the target is the last operand of the branch
+			Instruction *branch = blocks[node.block].branch;
+			int i;
+			for (i = 4; i > 0 && branch->operands[i] == ""; i--);
+			return "PPC2C_TAILCALL (ctx, " + c_identifier(branch->operands[i]) + ");";
+		}
+		return "PPC2C_RETURN (ctx);";
+	default:
+		return "";
+	}
+}
+
+static bool
+generate_nodes (Function &func, vector<BasicBlock> &blocks, list<Node> &nodes, int indent)
+{
+	list<Node>::iterator it;
+	for (it = nodes.begin(); it != nodes.end(); it++) {
+		Node &node = *it;
+		string statement;
+		switch (node.type) {
+		case NODE_BLOCK:
+			if (!generate_block (func, blocks[node.block], indent))
+				return false;
+			break;
+		case NODE_IF:
+			{
+				string condition = branch_condition (*blocks[node.block].branch, node.negate);
+				if (node.else_body.size() == 0 && node.body.size() == 1)
+					statement = jump_statement (func, blocks, node.body.front());
+				if (statement != "") {
+					OUTPUT ("%*sif (%s) %s\n", indent, "", condition.c_str(), statement.c_str());
+					break;
 				}
-				break;
-			case INSTRUCTION_TYPE_FLOW:
-				OUTPUT ("  goto %s;\n", ins.name.c_str());
-				break;
-			default:
-				ERROR ("Error: Unexpected instruction type\n");
+				OUTPUT ("%*sif (%s) {\n", indent, "", condition.c_str());
+				if (!generate_nodes (func, blocks, node.body, indent + 2))
+					return false;
+				if (node.else_body.size() > 0) {
+					OUTPUT ("%*s} else {\n", indent, "");
+					if (!generate_nodes (func, blocks, node.else_body, indent + 2))
+						return false;
+				}
+				OUTPUT ("%*s}\n", indent, "");
+			}
+			break;
+		case NODE_LOOP:
+			if (node.loop == LOOP_WHILE) {
+				// The header only holds the comparison, evaluated by the condition
+				if (!generate_block (func, blocks[node.block], indent))
+					return false;
+				OUTPUT ("%*swhile (%s) {\n", indent, "",
+					branch_condition (*blocks[node.block].branch, node.negate).c_str());
+			} else {
+				OUTPUT ("%*s%s {\n", indent, "", node.loop == LOOP_DO_WHILE ? "do" : "while (1)");
+			}
+			if (!generate_nodes (func, blocks, node.body, indent + 2))
 				return false;
+			if (node.loop == LOOP_DO_WHILE)
+				OUTPUT ("%*s} while (%s);\n", indent, "",
+					branch_condition (*blocks[node.block].branch, node.negate).c_str());
+			else
+				OUTPUT ("%*s}\n", indent, "");
+			break;
+		case NODE_SWITCH:
+			{
+				list<Node>::iterator c;
+				OUTPUT ("%*sswitch ((uint32_t) %s) {\n", indent, "",
+					string (Register (blocks[node.block].switch_register)).c_str());
+				for (c = node.body.begin(); c != node.body.end(); c++) {
+					size_t i;
+					if (c->values.size() == 0)
+						OUTPUT ("%*sdefault:\n", indent, "");
+					for (i = 0; i < c->values.size(); i++)
+						OUTPUT ("%*scase %u:\n", indent, "", (uint32) c->values[i]);
+					if (!generate_nodes (func, blocks, c->body, indent + 2))
+						return false;
+				}
+				OUTPUT ("%*s}\n", indent, "");
 			}
+			break;
+		default:
+			OUTPUT ("%*s%s\n", indent, "", jump_statement (func, blocks, node).c_str());
+			break;
+		}
+	}
+	return true;
+}
+
+/* Vector registers used by a function live in locals too, which the
+ * register file macros of the runtime pick up through these */
+static void
+generate_vector_locals (uint32 used)
+{
+	string locals, load, store;
+	int i;
+
+	for (i = 0; i < VECTOR_REGISTERS; i++) {
+		if ((used & (1u << i)) == 0)
+			continue;
+		string reg = "vr" + tostr(i);
+		locals += (locals == "" ? "__m128i " : ", ") + reg;
+		load += (load == "" ? "" : "; ") + reg + " = PPC2C_VR_GET (ctx, " + tostr(i) + ")";
+		store += (store == "" ? "" : "; ") + string ("PPC2C_VR_SET (ctx, ") + tostr(i) + ", " + reg + ")";
+	}
+	OUTPUT ("#undef PPC2C_VECTOR_LOCALS\n#undef PPC2C_VECTOR_LOAD\n#undef PPC2C_VECTOR_STORE\n");
+	if (used == 0) {
+		OUTPUT ("#define PPC2C_VECTOR_LOCALS\n");
+		OUTPUT ("#define PPC2C_VECTOR_LOAD(ctx)\n");
+		OUTPUT ("#define PPC2C_VECTOR_STORE(ctx)\n\n");
+	} else {
+		OUTPUT ("#define PPC2C_VECTOR_LOCALS %s;\n", locals.c_str());
+		OUTPUT ("#define PPC2C_VECTOR_LOAD(ctx) %s\n", load.c_str());
+		OUTPUT ("#define PPC2C_VECTOR_STORE(ctx) %s\n\n", store.c_str());
+	}
+}
+
+static bool
+generate_functions ()
+{
+	list<Function>::iterator it;
+	ProfileScope lowering(PHASE_LOWERING);
+	for (it = functions.begin(); it != functions.end(); it++) {
+		Function &func = *it;
+		vector<BasicBlock> blocks;
+		list<Node> nodes;
+
+		// The C code of the previous function is printed already
+		code_arena.reset();
+
+		if (func.alias != "") {
+			generate_prototype(func);
+			OUTPUT ("\n{\n  %s (ctx);\n}\n\n", c_identifier(func.alias).c_str());
+			continue;
 		}
 
+		uint32 vectors = vector_registers (func);
+
+		{
+			ProfileScope cfg(PHASE_CFG);
+			build_blocks (func, blocks);
+			structure_function (blocks, nodes);
+		}
+
+		if (vectors != 0)
+			generate_vector_locals (vectors);
+		generate_prototype(func);
+		OUTPUT ("\n{\n");
+		OUTPUT ("  PPC2C_ENTER (ctx);\n\n");
+
+		if (!generate_nodes (func, blocks, nodes, 2))
+			return false;
+
 		OUTPUT ("}\n\n");
+		if (vectors != 0)
+			generate_vector_locals (0);
 	}
 	return true;
 }
 
+/* Lets the runtime find lifted functions from a guest address, for indirect
+ * calls through CTR */
+static void
+generate_export_table ()
+{
+	list<Function>::iterator it;
+	OUTPUT ("const ppc2c_export_t ppc2c_lifted[] = {\n");
+	for (it = functions.begin(); it != functions.end(); it++)
+		OUTPUT ("  {0x%08X, %s},\n", (uint32)it->address, c_identifier(it->name).c_str());
+	OUTPUT ("  {0, NULL}\n};\n");
+}
+
+#define IMAGE_MAGIC "PPC2CIMG"
+#define IMAGE_VERSION 1
+
+static void
+write_be32 (FILE *f, uint32 value)
+{
+	uchar bytes[4];
+	bytes[0] = (uchar) (value >> 24);
+	bytes[1] = (uchar) (value >> 16);
+	bytes[2] = (uchar) (value >> 8);
+	bytes[3] = (uchar) value;
+	qfwrite(f, bytes, sizeof(bytes));
+}
+
+/* Save every segment in the format ppc2c_load_image() reads, so the
+ * generated code can run against the memory of this database */
+static bool
+export_memory_image ()
+{
+	uchar data[0x10000];
+	char *path;
+	FILE *f;
+	int count = get_segm_qty();
+
+	path = askfile_c(1, "*.img", "Save the memory image for the PPC2C runtime");
+	if (path == NULL)
+		return false;
+	f = qfopen(path, "wb");
+	if (f == NULL) {
+		warning("Can't open %s for writing\n", path);
+		return false;
+	}
+
+	qfwrite(f, IMAGE_MAGIC, 8);
+	write_be32(f, IMAGE_VERSION);
+	write_be32(f, count);
+	for (int n = 0; n < count; n++) {
+		segment_t *seg = getnseg(n);
+		write_be32(f, (uint32)seg->startEA);
+		write_be32(f, (uint32)(seg->endEA - seg->startEA));
+		for (ea_t ea = seg->startEA; ea < seg->endEA; ea += sizeof(data)) {
+			size_t size = (size_t) qmin(seg->endEA - ea, (ea_t) sizeof(data));
+			if (!get_many_bytes(ea, data, size)) {
+				// Some bytes have no value, .bss for example
+				for (size_t i = 0; i < size; i++)
+					data[i] = isLoaded(ea + i) ? get_byte(ea + i) : 0;
+			}
+			qfwrite(f, data, size);
+		}
+	}
+	qfclose(f);
+	msg("Saved %d segments to %s\n", count, path);
+
+	return true;
+}
+
 int idaapi PluginStartup(void)
 {
   // PPC To C only works with PPC code :)
@@ -1616,24 +1907,80 @@ void idaapi PluginShutdown(void)
 }
 
 
-void idaapi PluginMain(int param)
+/* Save the parsed functions for ppc2c-lower instead of printing them */
+static bool
+export_functions ()
 {
+	char *path;
 
-	clock_t begin = clock();
+	path = askfile_c(1, "*.ir", "Save the functions for ppc2c-lower");
+	if (path == NULL)
+		return false;
+	if (!export_ir(path, functions))
+		return false;
+	msg("Saved %d functions to %s\n", functions.size(), path);
 
-	functions.clear();
-	parse_function (get_screen_ea(), true);
+	return true;
+}
+
+static bool
+generate_c ()
+{
+	bool vectors = false;
+	for (list<Function>::iterator it = functions.begin(); it != functions.end(); it++)
+		vectors |= vector_registers (*it) != 0;
 
-    OUTPUT ("#include <stdint.h>\n\n");
+	OUTPUT ("#include \"%s\"\n\n", vectors ? "ppc2c_altivec.h" : "ppc2c_runtime.h");
 	for (list<Function>::iterator it = functions.begin(); it != functions.end(); it++) {
 		generate_prototype (*it);
 		OUTPUT (";\n");
 	}
-	generate_functions ();
+	if (!generate_functions ())
+		return false;
+	generate_export_table ();
+
+	return true;
+}
+
+bool
+lower_ir (const uchar *data, size_t size)
+{
+	profile_reset();
+
+	functions.clear();
+	if (!import_ir(data, size, functions))
+		return false;
+
+	return generate_c ();
+}
+
+void idaapi PluginMain(int param)
+{
+
+	// Run with 1 as argument in plugins.cfg to export the memory image
+	if (param == 1) {
+		export_memory_image ();
+		return;
+	}
+
+	profile_reset();
+
+	functions.clear();
+	dedup_reset();
+	load_toc_map();
+	parse_function (get_screen_ea(), true);
+
+	// and with 2 to save the functions for ppc2c-lower
+	if (param == 2) {
+		export_functions ();
+		return;
+	}
+
+	generate_c ();
 
-	clock_t end=clock();
-	double diffms = ((double)(end-begin)*1000)/CLOCKS_PER_SEC;
-	msg("Found %d functions in : %2d:%3d\n", functions.size(), (int)diffms/1000, (int)diffms%1000);
+	msg("Found %d functions\n", functions.size());
+	profile_report();
+	coverage_report();
 }
 
 
@@ -0,0 +1,366 @@
+/*
+ * ppc2c_altivec.cpp -- Vector instructions for the PPC to C converter
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+/*
+ * Lowers the Altivec/VMX instructions decoded by the PPCAltivec plugin, which
+ * come to us with the mnemonics of its g_altivecOpcodes table and with the
+ * vector registers printed as "%vrN", into SSE intrinsics working on
+ * __m128i locals. The big-endian element order is handled by keeping
+ * registers byte-reversed, see runtime/ppc2c_altivec.h, so templates picking
+ * elements by position have their indices flipped.
+ *
+ * Templates use %0 to %3 for the operands as vector registers, %f0 to %f3
+ * for their float view, %i for the immediate ending the operand list and %x
+ * for the address given by the rA|0 + rB operands.
+ *
+ * The VMX128 forms of the Xbox 360 and the Gekko paired singles aren't
+ * lowered, Cell's PPU has neither.
+ */
+
+#include "ppc2c_altivec.hpp"
+
+static const struct {
+  const char *mnemonic;
+  int operands;
+  const char *code;
+} vector_forms[] = {
+  /* Loads and stores */
+  {"lvebx", 3, "%0 = ppc2c_lvx (%x)"},
+  {"lvehx", 3, "%0 = ppc2c_lvx (%x)"},
+  {"lvewx", 3, "%0 = ppc2c_lvx (%x)"},
+  {"lvx", 3, "%0 = ppc2c_lvx (%x)"},
+  {"lvxl", 3, "%0 = ppc2c_lvx (%x)"},
+  {"lvsl", 3, "%0 = ppc2c_lvsl (%x)"},
+  {"lvsr", 3, "%0 = ppc2c_lvsr (%x)"},
+  {"lvlx", 3, "%0 = ppc2c_lvlx (%x)"},
+  {"lvlxl", 3, "%0 = ppc2c_lvlx (%x)"},
+  {"lvrx", 3, "%0 = ppc2c_lvrx (%x)"},
+  {"lvrxl", 3, "%0 = ppc2c_lvrx (%x)"},
+  {"stvebx", 3, "ppc2c_stvebx (%x, %0)"},
+  {"stvehx", 3, "ppc2c_stvehx (%x, %0)"},
+  {"stvewx", 3, "ppc2c_stvewx (%x, %0)"},
+  {"stvx", 3, "ppc2c_stvx (%x, %0)"},
+  {"stvxl", 3, "ppc2c_stvx (%x, %0)"},
+  {"stvlx", 3, "ppc2c_stvlx (%x, %0)"},
+  {"stvlxl", 3, "ppc2c_stvlx (%x, %0)"},
+  {"stvrx", 3, "ppc2c_stvrx (%x, %0)"},
+  {"stvrxl", 3, "ppc2c_stvrx (%x, %0)"},
+  /* Data stream hints */
+  {"dst", 3, ""},
+  {"dstt", 3, ""},
+  {"dstst", 3, ""},
+  {"dststt", 3, ""},
+  {"dss", 1, ""},
+  {"dssall", 0, ""},
+  /* Saturation isn't tracked, VSCR only keeps what was written to it */
+  {"mfvscr", 1, "%0 = _mm_cvtsi32_si128 ((int) ctx->vscr)"},
+  {"mtvscr", 1, "ctx->vscr = (uint32_t) _mm_cvtsi128_si32 (%0)"},
+  /* Integer arithmetic */
+  {"vaddubm", 3, "%0 = _mm_add_epi8 (%1, %2)"},
+  {"vadduhm", 3, "%0 = _mm_add_epi16 (%1, %2)"},
+  {"vadduwm", 3, "%0 = _mm_add_epi32 (%1, %2)"},
+  {"vaddsbs", 3, "%0 = _mm_adds_epi8 (%1, %2)"},
+  {"vaddshs", 3, "%0 = _mm_adds_epi16 (%1, %2)"},
+  {"vaddsws", 3, "%0 = ppc2c_vaddsws (%1, %2)"},
+  {"vaddubs", 3, "%0 = _mm_adds_epu8 (%1, %2)"},
+  {"vadduhs", 3, "%0 = _mm_adds_epu16 (%1, %2)"},
+  {"vadduws", 3, "%0 = ppc2c_vadduws (%1, %2)"},
+  {"vaddcuw", 3, "%0 = ppc2c_vaddcuw (%1, %2)"},
+  {"vsububm", 3, "%0 = _mm_sub_epi8 (%1, %2)"},
+  {"vsubuhm", 3, "%0 = _mm_sub_epi16 (%1, %2)"},
+  {"vsubuwm", 3, "%0 = _mm_sub_epi32 (%1, %2)"},
+  {"vsubsbs", 3, "%0 = _mm_subs_epi8 (%1, %2)"},
+  {"vsubshs", 3, "%0 = _mm_subs_epi16 (%1, %2)"},
+  {"vsubsws", 3, "%0 = ppc2c_vsubsws (%1, %2)"},
+  {"vsububs", 3, "%0 = _mm_subs_epu8 (%1, %2)"},
+  {"vsubuhs", 3, "%0 = _mm_subs_epu16 (%1, %2)"},
+  {"vsubuws", 3, "%0 = ppc2c_vsubuws (%1, %2)"},
+  {"vsubcuw", 3, "%0 = ppc2c_vsubcuw (%1, %2)"},
+  {"vavgub", 3, "%0 = _mm_avg_epu8 (%1, %2)"},
+  {"vavguh", 3, "%0 = _mm_avg_epu16 (%1, %2)"},
+  {"vavguw", 3, "%0 = ppc2c_vavguw (%1, %2)"},
+  {"vavgsb", 3, "%0 = ppc2c_vavgsb (%1, %2)"},
+  {"vavgsh", 3, "%0 = ppc2c_vavgsh (%1, %2)"},
+  {"vavgsw", 3, "%0 = ppc2c_vavgsw (%1, %2)"},
+  {"vmaxub", 3, "%0 = _mm_max_epu8 (%1, %2)"},
+  {"vmaxuh", 3, "%0 = _mm_max_epu16 (%1, %2)"},
+  {"vmaxuw", 3, "%0 = _mm_max_epu32 (%1, %2)"},
+  {"vmaxsb", 3, "%0 = _mm_max_epi8 (%1, %2)"},
+  {"vmaxsh", 3, "%0 = _mm_max_epi16 (%1, %2)"},
+  {"vmaxsw", 3, "%0 = _mm_max_epi32 (%1, %2)"},
+  {"vminub", 3, "%0 = _mm_min_epu8 (%1, %2)"},
+  {"vminuh", 3, "%0 = _mm_min_epu16 (%1, %2)"},
+  {"vminuw", 3, "%0 = _mm_min_epu32 (%1, %2)"},
+  {"vminsb", 3, "%0 = _mm_min_epi8 (%1, %2)"},
+  {"vminsh", 3, "%0 = _mm_min_epi16 (%1, %2)"},
+  {"vminsw", 3, "%0 = _mm_min_epi32 (%1, %2)"},
+  /* Multiplies, even elements are the odd host lanes */
+  {"vmuleub", 3, "%0 = ppc2c_vmuleub (%1, %2)"},
+  {"vmuloub", 3, "%0 = ppc2c_vmuloub (%1, %2)"},
+  {"vmulesb", 3, "%0 = ppc2c_vmulesb (%1, %2)"},
+  {"vmulosb", 3, "%0 = ppc2c_vmulosb (%1, %2)"},
+  {"vmuleuh", 3, "%0 = ppc2c_vmuleuh (%1, %2)"},
+  {"vmulouh", 3, "%0 = ppc2c_vmulouh (%1, %2)"},
+  {"vmulesh", 3, "%0 = ppc2c_vmulesh (%1, %2)"},
+  {"vmulosh", 3, "%0 = ppc2c_vmulosh (%1, %2)"},
+  {"vmladduhm", 4, "%0 = _mm_add_epi16 (_mm_mullo_epi16 (%1, %2), %3)"},
+  {"vmhaddshs", 4, "%0 = ppc2c_vmhaddshs (%1, %2, %3)"},
+  {"vmhraddshs", 4, "%0 = ppc2c_vmhraddshs (%1, %2, %3)"},
+  {"vmsumshm", 4, "%0 = _mm_add_epi32 (_mm_madd_epi16 (%1, %2), %3)"},
+  {"vmsumshs", 4, "%0 = ppc2c_vmsumshs (%1, %2, %3)"},
+  {"vmsumubm", 4, "%0 = ppc2c_vmsumubm (%1, %2, %3)"},
+  {"vmsummbm", 4, "%0 = ppc2c_vmsummbm (%1, %2, %3)"},
+  {"vmsumuhm", 4, "%0 = ppc2c_vmsumuhm (%1, %2, %3)"},
+  {"vmsumuhs", 4, "%0 = ppc2c_vmsumuhs (%1, %2, %3)"},
+  {"vsumsws", 3, "%0 = ppc2c_vsumsws (%1, %2)"},
+  {"vsum2sws", 3, "%0 = ppc2c_vsum2sws (%1, %2)"},
+  {"vsum4ubs", 3, "%0 = ppc2c_vsum4ubs (%1, %2)"},
+  {"vsum4sbs", 3, "%0 = ppc2c_vsum4sbs (%1, %2)"},
+  {"vsum4shs", 3, "%0 = ppc2c_vsum4shs (%1, %2)"},
+  /* Logical */
+  {"vand", 3, "%0 = _mm_and_si128 (%1, %2)"},
+  {"vandc", 3, "%0 = _mm_andnot_si128 (%2, %1)"},
+  {"vor", 3, "%0 = _mm_or_si128 (%1, %2)"},
+  {"vxor", 3, "%0 = _mm_xor_si128 (%1, %2)"},
+  {"vnor", 3, "%0 = _mm_xor_si128 (_mm_or_si128 (%1, %2), _mm_set1_epi32 (-1))"},
+  {"vsel", 4, "%0 = _mm_or_si128 (_mm_andnot_si128 (%3, %1), _mm_and_si128 (%3, %2))"},
+  /* Shifts and rotates */
+  {"vslb", 3, "%0 = ppc2c_vslb (%1, %2)"},
+  {"vslh", 3, "%0 = ppc2c_vslh (%1, %2)"},
+  {"vslw", 3, "%0 = ppc2c_vslw (%1, %2)"},
+  {"vsrb", 3, "%0 = ppc2c_vsrb (%1, %2)"},
+  {"vsrh", 3, "%0 = ppc2c_vsrh (%1, %2)"},
+  {"vsrw", 3, "%0 = ppc2c_vsrw (%1, %2)"},
+  {"vsrab", 3, "%0 = ppc2c_vsrab (%1, %2)"},
+  {"vsrah", 3, "%0 = ppc2c_vsrah (%1, %2)"},
+  {"vsraw", 3, "%0 = ppc2c_vsraw (%1, %2)"},
+  {"vrlb", 3, "%0 = ppc2c_vrlb (%1, %2)"},
+  {"vrlh", 3, "%0 = ppc2c_vrlh (%1, %2)"},
+  {"vrlw", 3, "%0 = ppc2c_vrlw (%1, %2)"},
+  {"vsl", 3, "%0 = ppc2c_vsl (%1, %2)"},
+  {"vsr", 3, "%0 = ppc2c_vsr (%1, %2)"},
+  {"vslo", 3, "%0 = ppc2c_vslo (%1, %2)"},
+  {"vsro", 3, "%0 = ppc2c_vsro (%1, %2)"},
+  {"vsldoi", 4, "%0 = _mm_alignr_epi8 (%1, %2, 16 - %i)"},
+  /* Permutes, merges and splats */
+  {"vperm", 4, "%0 = ppc2c_vperm (%1, %2, %3)"},
+  {"vmrghb", 3, "%0 = _mm_unpackhi_epi8 (%2, %1)"},
+  {"vmrghh", 3, "%0 = _mm_unpackhi_epi16 (%2, %1)"},
+  {"vmrghw", 3, "%0 = _mm_unpackhi_epi32 (%2, %1)"},
+  {"vmrglb", 3, "%0 = _mm_unpacklo_epi8 (%2, %1)"},
+  {"vmrglh", 3, "%0 = _mm_unpacklo_epi16 (%2, %1)"},
+  {"vmrglw", 3, "%0 = _mm_unpacklo_epi32 (%2, %1)"},
+  {"vspltb", 3, "%0 = _mm_shuffle_epi8 (%1, _mm_set1_epi8 (15 - %i))"},
+  {"vsplth", 3, "%0 = _mm_shuffle_epi8 (%1, _mm_set1_epi16 ((14 - 2 * %i) | (15 - 2 * %i) << 8))"},
+  {"vspltw", 3, "%0 = _mm_shuffle_epi32 (%1, (3 - %i) * 0x55)"},
+  {"vspltisb", 2, "%0 = _mm_set1_epi8 (%i)"},
+  {"vspltish", 2, "%0 = _mm_set1_epi16 (%i)"},
+  {"vspltisw", 2, "%0 = _mm_set1_epi32 (%i)"},
+  /* Packs and unpacks, the high half being the upper host lanes */
+  {"vpkuhum", 3, "%0 = ppc2c_vpkuhum (%1, %2)"},
+  {"vpkuwum", 3, "%0 = ppc2c_vpkuwum (%1, %2)"},
+  {"vpkuhus", 3, "%0 = ppc2c_vpkuhus (%1, %2)"},
+  {"vpkuwus", 3, "%0 = ppc2c_vpkuwus (%1, %2)"},
+  {"vpkshss", 3, "%0 = _mm_packs_epi16 (%2, %1)"},
+  {"vpkshus", 3, "%0 = _mm_packus_epi16 (%2, %1)"},
+  {"vpkswss", 3, "%0 = _mm_packs_epi32 (%2, %1)"},
+  {"vpkswus", 3, "%0 = _mm_packus_epi32 (%2, %1)"},
+  {"vpkpx", 3, "%0 = ppc2c_vpkpx (%1, %2)"},
+  {"vupkhsb", 2, "%0 = _mm_cvtepi8_epi16 (_mm_srli_si128 (%1, 8))"},
+  {"vupklsb", 2, "%0 = _mm_cvtepi8_epi16 (%1)"},
+  {"vupkhsh", 2, "%0 = _mm_cvtepi16_epi32 (_mm_srli_si128 (%1, 8))"},
+  {"vupklsh", 2, "%0 = _mm_cvtepi16_epi32 (%1)"},
+  {"vupkhpx", 2, "%0 = ppc2c_vupkhpx (%1)"},
+  {"vupklpx", 2, "%0 = ppc2c_vupklpx (%1)"},
+  /* Floating point. vmaddfp and vnmsubfp take vA, vC, vB and aren't fused */
+  {"vaddfp", 3, "%0 = PPC2C_VI (_mm_add_ps (%f1, %f2))"},
+  {"vsubfp", 3, "%0 = PPC2C_VI (_mm_sub_ps (%f1, %f2))"},
+  {"vmaddfp", 4, "%0 = PPC2C_VI (_mm_add_ps (_mm_mul_ps (%f1, %f2), %f3))"},
+  {"vnmsubfp", 4, "%0 = PPC2C_VI (_mm_sub_ps (%f3, _mm_mul_ps (%f1, %f2)))"},
+  {"vmaxfp", 3, "%0 = PPC2C_VI (_mm_max_ps (%f1, %f2))"},
+  {"vminfp", 3, "%0 = PPC2C_VI (_mm_min_ps (%f1, %f2))"},
+  {"vrefp", 2, "%0 = PPC2C_VI (_mm_rcp_ps (%f1))"},
+  {"vrsqrtefp", 2, "%0 = PPC2C_VI (_mm_rsqrt_ps (%f1))"},
+  {"vexptefp", 2, "%0 = ppc2c_vexptefp (%1)"},
+  {"vlogefp", 2, "%0 = ppc2c_vlogefp (%1)"},
+  {"vrfin", 2, "%0 = PPC2C_VI (_mm_round_ps (%f1, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC))"},
+  {"vrfiz", 2, "%0 = PPC2C_VI (_mm_round_ps (%f1, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC))"},
+  {"vrfip", 2, "%0 = PPC2C_VI (_mm_round_ps (%f1, _MM_FROUND_TO_POS_INF | _MM_FROUND_NO_EXC))"},
+  {"vrfim", 2, "%0 = PPC2C_VI (_mm_round_ps (%f1, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC))"},
+  {"vcfsx", 3, "%0 = PPC2C_VI (_mm_mul_ps (_mm_cvtepi32_ps (%1), _mm_set1_ps (1.0f / (1u << %i))))"},
+  {"vcfux", 3, "%0 = ppc2c_vcfux (%1, %i)"},
+  {"vctsxs", 3, "%0 = ppc2c_vctsxs (%1, %i)"},
+  {"vctuxs", 3, "%0 = ppc2c_vctuxs (%1, %i)"},
+  /* Compares, the record forms also set CR6 */
+  {"vcmpequb", 3, "%0 = _mm_cmpeq_epi8 (%1, %2)"},
+  {"vcmpequh", 3, "%0 = _mm_cmpeq_epi16 (%1, %2)"},
+  {"vcmpequw", 3, "%0 = _mm_cmpeq_epi32 (%1, %2)"},
+  {"vcmpgtsb", 3, "%0 = _mm_cmpgt_epi8 (%1, %2)"},
+  {"vcmpgtsh", 3, "%0 = _mm_cmpgt_epi16 (%1, %2)"},
+  {"vcmpgtsw", 3, "%0 = _mm_cmpgt_epi32 (%1, %2)"},
+  {"vcmpgtub", 3, "%0 = ppc2c_vcmpgtub (%1, %2)"},
+  {"vcmpgtuh", 3, "%0 = ppc2c_vcmpgtuh (%1, %2)"},
+  {"vcmpgtuw", 3, "%0 = ppc2c_vcmpgtuw (%1, %2)"},
+  {"vcmpeqfp", 3, "%0 = PPC2C_VI (_mm_cmpeq_ps (%f1, %f2))"},
+  {"vcmpgtfp", 3, "%0 = PPC2C_VI (_mm_cmpgt_ps (%f1, %f2))"},
+  {"vcmpgefp", 3, "%0 = PPC2C_VI (_mm_cmpge_ps (%f1, %f2))"},
+  {"vcmpbfp", 3, "%0 = ppc2c_vcmpbfp (%1, %2)"},
+  {NULL, 0, NULL}
+};
+
+static int
+find_vector_form (Instruction &ins)
+{
+  int i;
+
+  if (ins.type != INSTRUCTION_TYPE_INSTRUCTION)
+    return -1;
+  for (i = 0; vector_forms[i].mnemonic; i++)
+    if (ins.name == vector_forms[i].mnemonic)
+      return i;
+  return -1;
+}
+
+static int
+count_operands (Instruction &ins)
+{
+  int i;
+
+  for (i = 0; i < 5 && ins.operands[i] != ""; i++);
+  return i;
+}
+
+static string
+trim (const string &str)
+{
+  size_t begin = str.find_first_not_of(" ");
+  size_t end = str.find_last_not_of(" ");
+
+  if (begin == string::npos)
+    return "";
+  return str.substr(begin, end - begin + 1);
+}
+
+/* "%vr12" to 12, or -1 if the operand isn't a vector register */
+static int
+vector_register_number (const string &operand)
+{
+  string op = trim (operand);
+
+  if (op.compare(0, 3, "%vr") != 0 || op.length() < 4)
+    return -1;
+  return atoi (op.c_str() + 3);
+}
+
+static void
+append_vector_register (const string &operand)
+{
+  int reg = vector_register_number (operand);
+
+  if (reg < 0 || reg >= VECTOR_REGISTERS) {
+    ERROR ("Error: Unknown vector register : '%s'\n", operand.c_str());
+    code_arena << operand;
+    return;
+  }
+  code_arena << "vr";
+  code_arena.append_int (reg);
+}
+
+static void
+append_indexed_address (Instruction &ins)
+{
+  Register base = Register (trim (ins.operands[1]));
+  Register index = Register (trim (ins.operands[2]));
+
+  if (base != REGISTER_R0)
+    code_arena << base << " + ";
+  code_arena << index;
+}
+
+bool
+is_vector_instruction (Instruction &ins)
+{
+  return find_vector_form (ins) >= 0;
+}
+
+bool
+handle_vector (Function &func, Instruction &ins, HandlerResult *result)
+{
+  int form = find_vector_form (ins);
+  const char *p;
+
+  if (form < 0)
+    return false;
+
+  result->out_reg = REGISTER_UNSET;
+  result->in_reg1 = REGISTER_UNSET;
+  result->in_reg2 = REGISTER_UNSET;
+
+  if (count_operands (ins) != vector_forms[form].operands) {
+    ERROR ("Assertion : Wrong number of operands for instruction : %s\n", ins.name.c_str());
+    return false;
+  }
+
+  for (p = vector_forms[form].code; *p; p++) {
+    const char *text = p;
+
+    while (*p && *p != '%')
+      p++;
+    code_arena.append (text, p - text);
+    if (*p == '\0')
+      break;
+    p++;
+    if (*p >= '0' && *p <= '3') {
+      append_vector_register (ins.operands[*p - '0']);
+    } else if (*p == 'f') {
+      p++;
+      code_arena << "PPC2C_VF (";
+      append_vector_register (ins.operands[*p - '0']);
+      code_arena << ")";
+    } else if (*p == 'i') {
+      code_arena << trim (ins.operands[vector_forms[form].operands - 1]);
+    } else if (*p == 'x') {
+      append_indexed_address (ins);
+    }
+  }
+
+  /* Record forms of the compares: Rc is bit 21 of their VXR encoding, the
+   * mnemonic lost its dot when it was parsed */
+  if (ins.name.compare(0, 4, "vcmp") == 0 && (ins.word & 0x400)) {
+    code_arena << "; PPC2C_CR_SET (CR, 6, ppc2c_vcmp_cr6 (";
+    append_vector_register (ins.operands[0]);
+    code_arena << "))";
+    cr[6].reg = REGISTER_UNSET;
+  }
+
+  return true;
+}
+
+/* Bit mask of the vector registers the lowered instructions use, they get
+ * locals in the generated function */
+uint32
+vector_registers (Function &func)
+{
+  list<Instruction>::iterator iter;
+  uint32 used = 0;
+  int i;
+
+  for (iter = func.instructions.begin(); iter != func.instructions.end(); iter++) {
+    if (!is_vector_instruction (*iter))
+      continue;
+    for (i = 0; i < 5; i++) {
+      int reg = vector_register_number (iter->operands[i]);
+
+      if (reg >= 0 && reg < VECTOR_REGISTERS)
+        used |= 1u << reg;
+    }
+  }
+  return used;
+}
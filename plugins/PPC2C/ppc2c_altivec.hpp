@@ -0,0 +1,23 @@
+/*
+ * ppc2c_altivec.hpp -- Vector instructions for the PPC to C converter
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+#ifndef __PPC2C_ALTIVEC_HPP__
+#define __PPC2C_ALTIVEC_HPP__
+
+#include "ppc2c_engine.hpp"
+#include "ppc2c_handlers.hpp"
+
+#define VECTOR_REGISTERS 32
+
+bool is_vector_instruction (Instruction &ins);
+bool handle_vector (Function &func, Instruction &ins, HandlerResult *result);
+uint32 vector_registers (Function &func);
+
+#endif /* __PPC2C_ALTIVEC_HPP__ */
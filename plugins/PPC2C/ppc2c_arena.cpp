@@ -0,0 +1,155 @@
+/*
+ * ppc2c_arena.cpp -- Append-only buffer for the C code of the handlers
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+#include "ppc2c_arena.hpp"
+#include <cstring>
+
+#define ARENA_INITIAL_SIZE 0x10000
+
+OutputArena code_arena;
+
+OutputArena::OutputArena ()
+{
+  this->buffer = NULL;
+  this->length = 0;
+  this->size = 0;
+}
+
+OutputArena::~OutputArena ()
+{
+  qfree (this->buffer);
+}
+
+void
+OutputArena::reset (void)
+{
+  this->length = 0;
+}
+
+void
+OutputArena::reserve (size_t len)
+{
+  size_t needed = this->length + len + 1;
+
+  if (needed <= this->size)
+    return;
+  if (this->size == 0)
+    this->size = ARENA_INITIAL_SIZE;
+  while (this->size < needed)
+    this->size *= 2;
+  this->buffer = (char *) qrealloc (this->buffer, this->size);
+}
+
+CodeSlice
+OutputArena::slice (size_t start)
+{
+  CodeSlice slice;
+
+  reserve (0);
+  slice.offset = start;
+  slice.length = this->length - start;
+  this->buffer[this->length++] = '\0';
+
+  return slice;
+}
+
+const char *
+OutputArena::c_str (CodeSlice slice) const
+{
+  if (slice.empty ())
+    return "";
+  return this->buffer + slice.offset;
+}
+
+OutputArena &
+OutputArena::append (const char *str, size_t len)
+{
+  reserve (len);
+  memcpy (this->buffer + this->length, str, len);
+  this->length += len;
+
+  return *this;
+}
+
+/* The slice may be in the buffer that reserve () moves, so it is copied by
+ * offset once there is room */
+OutputArena &
+OutputArena::append (CodeSlice slice)
+{
+  reserve (slice.length);
+  memmove (this->buffer + this->length, this->buffer + slice.offset, slice.length);
+  this->length += slice.length;
+
+  return *this;
+}
+
+OutputArena &
+OutputArena::append_int (sval_t value)
+{
+  char digits[24];
+  int i = sizeof(digits);
+  uval_t magnitude = value < 0 ? 0 - (uval_t) value : (uval_t) value;
+
+  do {
+    digits[--i] = (char) ('0' + magnitude % 10);
+    magnitude /= 10;
+  } while (magnitude != 0);
+  if (value < 0)
+    digits[--i] = '-';
+
+  return append (digits + i, sizeof(digits) - i);
+}
+
+/* Same as IDA prints them, "0x" and upper case digits */
+OutputArena &
+OutputArena::append_hex (uval_t value)
+{
+  char digits[24];
+  int i = sizeof(digits);
+
+  do {
+    digits[--i] = "0123456789ABCDEF"[value & 0xF];
+    value >>= 4;
+  } while (value != 0);
+  digits[--i] = 'x';
+  digits[--i] = '0';
+
+  return append (digits + i, sizeof(digits) - i);
+}
+
+OutputArena &
+OutputArena::operator<< (const char *str)
+{
+  return append (str, strlen (str));
+}
+
+OutputArena &
+OutputArena::operator<< (const string &str)
+{
+  return append (str.data (), str.length ());
+}
+
+/* Same names as Register::operator string () */
+OutputArena &
+OutputArena::operator<< (Register reg)
+{
+  int value = reg.value;
+
+  if (value >= 0 && value <= 32)
+    return append ("r", 1).append_int (value);
+  else if (value == REGISTER_SP)
+    return append ("r1", 2);
+  else if (value == REGISTER_LR)
+    return append ("LR", 2);
+  else if (value == REGISTER_CTR)
+    return append ("CTR", 3);
+
+  return *this << reg.str;
+}
@@ -0,0 +1,60 @@
+/*
+ * ppc2c_arena.hpp -- Append-only buffer for the C code of the handlers
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+#ifndef __PPC2C_ARENA_HPP__
+#define __PPC2C_ARENA_HPP__
+
+#include "ppc2c_engine.hpp"
+
+/* Part of the arena, by offset since the buffer moves when it grows */
+class CodeSlice {
+public:
+  CodeSlice() : offset(0), length(0) {};
+  bool empty () const { return length == 0; };
+  size_t offset;
+  size_t length;
+};
+
+/* The handlers append their C code here instead of adding up strings. It is
+ * emptied before every function but keeps its buffer, so once it is big
+ * enough for the largest function, lowering doesn't allocate anymore */
+class OutputArena {
+public:
+  OutputArena();
+  ~OutputArena();
+
+  void reset (void);
+  size_t mark (void) const { return length; };
+  // Everything appended since 'start', NUL terminated
+  CodeSlice slice (size_t start);
+  const char *c_str (CodeSlice slice) const;
+
+  OutputArena &append (const char *str, size_t len);
+  OutputArena &append (CodeSlice slice);
+  OutputArena &append_int (sval_t value);
+  OutputArena &append_hex (uval_t value);
+  OutputArena &operator<< (const char *str);
+  OutputArena &operator<< (const string &str);
+  OutputArena &operator<< (Register reg);
+
+private:
+  // Numbers go through append_int () so they are never taken for registers
+  OutputArena &operator<< (int);
+  OutputArena (const OutputArena &);
+  void reserve (size_t len);
+
+  char *buffer;
+  size_t length;
+  size_t size;
+};
+
+extern OutputArena code_arena;
+
+#endif /* __PPC2C_ARENA_HPP__ */
@@ -0,0 +1,370 @@
+/*
+ * ppc2c_constprop.cpp -- Constant propagation for the PPC to C converter
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+#include "ppc2c_constprop.hpp"
+#include "ppc2c_handlers.hpp"
+
+#include <bytes.hpp>
+#include <name.hpp>
+#include <segment.hpp>
+#include <allins.hpp>
+
+#include <map>
+#include <set>
+#include <sstream>
+
+#define GPR_COUNT 32
+#define MAX_STRING_LITERAL 256
+
+static map<ea_t, ea_t> toc_map;
+
+/* Every .opd entry gives the address of a function and its %rtoc value,
+ * same layout as the OPD_s structure created by CreateOpd in common.idh */
+void
+load_toc_map (void)
+{
+  segment_t *p_seg = get_segm_by_name(".opd");
+  ea_t ea;
+
+  toc_map.clear ();
+  if (p_seg == NULL)
+    return;
+
+  for (ea = p_seg->startEA; ea + 8 <= p_seg->endEA; ea += 8)
+    toc_map[get_long(ea)] = get_long(ea + 4);
+}
+
+ea_t
+get_function_toc (ea_t address)
+{
+  map<ea_t, ea_t>::iterator it = toc_map.find (address);
+
+  if (it == toc_map.end ())
+    return BADADDR;
+  return it->second;
+}
+
+static string
+hex_literal (uint64 value)
+{
+  std::ostringstream oss;
+
+  if ((int64) value < 0 && (int64) value >= -0x8000)
+    oss << "-0x" << std::hex << std::uppercase << (uint64) (-(int64) value);
+  else
+    oss << "0x" << std::hex << std::uppercase << value;
+  return oss.str();
+}
+
+static string
+string_literal (ea_t ea)
+{
+  char buf[MAX_STRING_LITERAL];
+  string literal = "\"";
+  size_t len, i;
+
+  len = get_max_ascii_length(ea, ASCSTR_C);
+  if (len == 0 || len >= sizeof(buf) ||
+      !get_ascii_contents(ea, len, ASCSTR_C, buf, sizeof(buf)))
+    return "";
+
+  for (i = 0; i < len && buf[i] != 0; i++) {
+    unsigned char c = buf[i];
+    char esc[8];
+
+    if (c == '"' || c == '\\') {
+      literal += '\\';
+      literal += c;
+    } else if (c == '\n') {
+      literal += "\\n";
+    } else if (c == '\t') {
+      literal += "\\t";
+    } else if (c < 0x20 || c >= 0x7F) {
+      /* Octal escapes can't swallow the following characters */
+      qsnprintf (esc, sizeof(esc), "\\%03o", c);
+      literal += esc;
+    } else {
+      literal += c;
+    }
+  }
+  return literal + "\"";
+}
+
+/* What a known value points to, for the comment of the folded instruction:
+ * the string at it or the named item it's in. Empty if it's just a number */
+static string
+constant_comment (uint64 value)
+{
+  char name[MAXSTR];
+  string text;
+  size_t pos;
+  ea_t head;
+
+  if (value == 0 || value > 0xFFFFFFFF || !isEnabled(value))
+    return "";
+
+  head = get_item_head(value);
+  if (head == value && isASCII(get_flags_novalue(value)))
+    text = string_literal (value);
+  if (text == "" && has_name(get_flags_novalue(head)) &&
+      get_true_name(BADADDR, head, name, sizeof(name)) != NULL) {
+    text = name;
+    if (head != value)
+      text += " + " + hex_literal (value - head);
+  }
+
+  /* Don't let the string end the comment */
+  for (pos = text.find ("*/"); pos != string::npos; pos = text.find ("*/", pos))
+    text.replace (pos, 2, "*\\/");
+  return text;
+}
+
+class ConstantState {
+public:
+  ConstantState(ea_t toc) { this->toc = toc; reset (); }
+  ea_t toc;
+  uint64 gpr[GPR_COUNT];
+  bool known[GPR_COUNT];
+  /* Folded instruction whose result wasn't read yet */
+  Instruction *pending[GPR_COUNT];
+
+  void reset (void) {
+    for (int i = 0; i < GPR_COUNT; i++) {
+      known[i] = false;
+      pending[i] = NULL;
+    }
+    if (toc != BADADDR)
+      set (2, toc);
+  }
+  void set (int reg, uint64 value) {
+    gpr[reg] = value;
+    known[reg] = true;
+  }
+  void clobber (int reg) {
+    if (reg >= 0 && reg < GPR_COUNT) {
+      known[reg] = false;
+      pending[reg] = NULL;
+    }
+  }
+  void read (int reg) {
+    if (reg >= 0 && reg < GPR_COUNT)
+      pending[reg] = NULL;
+  }
+};
+
+static bool
+is_store (uint16 itype)
+{
+  switch (itype) {
+    case PPC_stb: case PPC_stbu: case PPC_stbux: case PPC_stbx:
+    case PPC_std: case PPC_stdcx: case PPC_stdu: case PPC_stdux: case PPC_stdx:
+    case PPC_stfd: case PPC_stfdu: case PPC_stfdux: case PPC_stfdx:
+    case PPC_stfiwx: case PPC_stfs: case PPC_stfsu: case PPC_stfsux: case PPC_stfsx:
+    case PPC_sth: case PPC_sthbrx: case PPC_sthu: case PPC_sthux: case PPC_sthx:
+    case PPC_stmw: case PPC_stswi: case PPC_stswx:
+    case PPC_stw: case PPC_stwbrx: case PPC_stwcx: case PPC_stwu: case PPC_stwux: case PPC_stwx:
+    case PPC_mtctr: case PPC_mtlr: case PPC_mtspr: case PPC_mtcrf: case PPC_mtxer:
+      return true;
+    default:
+      return false;
+  }
+}
+
+static bool
+is_update (uint16 itype)
+{
+  switch (itype) {
+    case PPC_lbzu: case PPC_lbzux: case PPC_ldu: case PPC_ldux:
+    case PPC_lfdu: case PPC_lfdux: case PPC_lfsu: case PPC_lfsux:
+    case PPC_lhau: case PPC_lhaux: case PPC_lhzu: case PPC_lhzux:
+    case PPC_lwzu: case PPC_lwzux: case PPC_lwaux:
+    case PPC_stbu: case PPC_stbux: case PPC_stdu: case PPC_stdux:
+    case PPC_stfdu: case PPC_stfdux: case PPC_stfsu: case PPC_stfsux:
+    case PPC_sthu: case PPC_sthux: case PPC_stwu: case PPC_stwux:
+      return true;
+    default:
+      return false;
+  }
+}
+
+/* Value loaded from the TOC, which doesn't change once the module is
+ * relocated. Anything else in memory could, so only the TOC is folded */
+static bool
+load_toc_value (ConstantState &state, uint16 itype, ea_t addr, uint64 &value)
+{
+  if (state.toc == BADADDR || addr < state.toc - 0x8000 ||
+      addr >= state.toc + 0x8000 || !isLoaded(addr))
+    return false;
+
+  switch (itype) {
+    case PPC_lwz:
+      value = get_long(addr);
+      return true;
+    case PPC_ld:
+      value = get_qword(addr);
+      return true;
+    case PPC_lhz:
+      value = get_word(addr);
+      return true;
+    case PPC_lha:
+      value = (int16) get_word(addr);
+      return true;
+    case PPC_lbz:
+      value = get_byte(addr);
+      return true;
+    default:
+      return false;
+  }
+}
+
+/* Compute the result of the instruction in 'cmd' if its inputs are known.
+ * 'source' is the register it reads, or -1 */
+static bool
+evaluate (ConstantState &state, uint64 &value, int &source)
+{
+  op_t &op1 = cmd.Operands[0];
+  op_t &op2 = cmd.Operands[1];
+  op_t &op3 = cmd.Operands[2];
+
+  source = -1;
+  if (op1.type != o_reg || op1.reg >= GPR_COUNT)
+    return false;
+
+  switch (cmd.itype) {
+    case PPC_li:
+      value = (int16) op2.value;
+      return true;
+    case PPC_lis:
+      value = (int64) (int16) op2.value << 16;
+      return true;
+    case PPC_mr:
+      source = op2.reg;
+      value = state.gpr[source];
+      return state.known[source];
+    case PPC_addi:
+    case PPC_addis:
+      if (op2.reg == 0) {
+        value = (int16) op3.value;
+      } else {
+        source = op2.reg;
+        if (!state.known[source])
+          return false;
+        value = (int16) op3.value;
+      }
+      if (cmd.itype == PPC_addis)
+        value = (int64) value << 16;
+      if (source != -1)
+        value += state.gpr[source];
+      return true;
+    case PPC_ori:
+    case PPC_oris:
+      source = op2.reg;
+      if (!state.known[source])
+        return false;
+      value = state.gpr[source] |
+          ((uint64) (uint16) op3.value << (cmd.itype == PPC_oris ? 16 : 0));
+      return true;
+    case PPC_lwz:
+    case PPC_ld:
+    case PPC_lhz:
+    case PPC_lha:
+    case PPC_lbz:
+      if (op2.type != o_displ || op2.reg >= GPR_COUNT || !state.known[op2.reg])
+        return false;
+      source = op2.reg;
+      return load_toc_value (state, cmd.itype, state.gpr[source] + op2.addr, value);
+    default:
+      return false;
+  }
+}
+
+/* Track register values through the function the way fix_rtoc does, starting
+ * every basic block with only %rtoc known, and replace the instructions
+ * computing an address or a TOC value by the constant itself */
+void
+propagate_constants (Function &func, ea_t toc)
+{
+  ConstantState state (toc);
+  list<Instruction>::iterator it;
+  set<ea_t> targets;
+  ea_t next = BADADDR;
+  bool ended = true;
+  int i;
+
+  for (it = func.instructions.begin(); it != func.instructions.end(); it++)
+    if (it->type == INSTRUCTION_TYPE_INSTRUCTION && it->target != BADADDR)
+      targets.insert (it->target);
+
+  for (it = func.instructions.begin(); it != func.instructions.end(); it++) {
+    Instruction &ins = *it;
+    uint64 value;
+    int source;
+
+    if (ins.type != INSTRUCTION_TYPE_INSTRUCTION)
+      continue;
+    if (ended || ins.address != next || targets.find (ins.address) != targets.end ())
+      state.reset ();
+    ended = !ins.flow || get_branch_type (ins) != BRANCH_NONE;
+    next = ins.address + 4;
+
+    if (ua_ana0(ins.address) == 0) {
+      state.reset ();
+      continue;
+    }
+
+    if (evaluate (state, value, source)) {
+      int reg = cmd.Operands[0].reg;
+      string comment = constant_comment (value);
+
+      /* The guest address itself, the runtime has no symbols. A 'li'
+       * already is as short as it gets */
+      if (cmd.itype != PPC_li || comment != "")
+        ins.folded = string (Register (reg)) + " = " + hex_literal (value) + ";" +
+          (comment != "" ? " /* " + comment + " */" : "");
+      if (source == reg && state.pending[reg] != NULL)
+        state.pending[reg]->dead = true;
+      else
+        state.read (source);
+      state.set (reg, value);
+      state.pending[reg] = &ins;
+      continue;
+    }
+
+    /* Restoring the caller's %rtoc from its stack slot */
+    if (cmd.itype == PPC_ld && cmd.Operands[0].reg == 2 &&
+        cmd.Operands[1].type == o_displ && cmd.Operands[1].reg == 1 &&
+        toc != BADADDR) {
+      state.read (1);
+      state.set (2, toc);
+      state.pending[2] = NULL;
+      continue;
+    }
+
+    for (i = 0; i < UA_MAXOP && cmd.Operands[i].type != o_void; i++) {
+      op_t &op = cmd.Operands[i];
+
+      if (op.type == o_reg || op.type == o_phrase || op.type == o_displ)
+        state.read (op.reg);
+    }
+    if (is_call (ins)) {
+      /* Everything volatile is gone after a call */
+      state.clobber (0);
+      for (i = 3; i <= 12; i++)
+        state.clobber (i);
+      for (i = 0; i < GPR_COUNT; i++)
+        state.pending[i] = NULL;
+    } else {
+      if (cmd.Operands[0].type == o_reg && !is_store (cmd.itype))
+        state.clobber (cmd.Operands[0].reg);
+      if (is_update (cmd.itype))
+        state.clobber (cmd.Operands[1].reg);
+    }
+  }
+}
@@ -0,0 +1,20 @@
+/*
+ * ppc2c_constprop.hpp -- Constant propagation for the PPC to C converter
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+#ifndef __PPC2C_CONSTPROP_HPP__
+#define __PPC2C_CONSTPROP_HPP__
+
+#include "ppc2c_engine.hpp"
+
+void load_toc_map (void);
+ea_t get_function_toc (ea_t address);
+void propagate_constants (Function &func, ea_t toc);
+
+#endif /* __PPC2C_CONSTPROP_HPP__ */
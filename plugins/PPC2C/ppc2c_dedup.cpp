@@ -0,0 +1,150 @@
+/*
+ * ppc2c_dedup.cpp -- Duplicate function detection for the PPC to C converter
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+#include "ppc2c_dedup.hpp"
+#include "ppc2c_structure.hpp"
+
+#include <bytes.hpp>
+
+#include <map>
+#include <vector>
+
+#define PRIMARY_OPCODE(w) ((w) >> 26)
+#define OPCODE_BC 16
+#define OPCODE_B 18
+#define BRANCH_ABSOLUTE 0x2 // AA bit
+#define BRANCH_LINK 0x1 // LK bit
+
+#define TARGET_INSIDE 0x100000000ULL // Tags a target relative to the function
+#define TARGET_OUTSIDE 0x200000000ULL
+
+/* The instruction stream of a function, with the place of each instruction
+ * relative to the function. Relative branches have their displacement
+ * masked and are followed by their target, made relative to the function if
+ * it is inside it and isn't the return address a call to the next
+ * instruction puts in LR. Two functions with the same signature lower to
+ * the same C code, apart from their names */
+typedef vector<uint64> Signature;
+
+typedef struct {
+  string name;
+  Signature signature;
+} Lowered;
+
+static multimap<uint32, Lowered> lowered;
+
+static uint64
+normalize_target (Function &func, ea_t target)
+{
+  if (target >= func.address && target < func.end_address)
+    return TARGET_INSIDE | (uint32) (target - func.address);
+  return TARGET_OUTSIDE | (uint32) target;
+}
+
+static void
+build_signature (Function &func, ea_t toc, Signature &signature)
+{
+  list<Instruction>::iterator it;
+
+  signature.clear ();
+  signature.push_back (toc); // The same code with another TOC loads other data
+  for (it = func.instructions.begin(); it != func.instructions.end(); it++) {
+    uint32 word;
+    ea_t target = BADADDR;
+
+    if (it->type != INSTRUCTION_TYPE_INSTRUCTION)
+      continue;
+    word = it->word;
+    if (PRIMARY_OPCODE (word) == OPCODE_B && (word & BRANCH_ABSOLUTE) == 0) {
+      sval_t li = word & 0x03FFFFFC;
+
+      if (li & 0x02000000)
+        li -= 0x04000000;
+      target = it->address + li;
+      word &= ~0x03FFFFFC;
+    } else if (PRIMARY_OPCODE (word) == OPCODE_BC && (word & BRANCH_ABSOLUTE) == 0) {
+      sval_t bd = word & 0xFFFC;
+
+      if (bd & 0x8000)
+        bd -= 0x10000;
+      target = it->address + bd;
+      word &= ~0xFFFC;
+    }
+    signature.push_back (((uint64) (it->address - func.address) << 32) | word);
+    /* "bcl 20,31,$+4" only reads its own address into LR, which the code
+     * after it uses as an absolute address */
+    if (target != BADADDR && (word & BRANCH_LINK) && target == it->address + 4)
+      signature.push_back (TARGET_OUTSIDE | (uint32) target);
+    else if (target != BADADDR)
+      signature.push_back (normalize_target (func, target));
+
+    // The targets of a jump table are data, not part of the code
+    if (get_branch_type (*it) == BRANCH_INDIRECT &&
+        func.tables.find (it->address) != func.tables.end ()) {
+      JumpTable &table = func.tables[it->address];
+      size_t i;
+
+      signature.push_back (table.reg);
+      signature.push_back (normalize_target (func, table.index_use));
+      for (i = 0; i < table.targets.size (); i++)
+        signature.push_back (normalize_target (func, table.targets[i]));
+      if (table.defjump != BADADDR)
+        signature.push_back (normalize_target (func, table.defjump));
+    }
+  }
+}
+
+/* FNV-1a */
+static uint32
+hash_signature (Signature &signature)
+{
+  uint32 hash = 2166136261u;
+  size_t i;
+  int j;
+
+  for (i = 0; i < signature.size (); i++) {
+    for (j = 0; j < 64; j += 8) {
+      hash ^= (uint32) (signature[i] >> j) & 0xFF;
+      hash *= 16777619u;
+    }
+  }
+  return hash;
+}
+
+void
+dedup_reset (void)
+{
+  lowered.clear ();
+}
+
+/* If a function with the same body was seen before, set the alias of 'func'
+ * to it and return true. Otherwise remember 'func' as the one to lower */
+bool
+find_duplicate (Function &func, ea_t toc)
+{
+  multimap<uint32, Lowered>::iterator it;
+  Lowered entry;
+  uint32 hash;
+
+  build_signature (func, toc, entry.signature);
+  hash = hash_signature (entry.signature);
+
+  // Equal hashes are checked against the whole signature
+  for (it = lowered.find (hash); it != lowered.end () && it->first == hash; it++) {
+    if (it->second.signature == entry.signature) {
+      func.alias = it->second.name;
+      return true;
+    }
+  }
+
+  entry.name = func.name;
+  lowered.insert (pair<uint32, Lowered> (hash, entry));
+  return false;
+}
@@ -0,0 +1,19 @@
+/*
+ * ppc2c_dedup.hpp -- Duplicate function detection for the PPC to C converter
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+#ifndef __PPC2C_DEDUP_HPP__
+#define __PPC2C_DEDUP_HPP__
+
+#include "ppc2c_engine.hpp"
+
+void dedup_reset (void);
+bool find_duplicate (Function &func, ea_t toc);
+
+#endif /* __PPC2C_DEDUP_HPP__ */
@@ -9,7 +9,6 @@
  */
 #include "ppc2c_engine.hpp"
 #include <cstring>
-#include <sstream>
 
 #define INSTRUCTION_IS(x) (strcmp (ins.instruction, x) == 0)
 #define HAS_NO_OPERAND (ins.operands[0] == NULL)
@@ -23,9 +22,9 @@
 ConditionRegister cr[MAX_CR+1];
 
 string tostr(int i) {
-  std::ostringstream oss;
-  oss << i;
-  return oss.str();
+  char buf[16];
+  qsnprintf (buf, sizeof(buf), "%d", i);
+  return buf;
 }
 
 
@@ -33,6 +32,11 @@ Instruction::Instruction ()
 {
   this->type = INSTRUCTION_TYPE_NONE;
   this->name = "";
+  this->target = BADADDR;
+  this->flow = false;
+  this->folded = "";
+  this->dead = false;
+  this->word = 0;
   for (int i = 0; i < 5; i++)
     this->operands[i] = "";
 }
@@ -93,7 +97,7 @@ Register::operator std::string ()
   if (reg >= 0 && reg <= 32)
     return "r" + tostr(reg);
   else if (reg == REGISTER_SP)
-    return "sp";
+    return "r1";
   else if (reg == REGISTER_LR)
     return "LR";
   else if (reg == REGISTER_CTR)
@@ -104,11 +108,10 @@ Register::operator std::string ()
 }
 
 Register
-parse_pointer (ea_t ea, int operand, ea_t &offset)
-{
-  ua_ana0(ea);
-  if (cmd.Operands[operand].type != o_displ)
+parse_pointer (Instruction &ins, int operand, ea_t &offset)
+{
+  if (ins.ops[operand].type != o_displ)
 	  return REGISTER_UNSET;
-  offset = cmd.Operands[operand].addr;
-  return cmd.Operands[operand].reg;
+  offset = ins.ops[operand].value;
+  return ins.ops[operand].reg;
 }
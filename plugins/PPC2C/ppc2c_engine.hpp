@@ -25,6 +25,9 @@
 
 #include <string>
 #include <list>
+#include <map>
+#include <set>
+#include <vector>
 
 using namespace std;
 
@@ -86,6 +89,7 @@ public:
   operator int () {return this->value;};
   operator string ();
 private:
+  friend class OutputArena;
   enum_register value;
   string str;
 };
@@ -101,6 +105,16 @@ typedef enum {
 } InstructionType;
 
 
+/* The part of IDA's op_t the lowering needs, kept with the instruction so
+ * it doesn't decode it again */
+class Operand {
+public:
+  Operand() : type(o_void), reg(0), value(0) {};
+  optype_t type;
+  uint16 reg;
+  uval_t value; // op_t.value of o_imm, op_t.addr of the others
+};
+
 class Instruction {
 public:
   Instruction();
@@ -108,8 +122,22 @@ public:
   InstructionType type;
   string name;
   string operands[5];
+  uint32 word; // Encoding of the instruction
+  Operand ops[UA_MAXOP];
+  ea_t target; // Destination of the jump, BADADDR if it doesn't jump
+  bool flow; // Whether execution continues with the next instruction
+  string folded; // Replacement C statement when the result is a known constant
+  bool dead; // Result is overwritten by a folded instruction before any use
 };
 
+typedef struct {
+  int reg; // Register holding the case number
+  ea_t index_use; // Where the table starts using it
+  vector<uval_t> values;
+  vector<ea_t> targets;
+  ea_t defjump; // BADADDR if none
+} JumpTable;
+
 class Function {
 public:
   Function();
@@ -118,7 +146,10 @@ public:
   ea_t end_address;
   int arguments;
   bool ret;
+  string alias; // Identical function called instead of lowering this one
   list<Instruction> instructions;
+  map<ea_t, JumpTable> tables; // Jump tables IDA resolved, by bctr address
+  set<ea_t> calls;
 };
 
 typedef enum {
@@ -130,13 +161,14 @@ typedef enum {
 
 class ConditionRegister {
 public:
-  ConditionRegister() {};
+  ConditionRegister() : pending(false) {};
   Register reg; // Register to compare
   RegisterSize size; // size of comparison
   bool immediate; // whether or not it's an immediate comparison
   bool _signed; // whether or not the comparison is arithmetic or logical
-  uval_t cmp_imm; // Immediate value to compare
+  sval_t cmp_imm; // Immediate value to compare
   Register cmp_reg; // Second register to compare
+  bool pending; // CR isn't written yet, the code of the compare is due
 };
 
 #define MAX_CR 7
@@ -155,7 +187,7 @@ extern ConditionRegister cr[MAX_CR + 1];
   }
 
 string tostr(int);
-Register parse_pointer (ea_t ea, int operand, ea_t &offset);
+Register parse_pointer (Instruction &ins, int operand, ea_t &offset);
 
 
 #endif /* __PPC2C_HPP__ */
@@ -10,17 +10,17 @@
 
 #include "ppc2c_handlers.hpp"
 
-bool PPCAsm2C(ea_t ea, char* buff, int buffSize);
+bool PPCAsm2C(Instruction &ins, char* buff, int buffSize);
 void
 handle_ppc2c_instructions (Function &func, Instruction &ins, HandlerResult *result)
 {
   char buffer[1024];
   result->out_reg = result->in_reg1 = result->in_reg2 = REGISTER_UNSET;
 
-  if (PPCAsm2C(ins.address, buffer, sizeof(buffer)))
-    result->c_code = buffer;
+  if (PPCAsm2C(ins, buffer, sizeof(buffer)))
+    code_arena << buffer;
   else
-	result->c_code = " /* Error handling PPCAsm2C */";
+	code_arena << " /* Error handling PPCAsm2C */";
 }
 
 void
@@ -28,23 +28,9 @@ handle_preproc_set (Function &func, Instruction &ins, HandlerResult *result)
 {
   result->out_reg = result->in_reg1 = result->in_reg2 = REGISTER_UNSET;
 
-  result->c_code = "#define " + ins.operands[0] + ins.operands[1];
+  code_arena << "#define " << ins.operands[0] << ins.operands[1];
 }
 
-void
-handle_stdu (Function &func, Instruction &ins, HandlerResult *result)
-{
-  result->out_reg = ins.operands[0];
-  result->in_reg1 = result->out_reg;
-  result->in_reg2 = REGISTER_UNSET;
-
-  assert (result->out_reg == REGISTER_SP);
-
-  /* TODO: modify the stack */
-  result->c_code = "";
-}
-
-
 void
 handle_mflr (Function &func, Instruction &ins, HandlerResult *result)
 {
@@ -52,7 +38,7 @@ handle_mflr (Function &func, Instruction &ins, HandlerResult *result)
   result->in_reg1 = REGISTER_LR;
   result->in_reg2 = REGISTER_UNSET;
 
-  result->c_code = string (result->out_reg) + " = LR";
+  code_arena << result->out_reg << " = LR";
 }
 
 void
@@ -62,7 +48,7 @@ handle_mr (Function &func, Instruction &ins, HandlerResult *result)
   result->in_reg1 = ins.operands[1];
   result->in_reg2 = REGISTER_UNSET;
 
-  result->c_code = string (result->out_reg) + " = " + string (result->in_reg1);
+  code_arena << result->out_reg << " = " << result->in_reg1;
 }
 
 void
@@ -75,7 +61,7 @@ handle_mfspr (Function &func, Instruction &ins, HandlerResult *result)
   if (result->in_reg1 != REGISTER_LR)
     ERROR ("MFSPR: Unrecognized special register : " + result->in_reg1);
 
-  result->c_code = string(result->out_reg) + " = LR";
+  code_arena << result->out_reg << " = LR";
 }
 
 void
@@ -85,64 +71,185 @@ handle_mtlr (Function &func, Instruction &ins, HandlerResult *result)
   result->in_reg1 = ins.operands[1];
   result->in_reg2 = REGISTER_UNSET;
 
-  result->c_code = "LR = " + string (result->in_reg1);
+  code_arena << "LR = " << result->in_reg1;
 }
 
 void
-handle_mtspr (Function &func, Instruction &ins, HandlerResult *result)
+handle_mfctr (Function &func, Instruction &ins, HandlerResult *result)
 {
   result->out_reg = ins.operands[0];
-  result->in_reg1 = ins.operands[1];
+  result->in_reg1 = REGISTER_CTR;
   result->in_reg2 = REGISTER_UNSET;
 
-  if (result->in_reg1 == REGISTER_LR)
-    result->c_code = "  LR = " + string (result->in_reg1);
-  else
-    ERROR ("MFSPR: Unrecognized special register : " + result->in_reg1);
+  code_arena << result->out_reg << " = CTR";
 }
 
-
 void
-handle_std (Function &func, Instruction &ins, HandlerResult *result)
+handle_mtctr (Function &func, Instruction &ins, HandlerResult *result)
 {
-  ea_t offset;
-
-  result->out_reg = parse_pointer (ins.address, 1, offset);
+  result->out_reg = REGISTER_CTR;
   result->in_reg1 = ins.operands[0];
   result->in_reg2 = REGISTER_UNSET;
 
-  result->c_code = string (result->out_reg) + "[" + tostr(offset) + "] = " +
-    string (result->in_reg1);
+  code_arena << "CTR = " << result->in_reg1;
 }
 
 void
-handle_lbz (Function &func, Instruction &ins, HandlerResult *result)
+handle_mtspr (Function &func, Instruction &ins, HandlerResult *result)
 {
-  ea_t offset;
-
   result->out_reg = ins.operands[0];
-  result->in_reg1 = parse_pointer (ins.address, 1, offset);
+  result->in_reg1 = ins.operands[1];
   result->in_reg2 = REGISTER_UNSET;
 
-  result->c_code = string (result->out_reg) + " = ((uint8_t *)" +
-    string (result->in_reg1) + ")[" + tostr(offset) + "]";
+  if (result->in_reg1 == REGISTER_LR)
+    code_arena << "  LR = " << result->in_reg1;
+  else
+    ERROR ("MFSPR: Unrecognized special register : " + result->in_reg1);
 }
 
-void
-handle_lwz (Function &func, Instruction &ins, HandlerResult *result)
-{
-  ea_t offset;
 
-  result->out_reg = ins.operands[0];
-  result->in_reg1 = parse_pointer (ins.address, 1, offset);
-  result->in_reg2 = REGISTER_UNSET;
+/* Every load and store goes through the PPC2C_LD and PPC2C_ST macros of the
+ * runtime, which take care of the guest being big-endian */
+static const struct {
+  const char *mnemonic;
+  int size; // Bytes accessed
+  bool store;
+  bool _signed; // Load sign extends
+  bool update; // Address is written back to the base register
+  bool indexed; // Address is rA + rB instead of d(rA)
+  bool reversed; // Byte-reversed access
+} memory_forms[] = {
+  {"lbz", 1, false, false, false, false, false},
+  {"lbzu", 1, false, false, true, false, false},
+  {"lbzx", 1, false, false, false, true, false},
+  {"lbzux", 1, false, false, true, true, false},
+  {"lhz", 2, false, false, false, false, false},
+  {"lhzu", 2, false, false, true, false, false},
+  {"lhzx", 2, false, false, false, true, false},
+  {"lhzux", 2, false, false, true, true, false},
+  {"lha", 2, false, true, false, false, false},
+  {"lhau", 2, false, true, true, false, false},
+  {"lhax", 2, false, true, false, true, false},
+  {"lhaux", 2, false, true, true, true, false},
+  {"lhbrx", 2, false, false, false, true, true},
+  {"lwz", 4, false, false, false, false, false},
+  {"lwzu", 4, false, false, true, false, false},
+  {"lwzx", 4, false, false, false, true, false},
+  {"lwzux", 4, false, false, true, true, false},
+  {"lwa", 4, false, true, false, false, false},
+  {"lwax", 4, false, true, false, true, false},
+  {"lwaux", 4, false, true, true, true, false},
+  {"lwbrx", 4, false, false, false, true, true},
+  {"ld", 8, false, false, false, false, false},
+  {"ldu", 8, false, false, true, false, false},
+  {"ldx", 8, false, false, false, true, false},
+  {"ldux", 8, false, false, true, true, false},
+  {"stb", 1, true, false, false, false, false},
+  {"stbu", 1, true, false, true, false, false},
+  {"stbx", 1, true, false, false, true, false},
+  {"stbux", 1, true, false, true, true, false},
+  {"sth", 2, true, false, false, false, false},
+  {"sthu", 2, true, false, true, false, false},
+  {"sthx", 2, true, false, false, true, false},
+  {"sthux", 2, true, false, true, true, false},
+  {"sthbrx", 2, true, false, false, true, true},
+  {"stw", 4, true, false, false, false, false},
+  {"stwu", 4, true, false, true, false, false},
+  {"stwx", 4, true, false, false, true, false},
+  {"stwux", 4, true, false, true, true, false},
+  {"stwbrx", 4, true, false, false, true, true},
+  {"std", 8, true, false, false, false, false},
+  {"stdu", 8, true, false, true, false, false},
+  {"stdx", 8, true, false, false, true, false},
+  {"stdux", 8, true, false, true, true, false},
+  {NULL, 0, false, false, false, false, false}
+};
+
+/* The effective address of a load or store, from the base register and
+ * either the index register or the displacement */
+static void
+append_address (Register base, Register index, int displacement, bool update)
+{
+  if (index != REGISTER_UNSET) {
+    if (base == REGISTER_R0 && !update)
+      code_arena << index;
+    else
+      code_arena << base << " + " << index;
+  } else if (base == REGISTER_R0 && !update) {
+    code_arena.append_int (displacement);
+  } else if (displacement > 0) {
+    code_arena << base << " + ";
+    code_arena.append_int (displacement);
+  } else if (displacement < 0) {
+    code_arena << base << " - ";
+    code_arena.append_int (-displacement);
+  } else {
+    code_arena << base;
+  }
+}
 
-  result->c_code = string (result->out_reg) + " = ((uint32_t *)";
-  if (offset > 0)
-    result->c_code += "(" + string (result->in_reg1) + " + " + tostr(offset) + ")";
+void
+handle_load_store (Function &func, Instruction &ins, HandlerResult *result)
+{
+  Register base;
+  int displacement = 0;
+  bool update;
+  int i;
+
+  for (i = 0; memory_forms[i].mnemonic; i++)
+    if (ins.name == memory_forms[i].mnemonic)
+      break;
+  assert (memory_forms[i].mnemonic != NULL);
+  update = memory_forms[i].update;
+
+  if (memory_forms[i].indexed) {
+    base = Register (ins.operands[1]);
+    result->in_reg2 = ins.operands[2];
+  } else {
+    ea_t offset = 0;
+
+    base = parse_pointer (ins, 1, offset);
+    result->in_reg2 = REGISTER_UNSET;
+    displacement = (int16) offset;
+  }
+
+  /* A load with update can't load its base, so the base is updated first
+   * and the load reads it: the loaded register may be the index */
+  if (update && !memory_forms[i].store) {
+    code_arena << base << " = ";
+    append_address (base, result->in_reg2, displacement, update);
+    code_arena << "; ";
+  }
+
+  if (memory_forms[i].store) {
+    result->out_reg = REGISTER_UNSET;
+    result->in_reg1 = ins.operands[0];
+  } else {
+    result->out_reg = ins.operands[0];
+    result->in_reg1 = base;
+    code_arena << result->out_reg << " = ";
+    if (memory_forms[i]._signed)
+      code_arena << (memory_forms[i].size == 2 ? "(int16_t) " : "(int32_t) ");
+  }
+
+  code_arena << (memory_forms[i].store ? "PPC2C_ST" : "PPC2C_LD");
+  code_arena.append_int (memory_forms[i].size * 8);
+  if (memory_forms[i].reversed)
+    code_arena << "_LE";
+  code_arena << " (";
+  if (update && !memory_forms[i].store)
+    code_arena << base;
   else
-    result->c_code += string (result->in_reg1);
-  result->c_code += ")[0]";
+    append_address (base, result->in_reg2, displacement, update);
+  if (memory_forms[i].store)
+    code_arena << ", " << result->in_reg1;
+  code_arena << ")";
+
+  /* The store uses the old value of the base, and might store it */
+  if (update && memory_forms[i].store) {
+    code_arena << "; " << base << " = ";
+    append_address (base, result->in_reg2, displacement, update);
+  }
 }
 
 void
@@ -152,7 +259,7 @@ handle_li (Function &func, Instruction &ins, HandlerResult *result)
   result->in_reg1 = REGISTER_UNSET;
   result->in_reg2 = REGISTER_UNSET;
 
-  result->c_code = string (result->out_reg) + " = " + ins.operands[1];
+  code_arena << result->out_reg << " = " << ins.operands[1];
 }
 
 void
@@ -162,7 +269,7 @@ handle_lis (Function &func, Instruction &ins, HandlerResult *result)
   result->in_reg1 = REGISTER_UNSET;
   result->in_reg2 = REGISTER_UNSET;
 
-  result->c_code = string(result->out_reg) + " = " + ins.operands[1] + " << 16";
+  code_arena << result->out_reg << " = " << ins.operands[1] << " << 16";
 }
 
 void
@@ -172,8 +279,8 @@ handle_add (Function &func, Instruction &ins, HandlerResult *result)
   result->in_reg1 = ins.operands[1];
   result->in_reg2 = ins.operands[2];
 
-  result->c_code = string (result->out_reg) + " = " +
-    string (result->in_reg1) + " + " + string (result->in_reg2);
+  code_arena << result->out_reg << " = " <<
+    result->in_reg1 << " + " << result->in_reg2;
 }
 
 void
@@ -183,8 +290,8 @@ handle_addi (Function &func, Instruction &ins, HandlerResult *result)
   result->in_reg1 = ins.operands[1];
   result->in_reg2 = REGISTER_UNSET;
 
-  result->c_code = string (result->out_reg) + " = " +
-    string (result->in_reg1) + " + " + ins.operands[2];
+  code_arena << result->out_reg << " = " <<
+    result->in_reg1 << " + " << ins.operands[2];
 }
 
 void
@@ -194,8 +301,20 @@ handle_addis (Function &func, Instruction &ins, HandlerResult *result)
   result->in_reg1 = ins.operands[1];
   result->in_reg2 = REGISTER_UNSET;
 
-  result->c_code = string (result->out_reg) + " = (" +
-    string (result->in_reg1) + " + " + ins.operands[2] + ") << 16";
+  // The immediate is signed, the cast keeps its sign and the shift defined
+  code_arena << result->out_reg << " = " << result->in_reg1 <<
+    " + ((uint64_t) " << ins.operands[2] << " << 16)";
+}
+
+void
+handle_mulli (Function &func, Instruction &ins, HandlerResult *result)
+{
+  result->out_reg = ins.operands[0];
+  result->in_reg1 = ins.operands[1];
+  result->in_reg2 = REGISTER_UNSET;
+
+  code_arena << result->out_reg << " = " <<
+    result->in_reg1 << " * " << ins.operands[2];
 }
 
 void
@@ -205,8 +324,8 @@ handle_or (Function &func, Instruction &ins, HandlerResult *result)
   result->in_reg1 = ins.operands[1];
   result->in_reg2 = ins.operands[2];
 
-  result->c_code = string (result->out_reg) + " = " +
-    string (result->in_reg1) + " | " + string (result->in_reg2);
+  code_arena << result->out_reg << " = " <<
+    result->in_reg1 << " | " << result->in_reg2;
 }
 
 void
@@ -216,8 +335,8 @@ handle_ori (Function &func, Instruction &ins, HandlerResult *result)
   result->in_reg1 = ins.operands[1];
   result->in_reg2 = REGISTER_UNSET;
 
-  result->c_code = string (result->out_reg) + " = " +
-    string (result->in_reg1) + " | " + ins.operands[2];
+  code_arena << result->out_reg << " = " <<
+    result->in_reg1 << " | " << ins.operands[2];
 }
 
 void
@@ -227,8 +346,8 @@ handle_oris (Function &func, Instruction &ins, HandlerResult *result)
   result->in_reg1 = ins.operands[1];
   result->in_reg2 = REGISTER_UNSET;
 
-  result->c_code = string (result->out_reg) + " = (" +
-    string (result->in_reg1) + " | " + ins.operands[2] + ") << 16";
+  code_arena << result->out_reg << " = " << result->in_reg1 <<
+    " | ((uint64_t) " << ins.operands[2] << " << 16)";
 }
 
 
@@ -239,8 +358,8 @@ handle_xor (Function &func, Instruction &ins, HandlerResult *result)
   result->in_reg1 = ins.operands[1];
   result->in_reg2 = ins.operands[2];
 
-  result->c_code = string (result->out_reg) + " = " +
-    string (result->in_reg1) + " ^ " + string (result->in_reg2);
+  code_arena << result->out_reg << " = " <<
+    result->in_reg1 << " ^ " << result->in_reg2;
 }
 
 void
@@ -250,94 +369,513 @@ handle_and (Function &func, Instruction &ins, HandlerResult *result)
   result->in_reg1 = ins.operands[1];
   result->in_reg2 = ins.operands[2];
 
-  result->c_code = string (result->out_reg) + " = " +
-    string (result->in_reg1) + " & " + string (result->in_reg2);
+  code_arena << result->out_reg << " = " <<
+    result->in_reg1 << " & " << result->in_reg2;
 }
 
-void
-handle_cmpw (Function &func, Instruction &ins, HandlerResult *result)
+static void
+set_condition_register (Instruction &ins, HandlerResult *result,
+                        RegisterSize size, bool immediate, bool _signed)
 {
   ConditionRegister *crX;
 
   result->out_reg = ins.operands[0];
   result->in_reg1 = ins.operands[1];
-  result->in_reg2 = ins.operands[2];
-  result->c_code = "";
-
+  result->in_reg2 = immediate ? Register (REGISTER_UNSET) : Register (ins.operands[2]);
   assert (result->out_reg >= REGISTER_CR0 && result->out_reg <= REGISTER_CR7);
 
   crX = &cr[result->out_reg - REGISTER_CR0];
 
+  /* The compare only writes CR when something needs it, until then the
+   * branch ending the block can test the registers directly */
   crX->reg = result->in_reg1;
-  crX->size = REGISTER_SIZE_WORD;
-  crX->immediate = false;
-  crX->_signed = true;
-  crX->cmp_reg = result->in_reg2;
+  crX->pending = true;
+  crX->size = size;
+  crX->immediate = immediate;
+  crX->_signed = _signed;
+  if (immediate)
+    crX->cmp_imm = strtol (ins.operands[2].c_str(), NULL, 0);
+  else
+    crX->cmp_reg = result->in_reg2;
+}
+
+void
+handle_cmpw (Function &func, Instruction &ins, HandlerResult *result)
+{
+  set_condition_register (ins, result, REGISTER_SIZE_WORD, false, true);
 }
 
 void
 handle_cmplw (Function &func, Instruction &ins, HandlerResult *result)
 {
-  ConditionRegister *crX;
+  set_condition_register (ins, result, REGISTER_SIZE_WORD, false, false);
+}
 
-  result->out_reg = ins.operands[0];
-  result->in_reg1 = ins.operands[1];
-  result->in_reg2 = ins.operands[2];
-  result->c_code = "";
+void
+handle_cmpwi (Function &func, Instruction &ins, HandlerResult *result)
+{
+  set_condition_register (ins, result, REGISTER_SIZE_WORD, true, true);
+}
 
-  assert (result->out_reg >= REGISTER_CR0 && result->out_reg <= REGISTER_CR7);
+void
+handle_cmplwi (Function &func, Instruction &ins, HandlerResult *result)
+{
+  set_condition_register (ins, result, REGISTER_SIZE_WORD, true, false);
+}
 
-  crX = &cr[result->out_reg - REGISTER_CR0];
+void
+handle_cmpd (Function &func, Instruction &ins, HandlerResult *result)
+{
+  set_condition_register (ins, result, REGISTER_SIZE_QWORD, false, true);
+}
 
-  crX->reg = result->in_reg1;
-  crX->size = REGISTER_SIZE_WORD;
-  crX->immediate = false;
-  crX->_signed = false;
-  crX->cmp_reg = result->in_reg2;
+void
+handle_cmpld (Function &func, Instruction &ins, HandlerResult *result)
+{
+  set_condition_register (ins, result, REGISTER_SIZE_QWORD, false, false);
 }
 
 void
-handle_cmpwi (Function &func, Instruction &ins, HandlerResult *result)
+handle_cmpdi (Function &func, Instruction &ins, HandlerResult *result)
 {
-  ConditionRegister *crX;
+  set_condition_register (ins, result, REGISTER_SIZE_QWORD, true, true);
+}
 
-  result->out_reg = ins.operands[0];
-  result->in_reg1 = ins.operands[1];
-  result->in_reg2 = REGISTER_UNSET;
-  result->c_code = "";
+void
+handle_cmpldi (Function &func, Instruction &ins, HandlerResult *result)
+{
+  set_condition_register (ins, result, REGISTER_SIZE_QWORD, true, false);
+}
 
-  assert (result->out_reg >= REGISTER_CR0 && result->out_reg <= REGISTER_CR7);
+/* Strip the branch prediction hint from a mnemonic ("bne+" -> "bne") */
+static string
+branch_mnemonic (Instruction &ins)
+{
+  string mnem = ins.name;
 
-  crX = &cr[result->out_reg - REGISTER_CR0];
+  while (mnem.length() > 1 &&
+         (mnem[mnem.length() - 1] == '+' || mnem[mnem.length() - 1] == '-'))
+    mnem.erase(mnem.length() - 1);
 
-  crX->reg = result->in_reg1;
-  crX->size = REGISTER_SIZE_WORD;
-  crX->immediate = true;
-  crX->_signed = true;
-  crX->cmp_imm = strtol (ins.operands[2].c_str(), NULL, 0);
+  return mnem;
 }
 
+/* IDA names may use characters that C identifiers can't */
+static inline char
+identifier_char (char c)
+{
+  if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+      (c >= '0' && c <= '9') || c == '_')
+    return c;
+  return '_';
+}
+
+string
+c_identifier (const string &name)
+{
+  string identifier = name;
+  size_t i;
+
+  for (i = 0; i < identifier.length(); i++)
+    identifier[i] = identifier_char (identifier[i]);
+  if (identifier.length() > 0 && identifier[0] >= '0' && identifier[0] <= '9')
+    identifier = "_" + identifier;
+  return identifier;
+}
+
+/* Same as c_identifier (), straight into the arena */
+static void
+append_c_identifier (const string &name)
+{
+  size_t i;
+
+  if (name.length() > 0 && name[0] >= '0' && name[0] <= '9')
+    code_arena << "_";
+  for (i = 0; i < name.length(); i++) {
+    char c = identifier_char (name[i]);
+    code_arena.append (&c, 1);
+  }
+}
+
+/* Calls go through the runtime so the callee sees the registers */
 void
-handle_cmplwi (Function &func, Instruction &ins, HandlerResult *result)
+handle_bl (Function &func, Instruction &ins, HandlerResult *result)
 {
-  ConditionRegister *crX;
+  result->out_reg = result->in_reg1 = result->in_reg2 = REGISTER_UNSET;
 
-  result->out_reg = ins.operands[0];
-  result->in_reg1 = ins.operands[1];
-  result->in_reg2 = REGISTER_UNSET;
-  result->c_code = "";
+  code_arena << "PPC2C_CALL (ctx, ";
+  append_c_identifier (ins.operands[0]);
+  code_arena << ")";
+}
 
-  assert (result->out_reg >= REGISTER_CR0 && result->out_reg <= REGISTER_CR7);
+void
+handle_bctrl (Function &func, Instruction &ins, HandlerResult *result)
+{
+  result->out_reg = result->in_reg1 = result->in_reg2 = REGISTER_UNSET;
 
-  crX = &cr[result->out_reg - REGISTER_CR0];
+  code_arena << "PPC2C_CALL_INDIRECT (ctx, CTR)";
+}
 
-  crX->reg = result->in_reg1;
-  crX->size = REGISTER_SIZE_WORD;
-  crX->immediate = true;
-  crX->_signed = false;
-  crX->cmp_imm = strtol (ins.operands[2].c_str(), NULL, 0);
+void
+handle_blrl (Function &func, Instruction &ins, HandlerResult *result)
+{
+  result->out_reg = result->in_reg1 = result->in_reg2 = REGISTER_UNSET;
+
+  code_arena << "PPC2C_CALL_INDIRECT (ctx, LR)";
+}
+
+bool
+is_call (Instruction &ins)
+{
+  string mnem;
+
+  if (ins.type != INSTRUCTION_TYPE_INSTRUCTION || ins.name[0] != 'b')
+    return false;
+
+  /* Careful with "bnl" (branch if not less) */
+  mnem = branch_mnemonic (ins);
+  return mnem[mnem.length() - 1] == 'l' && mnem != "bnl";
+}
+
+BranchType
+get_branch_type (Instruction &ins)
+{
+  string mnem;
+  size_t len;
+
+  if (ins.type != INSTRUCTION_TYPE_INSTRUCTION || ins.name[0] != 'b')
+    return BRANCH_NONE;
+
+  mnem = branch_mnemonic (ins);
+  len = mnem.length();
+
+  if (mnem == "b")
+    return BRANCH_ALWAYS;
+  if (mnem == "blr")
+    return BRANCH_RETURN;
+  if (mnem == "bctr")
+    return BRANCH_INDIRECT;
+  /* Calls don't end a block */
+  if (is_call (ins))
+    return BRANCH_NONE;
+  if (len > 3 && mnem.compare(len - 2, 2, "lr") == 0)
+    return BRANCH_COND_RETURN;
+  if (len > 4 && mnem.compare(len - 3, 3, "ctr") == 0)
+    return BRANCH_INDIRECT;
+  if (ins.target != BADADDR)
+    return BRANCH_CONDITIONAL;
+
+  return BRANCH_NONE;
+}
+
+static const struct {
+  const char *cond;
+  const char *op;
+  const char *negated_op;
+  const char *bit; // Bit of the field tested when the compare isn't known
+  bool clear; // Condition holds if the bit is clear
+} conditions[] = {
+  {"lt", "<", ">=", "lt", false},
+  {"le", "<=", ">", "gt", true},
+  {"eq", "==", "!=", "eq", false},
+  {"ge", ">=", "<", "lt", true},
+  {"gt", ">", "<=", "gt", false},
+  {"ne", "!=", "==", "eq", true},
+  {"nl", ">=", "<", "lt", true},
+  {"ng", "<=", ">", "gt", true},
+  {"so", NULL, NULL, "so", false},
+  {"ns", NULL, NULL, "so", true},
+  {"un", NULL, NULL, "so", false},
+  {"nu", NULL, NULL, "so", true},
+  {NULL, NULL, NULL, NULL, false}
+};
+
+static string
+cr_condition (int crX, const string &cond, bool negate)
+{
+  ConditionRegister *c = &cr[crX];
+  string cast;
+  string result;
+  int i;
+
+  for (i = 0; conditions[i].cond; i++) {
+    if (cond == conditions[i].cond)
+      break;
+  }
+
+  if (conditions[i].cond == NULL) {
+    result = "cr" + tostr(crX) + "_" + cond;
+    return negate ? "!" + result : result;
+  }
+
+  /* Compares of another block, or whose registers changed since, are
+   * read back from CR */
+  if (conditions[i].op == NULL || c->reg == REGISTER_UNSET) {
+    result = "cr" + tostr(crX) + "_" + conditions[i].bit;
+    return negate != conditions[i].clear ? "!" + result : result;
+  }
+
+  if (c->size == REGISTER_SIZE_QWORD)
+    cast = c->_signed ? "(int64_t)" : "(uint64_t)";
+  else
+    cast = c->_signed ? "(int32_t)" : "(uint32_t)";
+
+  result = cast + string (c->reg) + " " +
+    (negate ? conditions[i].negated_op : conditions[i].op) + " ";
+  if (c->immediate)
+    result += tostr(c->cmp_imm);
+  else
+    result += cast + string (c->cmp_reg);
+
+  return result;
+}
+
+string
+branch_condition (Instruction &ins, bool negate)
+{
+  string mnem = branch_mnemonic (ins);
+  int crX = 0;
+
+  if (ins.operands[0].compare(0, 2, "cr") == 0 && ins.operands[0].length() == 3)
+    crX = ins.operands[0][2] - '0';
+
+  if (mnem == "bdnz")
+    return negate ? "--CTR == 0" : "--CTR != 0";
+  if (mnem == "bdz")
+    return negate ? "--CTR != 0" : "--CTR == 0";
+
+  if (mnem == "bc") {
+    // bc BO,BI,target_addr with BI as "4*crX+cond" or "cond"
+    int BO = atol(ins.operands[0].c_str());
+    string BI = ins.operands[1];
+    string cond = BI;
+
+    if (BI.compare(0, 2, "4*") == 0 && BI.length() >= 8) {
+      crX = BI[4] - '0';
+      cond = BI.substr(6, 2);
+    }
+    if ((BO & 0x14) == 0x14)
+      return negate ? "0" : "1";
+    if ((BO & 0x1C) == 0x04)
+      return cr_condition (crX, cond, !negate);
+    if ((BO & 0x1C) == 0x0C)
+      return cr_condition (crX, cond, negate);
+    return "/* bc " + ins.operands[0] + "," + ins.operands[1] + " */ " +
+      (negate ? "0" : "1");
+  }
+
+  /* Strip the "b" prefix and the "lr" suffix of conditional returns */
+  mnem = mnem.substr(1);
+  if (get_branch_type (ins) == BRANCH_COND_RETURN)
+    mnem.erase(mnem.length() - 2);
+
+  return cr_condition (crX, mnem, negate);
+}
+
+
+/* Field of CR an operand names, -1 if it isn't one */
+static int
+cr_field (const string &operand)
+{
+  if (operand.length() == 3 && operand.compare(0, 2, "cr") == 0 &&
+      operand[2] >= '0' && operand[2] <= '7')
+    return operand[2] - '0';
+  return -1;
+}
+
+/* Same parsing as branch_condition () */
+static int
+branch_field (Instruction &ins)
+{
+  string mnem = branch_mnemonic (ins);
+  BranchType type = get_branch_type (ins);
+
+  if (type != BRANCH_CONDITIONAL && type != BRANCH_COND_RETURN &&
+      type != BRANCH_INDIRECT)
+    return -1;
+  if (mnem == "bctr" || mnem == "bdnz" || mnem == "bdz")
+    return -1;
+  // bdnzt, bdzf and friends, which aren't lowered
+  if (mnem.compare(0, 2, "bd") == 0)
+    return CR_ALL;
+
+  if (mnem == "bc") {
+    int BO = atol(ins.operands[0].c_str());
+    string BI = ins.operands[1];
+
+    if ((BO & 0x1C) != 0x04 && (BO & 0x1C) != 0x0C)
+      return -1;
+    if (BI.compare(0, 2, "4*") == 0 && BI.length() >= 8)
+      return BI[4] - '0';
+    return 0;
+  }
+
+  return cr_field (ins.operands[0]) >= 0 ? cr_field (ins.operands[0]) : 0;
+}
+
+int
+condition_read (Instruction &ins)
+{
+  if (ins.type != INSTRUCTION_TYPE_INSTRUCTION)
+    return -1;
+  if (ins.name[0] == 'b')
+    return branch_field (ins);
+  if (ins.name.compare(0, 2, "cr") == 0 || ins.name == "mcrf" ||
+      ins.name == "mfcr" || ins.name == "mfocrf" || ins.name == "isel")
+    return CR_ALL;
+  return -1;
+}
+
+int
+condition_written (Instruction &ins)
+{
+  int opcode = ins.word >> 26;
+
+  if (ins.type != INSTRUCTION_TYPE_INSTRUCTION)
+    return -1;
+  if (ins.name.compare(0, 3, "cmp") == 0 || ins.name.compare(0, 4, "fcmp") == 0)
+    return cr_field (ins.operands[0]) >= 0 ? cr_field (ins.operands[0]) : 0;
+  if (ins.name.compare(0, 2, "cr") == 0 || ins.name == "mcrf" ||
+      ins.name == "mtcrf" || ins.name == "mtocrf" || ins.name == "mcrxr" ||
+      ins.name == "mcrfs")
+    return CR_ALL;
+  if (ins.name.compare(0, 4, "vcmp") == 0)
+    return (ins.word & 0x400) ? 6 : -1;
+
+  /* Record forms, the mnemonic lost its dot when it was parsed */
+  if (opcode == 28 || opcode == 29)
+    return 0;
+  if ((opcode == 20 || opcode == 21 || opcode == 23 || opcode == 30 ||
+       opcode == 31) && (ins.word & 1))
+    return 0;
+  if ((opcode == 59 || opcode == 63) && (ins.word & 1))
+    return 1;
+  return -1;
+}
+
+/* Fields of CR read after the block being printed, and after its calls */
+static uint32 live_fields;
+static uint32 call_fields;
+
+void
+reset_conditions (uint32 live, uint32 calls)
+{
+  int i;
+
+  for (i = 0; i <= MAX_CR; i++) {
+    cr[i].reg = REGISTER_UNSET;
+    cr[i].pending = false;
+  }
+  live_fields = live;
+  call_fields = calls;
+}
+
+/* The GPR a compare operand names, the stack pointer being r1 */
+static int
+gpr_number (Register reg)
+{
+  if (reg == REGISTER_SP)
+    return 1;
+  return reg;
 }
 
+bool
+writes_register (Instruction &ins, int reg)
+{
+  const string &name = ins.name;
+  size_t len = name.length();
+
+  if (reg < 0 || reg > 31)
+    return false;
+
+  // Loads and stores with update write their base register too
+  if ((name[0] == 'l' || name.compare(0, 2, "st") == 0) && len > 2 &&
+      (name[len - 1] == 'u' || name.compare(len - 2, 2, "ux") == 0) &&
+      ins.ops[1].reg == reg)
+    return true;
+  if (name.compare(0, 2, "st") == 0 || name.compare(0, 2, "mt") == 0)
+    return false;
+  if (ins.ops[0].type != o_reg)
+    return false;
+  if (name == "lmw" || name == "lswi")
+    return ins.ops[0].reg <= reg;
+  return ins.ops[0].reg == reg;
+}
+
+static void
+spill (int crX, vector<string> &code)
+{
+  ConditionRegister *c = &cr[crX];
+  string type;
+
+  if (c->size == REGISTER_SIZE_QWORD)
+    type = c->_signed ? "int64_t" : "uint64_t";
+  else
+    type = c->_signed ? "int32_t" : "uint32_t";
+
+  code.push_back ("PPC2C_CR_COMPARE (CR, " + tostr(crX) + ", " + type + ", " +
+      string (c->reg) + ", " +
+      (c->immediate ? tostr(c->cmp_imm) : string (c->cmp_reg)) + ");");
+  c->pending = false;
+}
+
+/* Code of the compares 'ins' needs in CR, or would change the registers
+ * of, to be printed before it */
+void
+spill_conditions (Instruction &ins, vector<string> &code)
+{
+  int read = condition_read (ins);
+  int written = condition_written (ins);
+  bool call = is_call (ins);
+  int i;
+
+  for (i = 0; i <= MAX_CR; i++) {
+    ConditionRegister *c = &cr[i];
+
+    if (c->reg == REGISTER_UNSET)
+      continue;
+    if (call) {
+      // The callee keeps the fields the ABI asks it to
+      if (c->pending && (call_fields & (1 << i)))
+        spill (i, code);
+      c->reg = REGISTER_UNSET;
+    } else if (written == i) {
+      // Overwritten before anything read it
+      c->reg = REGISTER_UNSET;
+    } else if (read == CR_ALL || written == CR_ALL) {
+      if (c->pending)
+        spill (i, code);
+      if (written == CR_ALL)
+        c->reg = REGISTER_UNSET;
+    } else if (writes_register (ins, gpr_number (c->reg)) ||
+               (!c->immediate && writes_register (ins, gpr_number (c->cmp_reg)))) {
+      if (c->pending)
+        spill (i, code);
+      c->reg = REGISTER_UNSET;
+    }
+    if (c->reg == REGISTER_UNSET)
+      c->pending = false;
+  }
+}
+
+/* Code of the compares still due at the end of a block: the one its branch
+ * tests is left to the condition, unless another block reads it too */
+void
+flush_conditions (Instruction *branch, vector<string> &code)
+{
+  int read = branch ? condition_read (*branch) : -1;
+  int i;
+
+  for (i = 0; i <= MAX_CR; i++) {
+    if (!cr[i].pending)
+      continue;
+    if ((live_fields & (1 << i)) || read == CR_ALL)
+      spill (i, code);
+    else if (read != i)
+      cr[i].reg = REGISTER_UNSET;
+    cr[i].pending = false;
+  }
+}
 
 #if 0
 proc cmpd {cr reg1 reg2} {
@@ -12,15 +12,29 @@
 #define __PPC_HANDLERS_H__
 
 #include "ppc2c_engine.hpp"
+#include "ppc2c_arena.hpp"
 #include <string>
+#include <vector>
 
+/* Handlers append their C code to code_arena, the caller makes it the
+ * c_code of the result */
 typedef struct {
-  string c_code;
+  CodeSlice c_code; // In code_arena
   Register out_reg;
   Register in_reg1;
   Register in_reg2;
 } HandlerResult;
 
+typedef enum {
+  BRANCH_NONE = 0,
+  BRANCH_ALWAYS,       // b
+  BRANCH_CONDITIONAL,  // bc, beq, bdnz...
+  BRANCH_RETURN,       // blr
+  BRANCH_COND_RETURN,  // beqlr, bnelr...
+  BRANCH_INDIRECT,     // bctr
+  BRANCH_SWITCH,       // bctr through a jump table
+} BranchType;
+
 typedef struct {
   const char *instruction;
   InstructionType type;
@@ -53,20 +67,20 @@ static inline bool has_variable_operands (Instruction &ins) {
 
 void handle_ppc2c_instructions (Function &func, Instruction &ins, HandlerResult *result);
 void handle_preproc_set (Function &func, Instruction &ins, HandlerResult *result);
-void handle_stdu (Function &func, Instruction &ins, HandlerResult *result);
+void handle_load_store (Function &func, Instruction &ins, HandlerResult *result);
 void handle_mr (Function &func, Instruction &ins, HandlerResult *result);
 void handle_mflr (Function &func, Instruction &ins, HandlerResult *result);
 void handle_mfspr (Function &func, Instruction &ins, HandlerResult *result);
 void handle_mtlr (Function &func, Instruction &ins, HandlerResult *result);
 void handle_mtspr (Function &func, Instruction &ins, HandlerResult *result);
-void handle_std (Function &func, Instruction &ins, HandlerResult *result);
-void handle_lbz (Function &func, Instruction &ins, HandlerResult *result);
-void handle_lwz (Function &func, Instruction &ins, HandlerResult *result);
+void handle_mfctr (Function &func, Instruction &ins, HandlerResult *result);
+void handle_mtctr (Function &func, Instruction &ins, HandlerResult *result);
 void handle_li (Function &func, Instruction &ins, HandlerResult *result);
 void handle_lis (Function &func, Instruction &ins, HandlerResult *result);
 void handle_add (Function &func, Instruction &ins, HandlerResult *result);
 void handle_addi (Function &func, Instruction &ins, HandlerResult *result);
 void handle_addis (Function &func, Instruction &ins, HandlerResult *result);
+void handle_mulli (Function &func, Instruction &ins, HandlerResult *result);
 void handle_or (Function &func, Instruction &ins, HandlerResult *result);
 void handle_ori (Function &func, Instruction &ins, HandlerResult *result);
 void handle_oris (Function &func, Instruction &ins, HandlerResult *result);
@@ -76,24 +90,89 @@ void handle_cmpw (Function &func, Instruction &ins, HandlerResult *result);
 void handle_cmplw (Function &func, Instruction &ins, HandlerResult *result);
 void handle_cmpwi (Function &func, Instruction &ins, HandlerResult *result);
 void handle_cmplwi (Function &func, Instruction &ins, HandlerResult *result);
+void handle_cmpd (Function &func, Instruction &ins, HandlerResult *result);
+void handle_cmpld (Function &func, Instruction &ins, HandlerResult *result);
+void handle_cmpdi (Function &func, Instruction &ins, HandlerResult *result);
+void handle_cmpldi (Function &func, Instruction &ins, HandlerResult *result);
+void handle_bl (Function &func, Instruction &ins, HandlerResult *result);
+void handle_bctrl (Function &func, Instruction &ins, HandlerResult *result);
+void handle_blrl (Function &func, Instruction &ins, HandlerResult *result);
+
+string c_identifier (const string &name);
+bool writes_register (Instruction &ins, int reg);
+
+bool is_call (Instruction &ins);
+BranchType get_branch_type (Instruction &ins);
+string branch_condition (Instruction &ins, bool negate);
+
+/* Compares are printed as the condition of the branch that tests them when
+ * they can, and written to CR only when something else reads it */
+#define CR_ALL 8 // Every field of CR
+int condition_read (Instruction &ins);
+int condition_written (Instruction &ins);
+void reset_conditions (uint32 live, uint32 calls);
+void spill_conditions (Instruction &ins, vector<string> &code);
+void flush_conditions (Instruction *branch, vector<string> &code);
 
 
 static const InstructionSet instruction_set[] = {
   {"set", INSTRUCTION_TYPE_PREPROCESSOR, has_two_operands, handle_preproc_set},
-  {"stdu", INSTRUCTION_TYPE_INSTRUCTION, has_two_operands, handle_stdu},
   {"mr", INSTRUCTION_TYPE_INSTRUCTION, has_two_operands, handle_mr},
   {"mflr", INSTRUCTION_TYPE_INSTRUCTION, has_two_operands, handle_mflr},
   {"mfspr", INSTRUCTION_TYPE_INSTRUCTION, has_two_operands, handle_mfspr},
   {"mtlr", INSTRUCTION_TYPE_INSTRUCTION, has_two_operands, handle_mtlr},
   {"mtspr", INSTRUCTION_TYPE_INSTRUCTION, has_two_operands, handle_mtspr},
-  {"std", INSTRUCTION_TYPE_INSTRUCTION, has_two_operands, handle_std},
-  {"lbz", INSTRUCTION_TYPE_INSTRUCTION, has_two_operands, handle_lbz},
-  {"lwz", INSTRUCTION_TYPE_INSTRUCTION, has_two_operands, handle_lwz},
+  {"mfctr", INSTRUCTION_TYPE_INSTRUCTION, has_one_operand, handle_mfctr},
+  {"mtctr", INSTRUCTION_TYPE_INSTRUCTION, has_one_operand, handle_mtctr},
+  {"lbz", INSTRUCTION_TYPE_INSTRUCTION, has_two_operands, handle_load_store},
+  {"lbzu", INSTRUCTION_TYPE_INSTRUCTION, has_two_operands, handle_load_store},
+  {"lbzx", INSTRUCTION_TYPE_INSTRUCTION, has_three_operands, handle_load_store},
+  {"lbzux", INSTRUCTION_TYPE_INSTRUCTION, has_three_operands, handle_load_store},
+  {"lhz", INSTRUCTION_TYPE_INSTRUCTION, has_two_operands, handle_load_store},
+  {"lhzu", INSTRUCTION_TYPE_INSTRUCTION, has_two_operands, handle_load_store},
+  {"lhzx", INSTRUCTION_TYPE_INSTRUCTION, has_three_operands, handle_load_store},
+  {"lhzux", INSTRUCTION_TYPE_INSTRUCTION, has_three_operands, handle_load_store},
+  {"lha", INSTRUCTION_TYPE_INSTRUCTION, has_two_operands, handle_load_store},
+  {"lhau", INSTRUCTION_TYPE_INSTRUCTION, has_two_operands, handle_load_store},
+  {"lhax", INSTRUCTION_TYPE_INSTRUCTION, has_three_operands, handle_load_store},
+  {"lhaux", INSTRUCTION_TYPE_INSTRUCTION, has_three_operands, handle_load_store},
+  {"lhbrx", INSTRUCTION_TYPE_INSTRUCTION, has_three_operands, handle_load_store},
+  {"lwz", INSTRUCTION_TYPE_INSTRUCTION, has_two_operands, handle_load_store},
+  {"lwzu", INSTRUCTION_TYPE_INSTRUCTION, has_two_operands, handle_load_store},
+  {"lwzx", INSTRUCTION_TYPE_INSTRUCTION, has_three_operands, handle_load_store},
+  {"lwzux", INSTRUCTION_TYPE_INSTRUCTION, has_three_operands, handle_load_store},
+  {"lwa", INSTRUCTION_TYPE_INSTRUCTION, has_two_operands, handle_load_store},
+  {"lwax", INSTRUCTION_TYPE_INSTRUCTION, has_three_operands, handle_load_store},
+  {"lwaux", INSTRUCTION_TYPE_INSTRUCTION, has_three_operands, handle_load_store},
+  {"lwbrx", INSTRUCTION_TYPE_INSTRUCTION, has_three_operands, handle_load_store},
+  {"ld", INSTRUCTION_TYPE_INSTRUCTION, has_two_operands, handle_load_store},
+  {"ldu", INSTRUCTION_TYPE_INSTRUCTION, has_two_operands, handle_load_store},
+  {"ldx", INSTRUCTION_TYPE_INSTRUCTION, has_three_operands, handle_load_store},
+  {"ldux", INSTRUCTION_TYPE_INSTRUCTION, has_three_operands, handle_load_store},
+  {"stb", INSTRUCTION_TYPE_INSTRUCTION, has_two_operands, handle_load_store},
+  {"stbu", INSTRUCTION_TYPE_INSTRUCTION, has_two_operands, handle_load_store},
+  {"stbx", INSTRUCTION_TYPE_INSTRUCTION, has_three_operands, handle_load_store},
+  {"stbux", INSTRUCTION_TYPE_INSTRUCTION, has_three_operands, handle_load_store},
+  {"sth", INSTRUCTION_TYPE_INSTRUCTION, has_two_operands, handle_load_store},
+  {"sthu", INSTRUCTION_TYPE_INSTRUCTION, has_two_operands, handle_load_store},
+  {"sthx", INSTRUCTION_TYPE_INSTRUCTION, has_three_operands, handle_load_store},
+  {"sthux", INSTRUCTION_TYPE_INSTRUCTION, has_three_operands, handle_load_store},
+  {"sthbrx", INSTRUCTION_TYPE_INSTRUCTION, has_three_operands, handle_load_store},
+  {"stw", INSTRUCTION_TYPE_INSTRUCTION, has_two_operands, handle_load_store},
+  {"stwu", INSTRUCTION_TYPE_INSTRUCTION, has_two_operands, handle_load_store},
+  {"stwx", INSTRUCTION_TYPE_INSTRUCTION, has_three_operands, handle_load_store},
+  {"stwux", INSTRUCTION_TYPE_INSTRUCTION, has_three_operands, handle_load_store},
+  {"stwbrx", INSTRUCTION_TYPE_INSTRUCTION, has_three_operands, handle_load_store},
+  {"std", INSTRUCTION_TYPE_INSTRUCTION, has_two_operands, handle_load_store},
+  {"stdu", INSTRUCTION_TYPE_INSTRUCTION, has_two_operands, handle_load_store},
+  {"stdx", INSTRUCTION_TYPE_INSTRUCTION, has_three_operands, handle_load_store},
+  {"stdux", INSTRUCTION_TYPE_INSTRUCTION, has_three_operands, handle_load_store},
   {"li", INSTRUCTION_TYPE_INSTRUCTION, has_two_operands, handle_li},
   {"lis", INSTRUCTION_TYPE_INSTRUCTION, has_two_operands, handle_lis},
   {"add", INSTRUCTION_TYPE_INSTRUCTION, has_three_operands, handle_add},
   {"addi", INSTRUCTION_TYPE_INSTRUCTION, has_three_operands, handle_addi},
   {"addis", INSTRUCTION_TYPE_INSTRUCTION, has_three_operands, handle_addis},
+  {"mulli", INSTRUCTION_TYPE_INSTRUCTION, has_three_operands, handle_mulli},
   {"or", INSTRUCTION_TYPE_INSTRUCTION, has_three_operands, handle_or},
   {"ori", INSTRUCTION_TYPE_INSTRUCTION, has_three_operands, handle_ori},
   {"oris", INSTRUCTION_TYPE_INSTRUCTION, has_three_operands, handle_oris},
@@ -103,6 +182,13 @@ static const InstructionSet instruction_set[] = {
   {"cmplw", INSTRUCTION_TYPE_INSTRUCTION, has_three_operands, handle_cmplw},
   {"cmpwi", INSTRUCTION_TYPE_INSTRUCTION, has_three_operands, handle_cmpwi},
   {"cmplwi", INSTRUCTION_TYPE_INSTRUCTION, has_three_operands, handle_cmplwi},
+  {"cmpd", INSTRUCTION_TYPE_INSTRUCTION, has_three_operands, handle_cmpd},
+  {"cmpld", INSTRUCTION_TYPE_INSTRUCTION, has_three_operands, handle_cmpld},
+  {"cmpdi", INSTRUCTION_TYPE_INSTRUCTION, has_three_operands, handle_cmpdi},
+  {"cmpldi", INSTRUCTION_TYPE_INSTRUCTION, has_three_operands, handle_cmpldi},
+  {"bl", INSTRUCTION_TYPE_INSTRUCTION, has_one_operand, handle_bl},
+  {"bctrl", INSTRUCTION_TYPE_INSTRUCTION, has_no_operand, handle_bctrl},
+  {"blrl", INSTRUCTION_TYPE_INSTRUCTION, has_no_operand, handle_blrl},
   // PPCAsm2C functions
   {"bc", INSTRUCTION_TYPE_INSTRUCTION, has_variable_operands, handle_ppc2c_instructions},
   {"clrlwi", INSTRUCTION_TYPE_INSTRUCTION, has_variable_operands, handle_ppc2c_instructions},
@@ -0,0 +1,416 @@
+/*
+ * ppc2c_ir.cpp -- Saved functions of the PPC to C converter
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+/*
+ * The file is little-endian and made of fixed size records, all of them a
+ * multiple of 8 bytes, so it can be mapped and read in place. Strings are
+ * offsets in a pool of NUL terminated strings starting with "", each string
+ * stored once. The sections follow the header in this order:
+ *
+ *   header       "PPC2CIR\0" le32 version (3)
+ *                le32 functions, instructions, operands, tables, cases,
+ *                calls, pool size
+ *   functions    le64 address, le64 end address, le32 name, le32 alias,
+ *                le32 first instruction, le32 instructions,
+ *                le32 first table, le32 tables, le32 first call, le32 calls,
+ *                le32 arguments, le32 flags (1: returns)
+ *   instructions le64 address, le64 target, le32 word, u8 type,
+ *                u8 flags (1: flow, 2: dead), u8 operands, u8 0,
+ *                le32 first operand, le32 name, le32 folded,
+ *                le32 operand strings[5]
+ *   operands     le64 value, le16 reg, u8 type, u8 0, le32 0
+ *   tables       le64 bctr address, le64 default, le32 register,
+ *                le32 first case, le32 cases, le32 0, le64 index use
+ *   cases        le64 value, le64 target
+ *   calls        le64 address
+ *   pool
+ *
+ * Labels and comments are instructions of their type, with their text as
+ * the name. The basic blocks aren't saved, build_blocks () finds them
+ * again from the targets, the flow and the jump tables. BADADDR is all
+ * ones whatever the size of ea_t.
+ */
+
+#include "ppc2c_ir.hpp"
+
+#include <fpro.h>
+#include <kernwin.hpp>
+
+#include <cstring>
+
+#define IR_MAGIC "PPC2CIR"
+#define IR_VERSION 3
+#define IR_BADADDR 0xFFFFFFFFFFFFFFFFULL
+
+typedef enum {
+  SECTION_FUNCTIONS,
+  SECTION_INSTRUCTIONS,
+  SECTION_OPERANDS,
+  SECTION_TABLES,
+  SECTION_CASES,
+  SECTION_CALLS,
+  SECTION_POOL,
+  SECTION_COUNT,
+} IRSection;
+
+#define IR_HEADER_SIZE (8 + 4 + 4 * SECTION_COUNT)
+
+// Bytes of a record of each section, the pool is counted in bytes
+static const size_t record_size[SECTION_COUNT] = {56, 56, 16, 40, 16, 8, 1};
+
+#define FUNCTION_RETURNS 1
+#define INSTRUCTION_FLOW 1
+#define INSTRUCTION_DEAD 2
+
+/*
+ * Writing
+ */
+
+static vector<uchar> sections[SECTION_COUNT];
+static map<string, uint32> pool_index;
+
+static void
+put_le (vector<uchar> &out, uint64 value, int bytes)
+{
+  for (int i = 0; i < bytes; i++)
+    out.push_back ((uchar) (value >> (i * 8)));
+}
+
+static void
+put_ea (vector<uchar> &out, ea_t ea)
+{
+  put_le (out, ea == BADADDR ? IR_BADADDR : (uint64) ea, 8);
+}
+
+static void
+put_string (vector<uchar> &out, const string &str)
+{
+  vector<uchar> &pool = sections[SECTION_POOL];
+  map<string, uint32>::iterator it = pool_index.find (str);
+  uint32 offset;
+
+  if (it != pool_index.end ()) {
+    offset = it->second;
+  } else {
+    offset = pool.size ();
+    pool.insert (pool.end (), str.begin (), str.end ());
+    pool.push_back ('\0');
+    pool_index[str] = offset;
+  }
+  put_le (out, offset, 4);
+}
+
+static uint32
+count (IRSection section)
+{
+  return sections[section].size () / record_size[section];
+}
+
+static void
+put_instruction (Instruction &ins)
+{
+  vector<uchar> &out = sections[SECTION_INSTRUCTIONS];
+  int used = 0;
+  int i;
+
+  for (i = 0; i < UA_MAXOP; i++)
+    if (ins.ops[i].type != o_void)
+      used = i + 1;
+
+  put_ea (out, ins.address);
+  put_ea (out, ins.target);
+  put_le (out, ins.word, 4);
+  put_le (out, ins.type, 1);
+  put_le (out, (ins.flow ? INSTRUCTION_FLOW : 0) | (ins.dead ? INSTRUCTION_DEAD : 0), 1);
+  put_le (out, used, 1);
+  put_le (out, 0, 1);
+  put_le (out, count (SECTION_OPERANDS), 4);
+  put_string (out, ins.name);
+  put_string (out, ins.folded);
+  for (i = 0; i < 5; i++)
+    put_string (out, ins.operands[i]);
+
+  for (i = 0; i < used; i++) {
+    vector<uchar> &ops = sections[SECTION_OPERANDS];
+
+    put_le (ops, ins.ops[i].value, 8);
+    put_le (ops, ins.ops[i].reg, 2);
+    put_le (ops, ins.ops[i].type, 1);
+    put_le (ops, 0, 1);
+    put_le (ops, 0, 4);
+  }
+}
+
+static void
+put_table (ea_t address, JumpTable &table)
+{
+  vector<uchar> &out = sections[SECTION_TABLES];
+  size_t i;
+
+  put_ea (out, address);
+  put_ea (out, table.defjump);
+  put_le (out, table.reg, 4);
+  put_le (out, count (SECTION_CASES), 4);
+  put_le (out, table.targets.size (), 4);
+  put_le (out, 0, 4);
+  put_ea (out, table.index_use);
+
+  for (i = 0; i < table.targets.size (); i++) {
+    put_le (sections[SECTION_CASES], table.values[i], 8);
+    put_ea (sections[SECTION_CASES], table.targets[i]);
+  }
+}
+
+static void
+put_function (Function &func)
+{
+  vector<uchar> &out = sections[SECTION_FUNCTIONS];
+  list<Instruction>::iterator ins;
+  map<ea_t, JumpTable>::iterator table;
+  set<ea_t>::iterator call;
+
+  put_ea (out, func.address);
+  put_ea (out, func.end_address);
+  put_string (out, func.name);
+  put_string (out, func.alias);
+  put_le (out, count (SECTION_INSTRUCTIONS), 4);
+  put_le (out, func.instructions.size (), 4);
+  put_le (out, count (SECTION_TABLES), 4);
+  put_le (out, func.tables.size (), 4);
+  put_le (out, count (SECTION_CALLS), 4);
+  put_le (out, func.calls.size (), 4);
+  put_le (out, func.arguments, 4);
+  put_le (out, func.ret ? FUNCTION_RETURNS : 0, 4);
+
+  for (ins = func.instructions.begin (); ins != func.instructions.end (); ins++)
+    put_instruction (*ins);
+  for (table = func.tables.begin (); table != func.tables.end (); table++)
+    put_table (table->first, table->second);
+  for (call = func.calls.begin (); call != func.calls.end (); call++)
+    put_ea (sections[SECTION_CALLS], *call);
+}
+
+bool
+export_ir (const char *path, list<Function> &functions)
+{
+  list<Function>::iterator it;
+  vector<uchar> header;
+  FILE *f;
+  int i;
+
+  for (i = 0; i < SECTION_COUNT; i++)
+    sections[i].clear ();
+  pool_index.clear ();
+  // Offset 0 is the empty string
+  sections[SECTION_POOL].push_back ('\0');
+  pool_index[""] = 0;
+
+  for (it = functions.begin (); it != functions.end (); it++)
+    put_function (*it);
+
+  header.insert (header.end (), IR_MAGIC, IR_MAGIC + 8);
+  put_le (header, IR_VERSION, 4);
+  for (i = 0; i < SECTION_COUNT; i++)
+    put_le (header, count ((IRSection) i), 4);
+
+  f = qfopen (path, "wb");
+  if (f == NULL) {
+    warning ("Can't open %s for writing\n", path);
+    return false;
+  }
+  qfwrite (f, &header[0], header.size ());
+  for (i = 0; i < SECTION_COUNT; i++)
+    if (sections[i].size () > 0)
+      qfwrite (f, &sections[i][0], sections[i].size ());
+  qfclose (f);
+
+  for (i = 0; i < SECTION_COUNT; i++)
+    vector<uchar> ().swap (sections[i]);
+  pool_index.clear ();
+
+  return true;
+}
+
+/*
+ * Reading
+ */
+
+typedef struct {
+  const uchar *start[SECTION_COUNT];
+  uint32 count[SECTION_COUNT];
+} IRFile;
+
+static uint64
+get_le (const uchar *p, int bytes)
+{
+  uint64 value = 0;
+
+  for (int i = bytes - 1; i >= 0; i--)
+    value = (value << 8) | p[i];
+  return value;
+}
+
+static ea_t
+get_ea (const uchar *p)
+{
+  uint64 value = get_le (p, 8);
+
+  return value == IR_BADADDR ? BADADDR : (ea_t) value;
+}
+
+static const uchar *
+record (IRFile &ir, IRSection section, uint32 index)
+{
+  return ir.start[section] + (size_t) index * record_size[section];
+}
+
+/* The pool ends with a NUL, so any offset in it is a valid string */
+static bool
+get_string (IRFile &ir, const uchar *p, string &str)
+{
+  uint32 offset = (uint32) get_le (p, 4);
+
+  if (offset >= ir.count[SECTION_POOL])
+    return false;
+  str = (const char *) ir.start[SECTION_POOL] + offset;
+  return true;
+}
+
+/* A range of records of 'section', as the first one and how many */
+static bool
+valid_range (IRFile &ir, IRSection section, const uchar *p)
+{
+  uint64 first = get_le (p, 4);
+  uint64 n = get_le (p + 4, 4);
+
+  return first + n <= ir.count[section];
+}
+
+static bool
+get_instruction (IRFile &ir, uint32 index, Instruction &ins)
+{
+  const uchar *p = record (ir, SECTION_INSTRUCTIONS, index);
+  uint32 first_op = (uint32) get_le (p + 24, 4);
+  int used = p[22];
+  int i;
+
+  ins.address = get_ea (p);
+  ins.target = get_ea (p + 8);
+  ins.word = (uint32) get_le (p + 16, 4);
+  ins.type = (InstructionType) p[20];
+  ins.flow = (p[21] & INSTRUCTION_FLOW) != 0;
+  ins.dead = (p[21] & INSTRUCTION_DEAD) != 0;
+  if (ins.type > INSTRUCTION_TYPE_FLOW || used > UA_MAXOP ||
+      (uint64) first_op + used > ir.count[SECTION_OPERANDS])
+    return false;
+  if (!get_string (ir, p + 28, ins.name) || !get_string (ir, p + 32, ins.folded))
+    return false;
+  for (i = 0; i < 5; i++)
+    if (!get_string (ir, p + 36 + i * 4, ins.operands[i]))
+      return false;
+
+  for (i = 0; i < used; i++) {
+    const uchar *op = record (ir, SECTION_OPERANDS, first_op + i);
+
+    ins.ops[i].value = (uval_t) get_le (op, 8);
+    ins.ops[i].reg = (uint16) get_le (op + 8, 2);
+    ins.ops[i].type = op[10];
+  }
+  return true;
+}
+
+static bool
+get_table (IRFile &ir, uint32 index, Function &func)
+{
+  const uchar *p = record (ir, SECTION_TABLES, index);
+  uint32 first = (uint32) get_le (p + 20, 4);
+  uint32 n = (uint32) get_le (p + 24, 4);
+  JumpTable &table = func.tables[get_ea (p)];
+  uint32 i;
+
+  if (!valid_range (ir, SECTION_CASES, p + 20))
+    return false;
+  table.defjump = get_ea (p + 8);
+  table.reg = (int) get_le (p + 16, 4);
+  table.index_use = get_ea (p + 32);
+  for (i = 0; i < n; i++) {
+    const uchar *c = record (ir, SECTION_CASES, first + i);
+
+    table.values.push_back ((uval_t) get_le (c, 8));
+    table.targets.push_back (get_ea (c + 8));
+  }
+  return true;
+}
+
+static bool
+get_function (IRFile &ir, uint32 index, Function &func)
+{
+  const uchar *p = record (ir, SECTION_FUNCTIONS, index);
+  uint32 i;
+
+  func.address = get_ea (p);
+  func.end_address = get_ea (p + 8);
+  if (!get_string (ir, p + 16, func.name) || !get_string (ir, p + 20, func.alias))
+    return false;
+  if (!valid_range (ir, SECTION_INSTRUCTIONS, p + 24) ||
+      !valid_range (ir, SECTION_TABLES, p + 32) ||
+      !valid_range (ir, SECTION_CALLS, p + 40))
+    return false;
+  func.arguments = (int) get_le (p + 48, 4);
+  func.ret = (get_le (p + 52, 4) & FUNCTION_RETURNS) != 0;
+
+  for (i = 0; i < get_le (p + 28, 4); i++) {
+    func.instructions.push_back (Instruction ());
+    if (!get_instruction (ir, (uint32) get_le (p + 24, 4) + i, func.instructions.back ()))
+      return false;
+  }
+  for (i = 0; i < get_le (p + 36, 4); i++)
+    if (!get_table (ir, (uint32) get_le (p + 32, 4) + i, func))
+      return false;
+  for (i = 0; i < get_le (p + 44, 4); i++)
+    func.calls.insert (get_ea (record (ir, SECTION_CALLS, (uint32) get_le (p + 40, 4) + i)));
+  return true;
+}
+
+bool
+import_ir (const uchar *data, size_t size, list<Function> &functions)
+{
+  IRFile ir;
+  uint64 offset = IR_HEADER_SIZE;
+  uint32 i;
+
+  if (size < IR_HEADER_SIZE || memcmp (data, IR_MAGIC, 8) != 0) {
+    ERROR ("Error: Not a PPC2C IR file\n");
+    return false;
+  }
+  if (get_le (data + 8, 4) != IR_VERSION) {
+    ERROR ("Error: Unsupported PPC2C IR version %d\n", (int) get_le (data + 8, 4));
+    return false;
+  }
+  for (i = 0; i < SECTION_COUNT; i++) {
+    ir.count[i] = (uint32) get_le (data + 12 + i * 4, 4);
+    ir.start[i] = data + offset;
+    offset += (uint64) ir.count[i] * record_size[i];
+  }
+  if (offset > size || ir.count[SECTION_POOL] == 0 ||
+      ir.start[SECTION_POOL][ir.count[SECTION_POOL] - 1] != '\0') {
+    ERROR ("Error: Truncated PPC2C IR file\n");
+    return false;
+  }
+
+  for (i = 0; i < ir.count[SECTION_FUNCTIONS]; i++) {
+    functions.push_back (Function ());
+    if (!get_function (ir, i, functions.back ())) {
+      ERROR ("Error: Invalid function %d in PPC2C IR file\n", i);
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,29 @@
+/*
+ * ppc2c_ir.hpp -- Saved functions of the PPC to C converter
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+#ifndef __PPC2C_IR_HPP__
+#define __PPC2C_IR_HPP__
+
+#include "ppc2c_engine.hpp"
+
+/* Everything the lowering needs of the functions PPC2C parsed from the
+ * database, so ppc2c-lower can turn them into C without IDA. See
+ * ppc2c_ir.cpp for the format */
+bool export_ir (const char *path, list<Function> &functions);
+
+/* 'data' is the whole file, mapped or read. The functions are appended to
+ * 'functions' */
+bool import_ir (const uchar *data, size_t size, list<Function> &functions);
+
+/* In ppc2c.cpp, with the rest of the C generation: print the C code of the
+ * functions of an IR file */
+bool lower_ir (const uchar *data, size_t size);
+
+#endif /* __PPC2C_IR_HPP__ */
@@ -0,0 +1,89 @@
+/*
+ * ppc2c_masks.cpp -- Rotate masks and shift idioms of the PPC to C converter
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+#include "ppc2c_masks.hpp"
+
+/* The tables are spelled out by the preprocessor so they are constant data,
+ * M is MASK32 or MASK64 and R the row of one MB */
+#define MASK_COLS4(M, mb, me)						\
+  M(mb, (me)), M(mb, (me) + 1), M(mb, (me) + 2), M(mb, (me) + 3)
+#define MASK_COLS16(M, mb, me)						\
+  MASK_COLS4(M, mb, (me)), MASK_COLS4(M, mb, (me) + 4),			\
+  MASK_COLS4(M, mb, (me) + 8), MASK_COLS4(M, mb, (me) + 12)
+#define MASK_ROW32(M, mb)						\
+  { MASK_COLS16(M, mb, 0), MASK_COLS16(M, mb, 16) }
+#define MASK_ROW64(M, mb)						\
+  { MASK_COLS16(M, mb, 0), MASK_COLS16(M, mb, 16),			\
+    MASK_COLS16(M, mb, 32), MASK_COLS16(M, mb, 48) }
+#define MASK_ROWS4(R, M, mb)						\
+  R(M, (mb)), R(M, (mb) + 1), R(M, (mb) + 2), R(M, (mb) + 3)
+#define MASK_ROWS16(R, M, mb)						\
+  MASK_ROWS4(R, M, (mb)), MASK_ROWS4(R, M, (mb) + 4),			\
+  MASK_ROWS4(R, M, (mb) + 8), MASK_ROWS4(R, M, (mb) + 12)
+
+const unsigned int mask32_table[32][32] = {
+  MASK_ROWS16(MASK_ROW32, MASK32, 0),
+  MASK_ROWS16(MASK_ROW32, MASK32, 16)
+};
+
+const unsigned long long mask64_table[64][64] = {
+  MASK_ROWS16(MASK_ROW64, MASK64, 0),
+  MASK_ROWS16(MASK_ROW64, MASK64, 16),
+  MASK_ROWS16(MASK_ROW64, MASK64, 32),
+  MASK_ROWS16(MASK_ROW64, MASK64, 48)
+};
+
+/* The bits a left shift by SH keeps are the mask from 0 to 31-SH, and the
+ * ones of the right shift by 32-SH the mask from 32-SH to 31 */
+RotateIdiom
+rotate_idiom32 (int sh, unsigned int &mask)
+{
+  unsigned int left, right;
+
+  sh &= 31;
+  if (sh == 0)
+    return ROTATE_IDIOM_NONE;
+
+  left = mask32_table[0][31 - sh];
+  right = mask32_table[32 - sh][31];
+  if ((left & mask) == 0) {
+    if (right == mask)
+      mask = MASK32_ALLSET;
+    return ROTATE_IDIOM_RIGHT_SHIFT;
+  } else if ((right & mask) == 0) {
+    if (left == mask)
+      mask = MASK32_ALLSET;
+    return ROTATE_IDIOM_LEFT_SHIFT;
+  }
+  return ROTATE_IDIOM_ROTATE;
+}
+
+RotateIdiom
+rotate_idiom64 (int sh, unsigned long long &mask)
+{
+  unsigned long long left, right;
+
+  sh &= 63;
+  if (sh == 0)
+    return ROTATE_IDIOM_NONE;
+
+  left = mask64_table[0][63 - sh];
+  right = mask64_table[64 - sh][63];
+  if ((left & mask) == 0) {
+    if (right == mask)
+      mask = MASK64_ALLSET;
+    return ROTATE_IDIOM_RIGHT_SHIFT;
+  } else if ((right & mask) == 0) {
+    if (left == mask)
+      mask = MASK64_ALLSET;
+    return ROTATE_IDIOM_LEFT_SHIFT;
+  }
+  return ROTATE_IDIOM_ROTATE;
+}
@@ -0,0 +1,47 @@
+/*
+ * ppc2c_masks.hpp -- Rotate masks and shift idioms of the PPC to C converter
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+#ifndef __PPC2C_MASKS_HPP__
+#define __PPC2C_MASKS_HPP__
+
+#define MASK32_ALLSET	0xFFFFFFFF
+#define MASK64_ALLSET	0xFFFFFFFFFFFFFFFFULL
+
+/* The bits MB to ME inclusive, big-endian numbering, wrapping around when
+ * MB > ME. When MB == ME+1 both halves meet and all the bits are set */
+#define MASK32(mb, me)							\
+  ((mb) <= (me) ?							\
+   (MASK32_ALLSET >> (mb)) & (MASK32_ALLSET << (31 - (me))) :		\
+   (MASK32_ALLSET >> (mb)) | (MASK32_ALLSET << (31 - (me))))
+#define MASK64(mb, me)							\
+  ((mb) <= (me) ?							\
+   (MASK64_ALLSET >> (mb)) & (MASK64_ALLSET << (63 - (me))) :		\
+   (MASK64_ALLSET >> (mb)) | (MASK64_ALLSET << (63 - (me))))
+
+/* Indexed by [MB][ME], filled by the compiler */
+extern const unsigned int mask32_table[32][32];
+extern const unsigned long long mask64_table[64][64];
+
+/* What a rotate by SH then AND with a mask comes down to. The rotate
+ * leaves the bits of both halves of the word only when the mask keeps
+ * some of each, otherwise it is a shift, or nothing at all for SH = 0 */
+enum RotateIdiom {
+  ROTATE_IDIOM_NONE,		// rS & mask
+  ROTATE_IDIOM_RIGHT_SHIFT,	// (rS >> 32-SH) & mask
+  ROTATE_IDIOM_LEFT_SHIFT,	// (rS << SH) & mask
+  ROTATE_IDIOM_ROTATE		// ((rS << SH) | (rS >> 32-SH)) & mask
+};
+
+/* 'mask' becomes all ones when the shift already clears the bits it
+ * clears, (rS >> 24) & 0xFF is only rS >> 24 */
+RotateIdiom rotate_idiom32 (int sh, unsigned int &mask);
+RotateIdiom rotate_idiom64 (int sh, unsigned long long &mask);
+
+#endif /* __PPC2C_MASKS_HPP__ */
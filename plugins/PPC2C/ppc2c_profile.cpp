@@ -0,0 +1,257 @@
+/*
+ * ppc2c_profile.cpp -- Phase timers and counters for the PPC to C converter
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+#if defined(__NT__)
+#include <windows.h>
+#elif defined(__MAC__)
+#include <mach/mach_time.h>
+#else
+#include <time.h>
+#endif
+
+#include "ppc2c_profile.hpp"
+
+#include <kernwin.hpp>
+#include <fpro.h>
+
+#include <map>
+#include <vector>
+#include <algorithm>
+
+static const char *phase_names[PHASE_COUNT] = {
+  "other",
+  "cfg",
+  "operands",
+  "metadata",
+  "lowering",
+  "emission",
+};
+
+static const char *counter_names[COUNTER_COUNT] = {
+  "functions",
+  "aliased_functions",
+  "instructions",
+  "unknown_instructions",
+  "bytes_emitted",
+  "lines_emitted",
+};
+
+#define COVERAGE_SAMPLES 4 // Addresses kept for each unknown mnemonic
+#define COVERAGE_SHOWN 30 // Mnemonics listed in the output window
+
+typedef struct {
+  string name;
+  uint64 count;
+  vector<ea_t> samples;
+} UnknownInstruction;
+
+static map<string, UnknownInstruction> unknown;
+
+static uint64 phase_time[PHASE_COUNT];
+static uint64 phase_calls[PHASE_COUNT];
+static uint64 counters[COUNTER_COUNT];
+static ProfilePhase current = PHASE_OTHER;
+static uint64 started;
+static uint64 run_started;
+
+/* Nanoseconds from a clock that doesn't jump with the wall time */
+static uint64
+monotonic_ns (void)
+{
+#if defined(__NT__)
+  static LARGE_INTEGER frequency;
+  LARGE_INTEGER now;
+
+  if (frequency.QuadPart == 0)
+    QueryPerformanceFrequency (&frequency);
+  QueryPerformanceCounter (&now);
+  return (uint64) (now.QuadPart / frequency.QuadPart) * 1000000000 +
+      (uint64) (now.QuadPart % frequency.QuadPart) * 1000000000 / frequency.QuadPart;
+#elif defined(__MAC__)
+  static mach_timebase_info_data_t timebase;
+
+  if (timebase.denom == 0)
+    mach_timebase_info (&timebase);
+  return mach_absolute_time () * timebase.numer / timebase.denom;
+#else
+  struct timespec now;
+
+  clock_gettime (CLOCK_MONOTONIC, &now);
+  return (uint64) now.tv_sec * 1000000000 + now.tv_nsec;
+#endif
+}
+
+ProfileScope::ProfileScope(ProfilePhase phase)
+{
+  uint64 now = monotonic_ns ();
+
+  phase_time[current] += now - started;
+  phase_calls[phase]++;
+  parent = current;
+  current = phase;
+  started = now;
+}
+
+ProfileScope::~ProfileScope()
+{
+  uint64 now = monotonic_ns ();
+
+  phase_time[current] += now - started;
+  current = parent;
+  started = now;
+}
+
+void
+profile_reset (void)
+{
+  int i;
+
+  for (i = 0; i < PHASE_COUNT; i++) {
+    phase_time[i] = 0;
+    phase_calls[i] = 0;
+  }
+  for (i = 0; i < COUNTER_COUNT; i++)
+    counters[i] = 0;
+  unknown.clear ();
+  current = PHASE_OTHER;
+  run_started = started = monotonic_ns ();
+}
+
+void
+profile_count (ProfileCounter counter, uint64 amount)
+{
+  counters[counter] += amount;
+}
+
+static void
+write_json (const char *path, uint64 total)
+{
+  FILE *f = qfopen (path, "w");
+  int i;
+
+  if (f == NULL) {
+    warning ("Can't open %s for writing\n", path);
+    return;
+  }
+  qfprintf (f, "{\n  \"total_ns\": %llu,\n  \"phases\": {\n", total);
+  for (i = 0; i < PHASE_COUNT; i++)
+    qfprintf (f, "    \"%s\": {\"ns\": %llu, \"calls\": %llu}%s\n", phase_names[i],
+        phase_time[i], phase_calls[i], i < PHASE_COUNT - 1 ? "," : "");
+  qfprintf (f, "  },\n  \"counters\": {\n");
+  for (i = 0; i < COUNTER_COUNT; i++)
+    qfprintf (f, "    \"%s\": %llu%s\n", counter_names[i], counters[i],
+        i < COUNTER_COUNT - 1 ? "," : "");
+  qfprintf (f, "  }\n}\n");
+  qfclose (f);
+}
+
+/* Print the time spent in each phase and the counters. If PPC2C_PROFILE
+ * is set, the same goes as JSON to the file it names */
+void
+profile_report (void)
+{
+  uint64 now = monotonic_ns ();
+  uint64 total = now - run_started;
+  const char *path = getenv ("PPC2C_PROFILE");
+  int i;
+
+  phase_time[current] += now - started;
+  started = now;
+
+  msg ("PPC2C profile: %.3f ms\n", total / 1000000.0);
+  msg ("  %-12s %12s %6s %10s\n", "phase", "ms", "%", "calls");
+  for (i = 0; i < PHASE_COUNT; i++)
+    msg ("  %-12s %12.3f %6.1f %10llu\n", phase_names[i],
+        phase_time[i] / 1000000.0,
+        total > 0 ? phase_time[i] * 100.0 / total : 0.0, phase_calls[i]);
+  for (i = 0; i < COUNTER_COUNT; i++)
+    msg ("  %-24s %12llu\n", counter_names[i], counters[i]);
+
+  if (path != NULL && path[0] != '\0')
+    write_json (path, total);
+}
+
+/* Remember an instruction that had no handler, so the ones that matter most
+ * can be found once the run is over */
+void
+coverage_unknown (Instruction &ins)
+{
+  UnknownInstruction &entry = unknown[ins.name];
+
+  if (entry.count++ == 0)
+    entry.name = ins.name;
+  if (entry.samples.size () < COVERAGE_SAMPLES)
+    entry.samples.push_back (ins.address);
+}
+
+static bool
+by_count_desc (const UnknownInstruction &a, const UnknownInstruction &b)
+{
+  if (a.count != b.count)
+    return a.count > b.count;
+  return a.name < b.name;
+}
+
+static string
+coverage_samples (UnknownInstruction &entry)
+{
+  string samples;
+  char buf[32];
+  size_t i;
+
+  for (i = 0; i < entry.samples.size (); i++) {
+    qsnprintf (buf, sizeof(buf), "%s0x%a", i > 0 ? " " : "", entry.samples[i]);
+    samples += buf;
+  }
+  return samples;
+}
+
+/* List the unknown mnemonics by frequency, with the share of the emitted
+ * lines they stand for. If PPC2C_COVERAGE is set, the whole list is also
+ * appended to the file it names, one tab separated line per mnemonic, so
+ * the runs over many databases can be merged */
+void
+coverage_report (void)
+{
+  vector<UnknownInstruction> sorted;
+  map<string, UnknownInstruction>::iterator it;
+  uint64 lines = counters[COUNTER_LINES];
+  const char *path = getenv ("PPC2C_COVERAGE");
+  size_t i;
+
+  if (unknown.size () == 0)
+    return;
+  for (it = unknown.begin (); it != unknown.end (); it++)
+    sorted.push_back (it->second);
+  sort (sorted.begin (), sorted.end (), by_count_desc);
+
+  msg ("PPC2C unknown instructions: %llu in %d mnemonics\n",
+      counters[COUNTER_UNKNOWN], (int) sorted.size ());
+  msg ("  %-12s %10s %7s  %s\n", "mnemonic", "count", "% lines", "samples");
+  for (i = 0; i < sorted.size () && i < COVERAGE_SHOWN; i++)
+    msg ("  %-12s %10llu %7.2f  %s\n", sorted[i].name.c_str (), sorted[i].count,
+        lines > 0 ? sorted[i].count * 100.0 / lines : 0.0,
+        coverage_samples (sorted[i]).c_str ());
+  if (sorted.size () > COVERAGE_SHOWN)
+    msg ("  ... %d more\n", (int) (sorted.size () - COVERAGE_SHOWN));
+
+  if (path != NULL && path[0] != '\0') {
+    FILE *f = qfopen (path, "a");
+
+    if (f == NULL) {
+      warning ("Can't open %s for writing\n", path);
+      return;
+    }
+    for (i = 0; i < sorted.size (); i++)
+      qfprintf (f, "%s\t%llu\t%llu\t%s\n", sorted[i].name.c_str (), sorted[i].count,
+          lines, coverage_samples (sorted[i]).c_str ());
+    qfclose (f);
+  }
+}
@@ -0,0 +1,53 @@
+/*
+ * ppc2c_profile.hpp -- Phase timers and counters for the PPC to C converter
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+#ifndef __PPC2C_PROFILE_HPP__
+#define __PPC2C_PROFILE_HPP__
+
+#include "ppc2c_engine.hpp"
+
+typedef enum {
+  PHASE_OTHER = 0,
+  PHASE_CFG,        // Following xrefs, basic blocks and structuring
+  PHASE_OPERANDS,   // Decoding and printing instructions through IDA
+  PHASE_METADATA,   // Names and comments
+  PHASE_LOWERING,   // Constant propagation and instruction handlers
+  PHASE_EMISSION,   // Printing the C code
+  PHASE_COUNT,
+} ProfilePhase;
+
+typedef enum {
+  COUNTER_FUNCTIONS = 0,
+  COUNTER_ALIASES,   // Functions identical to one already lowered
+  COUNTER_INSTRUCTIONS,
+  COUNTER_UNKNOWN,   // Instructions without a handler
+  COUNTER_BYTES,     // Bytes of C code emitted
+  COUNTER_LINES,     // Lines of C code emitted
+  COUNTER_COUNT,
+} ProfileCounter;
+
+/* Time spent in a phase is exclusive: entering a phase pauses the one it is
+ * nested in, so the phases add up to the whole run */
+class ProfileScope {
+public:
+  ProfileScope(ProfilePhase phase);
+  ~ProfileScope();
+private:
+  ProfilePhase parent;
+};
+
+void profile_reset (void);
+void profile_count (ProfileCounter counter, uint64 amount = 1);
+void profile_report (void);
+
+void coverage_unknown (Instruction &ins);
+void coverage_report (void);
+
+#endif /* __PPC2C_PROFILE_HPP__ */
@@ -0,0 +1,992 @@
+/*
+ * ppc2c_structure.cpp -- Control flow recovery for the PPC to C converter
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+#include "ppc2c_structure.hpp"
+
+#include <bytes.hpp>
+#include <nalt.hpp>
+
+#include <map>
+#include <algorithm>
+
+
+BasicBlock::BasicBlock()
+{
+  address = BADADDR;
+  branch = NULL;
+  type = BRANCH_NONE;
+  taken = BLOCK_NONE;
+  fallthrough = BLOCK_NONE;
+  default_case = BLOCK_NONE;
+  switch_register = REGISTER_UNSET;
+  goto_target = false;
+  live_conditions = 0;
+  call_conditions = 0;
+}
+
+Node::Node(NodeType type, int block)
+{
+  this->type = type;
+  this->block = block;
+  negate = false;
+  loop = LOOP_ENDLESS;
+}
+
+/* Read the jump table IDA (or PPCJT) resolved for the bctr at 'ea'. Only
+ * dense tables of offsets or addresses with a known register are usable */
+bool
+read_jump_table (ea_t ea, JumpTable &table)
+{
+  switch_info_ex_t si;
+  int size;
+  uval_t i;
+
+  if (get_switch_info_ex (ea, &si, sizeof(si)) <= 0)
+    return false;
+  if ((si.flags & SWI_EXTENDED) == 0 || (si.flags & SWI_SPARSE) != 0 ||
+      (si.flags2 & SWI2_INDIRECT) != 0 || si.regnum < 0 || si.regnum > 31)
+    return false;
+
+  size = si.get_jtable_element_size ();
+  table.reg = si.regnum;
+  table.index_use = si.startea;
+  table.values.clear ();
+  table.targets.clear ();
+  for (i = 0; i < si.ncases; i++) {
+    ea_t entry = si.jumps + i * size;
+    sval_t element;
+
+    switch (size) {
+      case 1:
+        element = (si.flags & SWI_SIGNED) ? (sval_t) (char) get_byte (entry) :
+            (sval_t) get_byte (entry);
+        break;
+      case 2:
+        element = (si.flags & SWI_SIGNED) ? (sval_t) (short) get_word (entry) :
+            (sval_t) get_word (entry);
+        break;
+      case 4:
+        element = (si.flags & SWI_SIGNED) ? (sval_t) (int32) get_long (entry) :
+            (sval_t) get_long (entry);
+        break;
+      default:
+        element = (sval_t) get_qword (entry);
+        break;
+    }
+    if (si.flags & SWI_ELBASE)
+      element = si.elbase + (element << si.get_shift ());
+    table.values.push_back (si.lowcase + i);
+    table.targets.push_back ((ea_t) element);
+  }
+  table.defjump = (si.flags & SWI_DEFAULT) ? si.defjump : BADADDR;
+
+  return table.targets.size () > 0;
+}
+
+/* The switch tests the register as it is at the bctr, which has to be the
+ * index the table was read with: nothing from the instruction that starts
+ * using it, that one included, to the bctr may write it */
+static bool
+index_unchanged (Function &func, BasicBlock &block, Instruction *bctr,
+    JumpTable &table)
+{
+  list<Instruction>::iterator it = block.begin;
+
+  if (table.index_use == BADADDR || table.index_use > bctr->address)
+    return false;
+  while (&(*it) != bctr)
+    it++;
+  // The instructions are in the order of their addresses
+  while (it != func.instructions.begin ()) {
+    it--;
+    if (it->address < table.index_use)
+      break;
+    if (it->type == INSTRUCTION_TYPE_INSTRUCTION &&
+        writes_register (*it, table.reg))
+      return false;
+  }
+  return true;
+}
+
+static int
+block_at (map<ea_t, int> &block_index, ea_t address)
+{
+  map<ea_t, int>::iterator it = block_index.find (address);
+
+  if (it == block_index.end ())
+    return BLOCK_EXIT;
+  return it->second;
+}
+
+/* Many cases of a switch can share the same block */
+static void
+add_pred (vector<BasicBlock> &blocks, int block, int pred)
+{
+  vector<int> &preds = blocks[block].preds;
+
+  if (find (preds.begin (), preds.end (), pred) == preds.end ())
+    preds.push_back (pred);
+}
+
+/* Split the function into basic blocks. A block starts at the function entry,
+ * at every jump target, after every branch and wherever the instructions stop
+ * being contiguous. */
+void
+build_blocks (Function &func, vector<BasicBlock> &blocks)
+{
+  map<ea_t, int> block_index;
+  map<ea_t, bool> leaders;
+  map<ea_t, JumpTable> &tables = func.tables;
+  map<ea_t, JumpTable>::iterator table;
+  list<Instruction>::iterator it;
+  ea_t next = BADADDR;
+  bool ended = true;
+  char buf[MAXSTR];
+  size_t i, j;
+
+  blocks.clear ();
+
+  for (it = func.instructions.begin(); it != func.instructions.end(); it++) {
+    if (it->type != INSTRUCTION_TYPE_INSTRUCTION)
+      continue;
+    if (ended || it->address != next)
+      leaders[it->address] = true;
+    if (it->target != BADADDR)
+      leaders[it->target] = true;
+    if (get_branch_type (*it) == BRANCH_INDIRECT) {
+      table = tables.find (it->address);
+      if (table != tables.end ()) {
+        for (i = 0; i < table->second.targets.size (); i++)
+          leaders[table->second.targets[i]] = true;
+        if (table->second.defjump != BADADDR)
+          leaders[table->second.defjump] = true;
+      }
+    }
+    ended = !it->flow || get_branch_type (*it) != BRANCH_NONE;
+    next = it->address + 4;
+  }
+
+  for (it = func.instructions.begin(); it != func.instructions.end(); it++) {
+    if (blocks.size () > 0 && blocks.back ().address == it->address)
+      continue;
+    if (leaders.find (it->address) == leaders.end ())
+      continue;
+    if (blocks.size () > 0)
+      blocks.back ().end = it;
+    blocks.push_back (BasicBlock ());
+    blocks.back ().address = it->address;
+    blocks.back ().begin = it;
+    block_index[it->address] = blocks.size () - 1;
+  }
+  if (blocks.size () > 0)
+    blocks.back ().end = func.instructions.end ();
+
+  for (i = 0; i < blocks.size (); i++) {
+    BasicBlock &block = blocks[i];
+    Instruction *last = NULL;
+
+    for (it = block.begin; it != block.end; it++) {
+      if (it->type == INSTRUCTION_TYPE_INSTRUCTION)
+        last = &(*it);
+      else if (it->type == INSTRUCTION_TYPE_LABEL && it->address == block.address)
+        block.label = c_identifier (it->name);
+    }
+    if (block.label.size () == 0) {
+      qsnprintf (buf, sizeof(buf), "loc_%a", block.address);
+      block.label = buf;
+    }
+    if (last == NULL)
+      continue;
+
+    block.type = get_branch_type (*last);
+    if (block.type != BRANCH_NONE)
+      block.branch = last;
+    if (block.type == BRANCH_INDIRECT &&
+        tables.find (last->address) != tables.end ()) {
+      JumpTable &table = tables[last->address];
+
+      /* A case landing outside the function is a tail call, which a switch
+       * can't express, and an index changed before the bctr isn't the
+       * value the switch would test */
+      for (j = 0; j < table.targets.size (); j++)
+        if (block_at (block_index, table.targets[j]) == BLOCK_EXIT)
+          break;
+      if (j == table.targets.size () &&
+          index_unchanged (func, block, last, table)) {
+        block.type = BRANCH_SWITCH;
+        block.switch_register = table.reg;
+        block.case_values = table.values;
+        for (j = 0; j < table.targets.size (); j++)
+          block.cases.push_back (block_at (block_index, table.targets[j]));
+        if (table.defjump != BADADDR)
+          block.default_case = block_at (block_index, table.defjump);
+        if (block.default_case == BLOCK_EXIT)
+          block.default_case = BLOCK_NONE;
+      }
+    }
+
+    switch (block.type) {
+      case BRANCH_ALWAYS:
+        block.taken = block_at (block_index, last->target);
+        break;
+      case BRANCH_CONDITIONAL:
+        block.taken = block_at (block_index, last->target);
+        // Fall through
+      case BRANCH_COND_RETURN:
+        if (block.type == BRANCH_COND_RETURN)
+          block.taken = BLOCK_EXIT;
+        // Fall through
+      case BRANCH_NONE:
+        if (last->flow)
+          block.fallthrough = block_at (block_index, last->address + 4);
+        break;
+      default:
+        break;
+    }
+    /* A conditional branch with both edges to the same block is no branch */
+    if (block.type == BRANCH_CONDITIONAL && block.taken == block.fallthrough) {
+      block.type = BRANCH_ALWAYS;
+      block.fallthrough = BLOCK_NONE;
+    }
+  }
+
+  for (i = 0; i < blocks.size (); i++) {
+    if (blocks[i].taken >= 0)
+      blocks[blocks[i].taken].preds.push_back (i);
+    if (blocks[i].fallthrough >= 0)
+      blocks[blocks[i].fallthrough].preds.push_back (i);
+    for (j = 0; j < blocks[i].cases.size (); j++)
+      add_pred (blocks, blocks[i].cases[j], i);
+    if (blocks[i].default_case >= 0)
+      add_pred (blocks, blocks[i].default_case, i);
+  }
+}
+
+/* Cooper, Harvey and Kennedy's "A Simple, Fast Dominance Algorithm".
+ * Nodes that can't be reached from 'entry' keep BLOCK_NONE as idom */
+static void
+compute_dominators (int entry, vector< vector<int> > &succs,
+    vector< vector<int> > &preds, vector<int> &idom)
+{
+  int count = succs.size ();
+  vector<int> order;
+  vector<int> position (count, -1);
+  vector<size_t> next (count, 0);
+  vector<int> stack;
+  bool changed = true;
+  int i;
+  size_t j;
+
+  /* Depth first post order, without recursion */
+  position[entry] = 0;
+  stack.push_back (entry);
+  while (stack.size () > 0) {
+    int n = stack.back ();
+
+    if (next[n] < succs[n].size ()) {
+      int s = succs[n][next[n]++];
+
+      if (position[s] == -1) {
+        position[s] = 0;
+        stack.push_back (s);
+      }
+    } else {
+      order.push_back (n);
+      stack.pop_back ();
+    }
+  }
+  reverse (order.begin (), order.end ());
+  for (i = 0; i < (int) order.size (); i++)
+    position[order[i]] = i;
+
+  idom.assign (count, BLOCK_NONE);
+  idom[entry] = entry;
+  while (changed) {
+    changed = false;
+    for (i = 1; i < (int) order.size (); i++) {
+      int n = order[i];
+      int new_idom = BLOCK_NONE;
+
+      for (j = 0; j < preds[n].size (); j++) {
+        int a = preds[n][j];
+        int b = new_idom;
+
+        if (idom[a] == BLOCK_NONE)
+          continue;
+        if (b != BLOCK_NONE) {
+          while (a != b) {
+            while (position[a] > position[b])
+              a = idom[a];
+            while (position[b] > position[a])
+              b = idom[b];
+          }
+        }
+        new_idom = a;
+      }
+      if (idom[n] != new_idom) {
+        idom[n] = new_idom;
+        changed = true;
+      }
+    }
+  }
+}
+
+typedef struct {
+  int header; // Innermost loop being emitted
+  int follow; // Where a 'break' goes
+  int stop; // Where the current region ends
+  int latch; // Block whose branch is the do/while condition
+  bool *latch_used;
+} Region;
+
+class Structurer {
+public:
+  Structurer(vector<BasicBlock> &blocks);
+  void run (list<Node> &nodes);
+
+private:
+  vector<BasicBlock> &blocks;
+  int count;
+  vector<int> idom;
+  vector<int> ipdom;
+  vector<int> dom_pre; // Dominator tree interval, for constant time queries
+  vector<int> dom_post;
+  vector<int> loop_of; // Innermost loop header of each block
+  vector<int> loop_parent; // Enclosing loop header of each header
+  vector<int> loop_follow;
+  vector<int> loop_latch; // Single latch of the loop, BLOCK_NONE if many
+  vector<bool> header;
+  vector<bool> emitted;
+
+  void analyse (void);
+  void find_loops (vector<int> &reachable);
+  bool dominates (int a, int b);
+  bool in_loop (int b, int h);
+  bool is_silent (int b);
+  bool is_empty (list<Node> &nodes);
+  bool is_shared (int b, int to, Region &r);
+  bool jump_to (int from, int to, Region &r, list<Node> &out);
+  void emit_sequence (int b, Region r, list<Node> &out);
+  int emit_if (int b, Region &r, list<Node> &out);
+  int emit_switch (int b, Region &r, list<Node> &out);
+  int emit_loop (int h, list<Node> &out);
+};
+
+Structurer::Structurer(vector<BasicBlock> &blocks) : blocks(blocks)
+{
+  count = blocks.size ();
+}
+
+bool
+Structurer::dominates (int a, int b)
+{
+  if (a < 0 || b < 0 || dom_pre[a] < 0 || dom_pre[b] < 0)
+    return false;
+  return dom_pre[a] <= dom_pre[b] && dom_post[b] <= dom_post[a];
+}
+
+bool
+Structurer::in_loop (int b, int h)
+{
+  int l;
+
+  if (b < 0)
+    return false;
+  for (l = loop_of[b]; l != BLOCK_NONE; l = loop_parent[l])
+    if (l == h)
+      return true;
+  return false;
+}
+
+void
+Structurer::analyse (void)
+{
+  vector< vector<int> > succs (count + 1);
+  vector< vector<int> > preds (count + 1);
+  vector< vector<int> > children (count);
+  vector<int> order;
+  vector<int> stack;
+  int exit = count;
+  int clock = 0;
+  int i;
+  size_t j;
+
+  /* Forward graph with a virtual exit node */
+  for (i = 0; i < count; i++) {
+    vector<int> edges (blocks[i].cases);
+    bool leaves = blocks[i].type == BRANCH_RETURN ||
+        blocks[i].type == BRANCH_INDIRECT;
+
+    edges.push_back (blocks[i].taken);
+    edges.push_back (blocks[i].fallthrough);
+    edges.push_back (blocks[i].default_case);
+    for (j = 0; j < edges.size (); j++) {
+      if (edges[j] == BLOCK_EXIT)
+        leaves = true;
+      else if (edges[j] >= 0)
+        succs[i].push_back (edges[j]);
+    }
+    if (leaves || succs[i].size () == 0)
+      succs[i].push_back (exit);
+    for (j = 0; j < succs[i].size (); j++)
+      preds[succs[i][j]].push_back (i);
+  }
+
+  compute_dominators (0, succs, preds, idom);
+  compute_dominators (exit, preds, succs, ipdom);
+  idom.resize (count);
+  ipdom.resize (count);
+  for (i = 0; i < count; i++)
+    if (ipdom[i] == exit)
+      ipdom[i] = BLOCK_NONE;
+
+  /* Number the dominator tree so dominance is an interval check */
+  dom_pre.assign (count, -1);
+  dom_post.assign (count, -1);
+  for (i = 1; i < count; i++)
+    if (idom[i] != BLOCK_NONE)
+      children[idom[i]].push_back (i);
+  stack.push_back (0);
+  dom_pre[0] = clock++;
+  while (stack.size () > 0) {
+    int n = stack.back ();
+
+    if (children[n].size () > 0) {
+      int c = children[n].back ();
+
+      children[n].pop_back ();
+      dom_pre[c] = clock++;
+      stack.push_back (c);
+    } else {
+      dom_post[n] = clock++;
+      stack.pop_back ();
+    }
+  }
+
+  /* Loops are only looked for in the blocks reachable from the entry */
+  for (i = 0; i < count; i++)
+    if (dom_pre[i] >= 0)
+      order.push_back (i);
+  find_loops (order);
+}
+
+static bool
+by_order_desc (const pair<int, int> &a, const pair<int, int> &b)
+{
+  return a.second > b.second;
+}
+
+void
+Structurer::find_loops (vector<int> &reachable)
+{
+  vector< pair<int, int> > headers;
+  vector< vector<int> > members (count);
+  vector<int> work;
+  size_t i, j;
+
+  header.assign (count, false);
+  loop_of.assign (count, BLOCK_NONE);
+  loop_parent.assign (count, BLOCK_NONE);
+  loop_follow.assign (count, BLOCK_NONE);
+  loop_latch.assign (count, BLOCK_NONE);
+
+  for (i = 0; i < reachable.size (); i++) {
+    int h = reachable[i];
+
+    for (j = 0; j < blocks[h].preds.size (); j++) {
+      if (dominates (h, blocks[h].preds[j]) && !header[h]) {
+        header[h] = true;
+        headers.push_back (pair<int, int> (h, dom_pre[h]));
+      }
+    }
+  }
+
+  /* A loop header comes after the header of any loop containing it in the
+   * dominator tree pre-order, so going backwards finds inner loops first */
+  sort (headers.begin (), headers.end (), by_order_desc);
+
+  for (i = 0; i < headers.size (); i++) {
+    int h = headers[i].first;
+    int latches = 0;
+
+    loop_of[h] = h;
+    members[h].push_back (h);
+    for (j = 0; j < blocks[h].preds.size (); j++) {
+      int p = blocks[h].preds[j];
+
+      if (dominates (h, p)) {
+        work.push_back (p);
+        if (latches++ == 0)
+          loop_latch[h] = p;
+        else if (loop_latch[h] != p)
+          loop_latch[h] = BLOCK_NONE;
+      }
+    }
+    while (work.size () > 0) {
+      int n = work.back ();
+      int top;
+
+      work.pop_back ();
+      if (n == h || dom_pre[n] < 0)
+        continue;
+      if (loop_of[n] == BLOCK_NONE) {
+        loop_of[n] = h;
+        members[h].push_back (n);
+        top = n;
+      } else {
+        for (top = loop_of[n]; loop_parent[top] != BLOCK_NONE;
+             top = loop_parent[top]);
+        if (top == h)
+          continue;
+        loop_parent[top] = h;
+        members[h].insert (members[h].end (), members[top].begin (),
+            members[top].end ());
+      }
+      for (j = 0; j < blocks[top].preds.size (); j++)
+        work.push_back (blocks[top].preds[j]);
+    }
+  }
+
+  /* The follow of a loop is where its header exits, otherwise where its
+   * latch exits, otherwise the first exit */
+  for (i = 0; i < headers.size (); i++) {
+    int h = headers[i].first;
+    int l = loop_latch[h];
+    int follow = BLOCK_NONE;
+
+    if (blocks[h].type == BRANCH_CONDITIONAL) {
+      if (!in_loop (blocks[h].taken, h))
+        follow = blocks[h].taken;
+      else if (!in_loop (blocks[h].fallthrough, h))
+        follow = blocks[h].fallthrough;
+    }
+    if (follow == BLOCK_NONE && l != BLOCK_NONE &&
+        blocks[l].type == BRANCH_CONDITIONAL) {
+      if (!in_loop (blocks[l].taken, h))
+        follow = blocks[l].taken;
+      else if (!in_loop (blocks[l].fallthrough, h))
+        follow = blocks[l].fallthrough;
+    }
+    for (j = 0; follow == BLOCK_NONE && j < members[h].size (); j++) {
+      BasicBlock &b = blocks[members[h][j]];
+
+      if (b.taken >= 0 && !in_loop (b.taken, h))
+        follow = b.taken;
+      else if (b.fallthrough >= 0 && !in_loop (b.fallthrough, h))
+        follow = b.fallthrough;
+    }
+    if (follow == BLOCK_EXIT)
+      follow = BLOCK_NONE;
+    loop_follow[h] = follow;
+  }
+}
+
+/* A loop header that only sets the condition register can become the
+ * condition of a while statement */
+bool
+Structurer::is_silent (int b)
+{
+  list<Instruction>::iterator it;
+
+  for (it = blocks[b].begin; it != blocks[b].end; it++) {
+    if (it->type != INSTRUCTION_TYPE_INSTRUCTION || &(*it) == blocks[b].branch)
+      continue;
+    if (it->name.compare (0, 3, "cmp") != 0)
+      return false;
+    // A compare written to CR isn't evaluated again by the condition
+    if (condition_written (*it) != condition_read (*blocks[b].branch) ||
+        (blocks[b].live_conditions & (1 << condition_written (*it))))
+      return false;
+  }
+  return true;
+}
+
+/* An arm whose blocks print nothing: no label and only compares that the
+ * branches test inline */
+bool
+Structurer::is_empty (list<Node> &nodes)
+{
+  list<Node>::iterator n;
+  list<Instruction>::iterator it;
+
+  for (n = nodes.begin (); n != nodes.end (); n++) {
+    if (n->type != NODE_BLOCK || blocks[n->block].goto_target)
+      return false;
+    BasicBlock &block = blocks[n->block];
+    for (it = block.begin; it != block.end; it++) {
+      if (it->type == INSTRUCTION_TYPE_LABEL || &(*it) == block.branch)
+        continue;
+      if (it->type != INSTRUCTION_TYPE_INSTRUCTION ||
+          it->name.compare (0, 3, "cmp") != 0 ||
+          (block.live_conditions & (1 << condition_written (*it))))
+        return false;
+    }
+  }
+  return true;
+}
+
+/* An arm of the if ending 'b' that would be nested, but that another path
+ * than the branch enters as well, through a goto */
+bool
+Structurer::is_shared (int b, int to, Region &r)
+{
+  size_t i;
+
+  if (to < 0 || to == r.stop || emitted[to] || !dominates (b, to))
+    return false;
+  if (r.header != BLOCK_NONE &&
+      (to == r.header || to == r.follow || !in_loop (to, r.header)))
+    return false;
+  for (i = 0; i < blocks[to].preds.size (); i++)
+    if (blocks[to].preds[i] != b && !dominates (to, blocks[to].preds[i]))
+      return true;
+  return false;
+}
+
+/* Emit the jump from 'from' to 'to' if it can't be expressed by structure.
+ * Returns true if 'to' should be emitted right after 'from' */
+bool
+Structurer::jump_to (int from, int to, Region &r, list<Node> &out)
+{
+  if (to == BLOCK_NONE || to == r.stop)
+    return false;
+  if (to == BLOCK_EXIT) {
+    out.push_back (Node (NODE_RETURN, from));
+    return false;
+  }
+  if (r.header != BLOCK_NONE) {
+    if (to == r.header) {
+      out.push_back (Node (NODE_CONTINUE, to));
+      return false;
+    }
+    if (to == r.follow) {
+      out.push_back (Node (NODE_BREAK, to));
+      return false;
+    }
+  }
+  if (emitted[to] || !dominates (from, to) ||
+      (r.header != BLOCK_NONE && !in_loop (to, r.header))) {
+    blocks[to].goto_target = true;
+    out.push_back (Node (NODE_GOTO, to));
+    return false;
+  }
+  return true;
+}
+
+void
+Structurer::emit_sequence (int b, Region r, list<Node> &out)
+{
+  while (b >= 0) {
+    BasicBlock &block = blocks[b];
+    int next;
+
+    if (header[b] && b != r.header) {
+      next = emit_loop (b, out);
+    } else {
+      emitted[b] = true;
+      out.push_back (Node (NODE_BLOCK, b));
+
+      switch (block.type) {
+        case BRANCH_RETURN:
+        case BRANCH_INDIRECT:
+          out.push_back (Node (NODE_RETURN, b));
+          return;
+        case BRANCH_CONDITIONAL:
+        case BRANCH_COND_RETURN:
+          if (b == r.latch) {
+            *r.latch_used = true;
+            return;
+          }
+          next = emit_if (b, r, out);
+          break;
+        case BRANCH_SWITCH:
+          next = emit_switch (b, r, out);
+          break;
+        case BRANCH_ALWAYS:
+          next = block.taken;
+          break;
+        default:
+          next = block.fallthrough;
+          if (next == BLOCK_NONE)
+            next = BLOCK_EXIT;
+          break;
+      }
+    }
+    if (!jump_to (b, next, r, out))
+      return;
+    b = next;
+  }
+}
+
+/* Emit the if/else starting at 'b'. Returns the block where both arms meet */
+int
+Structurer::emit_if (int b, Region &r, list<Node> &out)
+{
+  BasicBlock &block = blocks[b];
+  int join = ipdom[b];
+  Node node (NODE_IF, b);
+  Region arm = r;
+  int shared = BLOCK_NONE;
+
+  arm.latch = BLOCK_NONE;
+  if (join != BLOCK_NONE)
+    arm.stop = join;
+
+  if (is_shared (b, block.taken, arm))
+    shared = block.taken;
+  else if (is_shared (b, block.fallthrough, arm))
+    shared = block.fallthrough;
+
+  /* Rather than a goto from one arm into the other, the if goes to the arm
+   * both enter, which follows the other one */
+  if (shared != BLOCK_NONE) {
+    int other = shared == block.taken ? block.fallthrough : block.taken;
+    list<Node>::reverse_iterator last;
+
+    blocks[shared].goto_target = true;
+    node.negate = shared == block.fallthrough;
+    node.body.push_back (Node (NODE_GOTO, shared));
+    out.push_back (node);
+    if (jump_to (b, other, arm, out))
+      emit_sequence (other, arm, out);
+
+    last = out.rbegin ();
+    if (last->type == NODE_GOTO && last->block == shared) {
+      out.pop_back ();
+    } else if (last->type != NODE_BREAK && last->type != NODE_CONTINUE &&
+               last->type != NODE_GOTO && last->type != NODE_RETURN &&
+               arm.stop != BLOCK_NONE) {
+      blocks[arm.stop].goto_target = true;
+      out.push_back (Node (NODE_GOTO, arm.stop));
+    }
+    emit_sequence (shared, arm, out);
+    return join;
+  }
+
+  if (jump_to (b, block.taken, arm, node.body))
+    emit_sequence (block.taken, arm, node.body);
+  if (jump_to (b, block.fallthrough, arm, node.else_body))
+    emit_sequence (block.fallthrough, arm, node.else_body);
+
+  // Arms without a body, unless the condition decrements CTR
+  if (is_empty (node.else_body))
+    node.else_body.clear ();
+  if (is_empty (node.body) &&
+      (node.else_body.size () > 0 || block.branch->name.compare (0, 2, "bd") != 0))
+    node.body.clear ();
+
+  if (node.body.size () == 0) {
+    node.negate = true;
+    node.body.swap (node.else_body);
+  }
+  if (node.body.size () > 0)
+    out.push_back (node);
+
+  return join;
+}
+
+/* Emit the switch ending 'b', one case per distinct target. A 'break' now
+ * leaves the switch, so loop exits from the cases become gotos. Returns the
+ * block where the cases meet */
+int
+Structurer::emit_switch (int b, Region &r, list<Node> &out)
+{
+  BasicBlock &block = blocks[b];
+  int join = ipdom[b];
+  Node node (NODE_SWITCH, b);
+  vector<int> targets;
+  Region arm = r;
+  size_t distinct, i, j;
+
+  arm.follow = BLOCK_NONE;
+  arm.latch = BLOCK_NONE;
+  if (join != BLOCK_NONE)
+    arm.stop = join;
+
+  for (i = 0; i < block.cases.size (); i++)
+    if (find (targets.begin (), targets.end (), block.cases[i]) == targets.end ())
+      targets.push_back (block.cases[i]);
+  distinct = targets.size ();
+  // The default case has no values, if it shares a block it is a goto to it
+  if (block.default_case != BLOCK_NONE && block.default_case != arm.stop)
+    targets.push_back (block.default_case);
+
+  for (i = 0; i < targets.size (); i++) {
+    Node c (NODE_CASE, targets[i]);
+    list<Node>::reverse_iterator last;
+
+    for (j = 0; i < distinct && j < block.cases.size (); j++)
+      if (block.cases[j] == targets[i])
+        c.values.push_back (block.case_values[j]);
+    if (jump_to (b, targets[i], arm, c.body))
+      emit_sequence (targets[i], arm, c.body);
+
+    last = c.body.rbegin ();
+    if (last == c.body.rend () ||
+        (last->type != NODE_BREAK && last->type != NODE_CONTINUE &&
+         last->type != NODE_GOTO && last->type != NODE_RETURN))
+      c.body.push_back (Node (NODE_BREAK, join));
+    node.body.push_back (c);
+  }
+  out.push_back (node);
+
+  return join;
+}
+
+/* Emit the loop with header 'h'. Returns the block following the loop */
+int
+Structurer::emit_loop (int h, list<Node> &out)
+{
+  BasicBlock &block = blocks[h];
+  int follow = loop_follow[h];
+  int latch = loop_latch[h];
+  bool latch_used = false;
+  Node node (NODE_LOOP, h);
+  Region body;
+
+  body.header = h;
+  body.follow = follow;
+  body.stop = BLOCK_NONE;
+  body.latch = BLOCK_NONE;
+  body.latch_used = &latch_used;
+
+  if (block.type == BRANCH_CONDITIONAL && follow != BLOCK_NONE &&
+      (block.taken == follow || block.fallthrough == follow) &&
+      is_silent (h)) {
+    int inside = block.taken == follow ? block.fallthrough : block.taken;
+
+    emitted[h] = true;
+    node.loop = LOOP_WHILE;
+    node.negate = block.taken == follow;
+    if (jump_to (h, inside, body, node.body))
+      emit_sequence (inside, body, node.body);
+  } else {
+    if (latch != BLOCK_NONE && blocks[latch].type == BRANCH_CONDITIONAL &&
+        follow != BLOCK_NONE &&
+        ((blocks[latch].taken == h && blocks[latch].fallthrough == follow) ||
+         (blocks[latch].fallthrough == h && blocks[latch].taken == follow)))
+      body.latch = latch;
+    emit_sequence (h, body, node.body);
+    if (latch_used) {
+      node.loop = LOOP_DO_WHILE;
+      node.block = latch;
+      node.negate = blocks[latch].taken != h;
+    }
+  }
+
+  if (node.body.size () > 0 && node.body.back ().type == NODE_CONTINUE)
+    node.body.pop_back ();
+  out.push_back (node);
+
+  return follow;
+}
+
+void
+Structurer::run (list<Node> &nodes)
+{
+  bool unused = false;
+  Region top;
+  int i;
+
+  if (count == 0)
+    return;
+
+  analyse ();
+  emitted.assign (count, false);
+
+  top.header = BLOCK_NONE;
+  top.follow = BLOCK_NONE;
+  top.stop = BLOCK_NONE;
+  top.latch = BLOCK_NONE;
+  top.latch_used = &unused;
+
+  emit_sequence (0, top, nodes);
+
+  /* Whatever couldn't be nested is emitted after the body, reached by goto */
+  for (i = 0; i < count; i++) {
+    if (emitted[i])
+      continue;
+    blocks[i].goto_target = true;
+    emit_sequence (i, top, nodes);
+  }
+}
+
+/* Which fields of CR are read after each block, and after the calls in it,
+ * before a compare sets them again: the compares of the block that set them
+ * have to write CR */
+static void
+find_live_conditions (vector<BasicBlock> &blocks)
+{
+  list<Instruction>::iterator it;
+  vector<uint32> used (blocks.size ());
+  vector<uint32> set (blocks.size ());
+  bool changed = true;
+  size_t b, j;
+
+  for (b = 0; b < blocks.size (); b++) {
+    for (it = blocks[b].begin; it != blocks[b].end; it++) {
+      int read = condition_read (*it);
+      int written = condition_written (*it);
+
+      if (read >= 0)
+        used[b] |= ~set[b] & (read == CR_ALL ? 0xFF : 1 << read);
+      if (written >= 0)
+        set[b] |= written == CR_ALL ? 0xFF : 1 << written;
+    }
+  }
+
+  while (changed) {
+    changed = false;
+    for (b = blocks.size (); b-- > 0; ) {
+      vector<int> succs (blocks[b].cases);
+      uint32 live = 0;
+
+      succs.push_back (blocks[b].taken);
+      succs.push_back (blocks[b].fallthrough);
+      succs.push_back (blocks[b].default_case);
+      for (j = 0; j < succs.size (); j++) {
+        if (succs[j] >= 0)
+          live |= used[succs[j]] | (blocks[succs[j]].live_conditions & ~set[succs[j]]);
+      }
+      if (live != blocks[b].live_conditions) {
+        blocks[b].live_conditions = live;
+        changed = true;
+      }
+    }
+  }
+
+  for (b = 0; b < blocks.size (); b++) {
+    list<Instruction>::iterator end = blocks[b].end;
+    uint32 live = blocks[b].live_conditions;
+
+    while (end != blocks[b].begin) {
+      Instruction &ins = *--end;
+      int read = condition_read (ins);
+      int written = condition_written (ins);
+
+      if (is_call (ins))
+        blocks[b].call_conditions |= live;
+      if (written >= 0)
+        live &= written == CR_ALL ? 0 : ~(1 << written);
+      if (read >= 0)
+        live |= read == CR_ALL ? 0xFF : 1 << read;
+    }
+  }
+}
+
+void
+structure_function (vector<BasicBlock> &blocks, list<Node> &nodes)
+{
+  Structurer structurer (blocks);
+
+  find_live_conditions (blocks);
+  nodes.clear ();
+  structurer.run (nodes);
+}
@@ -0,0 +1,83 @@
+/*
+ * ppc2c_structure.hpp -- Control flow recovery for the PPC to C converter
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+#ifndef __PPC2C_STRUCTURE_HPP__
+#define __PPC2C_STRUCTURE_HPP__
+
+#include "ppc2c_engine.hpp"
+#include "ppc2c_handlers.hpp"
+
+#include <vector>
+
+#define BLOCK_NONE -1 // No successor
+#define BLOCK_EXIT -2 // Leaves the function (return or tail call)
+
+class BasicBlock {
+public:
+  BasicBlock();
+  ea_t address;
+  string label; // Name used if the block is the target of a goto
+  list<Instruction>::iterator begin;
+  list<Instruction>::iterator end;
+  Instruction *branch; // Instruction ending the block, NULL if none
+  BranchType type;
+  int taken; // Successor when the branch is taken
+  int fallthrough; // Successor when execution continues after the block
+  vector<int> cases; // Successor of each case of a switch, BLOCK_NONE if none
+  vector<uval_t> case_values;
+  int default_case; // Successor when no case matches, BLOCK_NONE if none
+  int switch_register;
+  vector<int> preds;
+  bool goto_target;
+  uint32 live_conditions; // Fields of CR read after the block
+  uint32 call_conditions; // Fields of CR read after a call of the block
+};
+
+typedef enum {
+  NODE_BLOCK,
+  NODE_IF,
+  NODE_LOOP,
+  NODE_SWITCH,
+  NODE_CASE,
+  NODE_BREAK,
+  NODE_CONTINUE,
+  NODE_GOTO,
+  NODE_RETURN,
+} NodeType;
+
+typedef enum {
+  LOOP_ENDLESS,  // while (1) { ... }
+  LOOP_WHILE,    // while (cond) { ... }
+  LOOP_DO_WHILE, // do { ... } while (cond);
+} LoopType;
+
+/* A statement of the structured function body.
+ * NODE_BLOCK lowers 'block', NODE_IF and NODE_LOOP take their condition from
+ * the branch ending 'block', NODE_SWITCH switches on the register of 'block'
+ * and holds NODE_CASE nodes (the default case has no values), NODE_GOTO jumps
+ * to 'block' and NODE_RETURN leaves the function through the branch of
+ * 'block' (or BLOCK_NONE) */
+class Node {
+public:
+  Node(NodeType type, int block);
+  NodeType type;
+  int block;
+  bool negate; // Condition is the branch *not* being taken
+  LoopType loop;
+  vector<uval_t> values; // Case labels
+  list<Node> body;      // 'then' statements, or the loop body
+  list<Node> else_body;
+};
+
+bool read_jump_table (ea_t ea, JumpTable &table);
+void build_blocks (Function &func, vector<BasicBlock> &blocks);
+void structure_function (vector<BasicBlock> &blocks, list<Node> &nodes);
+
+#endif /* __PPC2C_STRUCTURE_HPP__ */
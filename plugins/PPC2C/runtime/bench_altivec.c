@@ -0,0 +1,386 @@
+/*
+ * bench_altivec.c -- Checks and benchmarks the SSE lowering of Altivec code
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+/*
+ * The element order is the part that's easy to get wrong, so the checks run
+ * instruction sequences as PPC2C lowers them and compare what they store to
+ * guest memory with what the big-endian definition of the instruction gives.
+ * The benchmark then runs a vmaddfp loop lowered to SSE against the same
+ * loop done one element at a time.
+ */
+
+#include "ppc2c_altivec.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DATA_ADDRESS 0x10000000
+#define DATA_SIZE 0x00100000
+#define SRC_A (DATA_ADDRESS)
+#define SRC_B (DATA_ADDRESS + 0x100)
+#define DEST (DATA_ADDRESS + 0x200)
+#define EXPECTED (DATA_ADDRESS + 0x300)
+
+#define X_ADDRESS (DATA_ADDRESS + 0x1000)
+#define Y_ADDRESS (DATA_ADDRESS + 0x1000 + DATA_SIZE / 2)
+#define ELEMENTS ((DATA_SIZE / 2 - 0x1000) / 4)
+
+static int failures = 0;
+
+static void
+check (const char *name, int size)
+{
+  if (memcmp (ppc2c_host (DEST), ppc2c_host (EXPECTED), size) != 0) {
+    int i;
+
+    printf ("FAIL %s\n  got      ", name);
+    for (i = 0; i < size; i++)
+      printf ("%02X", ppc2c_read8 (DEST + i));
+    printf ("\n  expected ");
+    for (i = 0; i < size; i++)
+      printf ("%02X", ppc2c_read8 (EXPECTED + i));
+    printf ("\n");
+    failures++;
+  } else {
+    printf ("ok   %s\n", name);
+  }
+}
+
+static void
+expect_bytes (const uint8_t *bytes)
+{
+  int i;
+
+  for (i = 0; i < 16; i++)
+    ppc2c_write8 (EXPECTED + i, bytes[i]);
+}
+
+static void
+run_checks (void)
+{
+  __m128i vr1, vr2, vr3, vr4;
+  uint8_t e[16];
+  uint32_t u;
+  float f;
+  int i;
+
+  for (i = 0; i < 0x40; i++) {
+    ppc2c_write8 (SRC_A + i, (uint8_t) (0x10 + i));
+    ppc2c_write8 (SRC_B + i, (uint8_t) (0x80 + i * 3));
+  }
+
+  /* lvx / stvx */
+  vr1 = ppc2c_lvx (SRC_A);
+  ppc2c_stvx (DEST, vr1);
+  for (i = 0; i < 16; i++)
+    e[i] = ppc2c_read8 (SRC_A + i);
+  expect_bytes (e);
+  check ("lvx/stvx", 16);
+
+  /* Unaligned load through lvsl and vperm */
+  vr1 = ppc2c_lvx (SRC_A + 5);
+  vr2 = ppc2c_lvx (SRC_A + 5 + 15);
+  vr3 = ppc2c_lvsl (SRC_A + 5);
+  vr4 = ppc2c_vperm (vr1, vr2, vr3);
+  ppc2c_stvx (DEST, vr4);
+  for (i = 0; i < 16; i++)
+    e[i] = ppc2c_read8 (SRC_A + 5 + i);
+  expect_bytes (e);
+  check ("lvsl/vperm", 16);
+
+  /* Same load with Cell's lvlx / lvrx */
+  vr1 = ppc2c_lvlx (SRC_A + 5);
+  vr2 = ppc2c_lvrx (SRC_A + 5 + 16);
+  vr3 = _mm_or_si128 (vr1, vr2);
+  ppc2c_stvx (DEST, vr3);
+  check ("lvlx/lvrx", 16);
+
+  /* vsldoi vD, vA, vB, 3 */
+  vr1 = ppc2c_lvx (SRC_A);
+  vr2 = ppc2c_lvx (SRC_B);
+  vr3 = _mm_alignr_epi8 (vr1, vr2, 16 - 3);
+  ppc2c_stvx (DEST, vr3);
+  for (i = 0; i < 16; i++)
+    e[i] = i + 3 < 16 ? ppc2c_read8 (SRC_A + i + 3) : ppc2c_read8 (SRC_B + i + 3 - 16);
+  expect_bytes (e);
+  check ("vsldoi", 16);
+
+  /* vmrghw / vmrglw */
+  vr3 = _mm_unpackhi_epi32 (vr2, vr1);
+  ppc2c_stvx (DEST, vr3);
+  for (i = 0; i < 4; i++) {
+    PPC2C_ST32 (EXPECTED + i * 8, PPC2C_LD32 (SRC_A + i * 4));
+    PPC2C_ST32 (EXPECTED + i * 8 + 4, PPC2C_LD32 (SRC_B + i * 4));
+  }
+  check ("vmrghw", 16);
+  vr3 = _mm_unpacklo_epi32 (vr2, vr1);
+  ppc2c_stvx (DEST, vr3);
+  for (i = 0; i < 2; i++) {
+    PPC2C_ST32 (EXPECTED + i * 8, PPC2C_LD32 (SRC_A + 8 + i * 4));
+    PPC2C_ST32 (EXPECTED + i * 8 + 4, PPC2C_LD32 (SRC_B + 8 + i * 4));
+  }
+  check ("vmrglw", 16);
+
+  /* vspltw vD, vB, 1, vsplth vD, vB, 5, vspltb vD, vB, 14 */
+  vr3 = _mm_shuffle_epi32 (vr1, (3 - 1) * 0x55);
+  ppc2c_stvx (DEST, vr3);
+  for (i = 0; i < 4; i++)
+    PPC2C_ST32 (EXPECTED + i * 4, PPC2C_LD32 (SRC_A + 4));
+  check ("vspltw", 16);
+  vr3 = _mm_shuffle_epi8 (vr1, _mm_set1_epi16 ((14 - 2 * 5) | (15 - 2 * 5) << 8));
+  ppc2c_stvx (DEST, vr3);
+  for (i = 0; i < 8; i++)
+    PPC2C_ST16 (EXPECTED + i * 2, PPC2C_LD16 (SRC_A + 10));
+  check ("vsplth", 16);
+  vr3 = _mm_shuffle_epi8 (vr1, _mm_set1_epi8 (15 - 14));
+  ppc2c_stvx (DEST, vr3);
+  memset (e, ppc2c_read8 (SRC_A + 14), 16);
+  expect_bytes (e);
+  check ("vspltb", 16);
+
+  /* vpkuhum, vupkhsb */
+  vr3 = ppc2c_vpkuhum (vr1, vr2);
+  ppc2c_stvx (DEST, vr3);
+  for (i = 0; i < 8; i++) {
+    e[i] = ppc2c_read8 (SRC_A + i * 2 + 1);
+    e[i + 8] = ppc2c_read8 (SRC_B + i * 2 + 1);
+  }
+  expect_bytes (e);
+  check ("vpkuhum", 16);
+  vr3 = _mm_cvtepi8_epi16 (_mm_srli_si128 (vr2, 8));
+  ppc2c_stvx (DEST, vr3);
+  for (i = 0; i < 8; i++)
+    PPC2C_ST16 (EXPECTED + i * 2, (int8_t) ppc2c_read8 (SRC_B + i));
+  check ("vupkhsb", 16);
+
+  /* vmuleuh / vmulouh */
+  vr3 = ppc2c_vmuleuh (vr1, vr2);
+  ppc2c_stvx (DEST, vr3);
+  for (i = 0; i < 4; i++)
+    PPC2C_ST32 (EXPECTED + i * 4, (uint32_t) PPC2C_LD16 (SRC_A + i * 4) *
+        PPC2C_LD16 (SRC_B + i * 4));
+  check ("vmuleuh", 16);
+  vr3 = ppc2c_vmulouh (vr1, vr2);
+  ppc2c_stvx (DEST, vr3);
+  for (i = 0; i < 4; i++)
+    PPC2C_ST32 (EXPECTED + i * 4, (uint32_t) PPC2C_LD16 (SRC_A + i * 4 + 2) *
+        PPC2C_LD16 (SRC_B + i * 4 + 2));
+  check ("vmulouh", 16);
+
+  /* vsumsws: the sum lands in word 3 */
+  vr3 = ppc2c_vsumsws (vr1, vr2);
+  ppc2c_stvx (DEST, vr3);
+  memset (e, 0, 16);
+  expect_bytes (e);
+  u = PPC2C_LD32 (SRC_A) + PPC2C_LD32 (SRC_A + 4) + PPC2C_LD32 (SRC_A + 8) +
+      PPC2C_LD32 (SRC_A + 12) + PPC2C_LD32 (SRC_B + 12);
+  PPC2C_ST32 (EXPECTED + 12, u);
+  check ("vsumsws", 16);
+
+  /* vslo by 3 octets, then vsl by 5 bits */
+  vr4 = _mm_set1_epi8 (3 << 3);
+  vr3 = ppc2c_vslo (vr1, vr4);
+  ppc2c_stvx (DEST, vr3);
+  for (i = 0; i < 16; i++)
+    e[i] = i + 3 < 16 ? ppc2c_read8 (SRC_A + i + 3) : 0;
+  expect_bytes (e);
+  check ("vslo", 16);
+  vr4 = _mm_set1_epi8 (5);
+  vr3 = ppc2c_vsl (vr1, vr4);
+  ppc2c_stvx (DEST, vr3);
+  for (i = 0; i < 16; i++)
+    e[i] = (uint8_t) ((ppc2c_read8 (SRC_A + i) << 5) |
+        (i < 15 ? ppc2c_read8 (SRC_A + i + 1) >> 3 : 0));
+  expect_bytes (e);
+  check ("vsl", 16);
+
+  /* vcfsx, vaddfp, vmaddfp on big-endian floats */
+  for (i = 0; i < 4; i++) {
+    PPC2C_ST32 (SRC_A + 0x20 + i * 4, (uint32_t) (i * 100 - 150));
+    f = 1.5f * i;
+    memcpy (&u, &f, 4);
+    PPC2C_ST32 (SRC_B + 0x20 + i * 4, u);
+  }
+  vr1 = ppc2c_lvx (SRC_A + 0x20);
+  vr2 = ppc2c_lvx (SRC_B + 0x20);
+  vr1 = PPC2C_VI (_mm_mul_ps (_mm_cvtepi32_ps (vr1), _mm_set1_ps (1.0f / (1u << 2))));
+  vr3 = PPC2C_VI (_mm_add_ps (_mm_mul_ps (PPC2C_VF (vr1), PPC2C_VF (vr2)), PPC2C_VF (vr2)));
+  ppc2c_stvx (DEST, vr3);
+  for (i = 0; i < 4; i++) {
+    f = ((i * 100 - 150) / 4.0f) * (1.5f * i) + 1.5f * i;
+    memcpy (&u, &f, 4);
+    PPC2C_ST32 (EXPECTED + i * 4, u);
+  }
+  check ("vcfsx/vmaddfp", 16);
+
+  /* vcmpequw. and CR6 */
+  {
+    uint32_t CR = 0;
+
+    vr3 = _mm_cmpeq_epi32 (vr1, vr1);
+    PPC2C_CR_SET (CR, 6, ppc2c_vcmp_cr6 (vr3));
+    printf ("%s vcmpequw. all true\n", cr6_lt && !cr6_eq ? "ok  " : "FAIL");
+    failures += !(cr6_lt && !cr6_eq);
+    vr3 = _mm_cmpeq_epi32 (vr1, vr2);
+    PPC2C_CR_SET (CR, 6, ppc2c_vcmp_cr6 (vr3));
+    printf ("%s vcmpequw. all false\n", !cr6_lt && cr6_eq ? "ok  " : "FAIL");
+    failures += !(!cr6_lt && cr6_eq);
+  }
+}
+
+/*
+ * y = a * x + y over big-endian floats :
+ *
+ *   loop:      lvx      v1, r4, r5
+ *              lvx      v2, r4, r6
+ *              vmaddfp  v2, v0, v1, v2
+ *              stvx     v2, r4, r6
+ *              addi     r4, r4, 16
+ *              bdnz     loop
+ *
+ * with the splatted a in v0.
+ */
+#undef PPC2C_VECTOR_LOCALS
+#undef PPC2C_VECTOR_LOAD
+#undef PPC2C_VECTOR_STORE
+#define PPC2C_VECTOR_LOCALS __m128i vr0, vr1, vr2;
+#define PPC2C_VECTOR_LOAD(ctx) vr0 = PPC2C_VR_GET (ctx, 0); vr1 = PPC2C_VR_GET (ctx, 1); vr2 = PPC2C_VR_GET (ctx, 2)
+#define PPC2C_VECTOR_STORE(ctx) PPC2C_VR_SET (ctx, 0, vr0); PPC2C_VR_SET (ctx, 1, vr1); PPC2C_VR_SET (ctx, 2, vr2)
+
+static void
+saxpy (ppc_context_t *ctx)
+{
+  PPC2C_ENTER (ctx);
+
+  do {
+    vr1 = ppc2c_lvx (r4 + r5);
+    vr2 = ppc2c_lvx (r4 + r6);
+    vr2 = PPC2C_VI (_mm_add_ps (_mm_mul_ps (PPC2C_VF (vr0), PPC2C_VF (vr1)), PPC2C_VF (vr2)));
+    ppc2c_stvx (r4 + r6, vr2);
+    r4 = r4 + 16;
+  } while (--CTR != 0);
+  PPC2C_RETURN (ctx);
+}
+
+#undef PPC2C_VECTOR_LOCALS
+#undef PPC2C_VECTOR_LOAD
+#undef PPC2C_VECTOR_STORE
+#define PPC2C_VECTOR_LOCALS
+#define PPC2C_VECTOR_LOAD(ctx)
+#define PPC2C_VECTOR_STORE(ctx)
+
+/* The same loop with the FPU, one element at a time */
+static void
+saxpy_scalar (ppc_context_t *ctx)
+{
+  uint32_t i;
+
+  for (i = 0; i < ctx->ctr * 4; i++) {
+    uint32_t x = PPC2C_LD32 (ctx->gpr[5] + i * 4);
+    uint32_t y = PPC2C_LD32 (ctx->gpr[6] + i * 4);
+    float fx, fy;
+
+    memcpy (&fx, &x, 4);
+    memcpy (&fy, &y, 4);
+    fy = (float) ctx->fpr[0] * fx + fy;
+    memcpy (&y, &fy, 4);
+    PPC2C_ST32 (ctx->gpr[6] + i * 4, y);
+  }
+}
+
+static double
+now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+reset_data (void)
+{
+  uint32_t i;
+
+  for (i = 0; i < ELEMENTS; i++) {
+    float x = (float) (i % 1000) / 8.0f;
+    float y = 1.0f;
+    uint32_t u;
+
+    memcpy (&u, &x, 4);
+    PPC2C_ST32 (X_ADDRESS + i * 4, u);
+    memcpy (&u, &y, 4);
+    PPC2C_ST32 (Y_ADDRESS + i * 4, u);
+  }
+}
+
+static double
+run (ppc2c_func_t function, int iterations)
+{
+  ppc_context_t ctx;
+  double start;
+  int i;
+
+  reset_data ();
+  start = now ();
+  for (i = 0; i < iterations; i++) {
+    ppc2c_init_context (&ctx, 0);
+    ctx.gpr[4] = 0;
+    ctx.gpr[5] = X_ADDRESS;
+    ctx.gpr[6] = Y_ADDRESS;
+    ctx.ctr = ELEMENTS / 4;
+    ctx.fpr[0] = 0.5;
+    PPC2C_VR_SET (&ctx, 0, _mm_set1_epi32 (0x3F000000)); /* 0.5f */
+    function (&ctx);
+  }
+  return now () - start;
+}
+
+int
+main (int argc, char *argv[])
+{
+  int iterations = argc > 1 ? atoi (argv[1]) : 200;
+  double vector_time, scalar_time;
+  double megabytes = ELEMENTS * 4 / 1048576.0;
+  uint8_t *scalar_result;
+
+  if (iterations <= 0 || ppc2c_init () < 0 ||
+      ppc2c_map (DATA_ADDRESS, DATA_SIZE) < 0)
+    return 1;
+
+  run_checks ();
+  if (failures) {
+    printf ("%d check(s) failed\n", failures);
+    return 1;
+  }
+
+  /* Both have to leave the same results behind */
+  scalar_result = malloc (ELEMENTS * 4);
+  scalar_time = run (saxpy_scalar, iterations);
+  memcpy (scalar_result, ppc2c_host (Y_ADDRESS), ELEMENTS * 4);
+  vector_time = run (saxpy, iterations);
+  if (memcmp (scalar_result, ppc2c_host (Y_ADDRESS), ELEMENTS * 4) != 0) {
+    fprintf (stderr, "saxpy results differ\n");
+    return 1;
+  }
+  free (scalar_result);
+
+  printf ("saxpy over %d x %u floats\n", iterations, (unsigned) ELEMENTS);
+  printf ("  scalar : %8.3f s %10.1f MB/s\n", scalar_time,
+      iterations * megabytes / scalar_time);
+  printf ("  sse    : %8.3f s %10.1f MB/s\n", vector_time,
+      iterations * megabytes / vector_time);
+  printf ("  speedup: %8.1fx\n", scalar_time / vector_time);
+
+  ppc2c_shutdown ();
+  return 0;
+}
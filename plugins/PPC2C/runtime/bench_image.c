@@ -0,0 +1,79 @@
+/*
+ * bench_image.c -- Writes the guest routines of bench_lifted for PPC2C
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+/*
+ * A raw image of the code at CODE_ADDRESS and the sidecar naming its
+ * functions, which headless_ppc2c converts to bench_lifted_code.c.
+ */
+
+#include "bench_kernels.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static uint8_t image[CODE_SIZE];
+
+static void
+put (uint32_t address, const uint32_t *code, size_t size)
+{
+  uint8_t *p = image + (address - CODE_ADDRESS);
+  size_t i;
+
+  for (i = 0; i < size / 4; i++, p += 4) {
+    p[0] = (uint8_t) (code[i] >> 24);
+    p[1] = (uint8_t) (code[i] >> 16);
+    p[2] = (uint8_t) (code[i] >> 8);
+    p[3] = (uint8_t) code[i];
+  }
+}
+
+int
+main (int argc, char *argv[])
+{
+  FILE *f;
+
+  if (argc != 3) {
+    fprintf (stderr, "Usage: %s image sidecar\n", argv[0]);
+    return 1;
+  }
+
+  memset (image, 0, sizeof(image));
+  put (CHECKSUM_ADDRESS, checksum_code, sizeof(checksum_code));
+  put (SUM_ADDRESS, sum_code, sizeof(sum_code));
+  put (BIAS_ADDRESS, bias_code, sizeof(bias_code));
+  put (ENTRY_ADDRESS, entry_code, sizeof(entry_code));
+
+  f = fopen (argv[1], "wb");
+  if (f == NULL || fwrite (image, sizeof(image), 1, f) != 1) {
+    perror (argv[1]);
+    return 1;
+  }
+  fclose (f);
+
+  f = fopen (argv[2], "w");
+  if (f == NULL) {
+    perror (argv[2]);
+    return 1;
+  }
+  fprintf (f, "segment .text 0x%X 0x%X 0 code\n", CODE_ADDRESS,
+      CODE_ADDRESS + CODE_SIZE);
+  fprintf (f, "entry 0x%X\n", ENTRY_ADDRESS);
+  fprintf (f, "func 0x%X 0x%X checksum\n", CHECKSUM_ADDRESS,
+      (unsigned) (CHECKSUM_ADDRESS + sizeof(checksum_code)));
+  fprintf (f, "func 0x%X 0x%X sum\n", SUM_ADDRESS,
+      (unsigned) (SUM_ADDRESS + sizeof(sum_code)));
+  fprintf (f, "func 0x%X 0x%X bias\n", BIAS_ADDRESS,
+      (unsigned) (BIAS_ADDRESS + sizeof(bias_code)));
+  fprintf (f, "func 0x%X 0x%X kernels\n", ENTRY_ADDRESS,
+      (unsigned) (ENTRY_ADDRESS + sizeof(entry_code)));
+  fclose (f);
+
+  return 0;
+}
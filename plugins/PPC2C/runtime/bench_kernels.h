@@ -0,0 +1,126 @@
+/*
+ * bench_kernels.h -- The guest routines of bench_lifted
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+#ifndef __BENCH_KERNELS_H__
+#define __BENCH_KERNELS_H__
+
+#include <stdint.h>
+
+#define CODE_ADDRESS 0x00010000
+#define CODE_SIZE 0x2000
+#define CHECKSUM_ADDRESS CODE_ADDRESS
+#define BIAS_ADDRESS (CODE_ADDRESS + 0x800)
+#define SUM_ADDRESS (CODE_ADDRESS + 0x1000)
+/* Calls them all, so PPC2C converts them from the entry point of the image */
+#define ENTRY_ADDRESS (CODE_ADDRESS + 0x1800)
+
+/*
+ * The first guest routine, a multiplicative checksum of r4 bytes at r3 :
+ *
+ *   checksum:  li     r5, 0
+ *              cmpwi  cr7, r4, 0
+ *              beq    cr7, done
+ *              mtctr  r4
+ *   loop:      lbz    r6, 0(r3)
+ *              mulli  r5, r5, 31
+ *              addi   r3, r3, 1
+ *              add    r5, r5, r6
+ *              bdnz   loop
+ *   done:      mr     r3, r5
+ *              blr
+ */
+#define D_FORM(op, rt, ra, imm) \
+  (((op) << 26) | ((rt) << 21) | ((ra) << 16) | ((imm) & 0xFFFF))
+#define X_FORM(rt, ra, rb, xo) \
+  ((31u << 26) | ((rt) << 21) | ((ra) << 16) | ((rb) << 11) | ((xo) << 1))
+#define BC(bo, bi, disp) \
+  ((16u << 26) | ((bo) << 21) | ((bi) << 16) | ((disp) & 0xFFFC))
+#define BL(disp) \
+  ((18u << 26) | ((disp) & 0x03FFFFFC) | 1)
+
+static const uint32_t checksum_code[] = {
+  D_FORM (14u, 5, 0, 0),            /* li     r5, 0 */
+  D_FORM (11u, 7 << 2, 4, 0),       /* cmpwi  cr7, r4, 0 */
+  BC (12u, 30, 7 * 4),              /* beq    cr7, done */
+  X_FORM (4, 9, 0, 467),            /* mtctr  r4 */
+  D_FORM (34u, 6, 3, 0),            /* lbz    r6, 0(r3) */
+  D_FORM (7u, 5, 5, 31),            /* mulli  r5, r5, 31 */
+  D_FORM (14u, 3, 3, 1),            /* addi   r3, r3, 1 */
+  X_FORM (5, 5, 6, 266),            /* add    r5, r5, r6 */
+  BC (16u, 0, -4 * 4),              /* bdnz   loop */
+  X_FORM (5, 3, 5, 444),            /* mr     r3, r5 */
+  0x4E800020,                       /* blr */
+};
+
+/*
+ * The second one sums the r4 words at r3, to exercise byte swapping :
+ *
+ *   sum:       li     r5, 0
+ *              mtctr  r4
+ *   loop:      lwz    r6, 0(r3)
+ *              addi   r3, r3, 4
+ *              add    r5, r5, r6
+ *              bdnz   loop
+ *              mr     r3, r5
+ *              blr
+ */
+static const uint32_t sum_code[] = {
+  D_FORM (14u, 5, 0, 0),            /* li     r5, 0 */
+  X_FORM (4, 9, 0, 467),            /* mtctr  r4 */
+  D_FORM (32u, 6, 3, 0),            /* lwz    r6, 0(r3) */
+  D_FORM (14u, 3, 3, 4),            /* addi   r3, r3, 4 */
+  X_FORM (5, 5, 6, 266),            /* add    r5, r5, r6 */
+  BC (16u, 0, -3 * 4),              /* bdnz   loop */
+  X_FORM (5, 3, 5, 444),            /* mr     r3, r5 */
+  0x4E800020,                       /* blr */
+};
+
+/*
+ * The third one sums the r4 words at r3 once moved to the upper halfword,
+ * with a sign extended addis and a zero extended oris :
+ *
+ *   bias:      li     r5, 0
+ *              mtctr  r4
+ *   loop:      lwz    r6, 0(r3)
+ *              addis  r6, r6, -2
+ *              oris   r6, r6, 0x8000
+ *              addi   r3, r3, 4
+ *              add    r5, r5, r6
+ *              bdnz   loop
+ *              mr     r3, r5
+ *              blr
+ */
+static const uint32_t bias_code[] = {
+  D_FORM (14u, 5, 0, 0),            /* li     r5, 0 */
+  X_FORM (4, 9, 0, 467),            /* mtctr  r4 */
+  D_FORM (32u, 6, 3, 0),            /* lwz    r6, 0(r3) */
+  D_FORM (15u, 6, 6, -2),           /* addis  r6, r6, -2 */
+  D_FORM (25u, 6, 6, 0x8000),       /* oris   r6, r6, 0x8000 */
+  D_FORM (14u, 3, 3, 4),            /* addi   r3, r3, 4 */
+  X_FORM (5, 5, 6, 266),            /* add    r5, r5, r6 */
+  BC (16u, 0, -5 * 4),              /* bdnz   loop */
+  X_FORM (5, 3, 5, 444),            /* mr     r3, r5 */
+  0x4E800020,                       /* blr */
+};
+
+/*
+ *   kernels:   bl     checksum
+ *              bl     sum
+ *              bl     bias
+ *              blr
+ */
+static const uint32_t entry_code[] = {
+  BL (CHECKSUM_ADDRESS - ENTRY_ADDRESS),
+  BL (SUM_ADDRESS - (ENTRY_ADDRESS + 4)),
+  BL (BIAS_ADDRESS - (ENTRY_ADDRESS + 8)),
+  0x4E800020,
+};
+
+#endif /* __BENCH_KERNELS_H__ */
@@ -0,0 +1,219 @@
+/*
+ * bench_lifted.c -- Lifted code against interpretation of the same PPC code
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+#include "ppc2c_runtime.h"
+#include "bench_kernels.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#define DATA_ADDRESS 0x20000000
+#define DATA_SIZE (1024 * 1024)
+
+/* bench_lifted_code.c, what headless_ppc2c converts the routines of
+ * bench_kernels.h to. "make lifted" converts them again */
+extern const ppc2c_export_t ppc2c_lifted[];
+
+/* Just enough of an interpreter to run the routine */
+static void
+interpret (ppc_context_t *ctx, uint32_t pc)
+{
+  uint64_t *gpr = ctx->gpr;
+
+  for (;;) {
+    uint32_t ins = ppc2c_read32 (pc);
+    uint32_t rt = (ins >> 21) & 0x1F;
+    uint32_t ra = (ins >> 16) & 0x1F;
+    uint32_t rb = (ins >> 11) & 0x1F;
+    int64_t simm = (int16_t) (ins & 0xFFFF);
+
+    pc += 4;
+    switch (ins >> 26) {
+      case 7:
+        gpr[rt] = gpr[ra] * simm;
+        break;
+      case 11:
+        {
+          int32_t a = (int32_t) gpr[ra];
+
+          PPC2C_CR_SET (ctx->cr, rt >> 2, a < simm ? PPC2C_CR_LT :
+              a > simm ? PPC2C_CR_GT : PPC2C_CR_EQ);
+        }
+        break;
+      case 14:
+        gpr[rt] = (ra ? gpr[ra] : 0) + simm;
+        break;
+      case 15:
+        gpr[rt] = (ra ? gpr[ra] : 0) + ((uint64_t) simm << 16);
+        break;
+      case 16:
+        {
+          int taken = 1;
+
+          if ((rt & 0x04) == 0)
+            taken = --ctx->ctr != 0 ? !(rt & 0x02) : (rt & 0x02) != 0;
+          if ((rt & 0x10) == 0)
+            taken = taken && (((ctx->cr >> (31 - ra)) & 1) == ((rt >> 3) & 1));
+          if (taken)
+            pc += (int16_t) (ins & 0xFFFC) - 4;
+        }
+        break;
+      case 19:
+        /* blr */
+        return;
+      case 25:
+        gpr[ra] = gpr[rt] | ((uint64_t) (ins & 0xFFFF) << 16);
+        break;
+      case 31:
+        switch ((ins >> 1) & 0x3FF) {
+          case 266:
+            gpr[rt] = gpr[ra] + gpr[rb];
+            break;
+          case 444:
+            gpr[ra] = gpr[rt] | gpr[rb];
+            break;
+          case 467:
+            ctx->ctr = gpr[rt];
+            break;
+          default:
+            fprintf (stderr, "Unhandled instruction %08X\n", ins);
+            abort ();
+        }
+        break;
+      case 32:
+        gpr[rt] = ppc2c_read32 ((ra ? gpr[ra] : 0) + simm);
+        break;
+      case 34:
+        gpr[rt] = ppc2c_read8 ((ra ? gpr[ra] : 0) + simm);
+        break;
+      default:
+        fprintf (stderr, "Unhandled instruction %08X\n", ins);
+        abort ();
+    }
+  }
+}
+
+static double
+now (void)
+{
+#ifdef _WIN32
+  LARGE_INTEGER counter, frequency;
+
+  QueryPerformanceCounter (&counter);
+  QueryPerformanceFrequency (&frequency);
+  return (double) counter.QuadPart / frequency.QuadPart;
+#else
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+}
+
+typedef struct {
+  const char *name;
+  const uint32_t *code;
+  uint32_t code_size;
+  uint32_t address;
+  uint32_t count; /* r4 */
+} kernel_t;
+
+static const kernel_t kernels[] = {
+  {"checksum", checksum_code, sizeof(checksum_code), CHECKSUM_ADDRESS,
+   DATA_SIZE},
+  {"sum", sum_code, sizeof(sum_code), SUM_ADDRESS, DATA_SIZE / 4},
+  {"bias", bias_code, sizeof(bias_code), BIAS_ADDRESS, DATA_SIZE / 4},
+};
+
+static uint64_t
+run (const kernel_t *kernel, int lifted, int iterations, double *seconds)
+{
+  ppc2c_func_t function = ppc2c_lookup (kernel->address);
+  ppc_context_t ctx;
+  uint64_t result = 0;
+  double start = now ();
+  int i;
+
+  for (i = 0; i < iterations; i++) {
+    ppc2c_init_context (&ctx, 0);
+    ctx.gpr[3] = DATA_ADDRESS;
+    ctx.gpr[4] = kernel->count;
+    if (lifted)
+      function (&ctx);
+    else
+      interpret (&ctx, kernel->address);
+    result += ctx.gpr[3];
+  }
+  *seconds = now () - start;
+  return result / iterations;
+}
+
+int
+main (int argc, char *argv[])
+{
+  int iterations = argc > 1 ? atoi (argv[1]) : 20;
+  double megabytes = DATA_SIZE / 1048576.0;
+  uint32_t i, k;
+
+  if (iterations <= 0 || ppc2c_init () < 0 ||
+      ppc2c_map (CODE_ADDRESS, CODE_SIZE) < 0 ||
+      ppc2c_map (DATA_ADDRESS, DATA_SIZE) < 0)
+    return 1;
+  ppc2c_register_table (ppc2c_lifted);
+
+  srand (1);
+  for (i = 0; i < DATA_SIZE; i++)
+    ppc2c_write8 (DATA_ADDRESS + i, (uint8_t) rand ());
+
+#ifdef PPC2C_PORTABLE_ACCESS
+  printf ("memory access : portable\n");
+#else
+  printf ("memory access : memcpy + byte swap\n");
+#endif
+  for (k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+    const kernel_t *kernel = &kernels[k];
+    double lifted_time, interpreted_time;
+    uint64_t lifted, interpreted;
+
+    if (ppc2c_lookup (kernel->address) == NULL) {
+      fprintf (stderr, "%s isn't in bench_lifted_code.c\n", kernel->name);
+      return 1;
+    }
+    for (i = 0; i < kernel->code_size / 4; i++)
+      ppc2c_write32 (kernel->address + i * 4, kernel->code[i]);
+
+    interpreted = run (kernel, 0, iterations, &interpreted_time);
+    lifted = run (kernel, 1, iterations, &lifted_time);
+
+    if (lifted != interpreted) {
+      fprintf (stderr, "%s mismatch : lifted %016llX, interpreted %016llX\n",
+          kernel->name, (unsigned long long) lifted,
+          (unsigned long long) interpreted);
+      return 1;
+    }
+
+    printf ("%s : %016llX over %d x %d bytes\n", kernel->name,
+        (unsigned long long) lifted, iterations, DATA_SIZE);
+    printf ("  interpreted : %8.3f s %10.1f MB/s\n", interpreted_time,
+        iterations * megabytes / interpreted_time);
+    printf ("  lifted      : %8.3f s %10.1f MB/s\n", lifted_time,
+        iterations * megabytes / lifted_time);
+    printf ("  speedup     : %8.1fx\n", interpreted_time / lifted_time);
+  }
+
+  ppc2c_shutdown ();
+  return 0;
+}
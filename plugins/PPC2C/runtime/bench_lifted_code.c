@@ -0,0 +1,73 @@
+#include "ppc2c_runtime.h"
+
+void kernels (ppc_context_t *ctx);
+void checksum (ppc_context_t *ctx);
+void bias (ppc_context_t *ctx);
+void sum (ppc_context_t *ctx);
+void kernels (ppc_context_t *ctx)
+{
+  PPC2C_ENTER (ctx);
+
+  PPC2C_CALL (ctx, checksum);
+  PPC2C_CALL (ctx, sum);
+  PPC2C_CALL (ctx, bias);
+  PPC2C_RETURN (ctx);
+}
+
+void checksum (ppc_context_t *ctx)
+{
+  PPC2C_ENTER (ctx);
+
+  r5 = 0;
+  if ((int32_t)r4 != 0) {
+    CTR = r4;
+    do {
+      r6 = PPC2C_LD8 (r3);
+      r5 = r5 * 0x1F;
+      r3 = r3 + 1;
+      r5 = r5 + r6;
+    } while (--CTR != 0);
+  }
+  r3 = r5;
+  PPC2C_RETURN (ctx);
+}
+
+void bias (ppc_context_t *ctx)
+{
+  PPC2C_ENTER (ctx);
+
+  r5 = 0;
+  CTR = r4;
+  do {
+    r6 = PPC2C_LD32 (r3);
+    r6 = r6 + ((uint64_t) -2 << 16);
+    r6 = r6 | ((uint64_t) 0x8000 << 16);
+    r3 = r3 + 4;
+    r5 = r5 + r6;
+  } while (--CTR != 0);
+  r3 = r5;
+  PPC2C_RETURN (ctx);
+}
+
+void sum (ppc_context_t *ctx)
+{
+  PPC2C_ENTER (ctx);
+
+  r5 = 0;
+  CTR = r4;
+  do {
+    r6 = PPC2C_LD32 (r3);
+    r3 = r3 + 4;
+    r5 = r5 + r6;
+  } while (--CTR != 0);
+  r3 = r5;
+  PPC2C_RETURN (ctx);
+}
+
+const ppc2c_export_t ppc2c_lifted[] = {
+  {0x00011800, kernels},
+  {0x00010000, checksum},
+  {0x00010800, bias},
+  {0x00011000, sum},
+  {0, NULL}
+};
@@ -0,0 +1,642 @@
+/*
+ * ppc2c_altivec.h -- SSE implementation of the Altivec instructions
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+#ifndef __PPC2C_ALTIVEC_H__
+#define __PPC2C_ALTIVEC_H__
+
+#include "ppc2c_runtime.h"
+
+/* SSE2, SSSE3 (pshufb, palignr) and SSE4.1 (pmovsx, pmin/pmax, round),
+ * build with -msse4.1 or better */
+#include <smmintrin.h>
+#include <math.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * A vector register is kept byte-reversed compared to its big-endian guest
+ * image: loading a quadword swaps all 16 bytes, so every element ends up
+ * byte swapped in place and in the host's native order, but element i of a
+ * vector with n elements lives in host lane n - 1 - i. Element-wise
+ * operations map directly to SSE, the ones picking elements by position
+ * (merges, splats, permutes, packs) flip their indices.
+ */
+typedef union {
+  __m128i v;
+  int8_t sb[16];
+  uint8_t ub[16];
+  int16_t sh[8];
+  uint16_t uh[8];
+  int32_t sw[4];
+  uint32_t uw[4];
+  float f[4];
+} ppc2c_vec_t;
+
+#define PPC2C_VR_GET(ctx, n) _mm_loadu_si128 ((const __m128i *) (ctx)->vr[n].b)
+#define PPC2C_VR_SET(ctx, n, value)                                     \
+  _mm_storeu_si128 ((__m128i *) (ctx)->vr[n].b, value)
+
+/* Float view of a register, and back */
+#define PPC2C_VF(v) _mm_castsi128_ps (v)
+#define PPC2C_VI(v) _mm_castps_si128 (v)
+
+#define PPC2C_VREVERSE                                                  \
+  _mm_set_epi8 (0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15)
+#define PPC2C_VIDENTITY                                                 \
+  _mm_set_epi8 (15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+
+/* Loads and stores. The guest arena is page aligned, so a guest quadword is
+ * host aligned too. Element loads bring in the whole quadword, which leaves
+ * the element where it belongs, the other ones are undefined anyway */
+static inline __m128i
+ppc2c_lvx (uint64_t address)
+{
+  return _mm_shuffle_epi8 (_mm_load_si128 ((const __m128i *)
+          ppc2c_host (address & ~15ull)), PPC2C_VREVERSE);
+}
+
+static inline void
+ppc2c_stvx (uint64_t address, __m128i value)
+{
+  _mm_store_si128 ((__m128i *) ppc2c_host (address & ~15ull),
+      _mm_shuffle_epi8 (value, PPC2C_VREVERSE));
+}
+
+static inline void
+ppc2c_stvebx (uint64_t address, __m128i value)
+{
+  ppc2c_vec_t u;
+
+  u.v = value;
+  ppc2c_write8 (address, u.ub[15 - (address & 15)]);
+}
+
+static inline void
+ppc2c_stvehx (uint64_t address, __m128i value)
+{
+  ppc2c_vec_t u;
+
+  u.v = value;
+  PPC2C_ST16 (address & ~1ull, u.uh[7 - ((address >> 1) & 7)]);
+}
+
+static inline void
+ppc2c_stvewx (uint64_t address, __m128i value)
+{
+  ppc2c_vec_t u;
+
+  u.v = value;
+  PPC2C_ST32 (address & ~3ull, u.uw[3 - ((address >> 2) & 3)]);
+}
+
+/* Permute controls for realigning misaligned data with vperm */
+static inline __m128i
+ppc2c_lvsl (uint64_t address)
+{
+  return _mm_add_epi8 (PPC2C_VREVERSE, _mm_set1_epi8 ((char) (address & 15)));
+}
+
+static inline __m128i
+ppc2c_lvsr (uint64_t address)
+{
+  return _mm_add_epi8 (PPC2C_VREVERSE,
+      _mm_set1_epi8 ((char) (16 - (address & 15))));
+}
+
+/* Shifts by a variable number of bytes, towards element 0 or away from it,
+ * filling with zeroes */
+static inline __m128i
+ppc2c_vshift_left_bytes (__m128i v, unsigned int n)
+{
+  /* Host lanes below n go negative, which pshufb clears */
+  return _mm_shuffle_epi8 (v,
+      _mm_sub_epi8 (PPC2C_VIDENTITY, _mm_set1_epi8 ((char) n)));
+}
+
+static inline __m128i
+ppc2c_vshift_right_bytes (__m128i v, unsigned int n)
+{
+  __m128i index = _mm_add_epi8 (PPC2C_VIDENTITY, _mm_set1_epi8 ((char) n));
+
+  return _mm_shuffle_epi8 (v,
+      _mm_or_si128 (index, _mm_cmpgt_epi8 (index, _mm_set1_epi8 (15))));
+}
+
+/* Cell's unaligned accesses: the left part goes from the address to the end
+ * of its quadword, the right part is what comes before the address */
+static inline __m128i
+ppc2c_lvlx (uint64_t address)
+{
+  return ppc2c_vshift_left_bytes (ppc2c_lvx (address), address & 15);
+}
+
+static inline __m128i
+ppc2c_lvrx (uint64_t address)
+{
+  if ((address & 15) == 0)
+    return _mm_setzero_si128 ();
+  return ppc2c_vshift_right_bytes (ppc2c_lvx (address), 16 - (address & 15));
+}
+
+static inline void
+ppc2c_stvlx (uint64_t address, __m128i value)
+{
+  ppc2c_vec_t u;
+  unsigned int i;
+
+  u.v = value;
+  for (i = 0; i < 16 - (address & 15); i++)
+    ppc2c_write8 (address + i, u.ub[15 - i]);
+}
+
+static inline void
+ppc2c_stvrx (uint64_t address, __m128i value)
+{
+  ppc2c_vec_t u;
+  unsigned int i, n = address & 15;
+
+  u.v = value;
+  for (i = 0; i < n; i++)
+    ppc2c_write8 ((address & ~15ull) + i, u.ub[n - 1 - i]);
+}
+
+static inline __m128i
+ppc2c_vperm (__m128i a, __m128i b, __m128i c)
+{
+  /* Guest byte k of a is host byte 15 - k, same for b with k - 16 */
+  __m128i index = _mm_andnot_si128 (c, _mm_set1_epi8 (15));
+  __m128i from_b = _mm_cmpeq_epi8 (_mm_and_si128 (c, _mm_set1_epi8 (16)),
+      _mm_set1_epi8 (16));
+
+  return _mm_blendv_epi8 (_mm_shuffle_epi8 (a, index),
+      _mm_shuffle_epi8 (b, index), from_b);
+}
+
+/* Whole register shifts, by the bits or octets given in the last byte of b */
+static inline __m128i
+ppc2c_vsl (__m128i a, __m128i b)
+{
+  __m128i count = _mm_and_si128 (b, _mm_cvtsi32_si128 (7));
+  __m128i carry = _mm_srl_epi64 (_mm_slli_si128 (a, 8),
+      _mm_sub_epi64 (_mm_cvtsi32_si128 (64), count));
+
+  return _mm_or_si128 (_mm_sll_epi64 (a, count), carry);
+}
+
+static inline __m128i
+ppc2c_vsr (__m128i a, __m128i b)
+{
+  __m128i count = _mm_and_si128 (b, _mm_cvtsi32_si128 (7));
+  __m128i carry = _mm_sll_epi64 (_mm_srli_si128 (a, 8),
+      _mm_sub_epi64 (_mm_cvtsi32_si128 (64), count));
+
+  return _mm_or_si128 (_mm_srl_epi64 (a, count), carry);
+}
+
+static inline __m128i
+ppc2c_vslo (__m128i a, __m128i b)
+{
+  return ppc2c_vshift_left_bytes (a, (_mm_cvtsi128_si32 (b) >> 3) & 15);
+}
+
+static inline __m128i
+ppc2c_vsro (__m128i a, __m128i b)
+{
+  return ppc2c_vshift_right_bytes (a, (_mm_cvtsi128_si32 (b) >> 3) & 15);
+}
+
+/* Element-wise operations without an SSE equivalent. Elements of a and b
+ * share their lanes, so these don't care about the lane order */
+#define PPC2C_VLOOP(name, field, count, expr)                           \
+static inline __m128i                                                   \
+name (__m128i va, __m128i vb)                                           \
+{                                                                       \
+  ppc2c_vec_t a, b, d;                                                  \
+  int i;                                                                \
+                                                                        \
+  a.v = va;                                                             \
+  b.v = vb;                                                             \
+  for (i = 0; i < count; i++)                                           \
+    d.field[i] = (expr);                                                \
+  return d.v;                                                           \
+}
+
+#define PPC2C_SAT(value, min, max)                                      \
+  ((value) < (min) ? (min) : (value) > (max) ? (max) : (value))
+
+PPC2C_VLOOP (ppc2c_vaddsws, sw, 4,
+    (int32_t) PPC2C_SAT ((int64_t) a.sw[i] + b.sw[i], INT32_MIN, INT32_MAX))
+PPC2C_VLOOP (ppc2c_vadduws, uw, 4,
+    (uint32_t) PPC2C_SAT ((uint64_t) a.uw[i] + b.uw[i], 0, UINT32_MAX))
+PPC2C_VLOOP (ppc2c_vaddcuw, uw, 4, ((uint64_t) a.uw[i] + b.uw[i]) >> 32)
+PPC2C_VLOOP (ppc2c_vsubsws, sw, 4,
+    (int32_t) PPC2C_SAT ((int64_t) a.sw[i] - b.sw[i], INT32_MIN, INT32_MAX))
+PPC2C_VLOOP (ppc2c_vsubuws, uw, 4, a.uw[i] > b.uw[i] ? a.uw[i] - b.uw[i] : 0)
+PPC2C_VLOOP (ppc2c_vsubcuw, uw, 4, a.uw[i] >= b.uw[i])
+PPC2C_VLOOP (ppc2c_vavgsw, sw, 4,
+    (int32_t) (((int64_t) a.sw[i] + b.sw[i] + 1) >> 1))
+PPC2C_VLOOP (ppc2c_vavguw, uw, 4,
+    (uint32_t) (((uint64_t) a.uw[i] + b.uw[i] + 1) >> 1))
+
+/* Shift counts are taken modulo the element size */
+PPC2C_VLOOP (ppc2c_vslb, ub, 16, (uint8_t) (a.ub[i] << (b.ub[i] & 7)))
+PPC2C_VLOOP (ppc2c_vslh, uh, 8, (uint16_t) (a.uh[i] << (b.uh[i] & 15)))
+PPC2C_VLOOP (ppc2c_vslw, uw, 4, a.uw[i] << (b.uw[i] & 31))
+PPC2C_VLOOP (ppc2c_vsrb, ub, 16, a.ub[i] >> (b.ub[i] & 7))
+PPC2C_VLOOP (ppc2c_vsrh, uh, 8, a.uh[i] >> (b.uh[i] & 15))
+PPC2C_VLOOP (ppc2c_vsrw, uw, 4, a.uw[i] >> (b.uw[i] & 31))
+PPC2C_VLOOP (ppc2c_vsrab, sb, 16, a.sb[i] >> (b.ub[i] & 7))
+PPC2C_VLOOP (ppc2c_vsrah, sh, 8, a.sh[i] >> (b.uh[i] & 15))
+PPC2C_VLOOP (ppc2c_vsraw, sw, 4, a.sw[i] >> (b.uw[i] & 31))
+PPC2C_VLOOP (ppc2c_vrlb, ub, 16, (uint8_t) ((a.ub[i] << (b.ub[i] & 7)) |
+        (a.ub[i] >> ((8 - (b.ub[i] & 7)) & 7))))
+PPC2C_VLOOP (ppc2c_vrlh, uh, 8, (uint16_t) ((a.uh[i] << (b.uh[i] & 15)) |
+        (a.uh[i] >> ((16 - (b.uh[i] & 15)) & 15))))
+PPC2C_VLOOP (ppc2c_vrlw, uw, 4, (a.uw[i] << (b.uw[i] & 31)) |
+    (a.uw[i] >> ((32 - (b.uw[i] & 31)) & 31)))
+
+/* Products of the even or odd elements, which are the odd or even host
+ * lanes */
+PPC2C_VLOOP (ppc2c_vmuleub, uh, 8, (uint16_t) (a.ub[2 * i + 1] * b.ub[2 * i + 1]))
+PPC2C_VLOOP (ppc2c_vmuloub, uh, 8, (uint16_t) (a.ub[2 * i] * b.ub[2 * i]))
+PPC2C_VLOOP (ppc2c_vmulesb, sh, 8, (int16_t) (a.sb[2 * i + 1] * b.sb[2 * i + 1]))
+PPC2C_VLOOP (ppc2c_vmulosb, sh, 8, (int16_t) (a.sb[2 * i] * b.sb[2 * i]))
+
+static inline __m128i
+ppc2c_vmuleuh (__m128i a, __m128i b)
+{
+  return _mm_blend_epi16 (_mm_srli_epi32 (_mm_mullo_epi16 (a, b), 16),
+      _mm_mulhi_epu16 (a, b), 0xAA);
+}
+
+static inline __m128i
+ppc2c_vmulouh (__m128i a, __m128i b)
+{
+  return _mm_blend_epi16 (_mm_mullo_epi16 (a, b),
+      _mm_slli_epi32 (_mm_mulhi_epu16 (a, b), 16), 0xAA);
+}
+
+static inline __m128i
+ppc2c_vmulesh (__m128i a, __m128i b)
+{
+  return _mm_blend_epi16 (_mm_srli_epi32 (_mm_mullo_epi16 (a, b), 16),
+      _mm_mulhi_epi16 (a, b), 0xAA);
+}
+
+static inline __m128i
+ppc2c_vmulosh (__m128i a, __m128i b)
+{
+  return _mm_blend_epi16 (_mm_mullo_epi16 (a, b),
+      _mm_slli_epi32 (_mm_mulhi_epi16 (a, b), 16), 0xAA);
+}
+
+static inline __m128i
+ppc2c_vavgsb (__m128i a, __m128i b)
+{
+  __m128i bias = _mm_set1_epi8 ((char) 0x80);
+
+  return _mm_xor_si128 (_mm_avg_epu8 (_mm_xor_si128 (a, bias),
+          _mm_xor_si128 (b, bias)), bias);
+}
+
+static inline __m128i
+ppc2c_vavgsh (__m128i a, __m128i b)
+{
+  __m128i bias = _mm_set1_epi16 ((short) 0x8000);
+
+  return _mm_xor_si128 (_mm_avg_epu16 (_mm_xor_si128 (a, bias),
+          _mm_xor_si128 (b, bias)), bias);
+}
+
+/* Unsigned compares, by moving both sides to the signed range */
+static inline __m128i
+ppc2c_vcmpgtub (__m128i a, __m128i b)
+{
+  __m128i bias = _mm_set1_epi8 ((char) 0x80);
+
+  return _mm_cmpgt_epi8 (_mm_xor_si128 (a, bias), _mm_xor_si128 (b, bias));
+}
+
+static inline __m128i
+ppc2c_vcmpgtuh (__m128i a, __m128i b)
+{
+  __m128i bias = _mm_set1_epi16 ((short) 0x8000);
+
+  return _mm_cmpgt_epi16 (_mm_xor_si128 (a, bias), _mm_xor_si128 (b, bias));
+}
+
+static inline __m128i
+ppc2c_vcmpgtuw (__m128i a, __m128i b)
+{
+  __m128i bias = _mm_set1_epi32 ((int) 0x80000000);
+
+  return _mm_cmpgt_epi32 (_mm_xor_si128 (a, bias), _mm_xor_si128 (b, bias));
+}
+
+static inline __m128i
+ppc2c_vcmpbfp (__m128i a, __m128i b)
+{
+  __m128 fa = PPC2C_VF (a);
+  __m128 fb = PPC2C_VF (b);
+  __m128 above = _mm_cmpnle_ps (fa, fb);
+  __m128 below = _mm_cmpnge_ps (fa, _mm_sub_ps (_mm_setzero_ps (), fb));
+
+  return _mm_or_si128 (
+      _mm_and_si128 (PPC2C_VI (above), _mm_set1_epi32 ((int) 0x80000000)),
+      _mm_and_si128 (PPC2C_VI (below), _mm_set1_epi32 (0x40000000)));
+}
+
+/* CR6 of the record forms of the compares: all true or all false */
+static inline uint32_t
+ppc2c_vcmp_cr6 (__m128i result)
+{
+  int mask = _mm_movemask_epi8 (result);
+
+  return mask == 0xFFFF ? PPC2C_CR_LT : mask == 0 ? PPC2C_CR_EQ : 0;
+}
+
+/* Conversions, with the fixed point scaled by 2^shift */
+static inline __m128i
+ppc2c_vcfux (__m128i b, int shift)
+{
+  __m128 high = _mm_cvtepi32_ps (_mm_srli_epi32 (b, 16));
+  __m128 low = _mm_cvtepi32_ps (_mm_and_si128 (b, _mm_set1_epi32 (0xFFFF)));
+  __m128 value = _mm_add_ps (_mm_mul_ps (high, _mm_set1_ps (65536.0f)), low);
+
+  return PPC2C_VI (_mm_mul_ps (value, _mm_set1_ps (1.0f / (1u << shift))));
+}
+
+static inline __m128i
+ppc2c_vctsxs (__m128i b, int shift)
+{
+  __m128 value = _mm_mul_ps (PPC2C_VF (b), _mm_set1_ps ((float) (1u << shift)));
+  __m128i result = _mm_cvttps_epi32 (value);
+
+  /* Positive overflow gives 0x80000000 like negative one, flip it to
+   * 0x7FFFFFFF, and NaNs become 0 */
+  result = _mm_xor_si128 (result,
+      PPC2C_VI (_mm_cmpge_ps (value, _mm_set1_ps (2147483648.0f))));
+  return _mm_and_si128 (result, PPC2C_VI (_mm_cmpord_ps (value, value)));
+}
+
+static inline __m128i
+ppc2c_vctuxs (__m128i vb, int shift)
+{
+  ppc2c_vec_t b, d;
+  int i;
+
+  b.v = vb;
+  for (i = 0; i < 4; i++) {
+    float value = b.f[i] * (float) (1u << shift);
+
+    if (!(value > 0.0f))
+      d.uw[i] = 0;
+    else if (value >= 4294967296.0f)
+      d.uw[i] = 0xFFFFFFFF;
+    else
+      d.uw[i] = (uint32_t) value;
+  }
+  return d.v;
+}
+
+static inline __m128i
+ppc2c_vexptefp (__m128i vb)
+{
+  ppc2c_vec_t b, d;
+  int i;
+
+  b.v = vb;
+  for (i = 0; i < 4; i++)
+    d.f[i] = exp2f (b.f[i]);
+  return d.v;
+}
+
+static inline __m128i
+ppc2c_vlogefp (__m128i vb)
+{
+  ppc2c_vec_t b, d;
+  int i;
+
+  b.v = vb;
+  for (i = 0; i < 4; i++)
+    d.f[i] = log2f (b.f[i]);
+  return d.v;
+}
+
+/* Multiply-high-and-add, with and without rounding */
+static inline __m128i
+ppc2c_vmhaddshs (__m128i va, __m128i vb, __m128i vc)
+{
+  ppc2c_vec_t a, b, c, d;
+  int i;
+
+  a.v = va; b.v = vb; c.v = vc;
+  for (i = 0; i < 8; i++) {
+    int32_t value = ((a.sh[i] * b.sh[i]) >> 15) + c.sh[i];
+    d.sh[i] = (int16_t) PPC2C_SAT (value, INT16_MIN, INT16_MAX);
+  }
+  return d.v;
+}
+
+static inline __m128i
+ppc2c_vmhraddshs (__m128i va, __m128i vb, __m128i vc)
+{
+  ppc2c_vec_t a, b, c, d;
+  int i;
+
+  a.v = va; b.v = vb; c.v = vc;
+  for (i = 0; i < 8; i++) {
+    int32_t value = ((a.sh[i] * b.sh[i] + 0x4000) >> 15) + c.sh[i];
+    d.sh[i] = (int16_t) PPC2C_SAT (value, INT16_MIN, INT16_MAX);
+  }
+  return d.v;
+}
+
+/* Multiply-sums, each word adds the products of the elements it holds */
+static inline __m128i
+ppc2c_vmsumubm (__m128i a, __m128i b, __m128i c)
+{
+  /* Widened to halfwords, the products fit pmaddwd's signed inputs */
+  __m128i mask = _mm_set1_epi16 (0xFF);
+  __m128i even = _mm_madd_epi16 (_mm_and_si128 (a, mask),
+      _mm_and_si128 (b, mask));
+  __m128i odd = _mm_madd_epi16 (_mm_srli_epi16 (a, 8), _mm_srli_epi16 (b, 8));
+
+  return _mm_add_epi32 (_mm_add_epi32 (even, odd), c);
+}
+
+static inline __m128i
+ppc2c_vmsummbm (__m128i a, __m128i b, __m128i c)
+{
+  __m128i mask = _mm_set1_epi16 (0xFF);
+  __m128i even = _mm_madd_epi16 (_mm_srai_epi16 (_mm_slli_epi16 (a, 8), 8),
+      _mm_and_si128 (b, mask));
+  __m128i odd = _mm_madd_epi16 (_mm_srai_epi16 (a, 8), _mm_srli_epi16 (b, 8));
+
+  return _mm_add_epi32 (_mm_add_epi32 (even, odd), c);
+}
+
+static inline __m128i
+ppc2c_vmsumuhm (__m128i va, __m128i vb, __m128i vc)
+{
+  ppc2c_vec_t a, b, c, d;
+  int i;
+
+  a.v = va; b.v = vb; c.v = vc;
+  for (i = 0; i < 4; i++)
+    d.uw[i] = (uint32_t) a.uh[2 * i] * b.uh[2 * i] +
+        (uint32_t) a.uh[2 * i + 1] * b.uh[2 * i + 1] + c.uw[i];
+  return d.v;
+}
+
+static inline __m128i
+ppc2c_vmsumuhs (__m128i va, __m128i vb, __m128i vc)
+{
+  ppc2c_vec_t a, b, c, d;
+  int i;
+
+  a.v = va; b.v = vb; c.v = vc;
+  for (i = 0; i < 4; i++) {
+    uint64_t value = (uint64_t) a.uh[2 * i] * b.uh[2 * i] +
+        (uint64_t) a.uh[2 * i + 1] * b.uh[2 * i + 1] + c.uw[i];
+    d.uw[i] = (uint32_t) PPC2C_SAT (value, 0, UINT32_MAX);
+  }
+  return d.v;
+}
+
+static inline __m128i
+ppc2c_vmsumshs (__m128i va, __m128i vb, __m128i vc)
+{
+  ppc2c_vec_t a, b, c, d;
+  int i;
+
+  a.v = va; b.v = vb; c.v = vc;
+  for (i = 0; i < 4; i++) {
+    int64_t value = (int64_t) a.sh[2 * i] * b.sh[2 * i] +
+        (int64_t) a.sh[2 * i + 1] * b.sh[2 * i + 1] + c.sw[i];
+    d.sw[i] = (int32_t) PPC2C_SAT (value, INT32_MIN, INT32_MAX);
+  }
+  return d.v;
+}
+
+/* Sums across. vsumsws leaves its result in word 3, vsum2sws in words 1
+ * and 3, which are host lanes 0 and 2 */
+static inline __m128i
+ppc2c_vsumsws (__m128i va, __m128i vb)
+{
+  ppc2c_vec_t a, b, d;
+  int64_t value;
+
+  a.v = va; b.v = vb;
+  value = (int64_t) a.sw[0] + a.sw[1] + a.sw[2] + a.sw[3] + b.sw[0];
+  d.v = _mm_setzero_si128 ();
+  d.sw[0] = (int32_t) PPC2C_SAT (value, INT32_MIN, INT32_MAX);
+  return d.v;
+}
+
+static inline __m128i
+ppc2c_vsum2sws (__m128i va, __m128i vb)
+{
+  ppc2c_vec_t a, b, d;
+  int i;
+
+  a.v = va; b.v = vb;
+  d.v = _mm_setzero_si128 ();
+  for (i = 0; i < 4; i += 2) {
+    int64_t value = (int64_t) a.sw[i] + a.sw[i + 1] + b.sw[i];
+    d.sw[i] = (int32_t) PPC2C_SAT (value, INT32_MIN, INT32_MAX);
+  }
+  return d.v;
+}
+
+PPC2C_VLOOP (ppc2c_vsum4ubs, uw, 4, (uint32_t) PPC2C_SAT ((uint64_t)
+        a.ub[4 * i] + a.ub[4 * i + 1] + a.ub[4 * i + 2] + a.ub[4 * i + 3] +
+        b.uw[i], 0, UINT32_MAX))
+PPC2C_VLOOP (ppc2c_vsum4sbs, sw, 4, (int32_t) PPC2C_SAT ((int64_t)
+        a.sb[4 * i] + a.sb[4 * i + 1] + a.sb[4 * i + 2] + a.sb[4 * i + 3] +
+        b.sw[i], INT32_MIN, INT32_MAX))
+PPC2C_VLOOP (ppc2c_vsum4shs, sw, 4, (int32_t) PPC2C_SAT ((int64_t)
+        a.sh[2 * i] + a.sh[2 * i + 1] + b.sw[i], INT32_MIN, INT32_MAX))
+
+/* Packs, a providing the first guest elements, which are the upper host
+ * lanes, hence the swapped operands */
+static inline __m128i
+ppc2c_vpkuhum (__m128i a, __m128i b)
+{
+  __m128i mask = _mm_set1_epi16 (0xFF);
+
+  return _mm_packus_epi16 (_mm_and_si128 (b, mask), _mm_and_si128 (a, mask));
+}
+
+static inline __m128i
+ppc2c_vpkuwum (__m128i a, __m128i b)
+{
+  __m128i mask = _mm_set1_epi32 (0xFFFF);
+
+  return _mm_packus_epi32 (_mm_and_si128 (b, mask), _mm_and_si128 (a, mask));
+}
+
+static inline __m128i
+ppc2c_vpkuhus (__m128i a, __m128i b)
+{
+  __m128i max = _mm_set1_epi16 (0xFF);
+
+  return _mm_packus_epi16 (_mm_min_epu16 (b, max), _mm_min_epu16 (a, max));
+}
+
+static inline __m128i
+ppc2c_vpkuwus (__m128i a, __m128i b)
+{
+  __m128i max = _mm_set1_epi32 (0xFFFF);
+
+  return _mm_packus_epi32 (_mm_min_epu32 (b, max), _mm_min_epu32 (a, max));
+}
+
+static inline __m128i
+ppc2c_vpkpx (__m128i va, __m128i vb)
+{
+  ppc2c_vec_t a, b, d;
+  int i;
+
+  a.v = va; b.v = vb;
+  for (i = 0; i < 8; i++) {
+    uint32_t w = i < 4 ? b.uw[i] : a.uw[i - 4];
+    d.uh[i] = (uint16_t) (((w >> 9) & 0x8000) | ((w >> 9) & 0x7C00) |
+        ((w >> 6) & 0x03E0) | ((w >> 3) & 0x001F));
+  }
+  return d.v;
+}
+
+/* Pixel unpacks, the high half being the upper host lanes */
+static inline __m128i
+ppc2c_vupkpx (__m128i vb, int high)
+{
+  ppc2c_vec_t b, d;
+  int i;
+
+  b.v = vb;
+  for (i = 0; i < 4; i++) {
+    uint16_t p = b.uh[i + (high ? 4 : 0)];
+    d.uw[i] = ((p & 0x8000) ? 0xFF000000 : 0) | ((p & 0x7C00) << 6) |
+        ((p & 0x03E0) << 3) | (p & 0x001F);
+  }
+  return d.v;
+}
+
+#define ppc2c_vupkhpx(b) ppc2c_vupkpx (b, 1)
+#define ppc2c_vupklpx(b) ppc2c_vupkpx (b, 0)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PPC2C_ALTIVEC_H__ */
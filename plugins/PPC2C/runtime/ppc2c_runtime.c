@@ -0,0 +1,254 @@
+/*
+ * ppc2c_runtime.c -- Runtime for C code generated by the PPC to C converter
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+#include "ppc2c_runtime.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#define ARENA_SIZE 0x100000000ULL
+#define IMAGE_MAGIC "PPC2CIMG"
+#define IMAGE_VERSION 1
+
+uint8_t *ppc2c_memory = NULL;
+
+/* Guest address to host function, open addressing with linear probing */
+typedef struct {
+  uint32_t address;
+  ppc2c_func_t function;
+} function_slot_t;
+
+static function_slot_t *functions = NULL;
+static uint32_t functions_size = 0;
+static uint32_t functions_count = 0;
+
+static void default_unresolved (ppc_context_t *ctx, uint32_t address);
+static void (*unresolved_handler) (ppc_context_t *, uint32_t) = default_unresolved;
+
+int
+ppc2c_init (void)
+{
+  if (ppc2c_memory != NULL)
+    return 0;
+
+#ifdef _WIN32
+  ppc2c_memory = (uint8_t *) VirtualAlloc (NULL, ARENA_SIZE, MEM_RESERVE,
+      PAGE_NOACCESS);
+#else
+  ppc2c_memory = (uint8_t *) mmap (NULL, ARENA_SIZE, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (ppc2c_memory == (uint8_t *) MAP_FAILED)
+    ppc2c_memory = NULL;
+#endif
+  if (ppc2c_memory == NULL) {
+    fprintf (stderr, "ppc2c: can't reserve the guest address space\n");
+    return -1;
+  }
+
+  return ppc2c_map (PPC2C_STACK_BASE, PPC2C_STACK_SIZE);
+}
+
+void
+ppc2c_shutdown (void)
+{
+  if (ppc2c_memory != NULL) {
+#ifdef _WIN32
+    VirtualFree (ppc2c_memory, 0, MEM_RELEASE);
+#else
+    munmap (ppc2c_memory, ARENA_SIZE);
+#endif
+  }
+  ppc2c_memory = NULL;
+  free (functions);
+  functions = NULL;
+  functions_size = functions_count = 0;
+}
+
+/* Make a range of the guest address space usable. The whole arena is already
+ * readable and writable with lazily allocated pages, except on Windows */
+int
+ppc2c_map (uint32_t address, uint32_t size)
+{
+  if (ppc2c_memory == NULL || (uint64_t) address + size > ARENA_SIZE)
+    return -1;
+#ifdef _WIN32
+  if (VirtualAlloc (ppc2c_memory + address, size, MEM_COMMIT,
+          PAGE_READWRITE) == NULL)
+    return -1;
+#endif
+  return 0;
+}
+
+static uint32_t
+read_be32 (const uint8_t *p)
+{
+  return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) |
+      ((uint32_t) p[2] << 8) | p[3];
+}
+
+/* The image written by the plugin: "PPC2CIMG", version and segment count,
+ * then for each segment its address, size and contents, all big-endian */
+int
+ppc2c_load_image (const char *path)
+{
+  uint8_t header[16];
+  uint32_t count, i;
+  FILE *f;
+
+  if (ppc2c_init () < 0)
+    return -1;
+
+  f = fopen (path, "rb");
+  if (f == NULL) {
+    fprintf (stderr, "ppc2c: can't open image %s\n", path);
+    return -1;
+  }
+  if (fread (header, 1, sizeof(header), f) != sizeof(header) ||
+      memcmp (header, IMAGE_MAGIC, 8) != 0 ||
+      read_be32 (header + 8) != IMAGE_VERSION) {
+    fprintf (stderr, "ppc2c: %s is not a PPC2C memory image\n", path);
+    fclose (f);
+    return -1;
+  }
+
+  count = read_be32 (header + 12);
+  for (i = 0; i < count; i++) {
+    uint8_t segment[8];
+    uint32_t address, size;
+
+    if (fread (segment, 1, sizeof(segment), f) != sizeof(segment))
+      break;
+    address = read_be32 (segment);
+    size = read_be32 (segment + 4);
+    if (ppc2c_map (address, size) < 0 ||
+        fread (ppc2c_memory + address, 1, size, f) != size)
+      break;
+  }
+  fclose (f);
+
+  if (i != count) {
+    fprintf (stderr, "ppc2c: image %s is truncated\n", path);
+    return -1;
+  }
+  return 0;
+}
+
+void
+ppc2c_init_context (ppc_context_t *ctx, uint32_t toc)
+{
+  memset (ctx, 0, sizeof(*ctx));
+  /* Leave room for the back chain and the callee's parameter save area */
+  ctx->gpr[1] = PPC2C_STACK_BASE + PPC2C_STACK_SIZE - 0x100;
+  ctx->gpr[2] = toc;
+  ctx->vscr = 0x00010000; /* Non-Java mode */
+}
+
+static uint32_t
+function_hash (uint32_t address)
+{
+  /* Code addresses are word aligned */
+  return (address >> 2) * 2654435761u;
+}
+
+static void
+insert_function (uint32_t address, ppc2c_func_t function)
+{
+  uint32_t i = function_hash (address) & (functions_size - 1);
+
+  while (functions[i].function != NULL && functions[i].address != address)
+    i = (i + 1) & (functions_size - 1);
+  if (functions[i].function == NULL)
+    functions_count++;
+  functions[i].address = address;
+  functions[i].function = function;
+}
+
+void
+ppc2c_register (uint32_t address, ppc2c_func_t function)
+{
+  if (function == NULL)
+    return;
+
+  /* Keep the table at most half full */
+  if ((functions_count + 1) * 2 > functions_size) {
+    function_slot_t *old = functions;
+    uint32_t old_size = functions_size, i;
+
+    functions_size = functions_size ? functions_size * 2 : 256;
+    functions = (function_slot_t *) calloc (functions_size, sizeof(function_slot_t));
+    if (functions == NULL) {
+      fprintf (stderr, "ppc2c: out of memory\n");
+      abort ();
+    }
+    functions_count = 0;
+    for (i = 0; i < old_size; i++)
+      if (old[i].function != NULL)
+        insert_function (old[i].address, old[i].function);
+    free (old);
+  }
+  insert_function (address, function);
+}
+
+void
+ppc2c_register_table (const ppc2c_export_t *table)
+{
+  for (; table->function != NULL; table++)
+    ppc2c_register (table->address, table->function);
+}
+
+ppc2c_func_t
+ppc2c_lookup (uint32_t address)
+{
+  uint32_t i;
+
+  if (functions_size == 0)
+    return NULL;
+
+  i = function_hash (address) & (functions_size - 1);
+  while (functions[i].function != NULL) {
+    if (functions[i].address == address)
+      return functions[i].function;
+    i = (i + 1) & (functions_size - 1);
+  }
+  return NULL;
+}
+
+static void
+default_unresolved (ppc_context_t *ctx, uint32_t address)
+{
+  fprintf (stderr, "ppc2c: call to unknown guest function 0x%08X (LR 0x%08X)\n",
+      address, (uint32_t) ctx->lr);
+  abort ();
+}
+
+void
+ppc2c_set_unresolved_handler (void (*handler) (ppc_context_t *ctx,
+        uint32_t address))
+{
+  unresolved_handler = handler ? handler : default_unresolved;
+}
+
+void
+ppc2c_call_indirect (ppc_context_t *ctx, uint64_t address)
+{
+  ppc2c_func_t function = ppc2c_lookup ((uint32_t) address);
+
+  if (function != NULL)
+    function (ctx);
+  else
+    unresolved_handler (ctx, (uint32_t) address);
+}
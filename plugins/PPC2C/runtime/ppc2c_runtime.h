@@ -0,0 +1,344 @@
+/*
+ * ppc2c_runtime.h -- Runtime for C code generated by the PPC to C converter
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+#ifndef __PPC2C_RUNTIME_H__
+#define __PPC2C_RUNTIME_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* A vector register, in the lane order of ppc2c_altivec.h */
+typedef struct {
+  uint8_t b[16];
+} ppc2c_vr_t;
+
+/* The guest register file. Lifted functions keep registers in locals and
+ * only go through this structure when calling or returning */
+typedef struct {
+  uint64_t gpr[32];
+  double fpr[32];
+  uint64_t lr;
+  uint64_t ctr;
+  uint32_t cr;
+  uint32_t xer;
+  ppc2c_vr_t vr[32];
+  uint32_t vscr;
+} ppc_context_t;
+
+typedef void (*ppc2c_func_t) (ppc_context_t *ctx);
+
+typedef struct {
+  uint32_t address;
+  ppc2c_func_t function;
+} ppc2c_export_t;
+
+/* Guest memory is a single 4GB reservation, a guest address is an offset
+ * into it. Its contents are big-endian, like on the PS3 */
+extern uint8_t *ppc2c_memory;
+
+#define PPC2C_STACK_BASE 0xD0000000
+#define PPC2C_STACK_SIZE 0x00100000
+
+int ppc2c_init (void);
+void ppc2c_shutdown (void);
+int ppc2c_map (uint32_t address, uint32_t size);
+int ppc2c_load_image (const char *path);
+void ppc2c_init_context (ppc_context_t *ctx, uint32_t toc);
+
+static inline uint8_t *
+ppc2c_host (uint64_t address)
+{
+  return ppc2c_memory + (uint32_t) address;
+}
+
+static inline uint8_t
+ppc2c_read8 (uint64_t address)
+{
+  return ppc2c_host (address)[0];
+}
+
+static inline uint16_t
+ppc2c_read16 (uint64_t address)
+{
+  uint8_t *p = ppc2c_host (address);
+  return (uint16_t) ((p[0] << 8) | p[1]);
+}
+
+static inline uint32_t
+ppc2c_read32 (uint64_t address)
+{
+  uint8_t *p = ppc2c_host (address);
+  return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) |
+      ((uint32_t) p[2] << 8) | p[3];
+}
+
+static inline uint64_t
+ppc2c_read64 (uint64_t address)
+{
+  return ((uint64_t) ppc2c_read32 (address) << 32) | ppc2c_read32 (address + 4);
+}
+
+static inline void
+ppc2c_write8 (uint64_t address, uint8_t value)
+{
+  ppc2c_host (address)[0] = value;
+}
+
+static inline void
+ppc2c_write16 (uint64_t address, uint16_t value)
+{
+  uint8_t *p = ppc2c_host (address);
+  p[0] = (uint8_t) (value >> 8);
+  p[1] = (uint8_t) value;
+}
+
+static inline void
+ppc2c_write32 (uint64_t address, uint32_t value)
+{
+  uint8_t *p = ppc2c_host (address);
+  p[0] = (uint8_t) (value >> 24);
+  p[1] = (uint8_t) (value >> 16);
+  p[2] = (uint8_t) (value >> 8);
+  p[3] = (uint8_t) value;
+}
+
+static inline void
+ppc2c_write64 (uint64_t address, uint64_t value)
+{
+  ppc2c_write32 (address, (uint32_t) (value >> 32));
+  ppc2c_write32 (address + 4, (uint32_t) value);
+}
+
+/*
+ * Loads and stores of the generated code. Build with :
+ *   PPC2C_PORTABLE_ACCESS  byte by byte accesses, for any compiler
+ *   PPC2C_HOST_BIG_ENDIAN  no byte swapping, for big-endian hosts
+ * Otherwise the value is copied with memcpy, which is safe for unaligned
+ * addresses, and swapped with the compiler's builtin, the pair compiling to
+ * a single load and bswap (or movbe).
+ */
+#if defined(PPC2C_PORTABLE_ACCESS)
+
+#define PPC2C_LD8(a) ppc2c_read8 (a)
+#define PPC2C_LD16(a) ppc2c_read16 (a)
+#define PPC2C_LD32(a) ppc2c_read32 (a)
+#define PPC2C_LD64(a) ppc2c_read64 (a)
+#define PPC2C_ST8(a, v) ppc2c_write8 (a, (uint8_t) (v))
+#define PPC2C_ST16(a, v) ppc2c_write16 (a, (uint16_t) (v))
+#define PPC2C_ST32(a, v) ppc2c_write32 (a, (uint32_t) (v))
+#define PPC2C_ST64(a, v) ppc2c_write64 (a, (uint64_t) (v))
+#define PPC2C_SWAP16(v) ((uint16_t) (((v) >> 8) | ((v) << 8)))
+#define PPC2C_SWAP32(v)                                                 \
+  ((((v) >> 24) & 0xFF) | (((v) >> 8) & 0xFF00) |                       \
+   (((v) << 8) & 0xFF0000) | ((uint32_t) (v) << 24))
+#define PPC2C_LD16_LE(a) PPC2C_SWAP16 (ppc2c_read16 (a))
+#define PPC2C_LD32_LE(a) PPC2C_SWAP32 (ppc2c_read32 (a))
+#define PPC2C_ST16_LE(a, v) ppc2c_write16 (a, PPC2C_SWAP16 ((uint16_t) (v)))
+#define PPC2C_ST32_LE(a, v) ppc2c_write32 (a, PPC2C_SWAP32 ((uint32_t) (v)))
+
+#else
+
+#include <string.h>
+
+#if defined(PPC2C_HOST_BIG_ENDIAN)
+#define PPC2C_BE16(v) (v)
+#define PPC2C_BE32(v) (v)
+#define PPC2C_BE64(v) (v)
+#define PPC2C_LE16(v) __builtin_bswap16 (v)
+#define PPC2C_LE32(v) __builtin_bswap32 (v)
+#elif defined(_MSC_VER)
+#include <stdlib.h>
+#define PPC2C_BE16(v) _byteswap_ushort (v)
+#define PPC2C_BE32(v) _byteswap_ulong (v)
+#define PPC2C_BE64(v) _byteswap_uint64 (v)
+#define PPC2C_LE16(v) (v)
+#define PPC2C_LE32(v) (v)
+#else
+#define PPC2C_BE16(v) __builtin_bswap16 (v)
+#define PPC2C_BE32(v) __builtin_bswap32 (v)
+#define PPC2C_BE64(v) __builtin_bswap64 (v)
+#define PPC2C_LE16(v) (v)
+#define PPC2C_LE32(v) (v)
+#endif
+
+#define PPC2C_ACCESSORS(bits, order, suffix)                            \
+static inline uint##bits##_t                                            \
+ppc2c_ld##bits##suffix (uint64_t address)                               \
+{                                                                       \
+  uint##bits##_t value;                                                 \
+  memcpy (&value, ppc2c_host (address), sizeof(value));                 \
+  return order##bits (value);                                           \
+}                                                                       \
+static inline void                                                      \
+ppc2c_st##bits##suffix (uint64_t address, uint##bits##_t value)         \
+{                                                                       \
+  value = order##bits (value);                                          \
+  memcpy (ppc2c_host (address), &value, sizeof(value));                 \
+}
+
+PPC2C_ACCESSORS (16, PPC2C_BE, )
+PPC2C_ACCESSORS (32, PPC2C_BE, )
+PPC2C_ACCESSORS (64, PPC2C_BE, )
+PPC2C_ACCESSORS (16, PPC2C_LE, _le)
+PPC2C_ACCESSORS (32, PPC2C_LE, _le)
+
+#define PPC2C_LD8(a) ppc2c_read8 (a)
+#define PPC2C_LD16(a) ppc2c_ld16 (a)
+#define PPC2C_LD32(a) ppc2c_ld32 (a)
+#define PPC2C_LD64(a) ppc2c_ld64 (a)
+#define PPC2C_ST8(a, v) ppc2c_write8 (a, (uint8_t) (v))
+#define PPC2C_ST16(a, v) ppc2c_st16 (a, (uint16_t) (v))
+#define PPC2C_ST32(a, v) ppc2c_st32 (a, (uint32_t) (v))
+#define PPC2C_ST64(a, v) ppc2c_st64 (a, (uint64_t) (v))
+#define PPC2C_LD16_LE(a) ppc2c_ld16_le (a)
+#define PPC2C_LD32_LE(a) ppc2c_ld32_le (a)
+#define PPC2C_ST16_LE(a, v) ppc2c_st16_le (a, (uint16_t) (v))
+#define PPC2C_ST32_LE(a, v) ppc2c_st32_le (a, (uint32_t) (v))
+
+#endif
+
+/* Functions reachable through a guest address: lifted functions, and host
+ * implementations of imports, registered at the address their stub jumps
+ * to. Anything else goes to the unresolved handler, which aborts by default */
+void ppc2c_register (uint32_t address, ppc2c_func_t function);
+void ppc2c_register_table (const ppc2c_export_t *table);
+ppc2c_func_t ppc2c_lookup (uint32_t address);
+void ppc2c_set_unresolved_handler (void (*handler) (ppc_context_t *ctx,
+        uint32_t address));
+void ppc2c_call_indirect (ppc_context_t *ctx, uint64_t address);
+
+/* Condition register fields, CR0 being the most significant nibble */
+#define PPC2C_CR_LT 8
+#define PPC2C_CR_GT 4
+#define PPC2C_CR_EQ 2
+#define PPC2C_CR_SO 1
+#define PPC2C_CR_FIELD(cr, n) (((cr) >> (28 - (n) * 4)) & 0xF)
+#define PPC2C_CR_SET(cr, n, bits)                                       \
+  ((cr) = ((cr) & ~(0xFu << (28 - (n) * 4))) | ((uint32_t) (bits) << (28 - (n) * 4)))
+#define PPC2C_CR_COMPARE(cr, n, type, a, b)                             \
+  PPC2C_CR_SET (cr, n, (type) (a) < (type) (b) ? PPC2C_CR_LT :          \
+      (type) (a) > (type) (b) ? PPC2C_CR_GT : PPC2C_CR_EQ)
+
+/* Names used by the converter when it can't tell what set a field */
+#define PPC2C_CR_BIT(n, bit) ((PPC2C_CR_FIELD (CR, n) & (bit)) != 0)
+#define cr0_lt PPC2C_CR_BIT (0, PPC2C_CR_LT)
+#define cr0_gt PPC2C_CR_BIT (0, PPC2C_CR_GT)
+#define cr0_eq PPC2C_CR_BIT (0, PPC2C_CR_EQ)
+#define cr0_so PPC2C_CR_BIT (0, PPC2C_CR_SO)
+#define cr1_lt PPC2C_CR_BIT (1, PPC2C_CR_LT)
+#define cr1_gt PPC2C_CR_BIT (1, PPC2C_CR_GT)
+#define cr1_eq PPC2C_CR_BIT (1, PPC2C_CR_EQ)
+#define cr1_so PPC2C_CR_BIT (1, PPC2C_CR_SO)
+#define cr2_lt PPC2C_CR_BIT (2, PPC2C_CR_LT)
+#define cr2_gt PPC2C_CR_BIT (2, PPC2C_CR_GT)
+#define cr2_eq PPC2C_CR_BIT (2, PPC2C_CR_EQ)
+#define cr2_so PPC2C_CR_BIT (2, PPC2C_CR_SO)
+#define cr3_lt PPC2C_CR_BIT (3, PPC2C_CR_LT)
+#define cr3_gt PPC2C_CR_BIT (3, PPC2C_CR_GT)
+#define cr3_eq PPC2C_CR_BIT (3, PPC2C_CR_EQ)
+#define cr3_so PPC2C_CR_BIT (3, PPC2C_CR_SO)
+#define cr4_lt PPC2C_CR_BIT (4, PPC2C_CR_LT)
+#define cr4_gt PPC2C_CR_BIT (4, PPC2C_CR_GT)
+#define cr4_eq PPC2C_CR_BIT (4, PPC2C_CR_EQ)
+#define cr4_so PPC2C_CR_BIT (4, PPC2C_CR_SO)
+#define cr5_lt PPC2C_CR_BIT (5, PPC2C_CR_LT)
+#define cr5_gt PPC2C_CR_BIT (5, PPC2C_CR_GT)
+#define cr5_eq PPC2C_CR_BIT (5, PPC2C_CR_EQ)
+#define cr5_so PPC2C_CR_BIT (5, PPC2C_CR_SO)
+#define cr6_lt PPC2C_CR_BIT (6, PPC2C_CR_LT)
+#define cr6_gt PPC2C_CR_BIT (6, PPC2C_CR_GT)
+#define cr6_eq PPC2C_CR_BIT (6, PPC2C_CR_EQ)
+#define cr6_so PPC2C_CR_BIT (6, PPC2C_CR_SO)
+#define cr7_lt PPC2C_CR_BIT (7, PPC2C_CR_LT)
+#define cr7_gt PPC2C_CR_BIT (7, PPC2C_CR_GT)
+#define cr7_eq PPC2C_CR_BIT (7, PPC2C_CR_EQ)
+#define cr7_so PPC2C_CR_BIT (7, PPC2C_CR_SO)
+
+/* Functions using vector registers redefine these to keep the ones they
+ * touch in locals as well */
+#define PPC2C_VECTOR_LOCALS
+#define PPC2C_VECTOR_LOAD(ctx)
+#define PPC2C_VECTOR_STORE(ctx)
+
+/* Moving between the register file and the locals of a lifted function */
+#define PPC2C_LOAD_REGISTERS(ctx)                                       \
+  r0 = (ctx)->gpr[0]; r1 = (ctx)->gpr[1]; r2 = (ctx)->gpr[2];           \
+  r3 = (ctx)->gpr[3]; r4 = (ctx)->gpr[4]; r5 = (ctx)->gpr[5];           \
+  r6 = (ctx)->gpr[6]; r7 = (ctx)->gpr[7]; r8 = (ctx)->gpr[8];           \
+  r9 = (ctx)->gpr[9]; r10 = (ctx)->gpr[10]; r11 = (ctx)->gpr[11];       \
+  r12 = (ctx)->gpr[12]; r13 = (ctx)->gpr[13]; r14 = (ctx)->gpr[14];     \
+  r15 = (ctx)->gpr[15]; r16 = (ctx)->gpr[16]; r17 = (ctx)->gpr[17];     \
+  r18 = (ctx)->gpr[18]; r19 = (ctx)->gpr[19]; r20 = (ctx)->gpr[20];     \
+  r21 = (ctx)->gpr[21]; r22 = (ctx)->gpr[22]; r23 = (ctx)->gpr[23];     \
+  r24 = (ctx)->gpr[24]; r25 = (ctx)->gpr[25]; r26 = (ctx)->gpr[26];     \
+  r27 = (ctx)->gpr[27]; r28 = (ctx)->gpr[28]; r29 = (ctx)->gpr[29];     \
+  r30 = (ctx)->gpr[30]; r31 = (ctx)->gpr[31];                           \
+  LR = (ctx)->lr; CTR = (ctx)->ctr; CR = (ctx)->cr;                   \
+  PPC2C_VECTOR_LOAD (ctx)
+
+#define PPC2C_STORE_REGISTERS(ctx)                                      \
+  (ctx)->gpr[0] = r0; (ctx)->gpr[1] = r1; (ctx)->gpr[2] = r2;           \
+  (ctx)->gpr[3] = r3; (ctx)->gpr[4] = r4; (ctx)->gpr[5] = r5;           \
+  (ctx)->gpr[6] = r6; (ctx)->gpr[7] = r7; (ctx)->gpr[8] = r8;           \
+  (ctx)->gpr[9] = r9; (ctx)->gpr[10] = r10; (ctx)->gpr[11] = r11;       \
+  (ctx)->gpr[12] = r12; (ctx)->gpr[13] = r13; (ctx)->gpr[14] = r14;     \
+  (ctx)->gpr[15] = r15; (ctx)->gpr[16] = r16; (ctx)->gpr[17] = r17;     \
+  (ctx)->gpr[18] = r18; (ctx)->gpr[19] = r19; (ctx)->gpr[20] = r20;     \
+  (ctx)->gpr[21] = r21; (ctx)->gpr[22] = r22; (ctx)->gpr[23] = r23;     \
+  (ctx)->gpr[24] = r24; (ctx)->gpr[25] = r25; (ctx)->gpr[26] = r26;     \
+  (ctx)->gpr[27] = r27; (ctx)->gpr[28] = r28; (ctx)->gpr[29] = r29;     \
+  (ctx)->gpr[30] = r30; (ctx)->gpr[31] = r31;                           \
+  (ctx)->lr = LR; (ctx)->ctr = CTR; (ctx)->cr = CR;                   \
+  PPC2C_VECTOR_STORE (ctx)
+
+#define PPC2C_ENTER(ctx)                                                \
+  uint64_t r0, r1, r2, r3, r4, r5, r6, r7, r8, r9, r10, r11, r12,       \
+      r13, r14, r15, r16, r17, r18, r19, r20, r21, r22, r23, r24, r25,  \
+      r26, r27, r28, r29, r30, r31, LR, CTR;                            \
+  uint32_t CR;                                                          \
+  PPC2C_VECTOR_LOCALS                                                   \
+  PPC2C_LOAD_REGISTERS (ctx)
+
+#define PPC2C_RETURN(ctx)                                               \
+  do { PPC2C_STORE_REGISTERS (ctx); return; } while (0)
+
+#define PPC2C_CALL(ctx, function)                                       \
+  do {                                                                  \
+    PPC2C_STORE_REGISTERS (ctx);                                        \
+    function (ctx);                                                     \
+    PPC2C_LOAD_REGISTERS (ctx);                                         \
+  } while (0)
+
+#define PPC2C_CALL_INDIRECT(ctx, address)                               \
+  do {                                                                  \
+    PPC2C_STORE_REGISTERS (ctx);                                        \
+    ppc2c_call_indirect (ctx, address);                                 \
+    PPC2C_LOAD_REGISTERS (ctx);                                         \
+  } while (0)
+
+#define PPC2C_TAILCALL(ctx, function)                                   \
+  do { PPC2C_STORE_REGISTERS (ctx); function (ctx); return; } while (0)
+
+#define PPC2C_TAILCALL_INDIRECT(ctx, address)                           \
+  do {                                                                  \
+    PPC2C_STORE_REGISTERS (ctx);                                        \
+    ppc2c_call_indirect (ctx, address);                                 \
+    return;                                                             \
+  } while (0)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PPC2C_RUNTIME_H__ */
@@ -22,26 +22,9 @@
 */
 
 /*
-
-8  cmplwi  crX, %r5, <jsize - 1>
-  ...
-7  bgt     crX, loc_jdefault
-OR
-7  ble     crX, loc_jtable
-
-  ....
-6  lwz     %r2, off_xyz
-5  rldic   %r4, %r5, 2,30
-4  lwzx    %r3, %r4, %r2 // interchangeable
-3  extsw   %r1, %r3
-2  add     %r0, %r1, %r2 // interchangeable
-1  mtctr   %r0
-0  bctr
-
-OR
-4 <skip>
-3 lwax     %r1, %r4, %r2
-*/
+ * The code recognized before a bctr is described in ppcjt_idioms.cpp, how
+ * the number of cases is found in ppcjt_bounds.cpp
+ */
 
 
 
@@ -53,20 +36,33 @@ OR
 #include <kernwin.hpp>
 #include <auto.hpp>
 #include <offset.hpp>
+#include <allins.hpp>
+#include <funcs.hpp>
+#include <segment.hpp>
+#include <netnode.hpp>
+#include <xref.hpp>
+
+#include "ppcjt_idioms.hpp"
+#include "ppcjt_bounds.hpp"
+#include "ppcjt_stats.hpp"
 
-//#define JUMP_DEBUG
-#include "../../module/jptcmn.cpp"
+#include <algorithm>
 
 
 #define PPCJT_VERSION	"v0.2"
 
+bool (idaapi* orig_is_switch)(switch_info_ex_t *si);
+
+// bcctr with the "branch always" bits of BO set
+#define BCTR_MASK	0xFE8007FF
+#define BCTR_WORD	0x4E800420
+
+#ifdef JUMP_DEBUG
 #define G_STR_SIZE	256
 char g_mnem[G_STR_SIZE];
 char g_opnd_s0[G_STR_SIZE];
 char g_opnd_s1[G_STR_SIZE];
 char g_opnd_s2[G_STR_SIZE];
-bool (idaapi* orig_is_switch)(switch_info_ex_t *si);
-
 
 bool decode_insn_to_mnem(ea_t ea) {
   if (decode_insn(ea) != 0) {
@@ -101,294 +97,447 @@ void print_ins(ea_t ea) {
     jmsg("0x%a: Not an instruction\n", ea);
   }
 }
+#else
+#define print_ins(ea)
+#endif
+
+/* Only the itype and operands are looked at, formatting the instruction to
+ * compare the text costs more than the whole match, and the analysis asks
+ * about every bctr */
+static bool is_bctr(void) {
+  // bctr == 0x600, bctrl == 0x608
+  if (cmd.auxpref_chars.high != 6 || cmd.auxpref_chars.low != 0)
+    return false;
+  if (cmd.itype == PPC_bctr)
+    return true;
+  // Printed as "b lt, ctr" by IDA's module
+  return (cmd.itype == PPC_b || cmd.itype == PPC_bcctr) &&
+    (get_long(cmd.ea) & BCTR_MASK) == BCTR_WORD;
+}
 
-class ppc_jump_pattern_t : public jump_pattern_t
-{
-public:
+/* What the matcher found at a bctr, saved in the database so the next
+ * analysis of the same code doesn't walk the pattern again. ncases is 0 when
+ * no jump table was recognized */
+struct switch_result_t {
+  uint32 hash;   // window_hash () of the window
+  ushort nranges; // Ranges of the window, saved under WINDOW_TAG
   ea_t jtable;
-  ea_t jump;
-  ea_t jtdefault;
-  ushort jtsize;
-  bool pattern_found;
-
-  static const char *ppc_roots;
-  static const char (*ppc_depends)[2];
-  ppc_jump_pattern_t(switch_info_ex_t &si) :
-    jump_pattern_t (ppc_roots, ppc_depends, si)
-  {
-    jtable = 0;
-    jump = 0;
-    jtdefault = 0;
-    jtsize = 0;
-    pattern_found = false;
+  ea_t defjump;
+  ea_t index_use; // Instruction scaling the case number
+  int regnum;     // And its register there
+  ushort ncases;
+  bool failed;   // See MATCH_FAILED
+  uchar element; // Size of the entries
+  uchar shift;
+  bool is_signed;
+  bool absolute; // The entries are the addresses of the cases
+};
+
+#define RESULTS_NODE	"$ PPC Jump Tables"
+#define RESULTS_TAG	'J'
+#define WINDOW_TAG	'W'
+// Ranges of addresses a window is saved as, the closest ones are merged
+// past this to fit a supval
+#define WINDOW_RANGES	32
+// Instructions looked at after the last one that matched, before giving up
+#define SCAN_DEPTH	32
+// Instructions before the bctr that a failed match depends on
+#define FAILED_WINDOW	SCAN_DEPTH
+
+static netnode results_node;
+
+/* The instructions a result depends on: the ones the matcher and the bound
+ * walk looked at, wherever the paths to the bctr took them */
+struct window_range_t {
+  ea_t start;
+  ea_t end;      // Last instruction of the range
+};
+
+typedef qvector<window_range_t> window_t;
+
+/* The table is where the base load points to when IDA knows it, or else
+ * right after the bctr, aligned to its entries as the compilers put it */
+static ea_t table_address(const idiom_matcher_t &m) {
+  const idiom_thread_t &t = *m.result;
+  ea_t jtable = BADADDR;
+
+  if (t.base_load != BADADDR) {
+    ea_t ptr = get_first_dref_from(t.base_load);
+
+    if (ptr != BADADDR)
+      jtable = t.base_size == 8 ? ea_t(get_qword(ptr)) : get_long(ptr);
   }
+  if (jtable == BADADDR || jtable == 0 || !isLoaded(jtable))
+    jtable = (m.jump + 4 + t.element - 1) & ~ea_t(t.element - 1);
+  return jtable;
+}
 
-  virtual bool handle_mov(void) {
-    jmsg("%a: Handling move \n", cmd.ea);
-    if (decode_insn_to_mnem(cmd.ea)) {
-      for (int i = 0; i < 6; i++) {
-	if (r[i] != -1 &&
-	    qstrcmp(g_mnem, "mr") == 0 &&
-	    cmd.Op1.reg == r[i]) {
-	  r[i] = cmd.Op2.reg;
-	  return true;
-	}
-      }
-    }
-    return false;
+static void fill_result(switch_result_t &res, const idiom_matcher_t &m,
+			const index_bound_t &bound) {
+  const idiom_thread_t &t = *m.result;
+
+  res.jtable = table_address(m);
+  res.element = t.element;
+  res.shift = t.shift;
+  res.is_signed = t.is_signed;
+  res.absolute = t.absolute;
+  res.defjump = bound.defjump;
+  res.ncases = ushort(bound.last + 1);
+  // The register the table is indexed with, for those who need the switch
+  // expression (PPC2C). The compare may be on another one, copied to it
+  res.index_use = t.index_use;
+  res.regnum = t.index_reg;
+}
+
+/* Case address in the table entry at 'p'. The PS3 is big endian */
+static ea_t entry_target(const uchar *p, const switch_result_t &res) {
+  uint64 value = 0;
+
+  for (int i = 0; i < res.element; i++)
+    value = (value << 8) | p[i];
+  if (res.absolute)
+    return ea_t(value);
+  if (res.is_signed && res.element < 8) {
+    uint64 sign = 1ull << (res.element * 8 - 1);
+
+    value = (value ^ sign) - sign;
   }
+  return res.jtable + (ea_t(value) << res.shift);
+}
 
-  virtual bool jpi0(void) {
-    jmsg("%a: Checking for jpi 0\n", cmd.ea);
-    if (decode_insn_to_mnem(cmd.ea) &&
-	qstrcmp(g_mnem, "b") == 0 &&
-	qstrcmp(g_opnd_s0, "lt") == 0 &&
-	qstrcmp(g_opnd_s1, "ctr") == 0 &&
-	cmd.auxpref_chars.high == 6 && // bctr == 0x600, bctrl == 0x608
-	cmd.auxpref_chars.low == 0) {
-      jmsg("Found bctr\n");
-      jump = cmd.ea;
-      jtable = cmd.ea + 4;
-      return true;
+/* How many entries of the table, from the first, go to code of the bctr's
+ * segment. The table is read at once, a compare of something else than the
+ * case number gives a count past its end, into the code of the cases */
+static ushort valid_cases(ea_t jump, const switch_result_t &res) {
+  segment_t *seg = getseg(jump);
+  qvector<uchar> table;
+  ushort n = res.ncases;
+
+  if (seg == NULL)
+    return 0;
+  while (n > 0 && !isLoaded(res.jtable + n * res.element - 1))
+    n--;
+  if (n == 0)
+    return 0;
+  table.resize(n * res.element);
+  if (!get_many_bytes(res.jtable, &table[0], table.size()))
+    return 0;
+
+  for (ushort i = 0; i < n; i++) {
+    ea_t target = entry_target(&table[i * res.element], res);
+
+    if (target < seg->startEA || target >= seg->endEA || (target & 3) != 0 ||
+	decode_insn(target) == 0) {
+      n = i;
+      break;
     }
-    return false;
   }
-  virtual bool jpi1(void) {
-    jmsg("%a: Checking for jpi 1\n", cmd.ea);
-    if (decode_insn_to_mnem(cmd.ea)) {
-      if (qstrcmp(g_mnem, "mts") == 0 &&
-	  qstrcmp(g_opnd_s0, "CTR") == 0) {
-	r[0] = cmd.Op2.reg;
-	jmsg("Found mtctr. r[0] == %d\n", r[0]);
-	return true;
-      }
-      if (qstrcmp(g_mnem, "mtctr") == 0 &&
-	  qstrcmp(g_opnd_s0, "ctr") == 0) {
-	r[0] = cmd.Op2.reg;
-	jmsg("Found mtctr. r[0] == %d\n", r[0]);
+  // cmd is the bctr again for the caller
+  decode_insn(jump);
+  return n;
+}
+
+/* Walk the code backwards from the bctr, breadth first along the flows and
+ * jumps (not the calls), giving every instruction to the matcher until one
+ * of the idioms is complete. The instructions looked at are in 'seen' */
+static bool scan_back(idiom_matcher_t &m, qvector<ea_t> &seen) {
+  qvector<ea_t> todo;
+  size_t last = 0; // Where the matcher last made progress
+
+  todo.push_back(m.jump);
+  seen.push_back(m.jump);
+  for (size_t i = 0; i < todo.size() && i <= last + SCAN_DEPTH; i++) {
+    xrefblk_t xb;
+
+    for (bool ok = xb.first_to(todo[i], XREF_ALL); ok; ok = xb.next_to()) {
+      ea_t ea = xb.from;
+      bool known = false;
+      int progress = m.progress;
+
+      if (!xb.iscode || xb.type == fl_CN || xb.type == fl_CF)
+	continue;
+      for (size_t j = 0; j < seen.size() && !known; j++)
+	known = seen[j] == ea;
+      if (known)
+	continue;
+      seen.push_back(ea);
+
+      if (decode_insn(ea) == 0)
+	continue;
+      print_ins(ea);
+      if (m.step(cmd, get_long(ea)))
 	return true;
-      }
+      if (m.progress != progress)
+	last = todo.size();
+      todo.push_back(ea);
     }
-    return false;
   }
-  virtual bool jpi2(void) {
-    jmsg("%a: Checking for jpi 2\n", cmd.ea);
-    if (decode_insn_to_mnem(cmd.ea) &&
-	qstrcmp(g_mnem, "add") == 0 &&
-	cmd.Op1.reg == r[0]) {
-      r[1] = cmd.Op2.reg;
-      r[2] = cmd.Op3.reg;
-      jmsg("Found add. r[1] == %d -- r[2] == %d\n", r[1], r[2]);
-      return true;
+  return false;
+}
+
+enum match_result_t {
+  MATCH_FOUND,
+  MATCH_FAILED,      // The table load was found, not the rest of the pattern
+  MATCH_UNSUPPORTED, // Not a jump table this plugin knows
+};
+
+static void fill_si(switch_info_ex_t *si, ea_t jump, const switch_result_t &res) {
+  si->flags = SWI_EXTENDED;
+  si->flags2 = 0;
+  si->jumps = res.jtable;
+  si->ncases = res.ncases;
+  // PPC2C checks that the register isn't written again from there to the
+  // bctr
+  si->startea = res.index_use;
+  si->elbase = 0;
+  // The relative entries are offsets from the start of the table
+  if (!res.absolute) {
+    si->flags |= SWI_ELBASE;
+    si->elbase = res.jtable;
+  }
+  if (res.is_signed)
+    si->flags |= SWI_SIGNED;
+  // A clamped case number never goes to a default
+  if (res.defjump != BADADDR)
+    si->flags |= SWI_DEFAULT;
+
+  si->set_jtable_element_size(res.element);
+  si->set_shift(res.shift);
+  si->defjump = res.defjump;
+  si->lowcase = 0;
+  si->regnum = res.regnum;
+  si->regdtyp = dt_dword;
+}
+
+/* The ranges of contiguous instructions in 'addresses'. Past WINDOW_RANGES
+ * the two closest ones become one, with the words between them */
+static void make_window(qvector<ea_t> &addresses, window_t &window) {
+  window.clear();
+  std::sort(addresses.begin(), addresses.end());
+  for (size_t i = 0; i < addresses.size(); i++) {
+    window_range_t r;
+
+    if (!window.empty() && addresses[i] <= window.back().end + 4) {
+      if (addresses[i] > window.back().end)
+	window.back().end = addresses[i];
+      continue;
     }
-    return false;
+    r.start = r.end = addresses[i];
+    window.push_back(r);
   }
-  virtual bool jpi3(void) {
-    jmsg("%a: Checking for jpi 3\n", cmd.ea);
-    if (decode_insn_to_mnem(cmd.ea)) {
-      if (qstrcmp(g_mnem, "extsw") == 0 &&
-	  cmd.Op1.reg == r[1]) {
-	r[3] = cmd.Op2.reg;
-	jmsg("Found extsw. r[3] == %d\n", r[3]);
-	return true;
-      }
-      if (qstrcmp(g_mnem, "extsw") == 0 &&
-	  cmd.Op1.reg == r[2]) {
-	uint16 reg_tmp = r[1];
-	r[1] = r[2];
-	r[2] = reg_tmp;
-	r[3] = cmd.Op2.reg;
-	jmsg("Found extsw. Switched r[1] and r[2]. r[3] == %d\n", r[3]);
-	return true;
-      }
-      if (qstrcmp(g_mnem, "lwax") == 0) {
-	if (cmd.Op1.reg == r[1] &&
-	    cmd.Op2.reg == r[2]) {
-	  r[4] = cmd.Op3.reg;
-	  skip[4] = true;
-	  pattern_found = true;
-	  jmsg("Found lwax. Skipping jpi5. r[4] is second operand. r[4] == %d\n",
-	       r[4]);
-	  return true;
-	}
-	if (cmd.Op1.reg == r[1] &&
-	    cmd.Op3.reg == r[2]) {
-	  r[4] = cmd.Op2.reg;
-	  skip[4] = true;
-	  pattern_found = true;
-	  jmsg("Found lwzx. Skipping jpi5. r[4] is first operand. r[4] == %d\n",
-	       r[4]);
-	  return true;
-	}
-	if (cmd.Op1.reg == r[2] &&
-	    cmd.Op2.reg == r[1]) {
-	  uint16 reg_tmp = r[1];
-	  r[1] = r[2];
-	  r[2] = reg_tmp;
-	  r[4] = cmd.Op3.reg;
-	  skip[4] = true;
-	  pattern_found = true;
-	  jmsg("Found lwax. Skipping jpi5. Switched r[1] and r[2]. "
-	       "r[4] is second operand. r[4] == %d\n", r[4]);
-	  return true;
-	}
-	if (cmd.Op1.reg == r[2] &&
-	    cmd.Op3.reg == r[1]) {
-	  uint16 reg_tmp = r[1];
-	  r[1] = r[2];
-	  r[2] = reg_tmp;
-	  r[4] = cmd.Op2.reg;
-	  skip[4] = true;
-	  pattern_found = true;
-	  jmsg("Found lwzx. Skipping jpi5. Switched r[1] and r[2]. "
-	       "r[4] is first operand. r[4] == %d\n", r[4]);
-	  return true;
+  while (window.size() > WINDOW_RANGES) {
+    size_t closest = 0;
+
+    for (size_t i = 1; i + 1 < window.size(); i++)
+      if (window[i + 1].start - window[i].end <
+	  window[closest + 1].start - window[closest].end)
+	closest = i;
+    window[closest].end = window[closest + 1].end;
+    for (size_t i = closest + 1; i + 1 < window.size(); i++)
+      window[i] = window[i + 1];
+    window.pop_back();
+  }
+}
+
+/* The words of the instructions a result depends on and whether they are
+ * still code, so a failed match is retried once the code before the bctr
+ * is created or patched */
+static uint32 window_hash(const window_t &window) {
+  uint32 hash = 2166136261u; // FNV-1a
+
+  for (size_t r = 0; r < window.size(); r++) {
+    for (ea_t ea = window[r].start; ea <= window[r].end; ea += 4) {
+      uint32 values[2];
+
+      values[0] = get_long(ea);
+      values[1] = get_flags_novalue(ea) & (MS_CLS | FF_REF | FF_FLOW);
+      for (int i = 0; i < 2; i++) {
+	for (int j = 0; j < 4; j++) {
+	  hash ^= (values[i] >> (j * 8)) & 0xFF;
+	  hash *= 16777619u;
 	}
       }
     }
-    return false;
   }
-  virtual bool jpi4(void) {
-    jmsg("%a: Checking for jpi 4\n", cmd.ea);
-    if (decode_insn_to_mnem(cmd.ea)) {
-      if (qstrcmp(g_mnem, "lwzx") == 0 &&
-	  cmd.Op1.reg == r[3] &&
-	  cmd.Op2.reg == r[2]) {
-	r[4] = cmd.Op3.reg;
-	jmsg("Found lwzx. r[4] is second operand. r[4] == %d\n", r[4]);
-	pattern_found = true;
-	return true;
-      }
-      if (qstrcmp(g_mnem, "lwzx") == 0 &&
-	  cmd.Op1.reg == r[3] &&
-	  cmd.Op3.reg == r[2]) {
-	r[4] = cmd.Op2.reg;
-	jmsg("Found lwzx. r[4] is first operand. r[4] == %d\n", r[4]);
-	pattern_found = true;
-	return true;
-      }
-    }
+  return hash;
+}
+
+static bool load_result(ea_t ea, switch_result_t &res) {
+  window_t window;
+
+  if (results_node.supval(ea, &res, sizeof(res), RESULTS_TAG) != sizeof(res))
     return false;
-  }
-  virtual bool jpi5(void) {
-    jmsg("%a: Checking for jpi 5\n", cmd.ea);
-    print_ins (cmd.ea);
-    if (decode_insn_to_mnem(cmd.ea)) {
-      if (qstrcmp(g_mnem, "rldic") == 0 &&
-	  cmd.Op1.reg == r[4] &&
-	  qstrcmp(g_opnd_s2, "2,30") == 0) {
-	r[5] = cmd.Op2.reg;
-	jmsg("Found rldic. r[5] == %d\n", r[5]);
-	return true;
-      }
-      if (qstrcmp(g_mnem, "rldicr") == 0 &&
-	  cmd.Op1.reg == r[4] &&
-	  qstrcmp(g_opnd_s2, "2,61") == 0) {
-	r[5] = cmd.Op2.reg;
-	jmsg("Found rldic. r[5] == %d\n", r[5]);
-	return true;
-      }
-      if (qstrcmp(g_mnem, "clrlslwi") == 0 &&
-	  cmd.Op1.reg == r[4]) {
-	r[5] = cmd.Op2.reg;
-	jmsg("Found clrlslwi. r[5] == %d\n", r[5]);
-	return true;
-      }
-    }
+  window.resize(res.nranges);
+  if (res.nranges == 0 ||
+      results_node.supval(ea, &window[0], res.nranges * sizeof(window_range_t),
+			  WINDOW_TAG) != ssize_t(res.nranges * sizeof(window_range_t)))
     return false;
-  }
-  virtual bool jpi6(void) {
-    jmsg("%a: Checking for jpi 6\n", cmd.ea);
-    if (decode_insn_to_mnem(cmd.ea)) {
-      print_ins(cmd.ea);
-      if (qstrcmp(g_mnem, "lwz") == 0 &&
-          cmd.Op1.reg == r[2]) {
-        jmsg("Found lwz.\n");
-        return true;
-      }
-      if (qstrcmp(g_mnem, "ld") == 0 &&
-          cmd.Op1.reg == r[2]) {
-        jmsg("Found ld.\n");
-        return true;
-      }
-    }
+  return window_hash(window) == res.hash;
+}
+
+/* The table at 'ea' was found by PPCJT, and the code it depends on changed
+ * since. The analysis may not have created all the paths to it then */
+static bool is_stale(ea_t ea) {
+  switch_result_t res;
+
+  if (results_node.supval(ea, &res, sizeof(res), RESULTS_TAG) != sizeof(res))
     return false;
-  }
-  virtual bool jpi7(void) {
-    jmsg("%a: Checking for jpi 7\n", cmd.ea);
-    if (decode_insn_to_mnem(cmd.ea)) {
-      if (qstrcmp(g_mnem, "bgt") == 0) {
-	jtdefault = cmd.Op2.addr;
-	jmsg("Found bgt. jtdefault : 0x%a\n", jtdefault);
-	return true;
-      }
-      if (qstrcmp(g_mnem, "ble") == 0) {
-	jtdefault = cmd.ea + 4;
-	jmsg("Found ble. jtdefault : 0x%a\n", jtdefault);
-	return true;
-      }
+  return res.ncases != 0 && !load_result(ea, res);
+}
+
+static void save_result(ea_t ea, switch_result_t &res, qvector<ea_t> &depends) {
+  window_t window;
+
+  make_window(depends, window);
+  res.nranges = ushort(window.size());
+  res.hash = window_hash(window);
+  results_node.supset(ea, &res, sizeof(res), RESULTS_TAG);
+  results_node.supset(ea, &window[0], window.size() * sizeof(window_range_t),
+		      WINDOW_TAG);
+}
+
+// cmd must be the bctr at 'ea'
+static match_result_t match_switch(ea_t ea, switch_info_ex_t *si) {
+  switch_result_t res;
+
+  if (load_result(ea, res)) {
+    stats_count(STAT_CACHED);
+    if (res.ncases == 0) {
+      if (!res.failed)
+	return MATCH_UNSUPPORTED;
+      stats_count(STAT_NEAR_MISS);
+      return MATCH_FAILED;
     }
-    return false;
+    stats_count(STAT_FOUND);
+    fill_si(si, ea, res);
+    return MATCH_FOUND;
   }
-  virtual bool jpi8(void) {
-    jmsg("%a: Checking for jpi 8\n", cmd.ea);
-    if (decode_insn_to_mnem(cmd.ea) &&
-	(qstrcmp(g_mnem, "cmplwi") == 0 ||
-	 qstrcmp(g_mnem, "cmpldi") == 0)) {
-      jtsize = ushort(cmd.Op3.value) + 1;
-      jmsg("Found cmplwi. Jump table size : %d\n", jtsize);
-      return true;
+
+  // IDA asks about every indirect jump, so the state lives on the stack and
+  // its constructor is the whole reset
+  idiom_matcher_t m(ea);
+  index_bound_t bound;
+  match_result_t result = MATCH_UNSUPPORTED;
+  qvector<ea_t> depends;
+  bool matched;
+
+  memset(&res, 0, sizeof(res));
+  matched = scan_back(m, depends);
+  if (matched &&
+      find_index_bound(m.result->index_use, m.result->index_reg, bound)) {
+    ushort valid;
+
+    fill_result(res, m, bound);
+    valid = valid_cases(ea, res);
+    if (valid < res.ncases) {
+      msg("Jump table at 0x%a: only %d of %d entries go to code\n", ea,
+	  valid, res.ncases);
+      stats_count(STAT_CUT);
     }
-    return false;
+    res.ncases = valid;
   }
-
-  void fill_si(void) {
-    si.flags = SWI_EXTENDED | SWI_SIGNED | SWI_ELBASE | SWI_DEFAULT;
-    si.flags2 = 0;
-    si.jumps = jtable;
-    si.ncases = ushort(jtsize);
-    si.startea = jump;
-    si.elbase = jtable;
-
-    si.set_jtable_element_size(4);
-    si.set_shift(0);
-    si.defjump = jtdefault;
-    si.lowcase = 0;
+  if (res.ncases != 0) {
+    msg("Found Jump Table at : 0x%a with %d cases\n", ea, res.ncases);
+    stats_count(STAT_FOUND);
+    fill_si(si, ea, res);
+    result = MATCH_FOUND;
+  } else if (m.pattern_found) {
+    msg("Couldn't recognize jump table at 0x%a\n", ea);
+    res.failed = true;
+    stats_count(STAT_NEAR_MISS);
+    stats_failure(ea);
+    // Retried when the code before the bctr changes, it may not be all
+    // code yet
+    for (int i = 1; i <= FAILED_WINDOW && ea >= ea_t(i * 4); i++)
+      if (getseg(ea - i * 4) == getseg(ea))
+	depends.push_back(ea - i * 4);
+    result = MATCH_FAILED;
   }
-};
-
-static const char s_ppc_roots[] = {1, 7, 0};
-static const char s_ppc_depends[][2] = {
-  {1, 0}, // 0
-  {2, 0}, // 1
-  {3, 6}, // 2
-  {4, 0}, // 3
-  {5, 6}, // 4
-  {8, 0}, // 5
-  {0, 0}, // 6
-  {8, 0}, // 7
-  {0, 0}, // 8
-};
-const char *ppc_jump_pattern_t::ppc_roots = s_ppc_roots;
-const char (*ppc_jump_pattern_t::ppc_depends)[2] = s_ppc_depends;
+  // And when the code the bound was looked for in changes
+  for (size_t i = 0; i < bound.visited.size(); i++)
+    depends.push_back(bound.visited[i]);
+  save_result(ea, res, depends);
+  return result;
+}
 
 bool idaapi ppcjt_is_switch (switch_info_ex_t *si) {
   ea_t ea = cmd.ea;
-  ppc_jump_pattern_t *p = new ppc_jump_pattern_t(*si);
+  uint64 started = stats_start();
+  bool found = match_switch(ea, si) == MATCH_FOUND;
 
-  if (p->match(ea)) {
-    msg("Found Jump Table at : 0x%a with %d cases\n", ea, p->jtsize);
-    p->fill_si();
+  stats_count(STAT_CALLS);
+  stats_stop(ea, started);
+  if (found)
     return true;
-  } else if (p->pattern_found) {
-    msg("Couldn't recognize jump table at 0x%a\n", ea);
-  }
 
   decode_insn(ea);
-  if (orig_is_switch)
-    return orig_is_switch(si);
-  else
+  if (orig_is_switch == NULL)
     return false;
+  stats_count(STAT_FALLBACK);
+  return orig_is_switch(si);
+}
+
+struct sweep_site_t {
+  ea_t ea;
+  switch_info_ex_t si;
+};
+
+/* Look for every bctr of the code segments, instead of waiting for the
+ * analysis to ask about them, then create all the tables found before
+ * reanalyzing the functions they are in */
+static void sweep_switches(void) {
+  qvector<sweep_site_t> sites;
+  qvector<ea_t> funcs;
+  int known = 0, failed = 0, unsupported = 0;
+
+  for (int i = 0; i < get_segm_qty(); i++) {
+    segment_t *seg = getnseg(i);
+
+    if (seg->type != SEG_CODE)
+      continue;
+    for (ea_t ea = seg->startEA; ea != BADADDR && ea < seg->endEA;
+	 ea = next_head(ea, seg->endEA)) {
+      sweep_site_t site;
+
+      if (!isCode(get_flags_novalue(ea)) || decode_insn(ea) == 0 || !is_bctr())
+	continue;
+      if (get_switch_info_ex(ea, &site.si, sizeof(site.si)) > 0 &&
+	  !is_stale(ea)) {
+	known++;
+	continue;
+      }
+      switch (match_switch(ea, &site.si)) {
+	case MATCH_FOUND:
+	  site.ea = ea;
+	  sites.push_back(site);
+	  break;
+	case MATCH_FAILED:
+	  failed++;
+	  break;
+	case MATCH_UNSUPPORTED:
+	  unsupported++;
+	  break;
+      }
+    }
+  }
+
+  for (size_t i = 0; i < sites.size(); i++) {
+    func_t *pfn = get_func(sites[i].ea);
+
+    set_switch_info_ex(sites[i].ea, &sites[i].si);
+    create_switch_table(sites[i].ea, &sites[i].si);
+    create_switch_xrefs(sites[i].ea, &sites[i].si);
+    // The sites come in address order, so those of a function are together
+    if (pfn != NULL && (funcs.empty() || funcs.back() != pfn->startEA))
+      funcs.push_back(pfn->startEA);
+  }
+  for (size_t i = 0; i < funcs.size(); i++)
+    reanalyze_function(get_func(funcs[i]));
+  autoWait();
+
+  msg("PPCJT: %d jump tables found, %d already known, %d failed, "
+      "%d unsupported, %d functions reanalyzed\n", (int) sites.size(), known,
+      failed, unsupported, (int) funcs.size());
 }
 
 int idaapi PluginStartup(void)
@@ -399,6 +548,9 @@ int idaapi PluginStartup(void)
 
   msg("Loading PPC Jump Table plugin %s\n", PPCJT_VERSION);
 
+  if (!idioms_compile())
+    return PLUGIN_SKIP;
+  results_node.create(RESULTS_NODE);
   orig_is_switch = ph.is_switch;
   ph.is_switch = ppcjt_is_switch;
 
@@ -421,6 +573,11 @@ void idaapi PluginShutdown(void)
 
 void idaapi PluginMain(int param)
 {
+  // 1 from plugins.cfg only prints what the plugin did so far
+  if (param == 1)
+    stats_report();
+  else
+    sweep_switches();
 }
 
 
@@ -433,7 +590,9 @@ void idaapi PluginMain(int param)
 
 const char G_PLUGIN_COMMENT[] = "PPC Jump Table fix";
 const char G_PLUGIN_HELP[] = "This plugin adds Jump Table support to the PowerPC process module"
-  "of IDA, resolving switch/cases into properly analyzed code.";
+  "of IDA, resolving switch/cases into properly analyzed code.\n"
+  "Running it looks for the jump tables of the whole database at once,\n"
+  "or with 1 as argument, prints its counters and recent failures.";
 const char G_PLUGIN_NAME[] = "PPC JP: Jump table size";
 const char G_PLUGIN_HOTKEY[] = "";
 
@@ -0,0 +1,326 @@
+/*
+ * ppcjt_bounds.cpp -- Range of the case number of a jump table
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+/*
+ * The compare isn't always right before the table: it can be hoisted into a
+ * predecessor, or a path can clamp the case number instead of comparing it.
+ * So every path to the instruction using the case number is walked back,
+ * following its register through the copies, until one of these bounds it:
+ *
+ *    cmplwi  crX, rIndex, N         with a bgt/bge crX to the default on the
+ *                                   way, or a ble/blt crX to the table
+ *    clrlwi  rIndex, rS, n          or the other masks of the low bits
+ *    andi.   rIndex, rS, mask
+ *
+ * and "subfic rIndex, rS, N" reverses it, the bound is then the one of rS.
+ * The table is as long as the largest bound of the paths. A path where the
+ * register is written by anything else, or clobbered by a call, bounds
+ * nothing and neither does the table.
+ */
+
+#include "ppcjt_bounds.hpp"
+#include "ppcjt_idioms.hpp"
+
+#include <bytes.hpp>
+#include <xref.hpp>
+#include <allins.hpp>
+
+// Instructions looked at on all the paths, before giving up
+#define BOUND_DEPTH	256
+// Paths waiting to be walked
+#define BOUND_MAX_PATHS	64
+// A mask wider than this is the size of the register, not of a table
+#define BOUND_MAX_LAST	0xFFF
+
+enum bound_cond_t {
+  COND_NONE,
+  COND_LE,   // The compared register is at most the immediate
+  COND_LT,   // It is below the immediate
+};
+
+/* A path being walked back. The case number at the use is 'reg' after the
+ * instruction at 'ea', or 'base' minus it once reversed */
+struct bound_path_t {
+  ea_t ea;
+  bool taken;         // Left 'ea' by its branch, not by the flow
+  int reg;
+  bool reversed;
+  uint64 base;
+  int crf;            // Condition register a branch on the path tests, -1 if none
+  bound_cond_t cond;  // What the branch says of the register compared in it
+  ea_t defjump;       // The other way of that branch
+};
+
+enum walk_result_t {
+  WALK_ON,        // Nothing known yet, go on with the predecessors
+  WALK_BOUNDED,
+  WALK_UNBOUNDED,
+};
+
+static bool is_store(ushort itype) {
+  switch (itype) {
+    case PPC_stb: case PPC_stbu: case PPC_stbux: case PPC_stbx:
+    case PPC_std: case PPC_stdcx: case PPC_stdu: case PPC_stdux: case PPC_stdx:
+    case PPC_sth: case PPC_sthbrx: case PPC_sthu: case PPC_sthux: case PPC_sthx:
+    case PPC_stmw: case PPC_stswi: case PPC_stswx:
+    case PPC_stw: case PPC_stwbrx: case PPC_stwcx: case PPC_stwu: case PPC_stwux: case PPC_stwx:
+    case PPC_mtctr: case PPC_mtlr: case PPC_mtspr: case PPC_mtcrf: case PPC_mtxer:
+      return true;
+  }
+  return false;
+}
+
+// The base register is written back
+static bool is_update(ushort itype) {
+  switch (itype) {
+    case PPC_lbzu: case PPC_lbzux: case PPC_ldu: case PPC_ldux:
+    case PPC_lhau: case PPC_lhaux: case PPC_lhzu: case PPC_lhzux:
+    case PPC_lwzu: case PPC_lwzux: case PPC_lwaux:
+    case PPC_stbu: case PPC_stbux: case PPC_stdu: case PPC_stdux:
+    case PPC_sthu: case PPC_sthux: case PPC_stwu: case PPC_stwux:
+      return true;
+  }
+  return false;
+}
+
+// bctrl has no xref, the direct calls have theirs
+static bool is_call(ea_t ea) {
+  xrefblk_t xb;
+
+  if (cmd.itype == PPC_bctrl)
+    return true;
+  for (bool ok = xb.first_from(ea, XREF_FAR); ok; ok = xb.next_from())
+    if (xb.iscode && (xb.type == fl_CN || xb.type == fl_CF))
+      return true;
+  return false;
+}
+
+// r0 and r3 to r12 don't survive a call
+static bool is_volatile(int reg) {
+  return reg == 0 || (reg >= 3 && reg <= 12);
+}
+
+/* What the conditional branch in cmd says of the register compared for it,
+ * on the way the path left it */
+static bound_cond_t branch_cond(const bound_path_t &p, ea_t &other) {
+  switch (cmd.itype) {
+    case PPC_bgt:
+      other = cmd.Op2.addr;
+      return p.taken ? COND_NONE : COND_LE;
+    case PPC_bge:
+      other = cmd.Op2.addr;
+      return p.taken ? COND_NONE : COND_LT;
+    case PPC_ble:
+      other = p.ea + 4;
+      return p.taken ? COND_LE : COND_NONE;
+    case PPC_blt:
+      other = p.ea + 4;
+      return p.taken ? COND_LT : COND_NONE;
+  }
+  return COND_NONE;
+}
+
+/* Highest value the instruction in cmd can give its destination, from the
+ * low bits it keeps. 0 if it isn't a mask */
+static uint64 mask_last(void) {
+  switch (cmd.itype) {
+    case PPC_clrlwi:
+    case PPC_srwi:
+      return 0xFFFFFFFFull >> cmd.Op3.value;
+    case PPC_extrwi:
+      return (1ull << cmd.Op3.value) - 1;
+    case PPC_rlwinm:
+      // Op4 and Op5 are MB and ME, a mask that doesn't wrap
+      if (cmd.Op4.value <= cmd.Op5.value)
+	return 0xFFFFFFFFull >> cmd.Op4.value;
+      break;
+    case PPC_clrldi:
+      if (cmd.Op3.value > 32)
+	return ~0ull >> cmd.Op3.value;
+      break;
+    case PPC_andi:
+      return cmd.Op3.value;
+  }
+  return 0;
+}
+
+// The case number at the use, once 'reg' is bounded by 'last'
+static walk_result_t bounded(const bound_path_t &p, uint64 last, uval_t &result) {
+  if (p.reversed) {
+    // rS <= N, so N - rS doesn't wrap
+    if (last > p.base)
+      return WALK_UNBOUNDED;
+    last = p.base;
+  }
+  if (last > BOUND_MAX_LAST)
+    return WALK_UNBOUNDED;
+  result = uval_t(last);
+  return WALK_BOUNDED;
+}
+
+/* cmd is the instruction at p.ea. Updates the path with it, or tells what
+ * it bounds the case number to */
+static walk_result_t walk(bound_path_t &p, uval_t &last) {
+  if (is_call(p.ea)) {
+    if (is_volatile(p.reg))
+      return WALK_UNBOUNDED;
+    p.crf = -1;
+    return WALK_ON;
+  }
+
+  // The direct branches only read the condition registers
+  if (cmd.Op1.type == o_near || cmd.Op2.type == o_near) {
+    ea_t other = BADADDR;
+    bound_cond_t cond = branch_cond(p, other);
+
+    // The branch nearest to the use is the one that matters
+    if (p.crf == -1 && cond != COND_NONE && cmd.Op1.type == o_reg) {
+      p.crf = cmd.Op1.reg;
+      p.cond = cond;
+      p.defjump = other;
+    }
+    return WALK_ON;
+  }
+
+  if (cmd.Op1.type == o_reg && p.crf != -1 && cmd.Op1.reg == p.crf) {
+    if ((cmd.itype == PPC_cmplwi || cmd.itype == PPC_cmpldi) &&
+	cmd.Op2.type == o_reg && cmd.Op2.reg == p.reg) {
+      uint64 value = cmd.Op3.value;
+
+      if (p.cond == COND_LT) {
+	if (value == 0)
+	  return WALK_UNBOUNDED;
+	value--;
+      }
+      jmsg("%a: r%d bounded to %a\n", p.ea, p.reg, ea_t(value));
+      return bounded(p, value, last);
+    }
+    // Compared for something else
+    p.crf = -1;
+  }
+
+  if (is_update(cmd.itype) && cmd.Op2.reg == p.reg)
+    return WALK_UNBOUNDED;
+  if (cmd.Op1.type != o_reg || cmd.Op1.reg != p.reg || is_store(cmd.itype))
+    return WALK_ON;
+
+  // The register is written, the case number comes from the source
+  switch (cmd.itype) {
+    case PPC_mr:
+    case PPC_extsw:
+      p.reg = cmd.Op2.reg;
+      return WALK_ON;
+    case PPC_clrldi:
+      // Zero extended, the compares of the low word still hold
+      if (cmd.Op3.value == 32) {
+	p.reg = cmd.Op2.reg;
+	return WALK_ON;
+      }
+      break;
+    case PPC_subfic:
+      if (p.reversed)
+	return WALK_UNBOUNDED;
+      p.reversed = true;
+      p.base = uint64(cmd.Op3.value);
+      p.reg = cmd.Op2.reg;
+      return WALK_ON;
+  }
+  if (mask_last() != 0) {
+    jmsg("%a: r%d masked to %a\n", p.ea, p.reg, ea_t(mask_last()));
+    // No case number goes to the default on this path
+    p.crf = -1;
+    return bounded(p, mask_last(), last);
+  }
+  return WALK_UNBOUNDED;
+}
+
+static bool same_state(const bound_path_t &a, const bound_path_t &b) {
+  return a.ea == b.ea && a.taken == b.taken && a.reg == b.reg &&
+    a.reversed == b.reversed && a.crf == b.crf;
+}
+
+/* Queue the predecessors of p.ea, along the flows and jumps. False if there
+ * are none, the path then bounds nothing */
+static bool push_preds(qvector<bound_path_t> &todo, qvector<bound_path_t> &seen,
+		       const bound_path_t &p) {
+  xrefblk_t xb;
+  bool any = false;
+
+  for (bool ok = xb.first_to(p.ea, XREF_ALL); ok; ok = xb.next_to()) {
+    bound_path_t q = p;
+    bool known = false;
+
+    if (!xb.iscode || xb.type == fl_CN || xb.type == fl_CF)
+      continue;
+    any = true;
+    q.ea = xb.from;
+    q.taken = xb.type != fl_F;
+    for (size_t i = 0; i < seen.size() && !known; i++)
+      known = same_state(seen[i], q);
+    // Around a loop again, the path was already walked from there
+    if (known)
+      continue;
+    if (todo.size() >= BOUND_MAX_PATHS)
+      return false;
+    seen.push_back(q);
+    todo.push_back(q);
+  }
+  return any;
+}
+
+bool find_index_bound(ea_t use, int reg, index_bound_t &bound) {
+  qvector<bound_path_t> todo;
+  qvector<bound_path_t> seen;
+  bound_path_t start;
+  bool found = false;
+
+  start.ea = use;
+  start.taken = false;
+  start.reg = reg;
+  start.reversed = false;
+  start.base = 0;
+  start.crf = -1;
+  start.cond = COND_NONE;
+  start.defjump = BADADDR;
+
+  bound.last = 0;
+  bound.defjump = BADADDR;
+  bound.visited.clear();
+
+  if (!push_preds(todo, seen, start))
+    return false;
+  for (int depth = 0; !todo.empty(); depth++) {
+    bound_path_t p = todo.back();
+    uval_t last = 0;
+
+    todo.pop_back();
+    bound.visited.push_back(p.ea);
+    if (depth == BOUND_DEPTH || decode_insn(p.ea) == 0)
+      return false;
+
+    switch (walk(p, last)) {
+      case WALK_UNBOUNDED:
+	jmsg("%a: r%d isn't bounded\n", p.ea, p.reg);
+	return false;
+      case WALK_BOUNDED:
+	if (!found || last > bound.last)
+	  bound.last = last;
+	if (bound.defjump == BADADDR && p.crf != -1)
+	  bound.defjump = p.defjump;
+	found = true;
+	break;
+      case WALK_ON:
+	if (!push_preds(todo, seen, p))
+	  return false;
+	break;
+    }
+  }
+  return found;
+}
@@ -0,0 +1,29 @@
+/*
+ * ppcjt_bounds.hpp -- Range of the case number of a jump table
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+#ifndef __PPCJT_BOUNDS_HPP__
+#define __PPCJT_BOUNDS_HPP__
+
+#include <ida.hpp>
+#include <ua.hpp>
+
+/* The cases a jump table can be entered with */
+struct index_bound_t {
+  uval_t last;    // Highest case number, the first one is 0
+  ea_t defjump;   // Where the case numbers past 'last' go, BADADDR if none do
+  qvector<ea_t> visited; // Instructions the bound depends on
+};
+
+/* 'reg' holds the case number at 'use'. Walks every path to 'use' back
+ * until it bounds the register, false if one of them doesn't. The
+ * instructions walked are in 'visited' either way */
+bool find_index_bound(ea_t use, int reg, index_bound_t &bound);
+
+#endif /* __PPCJT_BOUNDS_HPP__ */
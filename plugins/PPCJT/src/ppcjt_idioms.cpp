@@ -0,0 +1,398 @@
+/*
+ * ppcjt_idioms.cpp -- Jump table idioms of the PowerPC compilers
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+/*
+ * The code before a bctr is described by steps, in the order they are found
+ * walking back from it. A step can only be matched once the steps in its
+ * 'after' are, and all of them must be for the idiom to be complete. Each
+ * step has one or more forms, an instruction and what its operands must
+ * be: a variable (a register, bound by the first form that sees it), an
+ * immediate, anything or nothing.
+ *
+ *    lwz     rBase, off_xyz                 BASE
+ *    rldic   rScaled, rIndex, 2,30          SCALE
+ *    lwzx    rEntry, rScaled, rBase         LOAD, interchangeable
+ *    extsw   rOffset, rEntry                EXTEND
+ * OR lwax    rOffset, rScaled, rBase        EXTEND and LOAD
+ *    add     rTarget, rOffset, rBase        ADD, interchangeable
+ *    mtctr   rTarget                        MTCTR
+ *    bctr
+ *
+ * The compact tables of SNC have 1 or 2 byte entries, the offset of the
+ * case in words, and the 64 bit ones the address of the case :
+ *
+ *    lbzx    rEntry, rIndex, rBase          EXTEND, LOAD and SCALE
+ * OR lhzx    rEntry, rScaled, rBase         EXTEND and LOAD
+ *    slwi    rOffset, rEntry, 2             SHIFT, optional
+ *    add     rTarget, rOffset, rBase        ADD
+ *
+ *    sldi    rScaled, rIndex, 3             SCALE
+ *    ldx     rTarget, rScaled, rBase        ADD, EXTEND and LOAD
+ *
+ * The number of cases and the default are those of the compare of rIndex,
+ * wherever it is before the SCALE, see ppcjt_bounds.cpp.
+ *
+ * A new idiom is a new form, or a new step. idioms_compile () turns the
+ * forms into a mask of those that can match each itype, so the matcher
+ * only looks at the forms of the instruction it is given.
+ *
+ * The matcher doesn't read the database: it is given each instruction
+ * decoded, with its word, so bench/jt_bench of the headless build can feed
+ * it sequences of its own.
+ */
+
+#include "ppcjt_idioms.hpp"
+
+#include <allins.hpp>
+
+enum idiom_step_id_t {
+  S_MTCTR,
+  S_ADD,
+  S_SHIFT,
+  S_EXTEND,
+  S_LOAD,
+  S_SCALE,
+  S_BASE,
+  S_COUNT
+};
+
+#define STEP(s)		(1 << (s))
+#define ALL_STEPS	(STEP(S_COUNT) - 1)
+// The steps an idiom can do without
+#define OPTIONAL_STEPS	STEP(S_SHIFT)
+
+struct idiom_step_t {
+  const char *name; // For the debug messages
+  uint32 after;     // Steps found before this one, walking back
+  uint32 before;    // Steps that can't be found yet
+};
+
+static const idiom_step_t idiom_steps[S_COUNT] = {
+  {"mtctr",	0,				0},
+  {"add",	STEP(S_MTCTR),			0},
+  {"shift",	STEP(S_ADD),			STEP(S_EXTEND)},
+  {"extend",	STEP(S_ADD),			0},
+  {"load",	STEP(S_EXTEND),			0},
+  {"scale",	STEP(S_LOAD),			0},
+  {"base",	STEP(S_LOAD),			0},
+};
+
+enum idiom_op_kind_t {
+  OPK_ANY,  // Anything, or nothing
+  OPK_NONE, // No operand
+  OPK_VAR,  // A register, the variable's
+  OPK_IMM,  // This immediate
+  OPK_FROM, // A register, the variable's from now on
+};
+
+struct idiom_op_t {
+  uchar kind;
+  uchar arg;
+};
+
+#define ANY		{OPK_ANY, 0}
+#define NONE		{OPK_NONE, 0}
+#define VAR(v)		{OPK_VAR, v}
+#define IMM(n)		{OPK_IMM, n}
+#define FROM(v)		{OPK_FROM, v}
+
+#define FORM_COMMUTE	0x01 // The second and third operands are interchangeable
+#define FORM_SIGNED	0x02 // The entries are sign extended
+#define FORM_ABSOLUTE	0x04 // The entries are the addresses of the cases
+
+enum idiom_action_t {
+  ACT_NONE,
+  ACT_SHIFT,          // The entries are shifted by the third operand
+  ACT_BASE,           // Loads the address of the table
+};
+
+#define IDIOM_MAX_OPS	4
+
+struct idiom_form_t {
+  uchar step;
+  ushort itype;       // PPC_null to test the word whatever the itype
+  uint32 mask;        // If not 0, (word & mask) must be 'word'
+  uint32 word;
+  idiom_op_t ops[IDIOM_MAX_OPS];
+  uchar flags;
+  uchar action;
+  uint32 also;        // Steps this form stands for too
+  uchar element;      // Size of the entries, if the form tells
+};
+
+// mtspr CTR, rS. PPCAltivec decodes mtspr itself, under its own itype
+#define MTCTR_MASK	0xFC1FFFFF
+#define MTCTR_WORD	0x7C0903A6
+
+static const idiom_form_t idiom_forms[] = {
+  // "mtctr ctr, rS" in IDA's module, the simplified form only has rS
+  {S_MTCTR, PPC_mtctr, 0, 0, {ANY, VAR(V_TARGET)}, 0, ACT_NONE, 0, 0},
+  {S_MTCTR, PPC_mtctr, 0, 0, {VAR(V_TARGET), NONE}, 0, ACT_NONE, 0, 0},
+  {S_MTCTR, PPC_null, MTCTR_MASK, MTCTR_WORD, {ANY, VAR(V_TARGET)}, 0, ACT_NONE, 0, 0},
+
+  {S_ADD, PPC_add, 0, 0, {VAR(V_TARGET), VAR(V_OFFSET), VAR(V_BASE)},
+   FORM_COMMUTE, ACT_NONE, 0, 0},
+  {S_ADD, PPC_ldx, 0, 0, {VAR(V_TARGET), VAR(V_BASE), VAR(V_SCALED)},
+   FORM_COMMUTE | FORM_ABSOLUTE, ACT_NONE, STEP(S_EXTEND) | STEP(S_LOAD), 8},
+
+  {S_SHIFT, PPC_slwi, 0, 0, {VAR(V_OFFSET), FROM(V_OFFSET)}, 0, ACT_SHIFT, 0, 0},
+  {S_SHIFT, PPC_sldi, 0, 0, {VAR(V_OFFSET), FROM(V_OFFSET)}, 0, ACT_SHIFT, 0, 0},
+
+  {S_EXTEND, PPC_extsw, 0, 0, {VAR(V_OFFSET), VAR(V_ENTRY)}, FORM_SIGNED, ACT_NONE, 0, 0},
+  {S_EXTEND, PPC_lwax, 0, 0, {VAR(V_OFFSET), VAR(V_BASE), VAR(V_SCALED)},
+   FORM_COMMUTE | FORM_SIGNED, ACT_NONE, STEP(S_LOAD), 4},
+  {S_EXTEND, PPC_lhax, 0, 0, {VAR(V_OFFSET), VAR(V_BASE), VAR(V_SCALED)},
+   FORM_COMMUTE | FORM_SIGNED, ACT_NONE, STEP(S_LOAD), 2},
+  {S_EXTEND, PPC_lhzx, 0, 0, {VAR(V_OFFSET), VAR(V_BASE), VAR(V_SCALED)},
+   FORM_COMMUTE, ACT_NONE, STEP(S_LOAD), 2},
+  // Bytes need no scaling, the case number is the index
+  {S_EXTEND, PPC_lbzx, 0, 0, {VAR(V_OFFSET), VAR(V_BASE), VAR(V_INDEX)},
+   FORM_COMMUTE, ACT_NONE, STEP(S_LOAD) | STEP(S_SCALE), 1},
+
+  {S_LOAD, PPC_lwzx, 0, 0, {VAR(V_ENTRY), VAR(V_BASE), VAR(V_SCALED)},
+   FORM_COMMUTE, ACT_NONE, 0, 4},
+
+  {S_SCALE, PPC_rldic, 0, 0, {VAR(V_SCALED), VAR(V_INDEX), IMM(2), IMM(30)},
+   0, ACT_NONE, 0, 4},
+  {S_SCALE, PPC_rldicr, 0, 0, {VAR(V_SCALED), VAR(V_INDEX), IMM(2), IMM(61)},
+   0, ACT_NONE, 0, 4},
+  {S_SCALE, PPC_slwi, 0, 0, {VAR(V_SCALED), VAR(V_INDEX), IMM(2)}, 0, ACT_NONE, 0, 4},
+  {S_SCALE, PPC_clrlslwi, 0, 0, {VAR(V_SCALED), VAR(V_INDEX)}, 0, ACT_NONE, 0, 0},
+  {S_SCALE, PPC_add, 0, 0, {VAR(V_SCALED), VAR(V_INDEX), VAR(V_INDEX)},
+   0, ACT_NONE, 0, 2},
+  {S_SCALE, PPC_rldic, 0, 0, {VAR(V_SCALED), VAR(V_INDEX), IMM(1), IMM(31)},
+   0, ACT_NONE, 0, 2},
+  {S_SCALE, PPC_rldicr, 0, 0, {VAR(V_SCALED), VAR(V_INDEX), IMM(1), IMM(62)},
+   0, ACT_NONE, 0, 2},
+  {S_SCALE, PPC_slwi, 0, 0, {VAR(V_SCALED), VAR(V_INDEX), IMM(1)}, 0, ACT_NONE, 0, 2},
+  {S_SCALE, PPC_rldic, 0, 0, {VAR(V_SCALED), VAR(V_INDEX), IMM(3), IMM(29)},
+   0, ACT_NONE, 0, 8},
+  {S_SCALE, PPC_rldicr, 0, 0, {VAR(V_SCALED), VAR(V_INDEX), IMM(3), IMM(60)},
+   0, ACT_NONE, 0, 8},
+  {S_SCALE, PPC_sldi, 0, 0, {VAR(V_SCALED), VAR(V_INDEX), IMM(3)}, 0, ACT_NONE, 0, 8},
+
+  {S_BASE, PPC_lwz, 0, 0, {VAR(V_BASE)}, 0, ACT_BASE, 0, 4},
+  {S_BASE, PPC_ld, 0, 0, {VAR(V_BASE)}, 0, ACT_BASE, 0, 8},
+};
+
+#define NFORMS		(sizeof(idiom_forms) / sizeof(idiom_forms[0]))
+
+/* Built by idioms_compile () */
+static uint32 itype_forms[PPC_last]; // Forms of each itype
+static uint32 word_forms;            // Forms of any itype
+static uint32 step_forms[S_COUNT];   // Forms of each step
+static bool compiled;
+
+bool idioms_compile(void) {
+  if (compiled)
+    return true;
+  if (NFORMS > 32) {
+    msg("PPCJT: Too many idiom forms (%d)\n", (int) NFORMS);
+    return false;
+  }
+  memset(itype_forms, 0, sizeof(itype_forms));
+  memset(step_forms, 0, sizeof(step_forms));
+  word_forms = 0;
+  for (size_t i = 0; i < NFORMS; i++) {
+    const idiom_form_t &f = idiom_forms[i];
+
+    if (f.itype == PPC_null)
+      word_forms |= 1 << i;
+    else
+      itype_forms[f.itype] |= 1 << i;
+    step_forms[f.step] |= 1 << i;
+  }
+  compiled = true;
+  return true;
+}
+
+// The forms of the steps 'found' allows
+static uint32 enabled_forms(uint32 found) {
+  uint32 forms = 0;
+
+  for (int s = 0; s < S_COUNT; s++)
+    if ((found & STEP(s)) == 0 && (found & idiom_steps[s].before) == 0 &&
+	(found & idiom_steps[s].after) == idiom_steps[s].after)
+      forms |= step_forms[s];
+  return forms;
+}
+
+static bool bind_operands(const insn_t &insn, const idiom_form_t &f, int vars[],
+			  bool swap) {
+  for (int i = 0; i < IDIOM_MAX_OPS; i++) {
+    const idiom_op_t &spec = f.ops[i];
+    const op_t &x = insn.Operands[swap && (i == 1 || i == 2) ? 3 - i : i];
+
+    switch (spec.kind) {
+      case OPK_ANY:
+	break;
+      case OPK_NONE:
+	if (x.type != o_void)
+	  return false;
+	break;
+      case OPK_IMM:
+	if (x.type != o_imm || x.value != spec.arg)
+	  return false;
+	break;
+      case OPK_VAR:
+	if (x.type != o_reg)
+	  return false;
+	if (vars[spec.arg] == -1)
+	  vars[spec.arg] = x.reg;
+	else if (vars[spec.arg] != x.reg)
+	  return false;
+	break;
+      case OPK_FROM:
+	if (x.type != o_reg)
+	  return false;
+	vars[spec.arg] = x.reg;
+	break;
+    }
+  }
+  return true;
+}
+
+// What the form says of the table must agree with what is already known
+static bool check_layout(const insn_t &insn, const idiom_thread_t &t,
+			 const idiom_form_t &f) {
+  if (f.action == ACT_SHIFT && insn.Op3.value > 3)
+    return false;
+  // The base is loaded whatever the size of the entries
+  if (f.action == ACT_BASE)
+    return true;
+  return f.element == 0 || t.element == 0 || f.element == t.element;
+}
+
+static void apply(const insn_t &insn, idiom_thread_t &t, const idiom_form_t &f) {
+  ea_t ea = insn.ea;
+
+  t.found |= STEP(f.step) | f.also;
+  if (f.element != 0 && f.action != ACT_BASE)
+    t.element = f.element;
+  if (f.flags & FORM_SIGNED)
+    t.is_signed = true;
+  if (f.flags & FORM_ABSOLUTE)
+    t.absolute = true;
+  if (ea < t.first)
+    t.first = ea;
+  if ((STEP(f.step) | f.also) & STEP(S_SCALE)) {
+    t.index_use = ea;
+    t.index_reg = t.vars[V_INDEX];
+  }
+  switch (f.action) {
+    case ACT_SHIFT:
+      t.shift = uchar(insn.Op3.value);
+      break;
+    case ACT_BASE:
+      t.base_load = ea;
+      t.base_size = f.element;
+      break;
+  }
+  jmsg("%a: found %s\n", ea, idiom_steps[f.step].name);
+}
+
+idiom_matcher_t::idiom_matcher_t(ea_t _jump) {
+  idiom_thread_t &t = threads[0];
+
+  for (int i = 0; i < V_COUNT; i++)
+    t.vars[i] = -1;
+  t.found = 0;
+  t.first = _jump;
+  t.index_use = BADADDR;
+  t.index_reg = -1;
+  t.element = 0;
+  t.shift = 0;
+  t.is_signed = false;
+  t.absolute = false;
+  t.base_load = BADADDR;
+  t.base_size = 0;
+  nthreads = 1;
+  jump = _jump;
+  progress = 0;
+  pattern_found = false;
+  result = NULL;
+}
+
+void idiom_matcher_t::fork(const idiom_thread_t &t) {
+  if (nthreads < IDIOM_MAX_THREADS)
+    threads[nthreads++] = t;
+}
+
+bool idiom_matcher_t::step_thread(idiom_thread_t &t, const insn_t &insn,
+				  uint32 word) {
+  uint32 forms = enabled_forms(t.found);
+
+  if (insn.itype < PPC_last)
+    forms &= itype_forms[insn.itype] | word_forms;
+  else
+    forms &= word_forms;
+
+  for (size_t i = 0; forms != 0 && i < NFORMS; i++) {
+    const idiom_form_t &f = idiom_forms[i];
+    int vars[2][V_COUNT];
+    int n = 0;
+
+    if ((forms & (1 << i)) == 0)
+      continue;
+    forms &= ~(1 << i);
+    if (f.mask != 0 && (word & f.mask) != f.word)
+      continue;
+    if (!check_layout(insn, t, f))
+      continue;
+    for (int swap = 0; swap <= ((f.flags & FORM_COMMUTE) ? 1 : 0); swap++) {
+      memcpy(vars[n], t.vars, sizeof(t.vars));
+      if (bind_operands(insn, f, vars[n], swap != 0))
+	n++;
+    }
+    if (n == 0)
+      continue;
+    // Both ways fit, the steps after this one will tell which is right
+    if (n == 2) {
+      idiom_thread_t other = t;
+
+      memcpy(other.vars, vars[1], sizeof(other.vars));
+      apply(insn, other, f);
+      fork(other);
+    }
+    memcpy(t.vars, vars[0], sizeof(t.vars));
+    apply(insn, t, f);
+    return true;
+  }
+
+  // Follow the register copies
+  if (insn.itype == PPC_mr) {
+    for (int i = 0; i < V_COUNT; i++) {
+      if (t.vars[i] != -1 && insn.Op1.reg == t.vars[i]) {
+	t.vars[i] = insn.Op2.reg;
+	break;
+      }
+    }
+  }
+  return false;
+}
+
+bool idiom_matcher_t::step(const insn_t &insn, uint32 word) {
+  int n = nthreads;
+  bool progress = false;
+
+  for (int i = 0; i < n; i++)
+    progress |= step_thread(threads[i], insn, word);
+  for (int i = 0; i < nthreads; i++) {
+    if (threads[i].found & STEP(S_LOAD))
+      pattern_found = true;
+    if ((threads[i].found | OPTIONAL_STEPS) == ALL_STEPS) {
+      result = &threads[i];
+      return true;
+    }
+  }
+  if (progress)
+    this->progress++;
+  return false;
+}
@@ -0,0 +1,79 @@
+/*
+ * ppcjt_idioms.hpp -- Jump table idioms of the PowerPC compilers
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+#ifndef __PPCJT_IDIOMS_HPP__
+#define __PPCJT_IDIOMS_HPP__
+
+#include <ida.hpp>
+#include <ua.hpp>
+
+//#define JUMP_DEBUG
+#ifdef JUMP_DEBUG
+#define jmsg msg
+#else
+#define jmsg(...)
+#endif
+
+/* The registers an idiom binds, from the bctr backwards */
+enum idiom_var_t {
+  V_TARGET,  // Moved to CTR
+  V_OFFSET,  // Sign extended table entry, added to the base
+  V_BASE,    // Address of the table
+  V_ENTRY,   // Table entry, as loaded
+  V_SCALED,  // Case number times the entry size
+  V_INDEX,   // Case number
+  V_COUNT
+};
+
+#define IDIOM_MAX_THREADS 8
+
+/* One way of reading the instructions seen so far. A form with
+ * interchangeable operands can bind them both ways, each one gets its own */
+struct idiom_thread_t {
+  int vars[V_COUNT]; // Register bound to each variable, -1 if none yet
+  uint32 found;      // Steps matched
+  ea_t first;        // Lowest address matched
+  ea_t index_use;    // Instruction scaling the case number
+  int index_reg;     // And its register there
+  uchar element;     // Size of the entries
+  uchar shift;       // Of the entries, before they are added to the base
+  bool is_signed;
+  bool absolute;     // The entries are addresses, not offsets from the base
+  ea_t base_load;    // Instruction loading the address of the table
+  uchar base_size;   // And the size of what it loads
+};
+
+/* Matches all the idioms of ppcjt_idioms.cpp at once. It is given the
+ * instructions before the bctr one at a time, in the order they are walked
+ * back, so the walk is done once whatever the number of variants */
+class idiom_matcher_t {
+public:
+  idiom_matcher_t(ea_t jump);
+
+  // 'insn' is decoded from 'word'. Returns true once an idiom is complete
+  bool step(const insn_t &insn, uint32 word);
+
+  ea_t jump;
+  int progress;       // Instructions that matched a step
+  bool pattern_found; // The table load was matched
+  const idiom_thread_t *result;
+
+private:
+  bool step_thread(idiom_thread_t &t, const insn_t &insn, uint32 word);
+  void fork(const idiom_thread_t &t);
+
+  idiom_thread_t threads[IDIOM_MAX_THREADS];
+  int nthreads;
+};
+
+/* Builds the tables step () works from, once before the first match */
+bool idioms_compile(void);
+
+#endif /* __PPCJT_IDIOMS_HPP__ */
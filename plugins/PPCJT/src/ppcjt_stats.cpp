@@ -0,0 +1,113 @@
+/*
+ * ppcjt_stats.cpp -- Counters and timers of the jump table plugin
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+/*
+ * A few counters instead of the text of JUMP_DEBUG, cheap enough to always
+ * be on, so the share of the auto analysis spent in the plugin can be
+ * measured on a whole dump. They are printed when the plugin is run with 1
+ * as argument.
+ */
+
+#if defined(__NT__)
+#include <windows.h>
+#elif defined(__MAC__)
+#include <mach/mach_time.h>
+#else
+#include <time.h>
+#endif
+
+#include "ppcjt_stats.hpp"
+
+#include <kernwin.hpp>
+
+static const char *counter_names[STAT_COUNT] = {
+  "is_switch calls",
+  "jump tables found",
+  "answered from saved results",
+  "tables cut short",
+  "near misses",
+  "fallbacks to the module",
+};
+
+// Recent failures listed by the report
+#define FAILURE_RING	16
+
+static uint64 counters[STAT_COUNT];
+static uint64 total_ns;
+static uint64 slowest_ns;
+static ea_t slowest_ea = BADADDR;
+static ea_t failures[FAILURE_RING];
+static int nfailures; // All of them, the ring has the last FAILURE_RING
+
+/* Nanoseconds from a clock that doesn't jump with the wall time */
+static uint64 monotonic_ns(void) {
+#if defined(__NT__)
+  static LARGE_INTEGER frequency;
+  LARGE_INTEGER now;
+
+  if (frequency.QuadPart == 0)
+    QueryPerformanceFrequency(&frequency);
+  QueryPerformanceCounter(&now);
+  return (uint64) (now.QuadPart / frequency.QuadPart) * 1000000000 +
+    (uint64) (now.QuadPart % frequency.QuadPart) * 1000000000 / frequency.QuadPart;
+#elif defined(__MAC__)
+  static mach_timebase_info_data_t timebase;
+
+  if (timebase.denom == 0)
+    mach_timebase_info(&timebase);
+  return mach_absolute_time() * timebase.numer / timebase.denom;
+#else
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64) now.tv_sec * 1000000000 + now.tv_nsec;
+#endif
+}
+
+void stats_count(stats_counter_t counter) {
+  counters[counter]++;
+}
+
+uint64 stats_start(void) {
+  return monotonic_ns();
+}
+
+void stats_stop(ea_t ea, uint64 started) {
+  uint64 elapsed = monotonic_ns() - started;
+
+  total_ns += elapsed;
+  if (elapsed > slowest_ns) {
+    slowest_ns = elapsed;
+    slowest_ea = ea;
+  }
+}
+
+void stats_failure(ea_t ea) {
+  failures[nfailures % FAILURE_RING] = ea;
+  nfailures++;
+}
+
+void stats_report(void) {
+  uint64 calls = counters[STAT_CALLS];
+
+  msg("PPCJT stats: %.3f ms in is_switch, %.3f us per call\n",
+      total_ns / 1000000.0, calls > 0 ? total_ns / 1000.0 / calls : 0.0);
+  if (slowest_ea != BADADDR)
+    msg("  slowest call %.3f ms, at 0x%a\n", slowest_ns / 1000000.0, slowest_ea);
+  for (int i = 0; i < STAT_COUNT; i++)
+    msg("  %-28s %10llu\n", counter_names[i], counters[i]);
+
+  if (nfailures == 0)
+    return;
+  msg("  last failures, newest first:");
+  for (int i = 1; i <= FAILURE_RING && i <= nfailures; i++)
+    msg(" 0x%a", failures[(nfailures - i) % FAILURE_RING]);
+  msg("\n");
+}
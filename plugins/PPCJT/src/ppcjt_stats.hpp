@@ -0,0 +1,37 @@
+/*
+ * ppcjt_stats.hpp -- Counters and timers of the jump table plugin
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+#ifndef __PPCJT_STATS_HPP__
+#define __PPCJT_STATS_HPP__
+
+#include <ida.hpp>
+
+enum stats_counter_t {
+  STAT_CALLS,      // is_switch asked by the analysis
+  STAT_FOUND,      // Jump tables matched, by the analysis or the sweep
+  STAT_CACHED,     // Matches answered by a saved result
+  STAT_CUT,        // Tables cut short by the check of their entries
+  STAT_NEAR_MISS,  // The table load was found, not the rest
+  STAT_FALLBACK,   // Handed to the processor module's is_switch
+  STAT_COUNT
+};
+
+void stats_count(stats_counter_t counter);
+
+/* Time of the is_switch calls, from stats_start () to stats_stop () */
+uint64 stats_start(void);
+void stats_stop(ea_t ea, uint64 started);
+
+/* Kept in a ring, the last few are listed by stats_report () */
+void stats_failure(ea_t ea);
+
+void stats_report(void);
+
+#endif /* __PPCJT_STATS_HPP__ */
@@ -0,0 +1,376 @@
+/*
+ * gen_corpus.cpp -- Synthetic PPC64 functions for the headless benchmarks
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+/*
+ * Writes a raw image and its sidecar. The functions form a call tree: the
+ * children of function i are i * fanout + 1 to i * fanout + fanout, so the
+ * fan-out gives the width of the tree and the number of functions its
+ * depth. Function 0 is the entry point. A function body is drawn from the
+ * instruction mix, with a compare and a forward conditional branch in place
+ * of some of its instructions, and a bl to each of its children. The same
+ * seed always gives the same corpus.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#define BASE 0x10000
+#define FRAME_SIZE 112
+
+typedef unsigned int uint32;
+
+static unsigned long long seed = 1;
+
+/* xorshift64, so the corpus doesn't depend on the libc's rand () */
+static uint32
+next_random (uint32 n)
+{
+  seed ^= seed << 13;
+  seed ^= seed >> 7;
+  seed ^= seed << 17;
+  return (uint32) (seed % n);
+}
+
+/* A scratch register, r3 to r12 */
+static uint32
+reg (void)
+{
+  return 3 + next_random (10);
+}
+
+static uint32
+d_form (uint32 op, uint32 rt, uint32 ra, int d)
+{
+  return (op << 26) | (rt << 21) | (ra << 16) | (d & 0xFFFF);
+}
+
+static uint32
+x_form (uint32 rt, uint32 ra, uint32 rb, uint32 xo)
+{
+  return (31 << 26) | (rt << 21) | (ra << 16) | (rb << 11) | (xo << 1);
+}
+
+static uint32
+rlwinm (uint32 ra, uint32 rs, uint32 sh, uint32 mb, uint32 me)
+{
+  return (21 << 26) | (rs << 21) | (ra << 16) | (sh << 11) | (mb << 6) | (me << 1);
+}
+
+static uint32
+md_form (uint32 ra, uint32 rs, uint32 sh, uint32 mb, uint32 xo)
+{
+  return (30 << 26) | (rs << 21) | (ra << 16) | ((sh & 0x1F) << 11) |
+      ((mb & 0x1F) << 6) | (mb & 0x20) | (xo << 2) | ((sh >> 5) << 1);
+}
+
+/* A stack slot of the frame */
+static int
+slot (int size)
+{
+  return 0x70 + size * next_random (16);
+}
+
+typedef uint32 (*encoder_t) (void);
+
+static uint32 e_add (void) { return x_form (reg (), reg (), reg (), 266); }
+static uint32 e_addi (void) { return d_form (14, reg (), reg (), (int) next_random (0x200) - 0x100); }
+static uint32 e_addis (void) { return d_form (15, reg (), reg (), next_random (0x100)); }
+static uint32 e_li (void) { return d_form (14, reg (), 0, (int) next_random (0x200) - 0x100); }
+static uint32 e_lis (void) { return d_form (15, reg (), 0, next_random (0x100)); }
+static uint32 e_ori (void) { return d_form (24, reg (), reg (), next_random (0x10000)); }
+static uint32 e_oris (void) { return d_form (25, reg (), reg (), next_random (0x10000)); }
+static uint32 e_and (void) { return x_form (reg (), reg (), reg (), 28); }
+static uint32 e_xor (void) { return x_form (reg (), reg (), reg (), 316); }
+static uint32 e_mr (void) { uint32 rs = reg (); return x_form (rs, reg (), rs, 444); }
+static uint32 e_lbz (void) { return d_form (34, reg (), 1, slot (1)); }
+static uint32 e_lhz (void) { return d_form (40, reg (), 1, slot (2)); }
+static uint32 e_lha (void) { return d_form (42, reg (), 1, slot (2)); }
+static uint32 e_lwz (void) { return d_form (32, reg (), 1, slot (4)); }
+static uint32 e_ld (void) { return d_form (58, reg (), 1, slot (8)); }
+static uint32 e_stb (void) { return d_form (38, reg (), 1, slot (1)); }
+static uint32 e_sth (void) { return d_form (44, reg (), 1, slot (2)); }
+static uint32 e_stw (void) { return d_form (36, reg (), 1, slot (4)); }
+static uint32 e_std (void) { return d_form (62, reg (), 1, slot (8)); }
+static uint32 e_lwzx (void) { return x_form (reg (), reg (), reg (), 23); }
+static uint32 e_stwx (void) { return x_form (reg (), reg (), reg (), 151); }
+static uint32 e_ldx (void) { return x_form (reg (), reg (), reg (), 21); }
+static uint32 e_slwi (void) { uint32 n = 1 + next_random (30); return rlwinm (reg (), reg (), n, 0, 31 - n); }
+static uint32 e_srwi (void) { uint32 n = 1 + next_random (30); return rlwinm (reg (), reg (), 32 - n, n, 31); }
+static uint32 e_clrlwi (void) { return rlwinm (reg (), reg (), 0, 1 + next_random (30), 31); }
+static uint32 e_rlwinm (void) { return rlwinm (reg (), reg (), next_random (32), next_random (32), next_random (32)); }
+static uint32 e_srdi (void) { uint32 n = 1 + next_random (62); return md_form (reg (), reg (), 64 - n, n, 0); }
+static uint32 e_clrldi (void) { return md_form (reg (), reg (), 0, 1 + next_random (62), 0); }
+
+static const struct {
+  const char *mnemonic;
+  encoder_t encode;
+  int weight; // In the default mix, roughly what a compiler emits
+} encoders[] = {
+  {"add", e_add, 4},
+  {"addi", e_addi, 6},
+  {"addis", e_addis, 1},
+  {"li", e_li, 4},
+  {"lis", e_lis, 1},
+  {"ori", e_ori, 1},
+  {"oris", e_oris, 1},
+  {"and", e_and, 1},
+  {"xor", e_xor, 1},
+  {"mr", e_mr, 4},
+  {"lbz", e_lbz, 2},
+  {"lhz", e_lhz, 1},
+  {"lha", e_lha, 1},
+  {"lwz", e_lwz, 6},
+  {"ld", e_ld, 4},
+  {"stb", e_stb, 1},
+  {"sth", e_sth, 1},
+  {"stw", e_stw, 4},
+  {"std", e_std, 3},
+  {"lwzx", e_lwzx, 1},
+  {"stwx", e_stwx, 1},
+  {"ldx", e_ldx, 1},
+  {"slwi", e_slwi, 2},
+  {"srwi", e_srwi, 1},
+  {"clrlwi", e_clrlwi, 2},
+  {"rlwinm", e_rlwinm, 1},
+  {"srdi", e_srdi, 1},
+  {"clrldi", e_clrldi, 2},
+  {NULL, NULL, 0}
+};
+
+static vector<int> weights;
+static int total_weight;
+
+/* "lwz:4,add:2" gives the weight of each mnemonic, the others get 0 */
+static bool
+parse_mix (const char *mix)
+{
+  string spec = mix;
+  size_t pos = 0;
+
+  for (int i = 0; encoders[i].mnemonic; i++)
+    weights[i] = 0;
+  while (pos < spec.length ()) {
+    size_t end = spec.find (',', pos);
+    string item = spec.substr (pos, end == string::npos ? string::npos : end - pos);
+    size_t colon = item.find (':');
+    string mnemonic = item.substr (0, colon);
+    int weight = colon == string::npos ? 1 : atoi (item.c_str () + colon + 1);
+    int i;
+
+    for (i = 0; encoders[i].mnemonic && mnemonic != encoders[i].mnemonic; i++)
+      ;
+    if (encoders[i].mnemonic == NULL) {
+      fprintf (stderr, "Unknown mnemonic in the mix : %s\n", mnemonic.c_str ());
+      return false;
+    }
+    weights[i] = weight;
+    if (end == string::npos)
+      break;
+    pos = end + 1;
+  }
+  return true;
+}
+
+static uint32
+random_instruction (void)
+{
+  int pick = (int) next_random (total_weight);
+  int i;
+
+  for (i = 0; pick >= weights[i]; i++)
+    pick -= weights[i];
+  return encoders[i].encode ();
+}
+
+/* A conditional branch with BO 12 (true) or 4 (false) on a cr7 bit */
+static uint32
+branch (uint32 from, uint32 to)
+{
+  uint32 bo = next_random (2) ? 12 : 4;
+  uint32 bi = 28 + next_random (3);
+
+  return (16 << 26) | (bo << 21) | (bi << 16) | ((to - from) & 0xFFFC);
+}
+
+struct Function {
+  uint32 start;
+  vector<uint32> code;
+};
+
+static void
+generate (Function &func, int size, int branch_density, vector<uint32> &calls)
+{
+  // Index of the instructions the branches go to, patched once the body
+  // is done and its end is known
+  vector<pair<size_t, int> > branches;
+  size_t body, i;
+  size_t next_call = 0;
+
+  if (!calls.empty ()) {
+    func.code.push_back (0x7C0802A6); // mflr %r0
+    func.code.push_back (d_form (62, 0, 1, 16)); // std %r0, 0x10(%sp)
+    func.code.push_back (d_form (62, 1, 1, -FRAME_SIZE) | 1); // stdu %sp, -0x70(%sp)
+  }
+  body = func.code.size ();
+
+  for (i = 0; (int) i < size; i++) {
+    // The calls are spread evenly in the body, the branches stay clear of
+    // them so every function is exactly as long as main () planned
+    size_t call_at = next_call < calls.size () ?
+        (next_call + 1) * size / (calls.size () + 1) : size;
+
+    if (i >= call_at) {
+      uint32 ea = func.start + 4 * func.code.size ();
+
+      func.code.push_back ((18 << 26) | ((calls[next_call] - ea) & 0x3FFFFFC) | 1);
+      next_call++;
+    } else if ((int) next_random (100) < branch_density && i + 1 < call_at) {
+      // cmpwi cr7, rX, imm
+      func.code.push_back (d_form (11, 7 << 2, reg (), next_random (0x40)));
+      branches.push_back (make_pair (func.code.size (), (int) (i + 3 + next_random (8))));
+      func.code.push_back (0);
+      i++;
+    } else {
+      func.code.push_back (random_instruction ());
+    }
+  }
+
+  // Forward branches past the end of the body go to the epilogue
+  for (i = 0; i < branches.size (); i++) {
+    size_t target = min (body + branches[i].second, func.code.size ());
+
+    func.code[branches[i].first] = branch (func.start + 4 * branches[i].first,
+        func.start + 4 * target);
+  }
+
+  if (!calls.empty ()) {
+    func.code.push_back (d_form (14, 1, 1, FRAME_SIZE)); // addi %sp, %sp, 0x70
+    func.code.push_back (d_form (58, 0, 1, 16)); // ld %r0, 0x10(%sp)
+    func.code.push_back (0x7C0803A6); // mtlr %r0
+  }
+  func.code.push_back (0x4E800020); // blr
+}
+
+static void
+usage (const char *program)
+{
+  fprintf (stderr,
+      "Usage: %s [options] image sidecar\n"
+      "  -f count    Number of functions (64)\n"
+      "  -s size     Mean number of instructions of a function body (64)\n"
+      "  -b percent  Chance of a compare and branch at each instruction (10)\n"
+      "  -c fanout   Calls of a function to the next level of the tree (2)\n"
+      "  -m mix      Weight of each mnemonic, \"lwz:4,add:2\" (a compiler's)\n"
+      "  -r seed     Seed of the random generator (1)\n",
+      program);
+}
+
+int
+main (int argc, char *argv[])
+{
+  int count = 64;
+  int size = 64;
+  int branch_density = 10;
+  int fanout = 2;
+  const char *mix = NULL;
+  vector<Function> functions;
+  uint32 ea = BASE;
+  FILE *image, *sidecar;
+  int i, c;
+
+  while ((c = getopt (argc, argv, "f:s:b:c:m:r:h")) != -1) {
+    switch (c) {
+      case 'f': count = atoi (optarg); break;
+      case 's': size = atoi (optarg); break;
+      case 'b': branch_density = atoi (optarg); break;
+      case 'c': fanout = atoi (optarg); break;
+      case 'm': mix = optarg; break;
+      case 'r': seed = strtoull (optarg, NULL, 0); break;
+      default: usage (argv[0]); return 1;
+    }
+  }
+  if (optind != argc - 2 || count < 1 || size < 1 || fanout < 0 || seed == 0) {
+    usage (argv[0]);
+    return 1;
+  }
+
+  for (i = 0; encoders[i].mnemonic; i++)
+    weights.push_back (encoders[i].weight);
+  if (mix != NULL && !parse_mix (mix))
+    return 1;
+  total_weight = 0;
+  for (i = 0; encoders[i].mnemonic; i++)
+    total_weight += weights[i];
+  if (total_weight == 0) {
+    fprintf (stderr, "The mix is empty\n");
+    return 1;
+  }
+
+  // The sizes first, the calls need the addresses of the children
+  functions.resize (count);
+  vector<int> sizes (count);
+  for (i = 0; i < count; i++) {
+    int children = 0;
+
+    sizes[i] = size / 2 + (int) next_random (size + 1);
+    if (sizes[i] < 1)
+      sizes[i] = 1;
+    for (int j = 1; j <= fanout && i * fanout + j < count; j++)
+      children++;
+    functions[i].start = ea;
+    // Prologue, body with its calls, epilogue
+    ea += 4 * ((children ? 6 : 0) + sizes[i] + children + 1);
+  }
+  for (i = 0; i < count; i++) {
+    vector<uint32> calls;
+
+    for (int j = 1; j <= fanout && i * fanout + j < count; j++)
+      calls.push_back (functions[i * fanout + j].start);
+    generate (functions[i], sizes[i] + (int) calls.size (), branch_density, calls);
+  }
+
+  image = fopen (argv[optind], "wb");
+  sidecar = fopen (argv[optind + 1], "w");
+  if (image == NULL || sidecar == NULL) {
+    fprintf (stderr, "Can't open %s for writing\n", image == NULL ? argv[optind] : argv[optind + 1]);
+    return 1;
+  }
+  fprintf (sidecar, "# gen_corpus -f %d -s %d -b %d -c %d%s%s\n", count, size,
+      branch_density, fanout, mix ? " -m " : "", mix ? mix : "");
+  fprintf (sidecar, "segment .text 0x%X 0x%X code\n", BASE, ea);
+  fprintf (sidecar, "entry 0x%X\n", BASE);
+  for (i = 0; i < count; i++) {
+    Function &func = functions[i];
+    uint32 end = func.start + 4 * func.code.size ();
+
+    for (size_t j = 0; j < func.code.size (); j++) {
+      unsigned char bytes[4];
+
+      bytes[0] = (unsigned char) (func.code[j] >> 24);
+      bytes[1] = (unsigned char) (func.code[j] >> 16);
+      bytes[2] = (unsigned char) (func.code[j] >> 8);
+      bytes[3] = (unsigned char) func.code[j];
+      fwrite (bytes, 1, sizeof(bytes), image);
+    }
+    fprintf (sidecar, "func 0x%X 0x%X func_%d\n", func.start, end, i);
+  }
+  fclose (image);
+  fclose (sidecar);
+  fprintf (stderr, "%d functions, %d instructions\n", count, (ea - BASE) / 4);
+  return 0;
+}
@@ -0,0 +1,456 @@
+/*
+ * jt_bench.cpp -- Checks and times the PPCJT matcher on known switches
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+/*
+ * The corpus below is the code of switches, up to the bctr, with what PPCJT
+ * must find in it. The sequences are loaded one after the other in the
+ * stand-in's database, each followed by its default case, and analyzed
+ * once. Each one is then decoded back from the bctr and given to the
+ * idioms of ppcjt_idioms.cpp like PPCJT's walk would, and the case number
+ * it finds is bounded by ppcjt_bounds.cpp.
+ *
+ * A conditional branch to itself, or a "b" to itself, goes to the default
+ * case: the loader patches it. Nothing a compiler emits for a switch
+ * branches to itself. The other branches stay as they are, so a sequence
+ * can have blocks and paths of its own to the table.
+ *
+ * Any difference with the expected results is printed and the exit status
+ * is 1. With -n, the matcher and the bound walk are then timed on the whole
+ * corpus, the instructions decoded beforehand.
+ */
+
+#include "headless.hpp"
+#include "ppcjt_idioms.hpp"
+#include "ppcjt_bounds.hpp"
+
+#include <time.h>
+#include <unistd.h>
+
+#define BASE 0x10000
+#define MAX_WORDS 24
+
+static uint32
+d_form (uint32 op, uint32 rt, uint32 ra, int d)
+{
+  return (op << 26) | (rt << 21) | (ra << 16) | (d & 0xFFFF);
+}
+
+static uint32
+x_form (uint32 rt, uint32 ra, uint32 rb, uint32 xo)
+{
+  return (31 << 26) | (rt << 21) | (ra << 16) | (rb << 11) | (xo << 1);
+}
+
+static uint32
+rlwinm (uint32 ra, uint32 rs, uint32 sh, uint32 mb, uint32 me)
+{
+  return (21 << 26) | (rs << 21) | (ra << 16) | (sh << 11) | (mb << 6) | (me << 1);
+}
+
+/* rldic with xo 2, rldicr with xo 1 and 'mb' its ME */
+static uint32
+md_form (uint32 ra, uint32 rs, uint32 sh, uint32 mb, uint32 xo)
+{
+  return (30 << 26) | (rs << 21) | (ra << 16) | ((sh & 0x1F) << 11) |
+      ((mb & 0x1F) << 6) | (mb & 0x20) | (xo << 2) | ((sh >> 5) << 1);
+}
+
+#define CMPLWI(crf, ra, n)	((10 << 26) | ((crf) << 23) | ((ra) << 16) | (n))
+#define CMPLDI(crf, ra, n)	(CMPLWI (crf, ra, n) | (1 << 21))
+#define CMPWI(crf, ra, n)	((11 << 26) | ((crf) << 23) | ((ra) << 16) | ((n) & 0xFFFF))
+#define BC(bo, bi, off)		((16 << 26) | ((bo) << 21) | ((bi) << 16) | ((off) & 0xFFFC))
+#define BGT(crf, off)		BC (12, 4 * (crf) + 1, off)
+#define BGE(crf, off)		BC (4, 4 * (crf), off)
+#define BLE(crf, off)		BC (4, 4 * (crf) + 1, off)
+#define BEQ(crf, off)		BC (12, 4 * (crf) + 2, off)
+#define B(off)			((18 << 26) | ((off) & 0x3FFFFFC))
+#define MR(ra, rs)		x_form (rs, ra, rs, 444)
+#define EXTSW(ra, rs)		x_form (rs, ra, 0, 986)
+#define ADD(rt, ra, rb)		x_form (rt, ra, rb, 266)
+#define ADDI(rt, ra, n)		d_form (14, rt, ra, n)
+#define LI(rt, n)		d_form (14, rt, 0, n)
+#define SUBFIC(rt, ra, n)	d_form (8, rt, ra, n)
+#define LWZ(rt, d, ra)		d_form (32, rt, ra, d)
+#define LD(rt, d, ra)		d_form (58, rt, ra, d)
+#define LBZX(rt, ra, rb)	x_form (rt, ra, rb, 87)
+#define LHZX(rt, ra, rb)	x_form (rt, ra, rb, 279)
+#define LHAX(rt, ra, rb)	x_form (rt, ra, rb, 343)
+#define LWZX(rt, ra, rb)	x_form (rt, ra, rb, 23)
+#define LWAX(rt, ra, rb)	x_form (rt, ra, rb, 341)
+#define LDX(rt, ra, rb)		x_form (rt, ra, rb, 21)
+#define SLWI(ra, rs, n)		rlwinm (ra, rs, n, 0, 31 - (n))
+#define CLRLWI(ra, rs, n)	rlwinm (ra, rs, 0, n, 31)
+#define RLDIC(ra, rs, sh, mb)	md_form (ra, rs, sh, mb, 2)
+#define RLDICR(ra, rs, sh, me)	md_form (ra, rs, sh, me, 1)
+#define MTCTR(rs)		((31 << 26) | ((rs) << 21) | (9 << 16) | (467 << 1))
+#define BCTR			0x4E800420
+#define BLR			0x4E800020
+
+// To the default case, patched by the loader
+#define BGT_DEFAULT(crf)	BGT (crf, 0)
+#define BGE_DEFAULT(crf)	BGE (crf, 0)
+#define B_DEFAULT		B (0)
+
+// The load, add and jump of GCC's 64 bit tables of words, on rIndex
+#define GCC_TABLE(index) \
+  LD (9, 0x8, 2), RLDICR (0, index, 2, 61), LWAX (0, 9, 0), \
+  ADD (0, 0, 9), MTCTR (0), BCTR
+
+#define NO_DEFAULT -1
+#define DEFAULT -2 // The case after the bctr
+
+struct Sequence {
+  const char *name;
+  uint32 words[MAX_WORDS]; // Up to the bctr
+  bool found;
+  int element;
+  int shift;
+  bool is_signed;
+  bool absolute;
+  int ncases;
+  int defjump; // Index of the instruction in 'words', or one of the above
+  int index; // Register the table is indexed with, the switch's expression
+};
+
+static const Sequence corpus[] = {
+  // The only pattern of the first versions of PPCJT
+  {"gcc rldic", {CMPLWI (7, 3, 7), BGT_DEFAULT (7), LWZ (11, 0x10, 2),
+      RLDIC (9, 3, 2, 30), LWZX (0, 9, 11), EXTSW (0, 0), ADD (0, 0, 11),
+      MTCTR (0), BCTR},
+    true, 4, 0, true, false, 8, DEFAULT, 3},
+  {"gcc lwax", {CMPLWI (7, 4, 11), BGT_DEFAULT (7), LD (9, 0x8, 2),
+      RLDICR (0, 4, 2, 61), LWAX (0, 9, 0), ADD (0, 9, 0), MTCTR (0), BCTR},
+    true, 4, 0, true, false, 12, DEFAULT, 4},
+  {"gcc ble to the table", {CMPLWI (7, 3, 4), BLE (7, 8), B_DEFAULT,
+      GCC_TABLE (3)},
+    true, 4, 0, true, false, 5, 2, 3},
+  {"gcc bge, copied", {CMPLWI (7, 3, 4), BGE_DEFAULT (7), MR (10, 3),
+      GCC_TABLE (10)},
+    true, 4, 0, true, false, 4, DEFAULT, 10},
+  {"gcc cmpldi, extended", {CMPLDI (6, 3, 9), BGT_DEFAULT (6), EXTSW (10, 3),
+      GCC_TABLE (10)},
+    true, 4, 0, true, false, 10, DEFAULT, 10},
+  {"gcc slwi", {CMPLWI (7, 5, 3), BGT_DEFAULT (7), LD (9, 0x8, 2),
+      SLWI (0, 5, 2), LWAX (0, 9, 0), ADD (0, 0, 9), MTCTR (0), BCTR},
+    true, 4, 0, true, false, 4, DEFAULT, 5},
+  {"hoisted compare", {CMPLWI (7, 3, 5), BGT_DEFAULT (7), ADDI (4, 4, 1),
+      ADDI (5, 5, 1), ADDI (6, 6, 1), ADDI (7, 7, 1), ADDI (8, 8, 1),
+      ADDI (4, 4, 1), ADDI (5, 5, 1), ADDI (6, 6, 1), GCC_TABLE (3)},
+    true, 4, 0, true, false, 6, DEFAULT, 3},
+  {"compare in a predecessor block", {CMPLWI (7, 3, 5), BGT_DEFAULT (7),
+      CMPWI (6, 4, 0), BEQ (6, 8), ADDI (5, 5, 1), GCC_TABLE (3)},
+    true, 4, 0, true, false, 6, DEFAULT, 3},
+  {"compare before a jump to the table", {CMPLWI (7, 3, 5), BGT_DEFAULT (7),
+      B (8), BLR, GCC_TABLE (3)},
+    true, 4, 0, true, false, 6, DEFAULT, 3},
+  {"two paths, the larger bound", {CMPWI (6, 4, 0), BEQ (6, 16),
+      CMPLWI (7, 3, 3), BGT_DEFAULT (7), B (12), CMPLWI (7, 3, 9),
+      BGT_DEFAULT (7), GCC_TABLE (3)},
+    true, 4, 0, true, false, 10, DEFAULT, 3},
+  // The switch is on the copy the table reads, not the compared register
+  {"copied, then overwritten", {CMPLWI (7, 3, 5), BGT_DEFAULT (7), MR (10, 3),
+      LI (3, 0), B (8), BLR, GCC_TABLE (10)},
+    true, 4, 0, true, false, 6, DEFAULT, 10},
+  // Found, with the index scaled in its own register: PPC2C can't switch on
+  // the register at the bctr
+  {"scaled in place", {CMPLWI (7, 3, 2), BGT_DEFAULT (7), LD (9, 0x8, 2),
+      RLDICR (3, 3, 2, 61), LWAX (0, 9, 3), ADD (0, 0, 9), MTCTR (0), BCTR},
+    true, 4, 0, true, false, 3, DEFAULT, 3},
+  {"masked", {CLRLWI (10, 3, 29), GCC_TABLE (10)},
+    true, 4, 0, true, false, 8, NO_DEFAULT, 10},
+  {"reversed by subfic", {CMPLWI (7, 3, 6), BGT_DEFAULT (7), SUBFIC (10, 3, 6),
+      GCC_TABLE (10)},
+    true, 4, 0, true, false, 7, DEFAULT, 10},
+  {"snc bytes", {CMPLWI (7, 3, 4), BGT_DEFAULT (7), LD (9, 0x8, 2),
+      LBZX (11, 3, 9), SLWI (11, 11, 2), ADD (0, 11, 9), MTCTR (0), BCTR},
+    true, 1, 2, false, false, 5, DEFAULT, 3},
+  {"snc signed halfwords", {CMPLWI (7, 3, 5), BGT_DEFAULT (7), LD (9, 0x8, 2),
+      ADD (10, 3, 3), LHAX (0, 10, 9), ADD (0, 0, 9), MTCTR (0), BCTR},
+    true, 2, 0, true, false, 6, DEFAULT, 3},
+  {"snc shifted halfwords", {CMPLWI (7, 3, 2), BGT_DEFAULT (7), LD (9, 0x8, 2),
+      RLDICR (10, 3, 1, 62), LHZX (11, 10, 9), SLWI (11, 11, 2), ADD (0, 11, 9),
+      MTCTR (0), BCTR},
+    true, 2, 2, false, false, 3, DEFAULT, 3},
+  {"absolute", {CMPLWI (7, 3, 3), BGT_DEFAULT (7), LD (9, 0x8, 2),
+      RLDICR (10, 3, 3, 60), LDX (0, 10, 9), MTCTR (0), BCTR},
+    true, 8, 0, false, true, 4, DEFAULT, 3},
+  // The matcher finds these, the bound walk must not
+  {"no compare", {GCC_TABLE (3)},
+    false, 0, 0, false, false, 0, NO_DEFAULT, -1},
+  {"other register compared", {CMPLWI (7, 4, 3), BGT_DEFAULT (7), GCC_TABLE (3)},
+    false, 0, 0, false, false, 0, NO_DEFAULT, -1},
+  {"overwritten after the compare", {CMPLWI (7, 3, 3), BGT_DEFAULT (7), LI (3, 0),
+      GCC_TABLE (3)},
+    false, 0, 0, false, false, 0, NO_DEFAULT, -1},
+  {"two paths, one compares another register", {CMPWI (6, 4, 0), BEQ (6, 16),
+      CMPLWI (7, 3, 3), BGT_DEFAULT (7), B (12), CMPLWI (7, 4, 9),
+      BGT_DEFAULT (7), GCC_TABLE (3)},
+    false, 0, 0, false, false, 0, NO_DEFAULT, -1},
+  {"two paths, one overwrites the bound", {CMPWI (6, 4, 0), BEQ (6, 16),
+      CMPLWI (7, 3, 3), BGT_DEFAULT (7), B (16), CMPLWI (7, 3, 9),
+      BGT_DEFAULT (7), ADDI (3, 3, 1), GCC_TABLE (3)},
+    false, 0, 0, false, false, 0, NO_DEFAULT, -1},
+  // Not a switch
+  {"call through a pointer", {LD (0, 0, 9), MTCTR (0), BCTR},
+    false, 0, 0, false, false, 0, NO_DEFAULT, -1},
+};
+
+#define NSEQUENCES (sizeof(corpus) / sizeof(corpus[0]))
+
+/* A sequence, loaded and decoded from the bctr back */
+struct Loaded {
+  ea_t start;
+  ea_t jump;
+  ea_t defcase;
+  vector<insn_t> insns;
+  vector<uint32> words;
+};
+
+static double
+now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static size_t
+length (const Sequence &seq)
+{
+  size_t n = 0;
+
+  while (n < MAX_WORDS && seq.words[n] != BCTR)
+    n++;
+  return n + 1;
+}
+
+static void
+put_word (vector<uchar> &bytes, uint32 word)
+{
+  bytes.push_back ((uchar) (word >> 24));
+  bytes.push_back ((uchar) (word >> 16));
+  bytes.push_back ((uchar) (word >> 8));
+  bytes.push_back ((uchar) word);
+}
+
+/* Every sequence as a function of its own, then the analysis */
+static void
+load_corpus (vector<Loaded> &loaded)
+{
+  vector<uchar> bytes;
+  ea_t ea = BASE;
+  size_t i, j;
+
+  loaded.resize (NSEQUENCES);
+  for (i = 0; i < NSEQUENCES; i++) {
+    const Sequence &seq = corpus[i];
+    size_t n = length (seq);
+    ea_t defcase = ea + 4 * n;
+
+    for (j = 0; j < n; j++) {
+      uint32 word = seq.words[j];
+      ea_t from = ea + 4 * j;
+
+      if (word == BGT_DEFAULT ((word >> 18) & 7) || word == BGE_DEFAULT ((word >> 18) & 7))
+        word |= (defcase - from) & 0xFFFC;
+      else if (word == B_DEFAULT)
+        word |= (defcase - from) & 0x3FFFFFC;
+      put_word (bytes, word);
+    }
+    put_word (bytes, LI (3, 0));
+    put_word (bytes, BLR);
+
+    loaded[i].start = ea;
+    loaded[i].jump = ea + 4 * (n - 1);
+    loaded[i].defcase = defcase;
+    ea = defcase + 8;
+  }
+
+  hl_reset_database ();
+  hl_add_segment (".text", BASE, ea, SEG_CODE);
+  hl_load_bytes (BASE, &bytes[0], bytes.size ());
+  for (i = 0; i < NSEQUENCES; i++) {
+    hl_create_func (loaded[i].start, loaded[i].defcase + 8);
+    hl_queue_function (loaded[i].start);
+  }
+  hl_analyze ();
+
+  // Straight back from the bctr: the table is read in the block of the bctr,
+  // which is all the matcher needs. The bound walk follows the xrefs
+  for (i = 0; i < NSEQUENCES; i++) {
+    Loaded &l = loaded[i];
+
+    for (ea = l.jump; ea > l.start; ea -= 4) {
+      if (decode_insn (ea - 4) == 0)
+        break;
+      l.insns.push_back (cmd);
+      l.words.push_back (get_long (ea - 4));
+    }
+  }
+}
+
+static bool
+match (const Loaded &l, idiom_thread_t &result)
+{
+  idiom_matcher_t m (l.jump);
+  size_t i;
+
+  for (i = 0; i < l.insns.size (); i++) {
+    if (m.step (l.insns[i], l.words[i])) {
+      result = *m.result;
+      return true;
+    }
+  }
+  return false;
+}
+
+/* What PPCJT would find in the sequence, false if it wouldn't be a switch */
+static bool
+find (const Loaded &l, Sequence &got)
+{
+  idiom_thread_t t;
+  index_bound_t bound;
+
+  memset (&got, 0, sizeof(got));
+  got.defjump = NO_DEFAULT;
+  got.index = -1;
+  if (!match (l, t) || !find_index_bound (t.index_use, t.index_reg, bound))
+    return false;
+  got.found = true;
+  got.element = t.element;
+  got.shift = t.shift;
+  got.is_signed = t.is_signed;
+  got.absolute = t.absolute;
+  got.ncases = (int) bound.last + 1;
+  got.index = t.index_reg;
+  if (bound.defjump == l.defcase)
+    got.defjump = DEFAULT;
+  else if (bound.defjump != BADADDR)
+    got.defjump = (int) ((bound.defjump - l.start) / 4);
+  return true;
+}
+
+static void
+print_result (const char *what, const Sequence &s)
+{
+  if (!s.found) {
+    printf ("  %s: no switch\n", what);
+    return;
+  }
+  printf ("  %s: %d byte %s%s entries, shift %d, %d cases on r%d, default ",
+      what, s.element, s.is_signed ? "signed " : "",
+      s.absolute ? "absolute" : "relative", s.shift, s.ncases, s.index);
+  if (s.defjump == DEFAULT)
+    printf ("after the bctr\n");
+  else if (s.defjump == NO_DEFAULT)
+    printf ("none\n");
+  else
+    printf ("at instruction %d\n", s.defjump);
+}
+
+static bool
+same (const Sequence &a, const Sequence &b)
+{
+  if (a.found != b.found)
+    return false;
+  return !a.found || (a.element == b.element && a.shift == b.shift &&
+      a.is_signed == b.is_signed && a.absolute == b.absolute &&
+      a.ncases == b.ncases && a.defjump == b.defjump && a.index == b.index);
+}
+
+static void
+usage (const char *program)
+{
+  fprintf (stderr,
+      "Usage: %s [options]\n"
+      "  -n runs     Times the corpus is matched for the timings (0, none)\n"
+      "  -v          Print the result of every sequence\n",
+      program);
+}
+
+int
+main (int argc, char *argv[])
+{
+  int runs = 0;
+  bool verbose = false;
+  vector<Loaded> loaded;
+  size_t instructions = 0;
+  int failures = 0;
+  double start, matcher, bounds;
+  size_t i;
+  int c, r;
+
+  while ((c = getopt (argc, argv, "n:vh")) != -1) {
+    switch (c) {
+      case 'n': runs = atoi (optarg); break;
+      case 'v': verbose = true; break;
+      default: usage (argv[0]); return 1;
+    }
+  }
+  if (optind != argc || runs < 0) {
+    usage (argv[0]);
+    return 1;
+  }
+
+  hl_set_output (stdout);
+  idioms_compile ();
+  load_corpus (loaded);
+
+  for (i = 0; i < NSEQUENCES; i++) {
+    Sequence got;
+
+    find (loaded[i], got);
+    instructions += loaded[i].insns.size () + 1;
+    if (same (corpus[i], got)) {
+      if (verbose) {
+        printf ("ok   %s\n", corpus[i].name);
+        print_result ("found", got);
+      }
+      continue;
+    }
+    printf ("FAIL %s\n", corpus[i].name);
+    print_result ("expected", corpus[i]);
+    print_result ("found", got);
+    failures++;
+  }
+  printf ("%d of %d sequences as expected\n", (int) NSEQUENCES - failures,
+      (int) NSEQUENCES);
+  if (runs == 0)
+    return failures != 0;
+
+  // The matcher alone, on the decoded instructions
+  start = now ();
+  for (r = 0; r < runs; r++) {
+    for (i = 0; i < NSEQUENCES; i++) {
+      idiom_thread_t t;
+
+      match (loaded[i], t);
+    }
+  }
+  matcher = now () - start;
+
+  // The whole of it, the bound walk decodes from the database
+  start = now ();
+  for (r = 0; r < runs; r++) {
+    for (i = 0; i < NSEQUENCES; i++) {
+      Sequence got;
+
+      find (loaded[i], got);
+    }
+  }
+  bounds = now () - start;
+
+  printf ("matcher: %.1f ns per sequence, %.1f M instructions/s\n",
+      matcher * 1e9 / (runs * NSEQUENCES), runs * instructions / matcher / 1e6);
+  printf ("matcher and bounds: %.1f ns per sequence, %.0f sequences/s\n",
+      bounds * 1e9 / (runs * NSEQUENCES), runs * NSEQUENCES / bounds);
+  return failures != 0;
+}
@@ -0,0 +1,339 @@
+/*
+ * allins.hpp -- Instruction types of the PowerPC module, headless stand-in
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+#ifndef __HEADLESS_ALLINS_HPP__
+#define __HEADLESS_ALLINS_HPP__
+
+/* Same order as the IDA 6.0 PPC module, so PPC_b is 13 like PPC2C expects:
+ * the basic instructions, then the simplified mnemonics after
+ * PPC_last_basic. The names double as the mnemonics the stand-in prints */
+#define HEADLESS_PPC_INSTRUCTIONS \
+  X(null) \
+  X(add) \
+  X(addc) \
+  X(adde) \
+  X(addi) \
+  X(addic) \
+  X(addis) \
+  X(addme) \
+  X(addze) \
+  X(and) \
+  X(andc) \
+  X(andi) \
+  X(andis) \
+  X(b) \
+  X(bc) \
+  X(bcctr) \
+  X(bclr) \
+  X(cmp) \
+  X(cmpi) \
+  X(cmpl) \
+  X(cmpli) \
+  X(cntlzw) \
+  X(cntlzd) \
+  X(crand) \
+  X(crandc) \
+  X(creqv) \
+  X(crnand) \
+  X(crnor) \
+  X(cror) \
+  X(crorc) \
+  X(crxor) \
+  X(dcba) \
+  X(dcbf) \
+  X(dcbi) \
+  X(dcbst) \
+  X(dcbt) \
+  X(dcbtst) \
+  X(dcbz) \
+  X(divd) \
+  X(divdu) \
+  X(divw) \
+  X(divwu) \
+  X(eieio) \
+  X(eqv) \
+  X(extsb) \
+  X(extsh) \
+  X(extsw) \
+  X(fabs) \
+  X(fadd) \
+  X(fadds) \
+  X(fcfid) \
+  X(fcmpo) \
+  X(fcmpu) \
+  X(fctid) \
+  X(fctidz) \
+  X(fctiw) \
+  X(fctiwz) \
+  X(fdiv) \
+  X(fdivs) \
+  X(fmadd) \
+  X(fmadds) \
+  X(fmr) \
+  X(fmsub) \
+  X(fmsubs) \
+  X(fmul) \
+  X(fmuls) \
+  X(fnabs) \
+  X(fneg) \
+  X(fnmadd) \
+  X(fnmadds) \
+  X(fnmsub) \
+  X(fnmsubs) \
+  X(fres) \
+  X(frsp) \
+  X(frsqrte) \
+  X(fsel) \
+  X(fsqrt) \
+  X(fsqrts) \
+  X(fsub) \
+  X(fsubs) \
+  X(icbi) \
+  X(isync) \
+  X(lbz) \
+  X(lbzu) \
+  X(lbzux) \
+  X(lbzx) \
+  X(ld) \
+  X(ldarx) \
+  X(ldu) \
+  X(ldux) \
+  X(ldx) \
+  X(lfd) \
+  X(lfdu) \
+  X(lfdux) \
+  X(lfdx) \
+  X(lfs) \
+  X(lfsu) \
+  X(lfsux) \
+  X(lfsx) \
+  X(lha) \
+  X(lhau) \
+  X(lhaux) \
+  X(lhax) \
+  X(lhbrx) \
+  X(lhz) \
+  X(lhzu) \
+  X(lhzux) \
+  X(lhzx) \
+  X(lmw) \
+  X(lswi) \
+  X(lswx) \
+  X(lwa) \
+  X(lwarx) \
+  X(lwaux) \
+  X(lwax) \
+  X(lwbrx) \
+  X(lwz) \
+  X(lwzu) \
+  X(lwzux) \
+  X(lwzx) \
+  X(mcrf) \
+  X(mcrfs) \
+  X(mcrxr) \
+  X(mfcr) \
+  X(mffs) \
+  X(mfmsr) \
+  X(mfspr) \
+  X(mfsr) \
+  X(mfsrin) \
+  X(mftb) \
+  X(mtcrf) \
+  X(mtfsb0) \
+  X(mtfsb1) \
+  X(mtfsf) \
+  X(mtfsfi) \
+  X(mtmsr) \
+  X(mtmsrd) \
+  X(mtspr) \
+  X(mtsr) \
+  X(mtsrd) \
+  X(mtsrin) \
+  X(mulhd) \
+  X(mulhdu) \
+  X(mulhw) \
+  X(mulhwu) \
+  X(mulld) \
+  X(mulli) \
+  X(mullw) \
+  X(nand) \
+  X(neg) \
+  X(nor) \
+  X(or) \
+  X(orc) \
+  X(ori) \
+  X(oris) \
+  X(rfi) \
+  X(rfid) \
+  X(rldcl) \
+  X(rldcr) \
+  X(rldic) \
+  X(rldicl) \
+  X(rldicr) \
+  X(rldimi) \
+  X(rlwimi) \
+  X(rlwinm) \
+  X(rlwnm) \
+  X(sc) \
+  X(slbia) \
+  X(slbie) \
+  X(sld) \
+  X(slw) \
+  X(srad) \
+  X(sradi) \
+  X(sraw) \
+  X(srawi) \
+  X(srd) \
+  X(srw) \
+  X(stb) \
+  X(stbu) \
+  X(stbux) \
+  X(stbx) \
+  X(std) \
+  X(stdcx) \
+  X(stdu) \
+  X(stdux) \
+  X(stdx) \
+  X(stfd) \
+  X(stfdu) \
+  X(stfdux) \
+  X(stfdx) \
+  X(stfiwx) \
+  X(stfs) \
+  X(stfsu) \
+  X(stfsux) \
+  X(stfsx) \
+  X(sth) \
+  X(sthbrx) \
+  X(sthu) \
+  X(sthux) \
+  X(sthx) \
+  X(stmw) \
+  X(stswi) \
+  X(stswx) \
+  X(stw) \
+  X(stwbrx) \
+  X(stwcx) \
+  X(stwu) \
+  X(stwux) \
+  X(stwx) \
+  X(subf) \
+  X(subfc) \
+  X(subfe) \
+  X(subfic) \
+  X(subfme) \
+  X(subfze) \
+  X(sync) \
+  X(td) \
+  X(tdi) \
+  X(tlbia) \
+  X(tlbie) \
+  X(tlbsync) \
+  X(tw) \
+  X(twi) \
+  X(xor) \
+  X(xori) \
+  X(xoris) \
+  X(last_basic) \
+  X(cmpwi) \
+  X(cmpw) \
+  X(cmplwi) \
+  X(cmplw) \
+  X(cmpdi) \
+  X(cmpd) \
+  X(cmpldi) \
+  X(cmpld) \
+  X(trap) \
+  X(tdeq) \
+  X(tdeqi) \
+  X(twlgt) \
+  X(twllt) \
+  X(tweq) \
+  X(twlgti) \
+  X(twllti) \
+  X(tweqi) \
+  X(nop) \
+  X(not) \
+  X(mr) \
+  X(li) \
+  X(lis) \
+  X(la) \
+  X(mtctr) \
+  X(mfctr) \
+  X(mtlr) \
+  X(mflr) \
+  X(mtxer) \
+  X(mfxer) \
+  X(mtcr) \
+  X(blt) \
+  X(ble) \
+  X(beq) \
+  X(bge) \
+  X(bgt) \
+  X(bne) \
+  X(bso) \
+  X(bns) \
+  X(bdnz) \
+  X(bdz) \
+  X(bdnzt) \
+  X(bdnzf) \
+  X(bdzt) \
+  X(bdzf) \
+  X(bctr) \
+  X(bctrl) \
+  X(blr) \
+  X(blrl) \
+  X(bltlr) \
+  X(blelr) \
+  X(beqlr) \
+  X(bgelr) \
+  X(bgtlr) \
+  X(bnelr) \
+  X(bltctr) \
+  X(blectr) \
+  X(beqctr) \
+  X(bgectr) \
+  X(bgtctr) \
+  X(bnectr) \
+  X(sub) \
+  X(subc) \
+  X(extlwi) \
+  X(extrwi) \
+  X(inslwi) \
+  X(insrwi) \
+  X(rotlwi) \
+  X(rotrwi) \
+  X(rotlw) \
+  X(slwi) \
+  X(srwi) \
+  X(clrlwi) \
+  X(clrrwi) \
+  X(clrlslwi) \
+  X(extldi) \
+  X(extrdi) \
+  X(insrdi) \
+  X(rotldi) \
+  X(rotrdi) \
+  X(rotld) \
+  X(sldi) \
+  X(srdi) \
+  X(clrldi) \
+  X(clrrdi) \
+  X(clrlsldi) \
+  X(last)
+
+enum
+{
+#define X(name) PPC_##name,
+  HEADLESS_PPC_INSTRUCTIONS
+#undef X
+};
+
+#endif /* __HEADLESS_ALLINS_HPP__ */
@@ -0,0 +1,11 @@
+/*
+ * auto.hpp -- Headless IDA SDK stand-in, declared in ida.hpp
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+#include "ida.hpp"
@@ -0,0 +1,11 @@
+/*
+ * fpro.h -- Headless IDA SDK stand-in, declared in pro.h
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+#include "pro.h"
@@ -0,0 +1,489 @@
+/*
+ * ida.hpp -- Headless stand-in for the subset of the IDA SDK the plugins use
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+/*
+ * Only what PPC2C, PPCJT, fix_rtoc and PPCAltivec call is declared here,
+ * with the 6.0 SDK's names and signatures so they build unchanged. Every
+ * other SDK header of this directory includes this one, so the plugins can
+ * include whichever they were written against.
+ */
+
+#ifndef __HEADLESS_IDA_HPP__
+#define __HEADLESS_IDA_HPP__
+
+#include "pro.h"
+
+/* ida.hpp */
+struct idainfo {
+  char tag[3];
+  ushort version;
+  char procName[8];
+  ea_t beginEA; // Entry point
+  ea_t minEA;
+  ea_t maxEA;
+  uchar indent; // Indentation of the instructions
+  uchar comment; // Indentation of the comments
+  uchar s_cmtflg;
+};
+extern idainfo inf;
+
+#define SW_ALLCMT 0x02 // inf.s_cmtflg: show all comments
+inline bool showAllComments(void) { return (inf.s_cmtflg & SW_ALLCMT) != 0; }
+
+/* kernwin.hpp */
+int msg(const char *format, ...);
+int vmsg(const char *format, va_list va);
+void warning(const char *format, ...);
+void info(const char *format, ...);
+char *askfile_c(int savefile, const char *defval, const char *format, ...);
+int askyn_c(int deflt, const char *format, ...);
+ea_t get_screen_ea(void);
+bool jumpto(ea_t ea, int opnum = -1);
+void show_wait_box(const char *format, ...);
+void hide_wait_box(void);
+bool wasBreak(void);
+
+/* bytes.hpp */
+#define MS_VAL  0x000000FF // The byte value
+#define FF_IVL  0x00000100 // The byte has a value
+#define MS_CLS  0x00000600
+#define FF_CODE 0x00000600
+#define FF_DATA 0x00000400
+#define FF_TAIL 0x00000200
+#define FF_UNK  0x00000000
+#define FF_COMM 0x00000800
+#define FF_REF  0x00001000
+#define FF_LINE 0x00002000
+#define FF_NAME 0x00004000
+#define FF_LABL 0x00008000
+#define FF_FLOW 0x00010000
+#define FF_FUNC 0x04000000 // Start of a function (code)
+#define DT_TYPE 0xF0000000
+#define FF_BYTE 0x00000000
+#define FF_WORD 0x10000000
+#define FF_DWRD 0x20000000
+#define FF_QWRD 0x30000000
+#define FF_ASCI 0x50000000
+
+flags_t getFlags(ea_t ea);
+flags_t get_flags_novalue(ea_t ea);
+inline bool isCode(flags_t F) { return (F & MS_CLS) == FF_CODE; }
+inline bool isData(flags_t F) { return (F & MS_CLS) == FF_DATA; }
+inline bool isTail(flags_t F) { return (F & MS_CLS) == FF_TAIL; }
+inline bool isHead(flags_t F) { return (F & FF_DATA) != 0; }
+inline bool isUnknown(flags_t F) { return (F & MS_CLS) == FF_UNK; }
+inline bool hasValue(flags_t F) { return (F & FF_IVL) != 0; }
+inline bool has_cmt(flags_t F) { return (F & FF_COMM) != 0; }
+inline bool has_name(flags_t F) { return (F & FF_NAME) != 0; }
+inline bool has_dummy_name(flags_t F) { return (F & FF_LABL) != 0; }
+inline bool has_any_name(flags_t F) { return (F & (FF_NAME | FF_LABL)) != 0; }
+inline bool hasRef(flags_t F) { return (F & FF_REF) != 0; }
+inline bool isFlow(flags_t F) { return (F & FF_FLOW) != 0; }
+inline bool isFunc(flags_t F) { return isCode(F) && (F & FF_FUNC) != 0; }
+inline bool isASCII(flags_t F) { return isData(F) && (F & DT_TYPE) == FF_ASCI; }
+bool isEnabled(ea_t ea);
+bool isLoaded(ea_t ea);
+uchar get_byte(ea_t ea);
+ushort get_word(ea_t ea);
+uint32 get_long(ea_t ea);
+uint64 get_qword(ea_t ea);
+bool get_many_bytes(ea_t ea, void *buf, ssize_t size);
+void patch_byte(ea_t ea, uval_t x);
+void patch_long(ea_t ea, uval_t x);
+ea_t get_item_head(ea_t ea);
+ea_t get_item_end(ea_t ea);
+ea_t next_head(ea_t ea, ea_t maxea);
+ea_t prev_head(ea_t ea, ea_t minea);
+ea_t nextthat(ea_t ea, ea_t maxea, bool (idaapi *testf)(flags_t F, void *ud), void *ud = NULL);
+bool do_unknown(ea_t ea, int flags);
+bool doASCI(ea_t ea, ssize_t length);
+#define ASCSTR_C 0
+size_t get_max_ascii_length(ea_t ea, int strtype, bool only_ascii = false);
+bool get_ascii_contents(ea_t ea, size_t len, int type, char *buf, size_t bufsize);
+
+/* name.hpp */
+#define SN_CHECK 0x01
+#define SN_NOWARN 0x20
+char *get_name(ea_t from, ea_t ea, char *buf, size_t bufsize);
+char *get_true_name(ea_t from, ea_t ea, char *buf, size_t bufsize);
+bool set_name(ea_t ea, const char *name, int flag = 0);
+ea_t get_name_ea(ea_t from, const char *name);
+
+/* lines.hpp */
+ssize_t get_cmt(ea_t ea, bool rptble, char *buf, size_t bufsize);
+bool set_cmt(ea_t ea, const char *comm, bool rptble);
+ssize_t tag_remove(const char *instr, char *buf, size_t bufsize);
+ssize_t tag_strlen(const char *line);
+#define COLOR_DEFAULT 0x01
+#define COLOR_REGCMT 0x02
+#define COLOR_RPTCMT 0x03
+#define COLOR_AUTOCMT 0x04
+#define COLOR_INSN 0x05
+#define COLOR_SYMBOL 0x09
+#define COLOR_REG 0x21
+extern int gl_comm; // Set by the output callbacks to show the comments
+bool MakeLine(const char *contents, int indent = -1);
+
+/* area.hpp */
+class area_t {
+public:
+  ea_t startEA;
+  ea_t endEA;
+  area_t() : startEA(0), endEA(0) {}
+  area_t(ea_t s, ea_t e) : startEA(s), endEA(e) {}
+  bool contains(ea_t ea) const { return startEA <= ea && ea < endEA; }
+  asize_t size(void) const { return endEA - startEA; }
+};
+
+/* funcs.hpp */
+#define FUNC_NORET 0x0001
+#define FUNC_LIB 0x0004
+class func_t : public area_t {
+public:
+  ushort flags;
+  func_t() : flags(0) {}
+};
+func_t *get_func(ea_t ea);
+char *get_func_name(ea_t ea, char *buf, size_t bufsize);
+bool add_func(ea_t ea1, ea_t ea2);
+bool del_func(ea_t ea);
+int get_func_num(ea_t ea);
+size_t get_func_qty(void);
+func_t *getn_func(size_t n);
+func_t *get_next_func(ea_t ea);
+func_t *get_prev_func(ea_t ea);
+void reanalyze_function(func_t *pfn, ea_t ea1 = 0, ea_t ea2 = BADADDR, bool analyze_parents = false);
+
+/* segment.hpp */
+#define SEG_NORM 0
+#define SEG_CODE 2
+#define SEG_DATA 3
+#define SEG_BSS 9
+#define SEGPERM_EXEC 1
+#define SEGPERM_WRITE 2
+#define SEGPERM_READ 4
+class segment_t : public area_t {
+public:
+  uval_t name; // Index of the name, as in the SDK
+  uchar type;
+  uchar perm;
+  uchar bitness; // 0: 16, 1: 32, 2: 64 bits
+  segment_t() : name(0), type(SEG_NORM), perm(0), bitness(2) {}
+};
+segment_t *getseg(ea_t ea);
+segment_t *getnseg(int n);
+int get_segm_qty(void);
+segment_t *get_segm_by_name(const char *name);
+ssize_t get_true_segm_name(const segment_t *s, char *buf, size_t bufsize);
+
+/* xref.hpp */
+enum cref_t { fl_U, fl_CF = 16, fl_CN, fl_JF, fl_JN, fl_USobsolete, fl_F };
+enum dref_t { dr_U, dr_O, dr_W, dr_R, dr_T, dr_I };
+#define XREF_USER 0x20
+#define XREF_TAIL 0x40
+#define XREF_BASE 0x80
+#define XREF_MASK 0x1F
+#define XREF_ALL 0x00
+#define XREF_FAR 0x01
+#define XREF_DATA 0x02
+struct xrefblk_t {
+  ea_t from;
+  ea_t to;
+  uchar iscode;
+  uchar type;
+  uchar user;
+  // Position in the list being walked
+  int flags;
+  void *list;
+  size_t n;
+  bool first_from(ea_t from, int flags);
+  bool next_from(void);
+  bool first_to(ea_t to, int flags);
+  bool next_to(void);
+};
+bool add_cref(ea_t from, ea_t to, cref_t type);
+bool del_cref(ea_t from, ea_t to, bool expand);
+bool add_dref(ea_t from, ea_t to, dref_t type);
+void del_dref(ea_t from, ea_t to);
+ea_t get_first_cref_from(ea_t from);
+ea_t get_next_cref_from(ea_t from, ea_t current);
+ea_t get_first_cref_to(ea_t to);
+ea_t get_next_cref_to(ea_t to, ea_t current);
+ea_t get_first_dref_from(ea_t from);
+
+/* netnode.hpp */
+class netnode {
+public:
+  netnode() : netnodenumber(BADNODE) {}
+  netnode(nodeidx_t num) : netnodenumber(num) {}
+  netnode(const char *name, size_t namlen = 0, bool do_create = false);
+  operator nodeidx_t() const { return netnodenumber; }
+  bool create(const char *name, size_t namlen = 0);
+  bool create(void);
+  void kill(void);
+  ssize_t name(char *buf, size_t bufsize) const;
+  ssize_t supval(nodeidx_t alt, void *buf, size_t bufsize, char tag = 'S') const;
+  bool supset(nodeidx_t alt, const void *value, size_t length = 0, char tag = 'S');
+  bool supdel(nodeidx_t alt, char tag = 'S');
+  nodeidx_t sup1st(char tag = 'S') const;
+  nodeidx_t supnxt(nodeidx_t cur, char tag = 'S') const;
+  nodeidx_t altval(nodeidx_t alt, char tag = 'A') const;
+  bool altset(nodeidx_t alt, nodeidx_t value, char tag = 'A');
+  bool altdel(nodeidx_t alt, char tag = 'A');
+  nodeidx_t alt1st(char tag = 'A') const;
+  nodeidx_t altnxt(nodeidx_t cur, char tag = 'A') const;
+  ssize_t valobj(void *buf, size_t bufsize) const;
+  bool set(const void *value, size_t length);
+  ssize_t hashval(const char *idx, void *buf, size_t bufsize, char tag = 'H') const;
+  bool hashset(const char *idx, const void *value, size_t length = 0, char tag = 'H');
+  bool hashdel(const char *idx, char tag = 'H');
+private:
+  nodeidx_t netnodenumber;
+};
+
+/* ua.hpp */
+#define UA_MAXOP 6
+typedef uchar optype_t;
+const optype_t o_void = 0, o_reg = 1, o_mem = 2, o_phrase = 3, o_displ = 4,
+  o_imm = 5, o_far = 6, o_near = 7, o_idpspec0 = 8, o_idpspec1 = 9,
+  o_idpspec2 = 10, o_idpspec3 = 11, o_idpspec4 = 12, o_idpspec5 = 13;
+const char dt_byte = 0, dt_word = 1, dt_dword = 2, dt_float = 3, dt_double = 4,
+  dt_tbyte = 5, dt_packreal = 6, dt_qword = 7, dt_byte16 = 8, dt_code = 9;
+#define OF_NO_BASE_DISP 0x80
+#define OF_OUTER_DISP 0x40
+#define OF_NUMBER 0x10
+#define OF_SHOW 0x08 // The operand is shown
+class op_t {
+public:
+  char n; // Number of the operand
+  optype_t type;
+  char offb;
+  char offo;
+  uchar flags;
+  bool showed(void) const { return (flags & OF_SHOW) != 0; }
+  void set_showed(void) { flags |= OF_SHOW; }
+  void clr_showed(void) { flags &= ~OF_SHOW; }
+  char dtyp;
+  union { uint16 reg; uint16 phrase; };
+  union { uval_t value; struct { uint16 low; uint16 high; } value_shorts; };
+  union { ea_t addr; struct { uint16 low; uint16 high; } addr_shorts; };
+  union { ea_t specval; struct { uint16 low; uint16 high; } specval_shorts; };
+  char specflag1;
+  char specflag2;
+  char specflag3;
+  char specflag4;
+};
+class insn_t {
+public:
+  ea_t cs;
+  ea_t ip;
+  ea_t ea;
+  uint16 itype;
+  uint16 size;
+  union {
+    uint16 auxpref;
+    struct { uchar low; uchar high; } auxpref_chars;
+  };
+  char segpref;
+  char insnpref;
+  op_t Operands[UA_MAXOP];
+  char flags;
+};
+#define Op1 Operands[0]
+#define Op2 Operands[1]
+#define Op3 Operands[2]
+#define Op4 Operands[3]
+#define Op5 Operands[4]
+#define Op6 Operands[5]
+extern insn_t cmd;
+int ua_ana0(ea_t ea);
+int decode_insn(ea_t ea);
+ea_t decode_prev_insn(ea_t ea);
+const char *ua_mnem(ea_t ea, char *buf, size_t bufsize);
+bool ua_outop2(ea_t ea, char *buf, size_t bufsize, int n, int flags = 0);
+inline bool ua_outop(ea_t ea, char *buf, size_t bufsize, int n) { return ua_outop2(ea, buf, bufsize, n, 0); }
+bool generate_disasm_line(ea_t ea, char *buf, size_t bufsize, int flags = 0);
+
+/* Output of instructions, for the custom_out and custom_outop callbacks */
+#define OOF_SIGNED 0x0002
+#define OOFW_IMM 0x0000
+void init_output_buffer(char *buf, size_t bufsize);
+const char *term_output_buffer(void);
+void OutChar(char c);
+void OutLine(const char *str);
+void out_line(const char *str, uchar color);
+void out_register(const char *str);
+void out_symbol(char c);
+void out_keyword(const char *str);
+bool out_one_operand(int n);
+void OutMnem(int width = 8, const char *postfix = NULL);
+void OutValue(op_t &x, int outflags = 0);
+bool out_name_expr(op_t &x, ea_t ea, uval_t off = BADADDR);
+
+/* nalt.hpp: switches */
+#define SWI_SPARSE 0x00000001
+#define SWI_V32 0x00000002
+#define SWI_J32 0x00000004
+#define SWI_VSPLIT 0x00000008
+#define SWI_DEFAULT 0x00000010
+#define SWI_END_IN_TBL 0x00000020
+#define SWI_JMP_INV 0x00000040
+#define SWI_SHIFT_MASK 0x00000180
+#define SWI_ELBASE 0x00000200
+#define SWI_JSIZE 0x00000400
+#define SWI_VSIZE 0x00000800
+#define SWI_SEPARATE 0x00001000
+#define SWI_SIGNED 0x00002000
+#define SWI_CUSTOM 0x00004000
+#define SWI_EXTENDED 0x00008000
+#define SWI2_INDIRECT 0x0001
+#define SWI2_SUBTRACT 0x0002
+class switch_info_ex_t {
+public:
+  size_t cb;
+  int flags;
+  int flags2;
+  ushort ncases;
+  ea_t defjump;
+  ea_t jumps;
+  union { ea_t values; ea_t lowcase; };
+  ea_t startea;
+  ea_t elbase;
+  int regnum;
+  char regdtyp;
+  uval_t custom;
+  switch_info_ex_t() { clear (); }
+  void clear(void) { memset((void *) this, 0, sizeof(*this)); cb = sizeof(*this); regnum = -1; }
+  int get_shift(void) const { return (flags & SWI_SHIFT_MASK) >> 7; }
+  void set_shift(int shift) { flags &= ~SWI_SHIFT_MASK; flags |= ((shift & 3) << 7); }
+  int get_jtable_element_size(void) const {
+    switch (flags & (SWI_J32 | SWI_JSIZE)) {
+      case 0: return 2;
+      case SWI_J32: return 4;
+      case SWI_JSIZE: return 1;
+      default: return 8;
+    }
+  }
+  void set_jtable_element_size(int size) {
+    flags &= ~(SWI_J32 | SWI_JSIZE);
+    switch (size) {
+      case 4: flags |= SWI_J32; break;
+      case 1: flags |= SWI_JSIZE; break;
+      case 8: flags |= SWI_J32 | SWI_JSIZE; break;
+    }
+  }
+  bool is_indirect(void) const { return (flags & SWI_EXTENDED) != 0 && (flags2 & SWI2_INDIRECT) != 0; }
+  ea_t get_jtable_size(void) const { return ncases; }
+};
+ssize_t get_switch_info_ex(ea_t ea, switch_info_ex_t *buf, size_t bufsize);
+void set_switch_info_ex(ea_t ea, const switch_info_ex_t *si);
+void del_switch_info_ex(ea_t ea);
+bool create_switch_table(ea_t insn_ea, const switch_info_ex_t *si);
+void create_switch_xrefs(ea_t insn_ea, const switch_info_ex_t *si);
+
+/* idp.hpp */
+#define PLFM_PPC 12
+#define CUSTOM_CMD_ITYPE 0x8000
+typedef int idaapi hook_cb_t(void *user_data, int notification_code, va_list va);
+enum hook_type_t { HT_IDP, HT_UI, HT_DBG, HT_IDB, HT_LAST };
+bool hook_to_notification_point(hook_type_t hook_type, hook_cb_t *cb, void *user_data);
+int unhook_from_notification_point(hook_type_t hook_type, hook_cb_t *cb, void *user_data = NULL);
+struct processor_t {
+  int version;
+  int id;
+  uint32 flag;
+  int cnbits;
+  int dnbits;
+  bool (idaapi *is_switch)(switch_info_ex_t *si);
+  enum idp_notify {
+    init,
+    term,
+    newprc,
+    newasm,
+    newfile,
+    oldfile,
+    newbinary,
+    endbinary,
+    newseg,
+    assemble,
+    obsolete_makemicro,
+    outlabel,
+    rename,
+    may_show_sreg,
+    closebase,
+    load_idasgn,
+    coagulate,
+    auto_empty,
+    auto_queue_empty,
+    func_bounds,
+    may_be_func,
+    is_sane_insn,
+    is_jump_func,
+    gen_regvar_def,
+    setsgr,
+    set_compiler,
+    is_basic_block_end,
+    reglink,
+    get_vxd_name,
+    custom_ana,
+    custom_out,
+    custom_emu,
+    custom_outop,
+    custom_mnem,
+  };
+  int notify(idp_notify event_code, ...);
+};
+extern processor_t ph;
+
+/* auto.hpp */
+typedef int atype_t;
+const atype_t AU_UNK = 10, AU_CODE = 20, AU_WEAK = 25, AU_PROC = 30, AU_TAIL = 35,
+  AU_TRSP = 38, AU_USED = 40, AU_TYPE = 50, AU_LIBF = 60, AU_LBF2 = 70,
+  AU_LBF3 = 80, AU_CHLB = 90, AU_FINAL = 200;
+void auto_mark_range(ea_t start, ea_t end, atype_t type);
+inline void auto_mark(ea_t ea, atype_t type) { auto_mark_range(ea, ea + 1, type); }
+bool autoWait(void);
+void noUsed(ea_t ea);
+bool auto_make_code(ea_t ea);
+bool auto_make_proc(ea_t ea);
+
+/* loader.hpp */
+#define IDP_INTERFACE_VERSION 76
+#define PLUGIN_MOD 0x0001
+#define PLUGIN_DRAW 0x0002
+#define PLUGIN_SEG 0x0004
+#define PLUGIN_UNL 0x0008
+#define PLUGIN_HIDE 0x0010
+#define PLUGIN_DBG 0x0020
+#define PLUGIN_PROC 0x0040
+#define PLUGIN_FIX 0x0080
+#define PLUGIN_SKIP 0
+#define PLUGIN_OK 1
+#define PLUGIN_KEEP 2
+struct plugin_t {
+  int version;
+  int flags;
+  int (idaapi *init)(void);
+  void (idaapi *term)(void);
+  void (idaapi *run)(int arg);
+  char *comment;
+  char *help;
+  char *wanted_name;
+  char *wanted_hotkey;
+};
+
+/* offset.hpp */
+#define REF_OFF8 0
+#define REF_OFF16 1
+#define REF_OFF32 2
+#define REF_OFF64 9
+bool op_offset(ea_t ea, int n, uint32 reftype, ea_t target = BADADDR, ea_t base = 0, sval_t tdelta = 0);
+
+#endif /* __HEADLESS_IDA_HPP__ */
@@ -0,0 +1,142 @@
+/*
+ * pro.h -- Basic types of the headless IDA SDK stand-in
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+#ifndef __HEADLESS_PRO_H__
+#define __HEADLESS_PRO_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <string>
+
+#define idaapi
+#define ida_export
+#define ida_local
+
+typedef unsigned char uchar;
+typedef unsigned short ushort;
+typedef unsigned int uint;
+typedef int8_t int8;
+typedef uint8_t uint8;
+typedef int16_t int16;
+typedef uint16_t uint16;
+typedef int32_t int32;
+typedef uint32_t uint32;
+typedef int64_t int64;
+typedef uint64_t uint64;
+
+/* The plugins are built for the 64-bit address kernel (__EA64__) */
+typedef uint64 ea_t;
+typedef uint64 uval_t;
+typedef int64 sval_t;
+typedef uint64 asize_t;
+typedef uint32 flags_t;
+typedef ea_t nodeidx_t;
+
+#define BADADDR ea_t(-1)
+#define BADNODE nodeidx_t(-1)
+#define MAXSTR 1024
+
+/* Like the SDK's, a plain array: &v.front() is the storage, even for bool */
+template <class T> class qvector {
+public:
+  typedef T *iterator;
+  typedef const T *const_iterator;
+
+  qvector() : array(NULL), n(0), alloc(0) {}
+  qvector(const qvector<T> &other) : array(NULL), n(0), alloc(0) { *this = other; }
+  ~qvector() { delete [] array; }
+  qvector<T> &operator=(const qvector<T> &other) {
+    if (this != &other) {
+      clear ();
+      reserve (other.n);
+      for (size_t i = 0; i < other.n; i++)
+        array[i] = other.array[i];
+      n = other.n;
+    }
+    return *this;
+  }
+
+  size_t size(void) const { return n; }
+  bool empty(void) const { return n == 0; }
+  T &operator[](size_t i) { return array[i]; }
+  const T &operator[](size_t i) const { return array[i]; }
+  T &front(void) { return array[0]; }
+  T &back(void) { return array[n - 1]; }
+  iterator begin(void) { return array; }
+  iterator end(void) { return array + n; }
+  const_iterator begin(void) const { return array; }
+  const_iterator end(void) const { return array + n; }
+
+  void reserve(size_t count) {
+    if (count <= alloc)
+      return;
+    T *grown = new T[count];
+    for (size_t i = 0; i < n; i++)
+      grown[i] = array[i];
+    delete [] array;
+    array = grown;
+    alloc = count;
+  }
+  void resize(size_t count, const T &value = T()) {
+    if (count > alloc)
+      reserve (count > alloc * 2 ? count : alloc * 2);
+    for (size_t i = n; i < count; i++)
+      array[i] = value;
+    n = count;
+  }
+  void push_back(const T &value) { resize (n + 1, value); }
+  void pop_back(void) { n--; }
+  void clear(void) { n = 0; }
+
+private:
+  T *array;
+  size_t n;
+  size_t alloc;
+};
+
+class qstring : public std::string {
+public:
+  qstring() {}
+  qstring(const char *s) : std::string(s) {}
+  qstring(const std::string &s) : std::string(s) {}
+};
+
+/* Formats understand %a, the SDK's conversion for an ea_t in hex */
+int qsnprintf(char *buf, size_t size, const char *format, ...);
+int qvsnprintf(char *buf, size_t size, const char *format, va_list va);
+char *qstrncpy(char *dst, const char *src, size_t dstsize);
+char *qstrncat(char *dst, const char *src, size_t dstsize);
+char *qstrdup(const char *string);
+inline const char *qstrstr(const char *s, const char *x) { return strstr(s, x); }
+inline int qstrcmp(const char *a, const char *b) { return strcmp(a, b); }
+inline size_t qstrlen(const char *s) { return strlen(s); }
+inline void *qalloc(size_t size) { return malloc(size); }
+inline void qfree(void *ptr) { free(ptr); }
+inline void *qrealloc(void *ptr, size_t size) { return realloc(ptr, size); }
+
+template <class T> inline T qmin(const T &a, const T &b) { return a < b ? a : b; }
+template <class T> inline T qmax(const T &a, const T &b) { return a > b ? a : b; }
+
+/* fpro.h */
+FILE *qfopen(const char *file, const char *mode);
+int qfclose(FILE *fp);
+ssize_t qfread(FILE *fp, void *buf, size_t n);
+ssize_t qfwrite(FILE *fp, const void *buf, size_t n);
+int qfprintf(FILE *fp, const char *format, ...);
+int qvfprintf(FILE *fp, const char *format, va_list va);
+int qfseek(FILE *fp, long offset, int whence);
+long qftell(FILE *fp);
+
+#endif /* __HEADLESS_PRO_H__ */
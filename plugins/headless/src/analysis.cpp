@@ -0,0 +1,174 @@
+/*
+ * analysis.cpp -- Auto analysis of the headless IDA SDK stand-in
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+/*
+ * A small part of what the IDA kernel does after loading: follow the code
+ * from the entry point and the known functions, mark the instructions,
+ * create the code xrefs and the functions of the calls, and ask
+ * ph.is_switch() about every bctr so PPCJT resolves the jump tables.
+ */
+
+#include "headless.hpp"
+
+#include <set>
+
+static vector<ea_t> queue; // Functions to analyze
+static bool analyzing;
+
+void
+hl_queue_function (ea_t ea)
+{
+  queue.push_back (ea);
+}
+
+/* The dummy name IDA gives the referenced places, loc_ and sub_ */
+static void
+label (ea_t ea)
+{
+  if (!has_name (get_flags_novalue (ea)))
+    hl_set_flags (ea, FF_LABL, 0);
+}
+
+static ea_t
+near_target (void)
+{
+  int i;
+
+  for (i = 0; i < UA_MAXOP && cmd.Operands[i].type != o_void; i++)
+    if (cmd.Operands[i].type == o_near)
+      return cmd.Operands[i].addr;
+  return BADADDR;
+}
+
+static bool
+resolve_switch (ea_t ea, vector<ea_t> &pending)
+{
+  switch_info_ex_t si;
+  xrefblk_t xb;
+
+  if (ph.is_switch == NULL || !ph.is_switch (&si))
+    return false;
+  set_switch_info_ex (ea, &si);
+  create_switch_table (ea, &si);
+  create_switch_xrefs (ea, &si);
+  for (bool ok = xb.first_from (ea, XREF_FAR); ok; ok = xb.next_from ()) {
+    if (xb.iscode && xb.type == fl_JN) {
+      label (xb.to);
+      pending.push_back (xb.to);
+    }
+  }
+  return true;
+}
+
+/* Follow the code of the function at 'start', returns where it ends */
+static ea_t
+trace (ea_t start)
+{
+  vector<ea_t> pending;
+  set<ea_t> visited;
+  ea_t end = start;
+
+  pending.push_back (start);
+  while (!pending.empty ()) {
+    ea_t ea = pending.back ();
+    ea_t target;
+    ea_t next;
+    func_t *pfn;
+
+    pending.pop_back ();
+    if (visited.find (ea) != visited.end ())
+      continue;
+    // Another function starts here, this is a tail call
+    pfn = get_func (ea);
+    if (ea != start && pfn != NULL && pfn->startEA == ea)
+      continue;
+    visited.insert (ea);
+
+    if (decode_insn (ea) == 0 || !hl_make_code (ea, cmd.size))
+      continue;
+    next = ea + cmd.size;
+    end = qmax (end, next);
+    target = near_target ();
+
+    if (hl_ppc_is_call ()) {
+      if (target != BADADDR) {
+        add_cref (ea, target, fl_CN);
+        label (target);
+        hl_queue_function (target);
+      }
+      add_cref (ea, next, fl_F);
+      pending.push_back (next);
+      continue;
+    }
+
+    // Fall through first, then the branch
+    if (!hl_ppc_is_stop ())
+      add_cref (ea, next, fl_F);
+    if (target != BADADDR) {
+      add_cref (ea, target, fl_JN);
+      label (target);
+      if (isEnabled (target))
+        pending.push_back (target);
+    } else if (hl_ppc_is_indirect_jump ()) {
+      resolve_switch (ea, pending);
+    }
+    if (!hl_ppc_is_stop ())
+      pending.push_back (next);
+  }
+  return end;
+}
+
+static void
+analyze_queue (void)
+{
+  while (!queue.empty ()) {
+    ea_t ea = queue.back ();
+    func_t *pfn;
+    ea_t end;
+
+    queue.pop_back ();
+    pfn = get_func (ea);
+    if (pfn != NULL && pfn->startEA != ea)
+      continue;
+    if (pfn != NULL && isCode (get_flags_novalue (ea)))
+      continue; // Already done
+    if (!isLoaded (ea))
+      continue;
+    end = trace (ea);
+    if (end > ea && get_func (ea) == NULL)
+      hl_create_func (ea, end);
+  }
+}
+
+void
+hl_analyze_function (ea_t ea)
+{
+  hl_queue_function (ea);
+  // Functions added while analyzing are picked up by the outer loop
+  if (analyzing)
+    return;
+  analyzing = true;
+  analyze_queue ();
+  analyzing = false;
+}
+
+void
+hl_analyze (void)
+{
+  size_t i;
+
+  if (inf.beginEA != BADADDR)
+    hl_queue_function (inf.beginEA);
+  for (i = 0; i < get_func_qty (); i++)
+    hl_queue_function (getn_func (i)->startEA);
+  analyzing = true;
+  analyze_queue ();
+  analyzing = false;
+}
@@ -0,0 +1,1389 @@
+/*
+ * database.cpp -- In-memory database of the headless IDA SDK stand-in
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+#include "headless.hpp"
+
+#include <algorithm>
+#include <map>
+
+/* Bytes and flags of a segment, one flags_t per byte like in the IDB */
+typedef struct {
+  segment_t seg;
+  string name;
+  vector<flags_t> flags;
+} Segment;
+
+typedef struct {
+  ea_t from;
+  ea_t to;
+  uchar type;
+  bool iscode;
+  bool user;
+} Xref;
+
+typedef vector<Xref> XrefList;
+
+typedef struct {
+  string name;
+  map<pair<char, nodeidx_t>, string> sup;
+  map<pair<char, string>, string> hash;
+  string value;
+} Node;
+
+#define FIRST_NODE 0xFF00000000000000ULL // Nodes without an address
+
+idainfo inf;
+processor_t ph;
+
+static vector<Segment *> segments; // Sorted by address
+static Segment *last_segment;
+static map<ea_t, string> names;
+static map<string, ea_t> name_eas;
+static map<ea_t, string> comments[2]; // Regular and repeatable
+static map<ea_t, func_t> functions;
+static vector<func_t *> function_index; // For getn_func(), rebuilt when needed
+static bool function_index_dirty;
+static map<ea_t, XrefList> xrefs_from;
+static map<ea_t, XrefList> xrefs_to;
+static map<nodeidx_t, Node> nodes;
+static map<string, nodeidx_t> node_names;
+static nodeidx_t next_node = FIRST_NODE;
+static map<ea_t, switch_info_ex_t> switches;
+
+static Segment *
+find_segment (ea_t ea)
+{
+  size_t low = 0;
+  size_t high = segments.size ();
+
+  if (last_segment != NULL && last_segment->seg.contains (ea))
+    return last_segment;
+
+  while (low < high) {
+    size_t mid = (low + high) / 2;
+    Segment *s = segments[mid];
+
+    if (ea < s->seg.startEA) {
+      high = mid;
+    } else if (ea >= s->seg.endEA) {
+      low = mid + 1;
+    } else {
+      last_segment = s;
+      return s;
+    }
+  }
+  return NULL;
+}
+
+static flags_t *
+flags_at (ea_t ea)
+{
+  Segment *s = find_segment (ea);
+
+  if (s == NULL)
+    return NULL;
+  return &s->flags[ea - s->seg.startEA];
+}
+
+static bool
+by_start (const Segment *a, const Segment *b)
+{
+  return a->seg.startEA < b->seg.startEA;
+}
+
+void
+hl_reset_database (void)
+{
+  size_t i;
+
+  for (i = 0; i < segments.size (); i++)
+    delete segments[i];
+  segments.clear ();
+  last_segment = NULL;
+  names.clear ();
+  name_eas.clear ();
+  comments[0].clear ();
+  comments[1].clear ();
+  functions.clear ();
+  function_index.clear ();
+  function_index_dirty = false;
+  xrefs_from.clear ();
+  xrefs_to.clear ();
+  nodes.clear ();
+  node_names.clear ();
+  next_node = FIRST_NODE;
+  switches.clear ();
+
+  memset (&inf, 0, sizeof(inf));
+  memcpy (inf.tag, "IDA", 3);
+  inf.version = 600;
+  strcpy (inf.procName, "PPC");
+  inf.beginEA = BADADDR;
+  inf.minEA = BADADDR;
+  inf.maxEA = 0;
+  inf.indent = 16;
+  inf.comment = 40;
+
+  ph.version = IDP_INTERFACE_VERSION;
+  ph.id = PLFM_PPC;
+  ph.cnbits = 8;
+  ph.dnbits = 8;
+  ph.is_switch = NULL;
+}
+
+segment_t *
+hl_add_segment (const char *name, ea_t start, ea_t end, uchar type)
+{
+  Segment *s;
+
+  if (end <= start || find_segment (start) != NULL || find_segment (end - 1) != NULL)
+    return NULL;
+
+  s = new Segment;
+  s->seg.startEA = start;
+  s->seg.endEA = end;
+  s->seg.type = type;
+  s->seg.perm = SEGPERM_READ | (type == SEG_CODE ? SEGPERM_EXEC : SEGPERM_WRITE);
+  s->seg.bitness = 2;
+  s->name = name;
+  s->flags.resize ((size_t) (end - start), 0);
+  segments.push_back (s);
+  sort (segments.begin (), segments.end (), by_start);
+  for (size_t i = 0; i < segments.size (); i++)
+    segments[i]->seg.name = i;
+
+  inf.minEA = qmin (inf.minEA, start);
+  inf.maxEA = qmax (inf.maxEA, end);
+  return &s->seg;
+}
+
+void
+hl_set_segment (segment_t *seg, const char *name, uchar type)
+{
+  Segment *s = segments[seg->name];
+
+  s->name = name;
+  seg->type = type;
+  seg->perm = SEGPERM_READ | (type == SEG_CODE ? SEGPERM_EXEC : SEGPERM_WRITE);
+}
+
+void
+hl_load_bytes (ea_t ea, const uchar *bytes, size_t size)
+{
+  size_t i;
+
+  for (i = 0; i < size; i++) {
+    flags_t *F = flags_at (ea + i);
+
+    if (F != NULL)
+      *F = (*F & ~MS_VAL) | FF_IVL | bytes[i];
+  }
+}
+
+void
+hl_set_flags (ea_t ea, flags_t set, flags_t clear)
+{
+  flags_t *F = flags_at (ea);
+
+  if (F != NULL)
+    *F = (*F & ~clear) | set;
+}
+
+void
+hl_set_entry (ea_t ea)
+{
+  inf.beginEA = ea;
+}
+
+/*
+ * Bytes and flags
+ */
+
+flags_t
+getFlags (ea_t ea)
+{
+  flags_t *F = flags_at (ea);
+
+  return F == NULL ? 0 : *F;
+}
+
+flags_t
+get_flags_novalue (ea_t ea)
+{
+  return getFlags (ea) & ~MS_VAL;
+}
+
+bool
+isEnabled (ea_t ea)
+{
+  return find_segment (ea) != NULL;
+}
+
+bool
+isLoaded (ea_t ea)
+{
+  return hasValue (getFlags (ea));
+}
+
+uchar
+get_byte (ea_t ea)
+{
+  return (uchar) (getFlags (ea) & MS_VAL);
+}
+
+/* The guest is big-endian, whatever the host is */
+ushort
+get_word (ea_t ea)
+{
+  return (ushort) ((get_byte (ea) << 8) | get_byte (ea + 1));
+}
+
+uint32
+get_long (ea_t ea)
+{
+  Segment *s = find_segment (ea);
+
+  if (s != NULL && ea + 4 <= s->seg.endEA) {
+    const flags_t *F = &s->flags[ea - s->seg.startEA];
+
+    return ((F[0] & MS_VAL) << 24) | ((F[1] & MS_VAL) << 16) |
+        ((F[2] & MS_VAL) << 8) | (F[3] & MS_VAL);
+  }
+  return ((uint32) get_word (ea) << 16) | get_word (ea + 2);
+}
+
+uint64
+get_qword (ea_t ea)
+{
+  return ((uint64) get_long (ea) << 32) | get_long (ea + 4);
+}
+
+bool
+get_many_bytes (ea_t ea, void *buf, ssize_t size)
+{
+  uchar *bytes = (uchar *) buf;
+  bool loaded = true;
+  ssize_t i;
+
+  for (i = 0; i < size; i++) {
+    flags_t F = getFlags (ea + i);
+
+    loaded &= hasValue (F);
+    bytes[i] = (uchar) (F & MS_VAL);
+  }
+  return loaded;
+}
+
+void
+patch_byte (ea_t ea, uval_t x)
+{
+  uchar byte = (uchar) x;
+
+  hl_load_bytes (ea, &byte, 1);
+}
+
+void
+patch_long (ea_t ea, uval_t x)
+{
+  uchar bytes[4];
+
+  bytes[0] = (uchar) (x >> 24);
+  bytes[1] = (uchar) (x >> 16);
+  bytes[2] = (uchar) (x >> 8);
+  bytes[3] = (uchar) x;
+  hl_load_bytes (ea, bytes, sizeof(bytes));
+}
+
+ea_t
+get_item_head (ea_t ea)
+{
+  Segment *s = find_segment (ea);
+
+  if (s == NULL)
+    return ea;
+  while (ea > s->seg.startEA && isTail (s->flags[ea - s->seg.startEA]))
+    ea--;
+  return ea;
+}
+
+ea_t
+get_item_end (ea_t ea)
+{
+  Segment *s = find_segment (ea);
+
+  if (s == NULL)
+    return ea + 1;
+  ea++;
+  while (ea < s->seg.endEA && isTail (s->flags[ea - s->seg.startEA]))
+    ea++;
+  return ea;
+}
+
+ea_t
+next_head (ea_t ea, ea_t maxea)
+{
+  for (ea++; ea < maxea; ea++) {
+    Segment *s = find_segment (ea);
+
+    if (s == NULL) {
+      size_t i;
+
+      // Skip to the next segment
+      for (i = 0; i < segments.size () && segments[i]->seg.startEA <= ea; i++)
+        ;
+      if (i == segments.size ())
+        return BADADDR;
+      ea = segments[i]->seg.startEA - 1;
+      continue;
+    }
+    if (isHead (s->flags[ea - s->seg.startEA]))
+      return ea;
+  }
+  return BADADDR;
+}
+
+ea_t
+prev_head (ea_t ea, ea_t minea)
+{
+  while (ea > minea) {
+    ea--;
+    if (isHead (getFlags (ea)))
+      return ea;
+  }
+  return BADADDR;
+}
+
+ea_t
+nextthat (ea_t ea, ea_t maxea, bool (idaapi *testf)(flags_t F, void *ud), void *ud)
+{
+  for (ea = next_head (ea, maxea); ea != BADADDR; ea = next_head (ea, maxea))
+    if (testf (getFlags (ea), ud))
+      return ea;
+  return BADADDR;
+}
+
+bool
+do_unknown (ea_t ea, int flags)
+{
+  ea_t end = get_item_end (ea);
+
+  for (ea = get_item_head (ea); ea < end; ea++)
+    hl_set_flags (ea, 0, MS_CLS | DT_TYPE | FF_FUNC | FF_FLOW);
+  return true;
+}
+
+bool
+hl_make_code (ea_t ea, size_t size)
+{
+  size_t i;
+
+  if (!isCode (get_flags_novalue (ea))) {
+    for (i = 0; i < size; i++)
+      if (!isUnknown (get_flags_novalue (ea + i)) || !isLoaded (ea + i))
+        return false;
+  }
+  hl_set_flags (ea, FF_CODE, MS_CLS | DT_TYPE);
+  for (i = 1; i < size; i++)
+    hl_set_flags (ea + i, FF_TAIL, MS_CLS | DT_TYPE);
+  return true;
+}
+
+bool
+doASCI (ea_t ea, ssize_t length)
+{
+  ssize_t i;
+
+  if (length <= 0)
+    length = (ssize_t) get_max_ascii_length (ea, ASCSTR_C);
+  if (length <= 0)
+    return false;
+  hl_set_flags (ea, FF_DATA | FF_ASCI, MS_CLS | DT_TYPE);
+  for (i = 1; i < length; i++)
+    hl_set_flags (ea + i, FF_TAIL, MS_CLS | DT_TYPE);
+  return true;
+}
+
+/* Length with the terminating zero, or 0 if there is no C string there */
+size_t
+get_max_ascii_length (ea_t ea, int strtype, bool only_ascii)
+{
+  size_t len = 0;
+
+  while (isLoaded (ea + len)) {
+    uchar c = get_byte (ea + len++);
+
+    if (c == 0)
+      return len;
+    if (only_ascii && (c < 0x20 || c >= 0x7F) && c != '\n' && c != '\t' && c != '\r')
+      return 0;
+  }
+  return 0;
+}
+
+bool
+get_ascii_contents (ea_t ea, size_t len, int type, char *buf, size_t bufsize)
+{
+  size_t i;
+
+  if (bufsize == 0)
+    return false;
+  for (i = 0; i < len && i < bufsize - 1; i++)
+    buf[i] = (char) get_byte (ea + i);
+  buf[i] = 0;
+  return i == len;
+}
+
+/*
+ * Names and comments
+ */
+
+static char *
+copy_string (const string &s, char *buf, size_t bufsize)
+{
+  qstrncpy (buf, s.c_str (), bufsize);
+  return buf;
+}
+
+/* The names IDA makes up for unnamed places that are referenced */
+static bool
+dummy_name (ea_t ea, char *buf, size_t bufsize)
+{
+  flags_t F = get_flags_novalue (ea);
+  const char *prefix;
+
+  if (!has_dummy_name (F))
+    return false;
+  if (isFunc (F))
+    prefix = "sub";
+  else if (isCode (F))
+    prefix = "loc";
+  else if (isASCII (F))
+    prefix = "str";
+  else if (isData (F))
+    prefix = "unk";
+  else
+    prefix = "byte";
+  qsnprintf (buf, bufsize, "%s_%a", prefix, ea);
+  return true;
+}
+
+char *
+get_true_name (ea_t from, ea_t ea, char *buf, size_t bufsize)
+{
+  map<ea_t, string>::iterator it = names.find (ea);
+
+  if (it != names.end ())
+    return copy_string (it->second, buf, bufsize);
+  if (dummy_name (ea, buf, bufsize))
+    return buf;
+  return NULL;
+}
+
+char *
+get_name (ea_t from, ea_t ea, char *buf, size_t bufsize)
+{
+  return get_true_name (from, ea, buf, bufsize);
+}
+
+bool
+set_name (ea_t ea, const char *name, int flag)
+{
+  map<ea_t, string>::iterator it = names.find (ea);
+
+  if (it != names.end ()) {
+    name_eas.erase (it->second);
+    names.erase (it);
+  }
+  if (name == NULL || name[0] == '\0') {
+    hl_set_flags (ea, 0, FF_NAME);
+    return true;
+  }
+  if (name_eas.find (name) != name_eas.end ()) {
+    if ((flag & SN_NOWARN) == 0)
+      warning ("Name %s is already used\n", name);
+    return false;
+  }
+  names[ea] = name;
+  name_eas[name] = ea;
+  hl_set_flags (ea, FF_NAME, 0);
+  return true;
+}
+
+ea_t
+get_name_ea (ea_t from, const char *name)
+{
+  map<string, ea_t>::iterator it = name_eas.find (name);
+
+  if (it != name_eas.end ())
+    return it->second;
+  // Dummy names, "loc_1234"
+  const char *underscore = strchr (name, '_');
+  if (underscore != NULL && underscore[1] != '\0') {
+    char *end;
+    ea_t ea = strtoull (underscore + 1, &end, 16);
+
+    if (*end == '\0' && has_dummy_name (get_flags_novalue (ea)))
+      return ea;
+  }
+  return BADADDR;
+}
+
+ssize_t
+get_cmt (ea_t ea, bool rptble, char *buf, size_t bufsize)
+{
+  map<ea_t, string>::iterator it;
+
+  if (!has_cmt (get_flags_novalue (ea)))
+    return -1;
+  it = comments[rptble].find (ea);
+  if (it == comments[rptble].end ())
+    return -1;
+  if (buf != NULL && bufsize > 0)
+    qstrncpy (buf, it->second.c_str (), bufsize);
+  return (ssize_t) it->second.length ();
+}
+
+bool
+set_cmt (ea_t ea, const char *comm, bool rptble)
+{
+  if (comm == NULL || comm[0] == '\0')
+    comments[rptble].erase (ea);
+  else
+    comments[rptble][ea] = comm;
+  if (comments[0].find (ea) != comments[0].end () ||
+      comments[1].find (ea) != comments[1].end ())
+    hl_set_flags (ea, FF_COMM, 0);
+  else
+    hl_set_flags (ea, 0, FF_COMM);
+  return true;
+}
+
+/*
+ * Functions
+ */
+
+func_t *
+hl_create_func (ea_t start, ea_t end)
+{
+  func_t *pfn = get_func (start);
+  map<ea_t, func_t>::iterator next;
+
+  if (pfn != NULL || end <= start)
+    return NULL;
+  // Functions don't overlap
+  next = functions.upper_bound (start);
+  if (next != functions.end () && next->second.startEA < end)
+    end = next->second.startEA;
+
+  pfn = &functions[start];
+  pfn->startEA = start;
+  pfn->endEA = end;
+  pfn->flags = 0;
+  hl_set_flags (start, FF_FUNC | (has_name (getFlags (start)) ? 0 : FF_LABL), 0);
+  function_index_dirty = true;
+  return pfn;
+}
+
+func_t *
+get_func (ea_t ea)
+{
+  map<ea_t, func_t>::iterator it = functions.upper_bound (ea);
+
+  if (it == functions.begin ())
+    return NULL;
+  it--;
+  if (!it->second.contains (ea))
+    return NULL;
+  return &it->second;
+}
+
+char *
+get_func_name (ea_t ea, char *buf, size_t bufsize)
+{
+  func_t *pfn = get_func (ea);
+
+  if (pfn == NULL)
+    return NULL;
+  return get_name (BADADDR, pfn->startEA, buf, bufsize);
+}
+
+bool
+add_func (ea_t ea1, ea_t ea2)
+{
+  if (get_func (ea1) != NULL)
+    return false;
+  if (ea2 == BADADDR) {
+    // Find the end by following the code, like auto analysis does
+    hl_analyze_function (ea1);
+    return get_func (ea1) != NULL;
+  }
+  return hl_create_func (ea1, ea2) != NULL;
+}
+
+bool
+del_func (ea_t ea)
+{
+  func_t *pfn = get_func (ea);
+
+  if (pfn == NULL)
+    return false;
+  hl_set_flags (pfn->startEA, 0, FF_FUNC);
+  functions.erase (pfn->startEA);
+  function_index_dirty = true;
+  return true;
+}
+
+static void
+update_function_index (void)
+{
+  map<ea_t, func_t>::iterator it;
+
+  if (!function_index_dirty)
+    return;
+  function_index.clear ();
+  for (it = functions.begin (); it != functions.end (); it++)
+    function_index.push_back (&it->second);
+  function_index_dirty = false;
+}
+
+static bool
+by_func_start (const func_t *pfn, ea_t ea)
+{
+  return pfn->startEA < ea;
+}
+
+int
+get_func_num (ea_t ea)
+{
+  func_t *pfn = get_func (ea);
+  vector<func_t *>::iterator it;
+
+  if (pfn == NULL)
+    return -1;
+  update_function_index ();
+  it = lower_bound (function_index.begin (), function_index.end (), pfn->startEA,
+      by_func_start);
+  return (int) (it - function_index.begin ());
+}
+
+size_t
+get_func_qty (void)
+{
+  return functions.size ();
+}
+
+func_t *
+getn_func (size_t n)
+{
+  update_function_index ();
+  if (n >= function_index.size ())
+    return NULL;
+  return function_index[n];
+}
+
+func_t *
+get_next_func (ea_t ea)
+{
+  map<ea_t, func_t>::iterator it = functions.upper_bound (ea);
+
+  return it == functions.end () ? NULL : &it->second;
+}
+
+func_t *
+get_prev_func (ea_t ea)
+{
+  map<ea_t, func_t>::iterator it = functions.lower_bound (ea);
+
+  if (it == functions.begin ())
+    return NULL;
+  it--;
+  return &it->second;
+}
+
+void
+reanalyze_function (func_t *pfn, ea_t ea1, ea_t ea2, bool analyze_parents)
+{
+  ea_t start;
+
+  if (pfn == NULL)
+    return;
+  start = pfn->startEA;
+  del_func (start);
+  hl_analyze_function (start);
+}
+
+/*
+ * Segments
+ */
+
+segment_t *
+getseg (ea_t ea)
+{
+  Segment *s = find_segment (ea);
+
+  return s == NULL ? NULL : &s->seg;
+}
+
+segment_t *
+getnseg (int n)
+{
+  if (n < 0 || (size_t) n >= segments.size ())
+    return NULL;
+  return &segments[n]->seg;
+}
+
+int
+get_segm_qty (void)
+{
+  return (int) segments.size ();
+}
+
+segment_t *
+get_segm_by_name (const char *name)
+{
+  size_t i;
+
+  for (i = 0; i < segments.size (); i++)
+    if (segments[i]->name == name)
+      return &segments[i]->seg;
+  return NULL;
+}
+
+ssize_t
+get_true_segm_name (const segment_t *s, char *buf, size_t bufsize)
+{
+  if (s == NULL || s->name >= segments.size ())
+    return -1;
+  qstrncpy (buf, segments[s->name]->name.c_str (), bufsize);
+  return (ssize_t) segments[s->name]->name.length ();
+}
+
+/*
+ * Cross references
+ */
+
+/* Ordinary flows come first, then the other code references, then data,
+ * which is the order xrefblk_t walks them in IDA */
+static int
+xref_rank (const Xref &x)
+{
+  if (x.iscode && x.type == fl_F)
+    return 0;
+  return x.iscode ? 1 : 2;
+}
+
+static void
+insert_xref (XrefList &list, const Xref &x)
+{
+  XrefList::iterator it;
+
+  for (it = list.begin (); it != list.end (); it++) {
+    if (it->from == x.from && it->to == x.to && it->iscode == x.iscode) {
+      it->type = x.type;
+      return;
+    }
+  }
+  for (it = list.begin (); it != list.end (); it++)
+    if (xref_rank (*it) > xref_rank (x))
+      break;
+  list.insert (it, x);
+}
+
+static void
+remove_xref (XrefList &list, ea_t from, ea_t to, bool iscode)
+{
+  XrefList::iterator it;
+
+  for (it = list.begin (); it != list.end (); it++) {
+    if (it->from == from && it->to == to && it->iscode == iscode) {
+      list.erase (it);
+      return;
+    }
+  }
+}
+
+static bool
+add_xref (ea_t from, ea_t to, uchar type, bool iscode)
+{
+  Xref x;
+
+  x.from = from;
+  x.to = to;
+  x.type = type & XREF_MASK;
+  x.iscode = iscode;
+  x.user = (type & XREF_USER) != 0;
+  insert_xref (xrefs_from[from], x);
+  insert_xref (xrefs_to[to], x);
+  hl_set_flags (to, FF_REF, 0);
+  if (iscode && x.type == fl_F)
+    hl_set_flags (to, FF_FLOW, 0);
+  return true;
+}
+
+bool
+add_cref (ea_t from, ea_t to, cref_t type)
+{
+  return add_xref (from, to, (uchar) type, true);
+}
+
+bool
+add_dref (ea_t from, ea_t to, dref_t type)
+{
+  return add_xref (from, to, (uchar) type, false);
+}
+
+bool
+del_cref (ea_t from, ea_t to, bool expand)
+{
+  remove_xref (xrefs_from[from], from, to, true);
+  remove_xref (xrefs_to[to], from, to, true);
+  return true;
+}
+
+void
+del_dref (ea_t from, ea_t to)
+{
+  remove_xref (xrefs_from[from], from, to, false);
+  remove_xref (xrefs_to[to], from, to, false);
+}
+
+static bool
+xref_matches (const Xref &x, int flags)
+{
+  if ((flags & XREF_DATA) != 0)
+    return !x.iscode;
+  if ((flags & XREF_FAR) != 0)
+    return !(x.iscode && x.type == fl_F);
+  return true;
+}
+
+static bool
+next_xref (xrefblk_t *xb, bool forward)
+{
+  XrefList *list = (XrefList *) xb->list;
+
+  while (list != NULL && xb->n < list->size ()) {
+    Xref &x = (*list)[xb->n++];
+
+    if (xref_matches (x, xb->flags)) {
+      xb->from = x.from;
+      xb->to = x.to;
+      xb->iscode = x.iscode;
+      xb->type = x.type;
+      xb->user = x.user;
+      return true;
+    }
+  }
+  return false;
+}
+
+static XrefList *
+find_list (map<ea_t, XrefList> &xrefs, ea_t ea)
+{
+  map<ea_t, XrefList>::iterator it = xrefs.find (ea);
+
+  return it == xrefs.end () ? NULL : &it->second;
+}
+
+bool
+xrefblk_t::first_from (ea_t _from, int _flags)
+{
+  list = find_list (xrefs_from, _from);
+  flags = _flags;
+  n = 0;
+  return next_xref (this, true);
+}
+
+bool
+xrefblk_t::next_from (void)
+{
+  return next_xref (this, true);
+}
+
+bool
+xrefblk_t::first_to (ea_t _to, int _flags)
+{
+  list = find_list (xrefs_to, _to);
+  flags = _flags;
+  n = 0;
+  return next_xref (this, false);
+}
+
+bool
+xrefblk_t::next_to (void)
+{
+  return next_xref (this, false);
+}
+
+ea_t
+get_first_cref_from (ea_t from)
+{
+  xrefblk_t xb;
+
+  if (xb.first_from (from, XREF_ALL) && xb.iscode)
+    return xb.to;
+  return BADADDR;
+}
+
+ea_t
+get_first_dref_from (ea_t from)
+{
+  xrefblk_t xb;
+
+  if (xb.first_from (from, XREF_DATA))
+    return xb.to;
+  return BADADDR;
+}
+
+ea_t
+get_next_cref_from (ea_t from, ea_t current)
+{
+  xrefblk_t xb;
+  bool found = false;
+
+  for (bool ok = xb.first_from (from, XREF_ALL); ok && xb.iscode; ok = xb.next_from ()) {
+    if (found)
+      return xb.to;
+    found = xb.to == current;
+  }
+  return BADADDR;
+}
+
+ea_t
+get_first_cref_to (ea_t to)
+{
+  xrefblk_t xb;
+
+  for (bool ok = xb.first_to (to, XREF_ALL); ok; ok = xb.next_to ())
+    if (xb.iscode)
+      return xb.from;
+  return BADADDR;
+}
+
+ea_t
+get_next_cref_to (ea_t to, ea_t current)
+{
+  xrefblk_t xb;
+  bool found = false;
+
+  for (bool ok = xb.first_to (to, XREF_ALL); ok; ok = xb.next_to ()) {
+    if (!xb.iscode)
+      continue;
+    if (found)
+      return xb.from;
+    found = xb.from == current;
+  }
+  return BADADDR;
+}
+
+/*
+ * Netnodes. Altvals are kept as supvals holding a nodeidx_t
+ */
+
+netnode::netnode (const char *name, size_t namlen, bool do_create)
+{
+  string key = namlen == 0 ? string (name) : string (name, namlen);
+  map<string, nodeidx_t>::iterator it = node_names.find (key);
+
+  netnodenumber = BADNODE;
+  if (it != node_names.end ())
+    netnodenumber = it->second;
+  else if (do_create)
+    create (name, namlen);
+}
+
+bool
+netnode::create (const char *name, size_t namlen)
+{
+  string key = namlen == 0 ? string (name) : string (name, namlen);
+  map<string, nodeidx_t>::iterator it = node_names.find (key);
+
+  if (it != node_names.end ()) {
+    // Like the SDK, return false but still point to the existing node
+    netnodenumber = it->second;
+    return false;
+  }
+  netnodenumber = next_node++;
+  node_names[key] = netnodenumber;
+  nodes[netnodenumber].name = key;
+  return true;
+}
+
+bool
+netnode::create (void)
+{
+  netnodenumber = next_node++;
+  nodes[netnodenumber];
+  return true;
+}
+
+void
+netnode::kill (void)
+{
+  map<nodeidx_t, Node>::iterator it = nodes.find (netnodenumber);
+
+  if (it != nodes.end ()) {
+    if (it->second.name != "")
+      node_names.erase (it->second.name);
+    nodes.erase (it);
+  }
+  netnodenumber = BADNODE;
+}
+
+ssize_t
+netnode::name (char *buf, size_t bufsize) const
+{
+  map<nodeidx_t, Node>::const_iterator it = nodes.find (netnodenumber);
+
+  if (it == nodes.end () || it->second.name == "")
+    return -1;
+  qstrncpy (buf, it->second.name.c_str (), bufsize);
+  return (ssize_t) it->second.name.length ();
+}
+
+static ssize_t
+copy_value (const string &value, void *buf, size_t bufsize)
+{
+  if (buf != NULL)
+    memcpy (buf, value.data (), qmin (value.length (), bufsize));
+  return (ssize_t) value.length ();
+}
+
+ssize_t
+netnode::supval (nodeidx_t alt, void *buf, size_t bufsize, char tag) const
+{
+  map<nodeidx_t, Node>::const_iterator it = nodes.find (netnodenumber);
+  map<pair<char, nodeidx_t>, string>::const_iterator sup;
+
+  if (it == nodes.end ())
+    return -1;
+  sup = it->second.sup.find (make_pair (tag, alt));
+  if (sup == it->second.sup.end ())
+    return -1;
+  return copy_value (sup->second, buf, bufsize);
+}
+
+bool
+netnode::supset (nodeidx_t alt, const void *value, size_t length, char tag)
+{
+  if (netnodenumber == BADNODE)
+    return false;
+  if (length == 0)
+    length = strlen ((const char *) value) + 1;
+  nodes[netnodenumber].sup[make_pair (tag, alt)] = string ((const char *) value, length);
+  return true;
+}
+
+bool
+netnode::supdel (nodeidx_t alt, char tag)
+{
+  map<nodeidx_t, Node>::iterator it = nodes.find (netnodenumber);
+
+  return it != nodes.end () && it->second.sup.erase (make_pair (tag, alt)) > 0;
+}
+
+nodeidx_t
+netnode::supnxt (nodeidx_t cur, char tag) const
+{
+  map<nodeidx_t, Node>::const_iterator it = nodes.find (netnodenumber);
+  map<pair<char, nodeidx_t>, string>::const_iterator sup;
+
+  if (it == nodes.end ())
+    return BADNODE;
+  sup = it->second.sup.upper_bound (make_pair (tag, cur));
+  if (sup == it->second.sup.end () || sup->first.first != tag)
+    return BADNODE;
+  return sup->first.second;
+}
+
+nodeidx_t
+netnode::sup1st (char tag) const
+{
+  if (supval (0, NULL, 0, tag) >= 0)
+    return 0;
+  return supnxt (0, tag);
+}
+
+nodeidx_t
+netnode::altval (nodeidx_t alt, char tag) const
+{
+  nodeidx_t value = 0;
+
+  if (supval (alt, &value, sizeof(value), tag) != sizeof(value))
+    return 0;
+  return value;
+}
+
+bool
+netnode::altset (nodeidx_t alt, nodeidx_t value, char tag)
+{
+  return supset (alt, &value, sizeof(value), tag);
+}
+
+bool
+netnode::altdel (nodeidx_t alt, char tag)
+{
+  return supdel (alt, tag);
+}
+
+nodeidx_t
+netnode::alt1st (char tag) const
+{
+  return sup1st (tag);
+}
+
+nodeidx_t
+netnode::altnxt (nodeidx_t cur, char tag) const
+{
+  return supnxt (cur, tag);
+}
+
+ssize_t
+netnode::valobj (void *buf, size_t bufsize) const
+{
+  map<nodeidx_t, Node>::const_iterator it = nodes.find (netnodenumber);
+
+  if (it == nodes.end () || it->second.value == "")
+    return -1;
+  return copy_value (it->second.value, buf, bufsize);
+}
+
+bool
+netnode::set (const void *value, size_t length)
+{
+  if (netnodenumber == BADNODE)
+    return false;
+  nodes[netnodenumber].value = string ((const char *) value, length);
+  return true;
+}
+
+ssize_t
+netnode::hashval (const char *idx, void *buf, size_t bufsize, char tag) const
+{
+  map<nodeidx_t, Node>::const_iterator it = nodes.find (netnodenumber);
+  map<pair<char, string>, string>::const_iterator hash;
+
+  if (it == nodes.end ())
+    return -1;
+  hash = it->second.hash.find (make_pair (tag, string (idx)));
+  if (hash == it->second.hash.end ())
+    return -1;
+  return copy_value (hash->second, buf, bufsize);
+}
+
+bool
+netnode::hashset (const char *idx, const void *value, size_t length, char tag)
+{
+  if (netnodenumber == BADNODE)
+    return false;
+  if (length == 0)
+    length = strlen ((const char *) value) + 1;
+  nodes[netnodenumber].hash[make_pair (tag, string (idx))] = string ((const char *) value, length);
+  return true;
+}
+
+bool
+netnode::hashdel (const char *idx, char tag)
+{
+  map<nodeidx_t, Node>::iterator it = nodes.find (netnodenumber);
+
+  return it != nodes.end () && it->second.hash.erase (make_pair (tag, string (idx))) > 0;
+}
+
+/*
+ * Switches
+ */
+
+ssize_t
+get_switch_info_ex (ea_t ea, switch_info_ex_t *buf, size_t bufsize)
+{
+  map<ea_t, switch_info_ex_t>::iterator it = switches.find (ea);
+
+  if (it == switches.end ())
+    return -1;
+  memcpy (buf, &it->second, qmin (bufsize, sizeof(switch_info_ex_t)));
+  return sizeof(switch_info_ex_t);
+}
+
+void
+set_switch_info_ex (ea_t ea, const switch_info_ex_t *si)
+{
+  switches[ea] = *si;
+}
+
+void
+del_switch_info_ex (ea_t ea)
+{
+  switches.erase (ea);
+}
+
+/* Where the case number 'i' jumps to, BADADDR if the table isn't loaded */
+static ea_t
+switch_target (const switch_info_ex_t *si, int i)
+{
+  int size = si->get_jtable_element_size ();
+  ea_t entry = si->jumps + (ea_t) i * size;
+  sval_t element;
+
+  if (!isLoaded (entry) || !isLoaded (entry + size - 1))
+    return BADADDR;
+  switch (size) {
+    case 1:
+      element = (si->flags & SWI_SIGNED) ? (sval_t) (int8) get_byte (entry) : get_byte (entry);
+      break;
+    case 2:
+      element = (si->flags & SWI_SIGNED) ? (sval_t) (int16) get_word (entry) : get_word (entry);
+      break;
+    case 4:
+      element = (si->flags & SWI_SIGNED) ? (sval_t) (int32) get_long (entry) : get_long (entry);
+      break;
+    default:
+      element = (sval_t) get_qword (entry);
+      break;
+  }
+  if (si->flags & SWI_ELBASE)
+    return si->elbase + (element << si->get_shift ());
+  return (ea_t) element << si->get_shift ();
+}
+
+bool
+create_switch_table (ea_t insn_ea, const switch_info_ex_t *si)
+{
+  int size = si->get_jtable_element_size ();
+  int i, j;
+
+  for (i = 0; i < si->ncases; i++) {
+    ea_t entry = si->jumps + (ea_t) i * size;
+
+    do_unknown (entry, 0);
+    hl_set_flags (entry, FF_DATA | (size == 4 ? FF_DWRD : size == 8 ? FF_QWRD :
+            size == 2 ? FF_WORD : FF_BYTE), MS_CLS | DT_TYPE);
+    for (j = 1; j < size; j++)
+      hl_set_flags (entry + j, FF_TAIL, MS_CLS | DT_TYPE);
+    add_dref (insn_ea, entry, dr_R);
+  }
+  return true;
+}
+
+void
+create_switch_xrefs (ea_t insn_ea, const switch_info_ex_t *si)
+{
+  int i;
+
+  for (i = 0; i < si->ncases; i++) {
+    ea_t target = switch_target (si, i);
+
+    if (target != BADADDR)
+      add_cref (insn_ea, target, fl_JN);
+  }
+  if ((si->flags & SWI_DEFAULT) && si->defjump != BADADDR)
+    add_cref (insn_ea, si->defjump, fl_JN);
+}
+
+/*
+ * Hooks
+ */
+
+typedef struct {
+  hook_cb_t *cb;
+  void *user_data;
+} Hook;
+
+static vector<Hook> hooks[HT_LAST];
+
+bool
+hook_to_notification_point (hook_type_t hook_type, hook_cb_t *cb, void *user_data)
+{
+  Hook hook;
+
+  hook.cb = cb;
+  hook.user_data = user_data;
+  hooks[hook_type].push_back (hook);
+  return true;
+}
+
+int
+unhook_from_notification_point (hook_type_t hook_type, hook_cb_t *cb, void *user_data)
+{
+  vector<Hook>::iterator it;
+  int count = 0;
+
+  for (it = hooks[hook_type].begin (); it != hooks[hook_type].end ();) {
+    if (it->cb == cb && (user_data == NULL || it->user_data == user_data)) {
+      it = hooks[hook_type].erase (it);
+      count++;
+    } else {
+      it++;
+    }
+  }
+  return count;
+}
+
+/* The first hook that handles the event (returns non zero) gets the last
+ * word, like in IDA */
+int
+processor_t::notify (idp_notify event_code, ...)
+{
+  size_t i;
+  int code = 0;
+
+  for (i = 0; i < hooks[HT_IDP].size () && code == 0; i++) {
+    va_list va;
+
+    va_start (va, event_code);
+    code = hooks[HT_IDP][i].cb (hooks[HT_IDP][i].user_data, event_code, va);
+    va_end (va);
+  }
+  return code;
+}
+
+/*
+ * Analysis queue, everything is done right away in the stand-in
+ */
+
+void
+auto_mark_range (ea_t start, ea_t end, atype_t type)
+{
+  if (type == AU_PROC || type == AU_CODE)
+    hl_analyze_function (start);
+}
+
+bool
+autoWait (void)
+{
+  return true;
+}
+
+void
+noUsed (ea_t ea)
+{
+}
+
+bool
+auto_make_code (ea_t ea)
+{
+  hl_analyze_function (ea);
+  return isCode (get_flags_novalue (ea));
+}
+
+bool
+auto_make_proc (ea_t ea)
+{
+  hl_analyze_function (ea);
+  return get_func (ea) != NULL;
+}
+
+bool
+op_offset (ea_t ea, int n, uint32 reftype, ea_t target, ea_t base, sval_t tdelta)
+{
+  if (target != BADADDR)
+    add_dref (ea, target, dr_O);
+  return true;
+}
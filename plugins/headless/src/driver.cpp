@@ -0,0 +1,213 @@
+/*
+ * driver.cpp -- Runs the plugins against the headless IDA SDK stand-in
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+#include "headless.hpp"
+
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+/* The plugins linked in the executable, NULL terminated. Their init() is
+ * called before the analysis so their hooks see it, like in IDA, and the
+ * last one is the plugin that runs */
+extern plugin_t *headless_plugins[];
+
+static double
+now (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Instructions of the analyzed functions, for the throughput */
+static size_t
+count_instructions (void)
+{
+  size_t count = 0;
+  size_t i;
+
+  for (i = 0; i < get_func_qty (); i++) {
+    func_t *pfn = getn_func (i);
+    ea_t ea;
+
+    for (ea = pfn->startEA; ea != BADADDR; ea = next_head (ea, pfn->endEA))
+      if (isCode (get_flags_novalue (ea)))
+        count++;
+  }
+  return count;
+}
+
+/* In kilobytes */
+static long
+peak_rss (void)
+{
+  struct rusage usage;
+
+  if (getrusage (RUSAGE_SELF, &usage) != 0)
+    return 0;
+  return usage.ru_maxrss;
+}
+
+static void
+usage (const char *program)
+{
+  fprintf (stderr,
+      "Usage: %s [options] image\n"
+      "  -b base     Address of a raw image without segments (0x10000)\n"
+      "  -s sidecar  Segments, functions, names and comments of the image\n"
+      "  -e ea       Entry point\n"
+      "  -a ea       Address the plugin runs on, the entry point by default\n"
+      "  -r arg      Argument of the plugin's run() (0)\n"
+      "  -n runs     Number of times to run the plugin (1)\n"
+      "  -f path     Answer of the plugin's file dialogs\n"
+      "  -o path     Where the plugin's messages go, stdout by default\n"
+      "  -q          Discard the plugin's messages, only count them\n",
+      program);
+}
+
+static bool
+parse_ea (const char *str, ea_t *ea)
+{
+  char *end;
+
+  *ea = strtoull (str, &end, 0);
+  return *end == '\0';
+}
+
+int
+main (int argc, char *argv[])
+{
+  ea_t base = 0x10000;
+  ea_t entry = BADADDR;
+  ea_t screen = BADADDR;
+  const char *sidecar = NULL;
+  const char *output_path = NULL;
+  bool quiet = false;
+  int runs = 1;
+  int arg = 0;
+  FILE *output = stdout;
+  plugin_t *plugin = NULL;
+  bool *loaded;
+  double start, analysis, best = 0, total = 0;
+  size_t instructions;
+  int nplugins;
+  int i, c;
+
+  while ((c = getopt (argc, argv, "b:s:e:a:r:n:f:o:qh")) != -1) {
+    switch (c) {
+      case 'b':
+        if (!parse_ea (optarg, &base))
+          goto bad_usage;
+        break;
+      case 's':
+        sidecar = optarg;
+        break;
+      case 'e':
+        if (!parse_ea (optarg, &entry))
+          goto bad_usage;
+        break;
+      case 'a':
+        if (!parse_ea (optarg, &screen))
+          goto bad_usage;
+        break;
+      case 'r':
+        arg = atoi (optarg);
+        break;
+      case 'n':
+        runs = atoi (optarg);
+        break;
+      case 'f':
+        hl_set_askfile (optarg);
+        break;
+      case 'o':
+        output_path = optarg;
+        break;
+      case 'q':
+        quiet = true;
+        break;
+      default:
+        goto bad_usage;
+    }
+  }
+  if (optind != argc - 1 || runs < 1)
+    goto bad_usage;
+
+  if (output_path != NULL) {
+    output = qfopen (output_path, "w");
+    if (output == NULL) {
+      warning ("Can't open %s for writing\n", output_path);
+      return 1;
+    }
+  }
+
+  hl_reset_database ();
+  for (nplugins = 0; headless_plugins[nplugins] != NULL; nplugins++)
+    ;
+  loaded = new bool[nplugins];
+  for (i = 0; i < nplugins; i++) {
+    int code = headless_plugins[i]->init ();
+
+    loaded[i] = code != PLUGIN_SKIP;
+    if (!loaded[i])
+      warning ("Plugin %s skipped the database\n", headless_plugins[i]->wanted_name);
+  }
+  if (nplugins > 0 && loaded[nplugins - 1])
+    plugin = headless_plugins[nplugins - 1];
+
+  start = now ();
+  if (!hl_load_image (argv[optind], base) || !hl_load_sidecar (sidecar))
+    return 1;
+  if (entry != BADADDR)
+    hl_set_entry (entry);
+  if (screen != BADADDR)
+    hl_set_screen_ea (screen);
+  hl_analyze ();
+  analysis = now () - start;
+  instructions = count_instructions ();
+  fprintf (stderr, "Loaded %s: %d segments, %d functions, %llu instructions in %.3f s\n",
+      argv[optind], get_segm_qty (), (int) get_func_qty (),
+      (unsigned long long) instructions, analysis);
+
+  if (plugin != NULL) {
+    hl_set_output (quiet ? NULL : output);
+    for (i = 0; i < runs; i++) {
+      double elapsed;
+
+      start = now ();
+      plugin->run (arg);
+      elapsed = now () - start;
+      total += elapsed;
+      if (i == 0 || elapsed < best)
+        best = elapsed;
+    }
+    fprintf (stderr, "%s: %d runs, best %.3f ms, mean %.3f ms, %llu bytes of output per run\n",
+        plugin->wanted_name, runs, best * 1000, total * 1000 / runs,
+        (unsigned long long) hl_output_bytes () / runs);
+    // The plugin may only look at part of the database, PPC2C follows the
+    // calls of the function it runs on
+    fprintf (stderr, "%s: %.0f instructions/s, peak RSS %ld KB\n",
+        plugin->wanted_name, best > 0 ? instructions / best : 0.0, peak_rss ());
+    hl_set_output (stderr);
+  }
+
+  for (i = nplugins - 1; i >= 0; i--)
+    if (loaded[i] && headless_plugins[i]->term != NULL)
+      headless_plugins[i]->term ();
+  delete [] loaded;
+  if (output != stdout)
+    qfclose (output);
+  return 0;
+
+ bad_usage:
+  usage (argv[0]);
+  return 1;
+}
@@ -0,0 +1,74 @@
+/*
+ * headless.hpp -- Internals of the headless IDA SDK stand-in
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+#ifndef __HEADLESS_HPP__
+#define __HEADLESS_HPP__
+
+#include <ida.hpp>
+#include <allins.hpp>
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/* Register numbers in op_t.reg, the way fix_rtoc and the constant
+ * propagation of PPC2C expect them: GPRs first, then the FPRs */
+#define HL_REG_R0 0
+#define HL_REG_F0 32
+#define HL_REG_CR0 64
+#define HL_REG_LR 72
+#define HL_REG_CTR 73
+#define HL_REG_XER 74
+
+/* cmd.auxpref bits set by the decoder */
+#define HL_AUX_RC 0x0001 // Record form, "."
+#define HL_AUX_OE 0x0002 // Overflow enable, "o"
+#define HL_AUX_AA 0x0004 // Absolute address
+#define HL_AUX_LK 0x0008 // Link, "l"
+#define HL_AUX_LR 0x0500 // Branch to LR
+#define HL_AUX_CTR 0x0600 // Branch to CTR
+
+/* Database, database.cpp */
+segment_t *hl_add_segment(const char *name, ea_t start, ea_t end, uchar type);
+void hl_load_bytes(ea_t ea, const uchar *bytes, size_t size);
+void hl_set_flags(ea_t ea, flags_t set, flags_t clear);
+bool hl_make_code(ea_t ea, size_t size);
+func_t *hl_create_func(ea_t start, ea_t end);
+void hl_set_entry(ea_t ea);
+void hl_set_segment(segment_t *seg, const char *name, uchar type);
+void hl_reset_database(void);
+
+/* PowerPC decoder and printer, ppc.cpp */
+int hl_ppc_ana(void);
+const char *hl_ppc_mnem(char *buf, size_t bufsize);
+void hl_ppc_outop(op_t &x);
+bool hl_ppc_is_call(void);
+bool hl_ppc_is_stop(void);
+bool hl_ppc_is_indirect_jump(void);
+
+/* Loading images and sidecars, loader.cpp */
+bool hl_load_image(const char *path, ea_t base);
+bool hl_load_sidecar(const char *path);
+
+/* Auto analysis, analysis.cpp: follow the code from every function known so
+ * far and create the xrefs, functions and switches IDA would */
+void hl_queue_function(ea_t ea);
+void hl_analyze(void);
+void hl_analyze_function(ea_t ea);
+
+/* Where msg() output goes, and how many bytes went there since. NULL only
+ * counts them */
+void hl_set_output(FILE *f);
+uint64 hl_output_bytes(void);
+void hl_set_askfile(const char *path);
+void hl_set_screen_ea(ea_t ea);
+
+#endif /* __HEADLESS_HPP__ */
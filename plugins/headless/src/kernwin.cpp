@@ -0,0 +1,303 @@
+/*
+ * kernwin.cpp -- Messages, strings and files of the headless IDA SDK stand-in
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+#include "headless.hpp"
+
+static FILE *output = stdout;
+static uint64 output_bytes;
+static string askfile_path;
+static ea_t screen_ea = BADADDR;
+
+void
+hl_set_output (FILE *f)
+{
+  output = f;
+  output_bytes = 0;
+}
+
+uint64
+hl_output_bytes (void)
+{
+  return output_bytes;
+}
+
+void
+hl_set_askfile (const char *path)
+{
+  askfile_path = path == NULL ? "" : path;
+}
+
+void
+hl_set_screen_ea (ea_t ea)
+{
+  screen_ea = ea;
+}
+
+#define FORMAT_FLAGS "-+ #0123456789.*"
+
+static bool
+has_ea_conversion (const char *format)
+{
+  for (format = strchr (format, '%'); format != NULL; format = strchr (format, '%')) {
+    format++;
+    format += strspn (format, FORMAT_FLAGS);
+    if (*format == 'a')
+      return true;
+    if (*format)
+      format++;
+  }
+  return false;
+}
+
+/* Rewrite the SDK's %a, an ea_t in hex, into something vsnprintf knows */
+static const char *
+convert_format (const char *format, char *buf, size_t bufsize)
+{
+  size_t len = 0;
+
+  if (!has_ea_conversion (format))
+    return format;
+
+  while (*format && len + 4 < bufsize) {
+    if (*format != '%') {
+      buf[len++] = *format++;
+      continue;
+    }
+    buf[len++] = *format++;
+    // Flags, width and precision
+    while (*format && strchr (FORMAT_FLAGS, *format) != NULL && len + 4 < bufsize)
+      buf[len++] = *format++;
+    if (*format == 'a') {
+      buf[len++] = 'l';
+      buf[len++] = 'l';
+      buf[len++] = 'X';
+      format++;
+    } else if (*format) {
+      buf[len++] = *format++;
+    }
+  }
+  buf[len] = '\0';
+  return buf;
+}
+
+int
+qvsnprintf (char *buf, size_t size, const char *format, va_list va)
+{
+  char converted[MAXSTR];
+
+  return vsnprintf (buf, size, convert_format (format, converted, sizeof(converted)), va);
+}
+
+int
+qsnprintf (char *buf, size_t size, const char *format, ...)
+{
+  va_list va;
+  int len;
+
+  va_start (va, format);
+  len = qvsnprintf (buf, size, format, va);
+  va_end (va);
+  return len;
+}
+
+char *
+qstrncpy (char *dst, const char *src, size_t dstsize)
+{
+  if (dstsize == 0)
+    return dst;
+  strncpy (dst, src, dstsize - 1);
+  dst[dstsize - 1] = '\0';
+  return dst;
+}
+
+char *
+qstrncat (char *dst, const char *src, size_t dstsize)
+{
+  size_t len = strlen (dst);
+
+  if (len + 1 < dstsize)
+    qstrncpy (dst + len, src, dstsize - len);
+  return dst;
+}
+
+char *
+qstrdup (const char *string)
+{
+  return strdup (string);
+}
+
+int
+vmsg (const char *format, va_list va)
+{
+  char converted[MAXSTR];
+  int len;
+
+  format = convert_format (format, converted, sizeof(converted));
+  if (output == NULL) {
+    va_list copy;
+
+    va_copy (copy, va);
+    len = vsnprintf (NULL, 0, format, copy);
+    va_end (copy);
+  } else {
+    len = vfprintf (output, format, va);
+  }
+  if (len > 0)
+    output_bytes += len;
+  return len;
+}
+
+int
+msg (const char *format, ...)
+{
+  va_list va;
+  int len;
+
+  va_start (va, format);
+  len = vmsg (format, va);
+  va_end (va);
+  return len;
+}
+
+static void
+vreport (const char *prefix, const char *format, va_list va)
+{
+  char converted[MAXSTR];
+
+  fputs (prefix, stderr);
+  vfprintf (stderr, convert_format (format, converted, sizeof(converted)), va);
+}
+
+void
+warning (const char *format, ...)
+{
+  va_list va;
+
+  va_start (va, format);
+  vreport ("Warning: ", format, va);
+  va_end (va);
+}
+
+void
+info (const char *format, ...)
+{
+  va_list va;
+
+  va_start (va, format);
+  vreport ("", format, va);
+  va_end (va);
+}
+
+/* No user to ask: the answer comes from the command line */
+char *
+askfile_c (int savefile, const char *defval, const char *format, ...)
+{
+  static char path[MAXSTR];
+
+  if (askfile_path == "")
+    return NULL;
+  qstrncpy (path, askfile_path.c_str (), sizeof(path));
+  return path;
+}
+
+int
+askyn_c (int deflt, const char *format, ...)
+{
+  return deflt;
+}
+
+ea_t
+get_screen_ea (void)
+{
+  return screen_ea == BADADDR ? inf.beginEA : screen_ea;
+}
+
+bool
+jumpto (ea_t ea, int opnum)
+{
+  screen_ea = ea;
+  return true;
+}
+
+void
+show_wait_box (const char *format, ...)
+{
+}
+
+void
+hide_wait_box (void)
+{
+}
+
+bool
+wasBreak (void)
+{
+  return false;
+}
+
+/*
+ * fpro.h
+ */
+
+FILE *
+qfopen (const char *file, const char *mode)
+{
+  return fopen (file, mode);
+}
+
+int
+qfclose (FILE *fp)
+{
+  return fclose (fp);
+}
+
+ssize_t
+qfread (FILE *fp, void *buf, size_t n)
+{
+  return (ssize_t) fread (buf, 1, n, fp);
+}
+
+ssize_t
+qfwrite (FILE *fp, const void *buf, size_t n)
+{
+  return (ssize_t) fwrite (buf, 1, n, fp);
+}
+
+int
+qvfprintf (FILE *fp, const char *format, va_list va)
+{
+  char converted[MAXSTR];
+
+  return vfprintf (fp, convert_format (format, converted, sizeof(converted)), va);
+}
+
+int
+qfprintf (FILE *fp, const char *format, ...)
+{
+  va_list va;
+  int len;
+
+  va_start (va, format);
+  len = qvfprintf (fp, format, va);
+  va_end (va);
+  return len;
+}
+
+int
+qfseek (FILE *fp, long offset, int whence)
+{
+  return fseek (fp, offset, whence);
+}
+
+long
+qftell (FILE *fp)
+{
+  return ftell (fp);
+}
@@ -0,0 +1,285 @@
+/*
+ * loader.cpp -- Images and sidecars of the headless IDA SDK stand-in
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+/*
+ * Two kinds of images are loaded. A raw big-endian dump, mapped at a base
+ * address or cut into segments by the sidecar, and the PPC2CIMG memory
+ * images PPC2C exports, which already list their segments:
+ *
+ *   "PPC2CIMG" be32 version (1) be32 count
+ *   count * { be32 start, be32 size, size bytes }
+ *
+ * The sidecar is a text file with one directive per line, '#' starting a
+ * comment line. Numbers are C style, 0x for hex:
+ *
+ *   segment <name> <start> <end> [fileoff] [code|data|bss]
+ *   entry <ea>
+ *   func <start> [end] [name]
+ *   name <ea> <name>
+ *   cmt <ea> <text>
+ *   rcmt <ea> <text>
+ *   string <ea> [length]
+ */
+
+#include "headless.hpp"
+
+#define IMAGE_MAGIC "PPC2CIMG"
+#define IMAGE_VERSION 1
+
+static vector<uchar> image; // The raw image, for the sidecar's segments
+static ea_t image_base;
+static bool image_has_segments;
+
+static uint32
+read_be32 (const uchar *p)
+{
+  return ((uint32) p[0] << 24) | ((uint32) p[1] << 16) | ((uint32) p[2] << 8) | p[3];
+}
+
+static bool
+load_ppc2c_image (const char *path)
+{
+  size_t pos = 16;
+  uint32 count;
+  uint32 i;
+
+  if (read_be32 (&image[8]) != IMAGE_VERSION) {
+    warning ("%s: unsupported image version %d\n", path, read_be32 (&image[8]));
+    return false;
+  }
+  count = read_be32 (&image[12]);
+  for (i = 0; i < count; i++) {
+    char name[16];
+    uint32 start;
+    uint32 size;
+
+    if (pos + 8 > image.size ())
+      break;
+    start = read_be32 (&image[pos]);
+    size = read_be32 (&image[pos + 4]);
+    pos += 8;
+    if (pos + size > image.size ())
+      break;
+    qsnprintf (name, sizeof(name), "seg%03d", i);
+    if (hl_add_segment (name, start, (ea_t) start + size, SEG_NORM) == NULL) {
+      warning ("%s: segment %d at 0x%a overlaps another one\n", path, i, (ea_t) start);
+      return false;
+    }
+    hl_load_bytes (start, &image[pos], size);
+    pos += size;
+  }
+  if (i != count) {
+    warning ("%s: truncated image\n", path);
+    return false;
+  }
+  image_has_segments = true;
+  return true;
+}
+
+/* Read the image at 'path'. A raw image is only mapped by the sidecar's
+ * segments, or as a single code segment at 'base' if it has none */
+bool
+hl_load_image (const char *path, ea_t base)
+{
+  FILE *f = qfopen (path, "rb");
+  uchar buf[0x10000];
+  ssize_t len;
+
+  if (f == NULL) {
+    warning ("Can't open %s\n", path);
+    return false;
+  }
+  image.clear ();
+  while ((len = qfread (f, buf, sizeof(buf))) > 0)
+    image.insert (image.end (), buf, buf + len);
+  qfclose (f);
+
+  image_base = base;
+  image_has_segments = false;
+  if (image.size () >= 16 && memcmp (&image[0], IMAGE_MAGIC, 8) == 0)
+    return load_ppc2c_image (path);
+  return true;
+}
+
+/* Map the whole raw image if the sidecar didn't say where it goes */
+static void
+map_raw_image (void)
+{
+  if (image_has_segments || get_segm_qty () > 0 || image.empty ())
+    return;
+  hl_add_segment (".text", image_base, image_base + image.size (), SEG_CODE);
+  hl_load_bytes (image_base, &image[0], image.size ());
+}
+
+static bool
+parse_number (const char *str, ea_t *value)
+{
+  char *end;
+
+  if (str == NULL || *str == '\0')
+    return false;
+  *value = strtoull (str, &end, 0);
+  return *end == '\0';
+}
+
+static bool
+parse_segment (char **args, int nargs)
+{
+  ea_t start, end, fileoff = 0;
+  uchar type = SEG_CODE;
+  bool has_fileoff = false;
+  segment_t *seg;
+  int i;
+
+  if (nargs < 4 || !parse_number (args[2], &start) || !parse_number (args[3], &end))
+    return false;
+  for (i = 4; i < nargs; i++) {
+    if (qstrcmp (args[i], "code") == 0)
+      type = SEG_CODE;
+    else if (qstrcmp (args[i], "data") == 0)
+      type = SEG_DATA;
+    else if (qstrcmp (args[i], "bss") == 0)
+      type = SEG_BSS;
+    else if (parse_number (args[i], &fileoff))
+      has_fileoff = true;
+    else
+      return false;
+  }
+
+  // The segments of a PPC2CIMG image only get their name and type
+  seg = getseg (start);
+  if (image_has_segments && seg != NULL && seg->startEA == start) {
+    hl_set_segment (seg, args[1], type);
+    return true;
+  }
+
+  seg = hl_add_segment (args[1], start, end, type);
+  if (seg == NULL)
+    return false;
+  if (type == SEG_BSS || image_has_segments)
+    return true;
+  if (!has_fileoff)
+    fileoff = start - image_base;
+  if (fileoff < image.size ())
+    hl_load_bytes (start, &image[fileoff], (size_t) qmin (end - start, image.size () - fileoff));
+  return true;
+}
+
+/* Split 'line' in place. The last argument gets the rest of the line when
+ * 'max' is reached, for the comments */
+static int
+split (char *line, char **args, int max)
+{
+  int n = 0;
+
+  while (n < max) {
+    while (*line == ' ' || *line == '\t')
+      line++;
+    if (*line == '\0')
+      break;
+    args[n++] = line;
+    if (n == max)
+      break;
+    while (*line && *line != ' ' && *line != '\t')
+      line++;
+    if (*line)
+      *line++ = '\0';
+  }
+  return n;
+}
+
+static bool
+parse_line (char *line)
+{
+  char *args[8];
+  int nargs;
+  ea_t ea, value;
+
+  // The directive, the address and the rest of the line
+  nargs = split (line, args, 3);
+  if (nargs == 0)
+    return true;
+
+  if (qstrcmp (args[0], "segment") == 0) {
+    if (nargs < 3)
+      return false;
+    nargs = split (args[2], args + 2, 6) + 2;
+    return parse_segment (args, nargs);
+  }
+
+  if (nargs < 2 || !parse_number (args[1], &ea))
+    return false;
+  // The segments come first, the rest of the sidecar needs the bytes
+  map_raw_image ();
+
+  if (qstrcmp (args[0], "entry") == 0) {
+    hl_set_entry (ea);
+    hl_queue_function (ea);
+  } else if (qstrcmp (args[0], "func") == 0) {
+    nargs = nargs > 2 ? split (args[2], args + 2, 2) + 2 : 2;
+    if (nargs > 2 && parse_number (args[2], &value)) {
+      hl_create_func (ea, value);
+      if (nargs > 3)
+        set_name (ea, args[3], SN_NOWARN);
+    } else if (nargs > 2) {
+      set_name (ea, args[2], SN_NOWARN);
+    }
+    hl_queue_function (ea);
+  } else if (qstrcmp (args[0], "name") == 0) {
+    if (nargs < 3 || split (args[2], args + 2, 2) < 1)
+      return false;
+    set_name (ea, args[2], SN_NOWARN);
+  } else if (qstrcmp (args[0], "cmt") == 0 || qstrcmp (args[0], "rcmt") == 0) {
+    if (nargs < 3)
+      return false;
+    set_cmt (ea, args[2], args[0][0] == 'r');
+  } else if (qstrcmp (args[0], "string") == 0) {
+    if (nargs > 2 && parse_number (args[2], &value))
+      doASCI (ea, (ssize_t) value);
+    else
+      doASCI (ea, 0);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool
+hl_load_sidecar (const char *path)
+{
+  char line[MAXSTR];
+  int lineno = 0;
+  FILE *f;
+
+  if (path == NULL) {
+    map_raw_image ();
+    return true;
+  }
+
+  f = qfopen (path, "r");
+  if (f == NULL) {
+    warning ("Can't open %s\n", path);
+    return false;
+  }
+  while (fgets (line, sizeof(line), f) != NULL) {
+    size_t len = strlen (line);
+
+    lineno++;
+    while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+      line[--len] = '\0';
+    if (line[0] == '#' || line[0] == '\0')
+      continue;
+    if (!parse_line (line))
+      warning ("%s:%d: invalid line\n", path, lineno);
+  }
+  qfclose (f);
+  map_raw_image ();
+  return true;
+}
@@ -0,0 +1,313 @@
+/*
+ * output.cpp -- Instruction decoding and output of the headless IDA SDK stand-in
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+#include "headless.hpp"
+
+/* Color tags, like the SDK's: COLOR_ON <color> text COLOR_OFF <color> */
+#define COLOR_ON '\1'
+#define COLOR_OFF '\2'
+
+insn_t cmd;
+int gl_comm;
+
+static char *out_buf;
+static size_t out_size;
+static size_t out_pos;
+
+/* Where MakeLine() puts the line generated by a custom_out callback */
+static char *made_line;
+static size_t made_line_size;
+
+/*
+ * Decoding. The plugins' custom_ana callbacks see the instruction first,
+ * like with the IDA kernel
+ */
+
+int
+ua_ana0 (ea_t ea)
+{
+  int size;
+  int i;
+
+  memset (&cmd, 0, sizeof(cmd));
+  cmd.ea = ea;
+  cmd.ip = ea;
+  for (i = 0; i < UA_MAXOP; i++) {
+    cmd.Operands[i].n = (char) i;
+    cmd.Operands[i].flags = OF_SHOW;
+  }
+
+  size = ph.notify (ph.custom_ana);
+  if (size <= 0)
+    size = hl_ppc_ana ();
+  cmd.size = (uint16) (size > 0 ? size : 0);
+  return cmd.size;
+}
+
+int
+decode_insn (ea_t ea)
+{
+  return ua_ana0 (ea);
+}
+
+ea_t
+decode_prev_insn (ea_t ea)
+{
+  ea_t prev = prev_head (ea, inf.minEA);
+
+  if (prev == BADADDR || !isCode (get_flags_novalue (prev)) || decode_insn (prev) == 0)
+    return BADADDR;
+  return prev;
+}
+
+/* The mnemonic of 'cmd', without decoding it again */
+static const char *
+mnemonic (char *buf, size_t bufsize)
+{
+  if (ph.notify (ph.custom_mnem, buf, bufsize) == 2)
+    return buf;
+  return hl_ppc_mnem (buf, bufsize);
+}
+
+const char *
+ua_mnem (ea_t ea, char *buf, size_t bufsize)
+{
+  if (ua_ana0 (ea) == 0)
+    return NULL;
+  return mnemonic (buf, bufsize);
+}
+
+/*
+ * Output buffer
+ */
+
+void
+init_output_buffer (char *buf, size_t bufsize)
+{
+  out_buf = buf;
+  out_size = bufsize;
+  out_pos = 0;
+  if (bufsize > 0)
+    buf[0] = '\0';
+}
+
+const char *
+term_output_buffer (void)
+{
+  if (out_size > 0)
+    out_buf[qmin (out_pos, out_size - 1)] = '\0';
+  return out_buf;
+}
+
+void
+OutChar (char c)
+{
+  if (out_pos + 1 < out_size)
+    out_buf[out_pos++] = c;
+}
+
+void
+OutLine (const char *str)
+{
+  while (*str)
+    OutChar (*str++);
+}
+
+void
+out_line (const char *str, uchar color)
+{
+  OutChar (COLOR_ON);
+  OutChar ((char) color);
+  OutLine (str);
+  OutChar (COLOR_OFF);
+  OutChar ((char) color);
+}
+
+void
+out_register (const char *str)
+{
+  out_line (str, COLOR_REG);
+}
+
+void
+out_keyword (const char *str)
+{
+  out_line (str, COLOR_INSN);
+}
+
+void
+out_symbol (char c)
+{
+  char str[2] = {c, '\0'};
+
+  out_line (str, COLOR_SYMBOL);
+}
+
+void
+OutValue (op_t &x, int outflags)
+{
+  char buf[32];
+
+  qsnprintf (buf, sizeof(buf), "0x%llX", (unsigned long long) x.value);
+  out_line (buf, COLOR_DEFAULT);
+}
+
+bool
+out_name_expr (op_t &x, ea_t ea, uval_t off)
+{
+  char buf[MAXSTR];
+
+  if (get_name (cmd.ea, ea, buf, sizeof(buf)) == NULL)
+    return false;
+  out_line (buf, COLOR_SYMBOL);
+  return true;
+}
+
+bool
+out_one_operand (int n)
+{
+  op_t &x = cmd.Operands[n];
+
+  if (x.type == o_void || !x.showed ())
+    return false;
+  if (ph.notify (ph.custom_outop, &x) == 0)
+    hl_ppc_outop (x);
+  return true;
+}
+
+void
+OutMnem (int width, const char *postfix)
+{
+  char buf[MAXSTR];
+  int len;
+
+  if (mnemonic (buf, sizeof(buf)) == NULL)
+    return;
+  if (postfix != NULL)
+    qstrncat (buf, postfix, sizeof(buf));
+  out_line (buf, COLOR_INSN);
+  for (len = (int) strlen (buf); len < width; len++)
+    OutChar (' ');
+  OutChar (' ');
+}
+
+/* The operand 'n' of the instruction at 'ea'. Like the PPC module, the third
+ * operand comes with the ones after it, "2,30" for a rldic */
+bool
+ua_outop2 (ea_t ea, char *buf, size_t bufsize, int n, int flags)
+{
+  bool shown;
+  int i;
+
+  if (ua_ana0 (ea) == 0 || n < 0 || n >= UA_MAXOP) {
+    if (bufsize > 0)
+      buf[0] = '\0';
+    return false;
+  }
+  init_output_buffer (buf, bufsize);
+  shown = out_one_operand (n);
+  if (n == 2) {
+    for (i = 3; i < UA_MAXOP && cmd.Operands[i].type != o_void; i++) {
+      if (!cmd.Operands[i].showed ())
+        continue;
+      out_symbol (',');
+      out_one_operand (i);
+    }
+  }
+  term_output_buffer ();
+  return shown;
+}
+
+bool
+MakeLine (const char *contents, int indent)
+{
+  if (made_line != NULL)
+    qstrncpy (made_line, contents, made_line_size);
+  return true;
+}
+
+/* The whole line of the instruction at 'ea', through custom_out if a plugin
+ * wants to print it itself */
+bool
+generate_disasm_line (ea_t ea, char *buf, size_t bufsize, int flags)
+{
+  bool first;
+  int i;
+
+  if (ua_ana0 (ea) == 0)
+    return false;
+
+  made_line = buf;
+  made_line_size = bufsize;
+  gl_comm = 0;
+  i = ph.notify (ph.custom_out);
+  made_line = NULL;
+  if (i == 2)
+    return true;
+
+  init_output_buffer (buf, bufsize);
+  OutMnem ();
+  first = true;
+  for (i = 0; i < UA_MAXOP && cmd.Operands[i].type != o_void; i++) {
+    if (!cmd.Operands[i].showed ())
+      continue;
+    if (!first) {
+      out_symbol (',');
+      OutChar (' ');
+    }
+    out_one_operand (i);
+    first = false;
+  }
+  term_output_buffer ();
+  return true;
+}
+
+/*
+ * Color tags
+ */
+
+ssize_t
+tag_remove (const char *instr, char *buf, size_t bufsize)
+{
+  size_t len = 0;
+
+  if (bufsize == 0)
+    return -1;
+  // 'buf' may be 'instr', we only ever write behind the read position
+  while (*instr && len + 1 < bufsize) {
+    if (*instr == COLOR_ON || *instr == COLOR_OFF) {
+      instr++;
+      if (*instr)
+        instr++;
+      continue;
+    }
+    buf[len++] = *instr++;
+  }
+  buf[len] = '\0';
+  return (ssize_t) len;
+}
+
+ssize_t
+tag_strlen (const char *line)
+{
+  ssize_t len = 0;
+
+  while (*line) {
+    if (*line == COLOR_ON || *line == COLOR_OFF) {
+      line++;
+      if (*line)
+        line++;
+      continue;
+    }
+    line++;
+    len++;
+  }
+  return len;
+}
@@ -0,0 +1,20 @@
+/*
+ * plugins_fix_rtoc.cpp -- Plugins of the headless fix_rtoc executable
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+#include "headless.hpp"
+
+extern plugin_t ppcjt_PLUGIN;
+extern plugin_t fix_rtoc_PLUGIN;
+
+plugin_t *headless_plugins[] = {
+  &ppcjt_PLUGIN,
+  &fix_rtoc_PLUGIN,
+  NULL
+};
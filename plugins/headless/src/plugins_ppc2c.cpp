@@ -0,0 +1,21 @@
+/*
+ * plugins_ppc2c.cpp -- Plugins of the headless PPC2C executable
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+#include "headless.hpp"
+
+/* PPCJT resolves the jump tables during the analysis, then PPC2C runs */
+extern plugin_t ppcjt_PLUGIN;
+extern plugin_t ppc2c_PLUGIN;
+
+plugin_t *headless_plugins[] = {
+  &ppcjt_PLUGIN,
+  &ppc2c_PLUGIN,
+  NULL
+};
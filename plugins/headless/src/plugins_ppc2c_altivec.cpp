@@ -0,0 +1,25 @@
+/*
+ * plugins_ppc2c_altivec.cpp -- Plugins of the headless PPC2C executable with Altivec
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+#include "headless.hpp"
+
+/* PPCAltivec decodes the vector instructions and PPCJT resolves the jump
+ * tables during the analysis, then PPC2C runs. PPCAltivec also takes over
+ * mtspr and mfspr, so mtctr and mtlr reach PPC2C as mtspr */
+extern plugin_t ppcaltivec_PLUGIN;
+extern plugin_t ppcjt_PLUGIN;
+extern plugin_t ppc2c_PLUGIN;
+
+plugin_t *headless_plugins[] = {
+  &ppcaltivec_PLUGIN,
+  &ppcjt_PLUGIN,
+  &ppc2c_PLUGIN,
+  NULL
+};
@@ -0,0 +1,19 @@
+/*
+ * plugins_ppcjt.cpp -- Plugins of the headless PPCJT executable
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+#include "headless.hpp"
+
+/* PPCJT does its work in the analysis, through ph.is_switch */
+extern plugin_t ppcjt_PLUGIN;
+
+plugin_t *headless_plugins[] = {
+  &ppcjt_PLUGIN,
+  NULL
+};
@@ -0,0 +1,1037 @@
+/*
+ * ppc.cpp -- PowerPC decoder of the headless IDA SDK stand-in
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+/*
+ * Decodes the user mode PowerPC 64 instructions compilers emit for the Cell
+ * PPU and prints them the way the IDA PPC module does: simplified mnemonics,
+ * "%r3"-style registers, "crN" for the condition register fields, and the
+ * rotate and shift fields in decimal. Altivec and anything privileged or
+ * exotic is left undecoded so the plugins' custom_ana hooks can take it.
+ */
+
+#include "headless.hpp"
+
+#define OPCD(w) ((w) >> 26)
+#define RT(w) (((w) >> 21) & 0x1F)
+#define RA(w) (((w) >> 16) & 0x1F)
+#define RB(w) (((w) >> 11) & 0x1F)
+#define RC(w) (((w) >> 6) & 0x1F)
+#define XO10(w) (((w) >> 1) & 0x3FF)
+#define XO9(w) (((w) >> 1) & 0x1FF)
+#define XO5(w) (((w) >> 1) & 0x1F)
+#define SIMM(w) ((sval_t) (int16) ((w) & 0xFFFF))
+#define UIMM(w) ((w) & 0xFFFF)
+#define RC_BIT(w) ((w) & 1)
+#define OE_BIT(w) (((w) >> 10) & 1)
+
+#define SPR_XER 1
+#define SPR_LR 8
+#define SPR_CTR 9
+#define TBR_TB 268
+
+/* Shown as a condition bit, "4*cr7+eq", in the raw bc forms */
+#define o_crbit o_idpspec0
+
+static const char *mnemonics[] = {
+#define X(name) #name,
+  HEADLESS_PPC_INSTRUCTIONS
+#undef X
+};
+
+static const char *conditions[] = {"lt", "gt", "eq", "so"};
+
+/* Simplified conditional branches by condition bit, when the condition is
+ * true (BO=12) and false (BO=4). 0 when there is none */
+static const uint16 branch_true[] = {PPC_blt, PPC_bgt, PPC_beq, PPC_bso};
+static const uint16 branch_false[] = {PPC_bge, PPC_ble, PPC_bne, PPC_bns};
+static const uint16 branch_lr_true[] = {PPC_bltlr, PPC_bgtlr, PPC_beqlr, 0};
+static const uint16 branch_lr_false[] = {PPC_bgelr, PPC_blelr, PPC_bnelr, 0};
+static const uint16 branch_ctr_true[] = {PPC_bltctr, PPC_bgtctr, PPC_beqctr, 0};
+static const uint16 branch_ctr_false[] = {PPC_bgectr, PPC_blectr, PPC_bnectr, 0};
+
+static int nops; // Operands set so far
+
+static op_t &
+next_op (optype_t type)
+{
+  op_t &x = cmd.Operands[nops++];
+
+  x.type = type;
+  x.dtyp = dt_dword;
+  return x;
+}
+
+static void
+op_reg (int reg)
+{
+  next_op (o_reg).reg = (uint16) reg;
+}
+
+static void
+op_gpr (int reg)
+{
+  op_reg (HL_REG_R0 + reg);
+}
+
+static void
+op_fpr (int reg)
+{
+  op_reg (HL_REG_F0 + reg);
+}
+
+static void
+op_cr (int crf)
+{
+  op_reg (HL_REG_CR0 + crf);
+}
+
+static void
+op_imm (sval_t value)
+{
+  next_op (o_imm).value = (uval_t) value;
+}
+
+/* Bit numbers, shift counts and masks, always printed in decimal */
+static void
+op_dec (int value)
+{
+  op_t &x = next_op (o_imm);
+
+  x.value = (uval_t) value;
+  x.dtyp = dt_byte;
+}
+
+static void
+op_displ (int base, sval_t displ)
+{
+  op_t &x = next_op (o_displ);
+
+  x.reg = (uint16) base;
+  x.addr = (ea_t) displ;
+}
+
+static void
+op_near (ea_t addr)
+{
+  op_t &x = next_op (o_near);
+
+  x.addr = addr;
+  x.dtyp = dt_code;
+}
+
+static void
+op_crbit (int bit)
+{
+  next_op (o_crbit).value = (uval_t) bit;
+}
+
+static void
+op_hide_last (void)
+{
+  cmd.Operands[nops - 1].clr_showed ();
+}
+
+static int
+set (uint16 itype, uint16 auxpref = 0)
+{
+  cmd.itype = itype;
+  cmd.auxpref |= auxpref;
+  return 4;
+}
+
+/* Record and overflow forms */
+static int
+set_rc (uint16 itype, uint32 w, bool oe = false)
+{
+  return set (itype, (RC_BIT (w) ? HL_AUX_RC : 0) | (oe && OE_BIT (w) ? HL_AUX_OE : 0));
+}
+
+static ea_t
+branch_target (uint32 w, sval_t displ)
+{
+  if (w & 2)
+    return (ea_t) displ;
+  return cmd.ea + displ;
+}
+
+static int
+ana_bc (uint32 w)
+{
+  int BO = RT (w);
+  int BI = RA (w);
+  sval_t BD = SIMM (w & ~3);
+  ea_t target = branch_target (w, BD);
+  uint16 aux = (w & 1 ? HL_AUX_LK : 0) | (w & 2 ? HL_AUX_AA : 0);
+
+  if ((BO & 0x14) == 0x14) {
+    op_near (target);
+    return set (PPC_b, aux);
+  }
+  if ((BO & 0x1C) == 0x0C || (BO & 0x1C) == 0x04) {
+    op_cr (BI >> 2);
+    op_near (target);
+    return set ((BO & 0x08) ? branch_true[BI & 3] : branch_false[BI & 3], aux);
+  }
+  if ((BO & 0x1E) == 0x10 || (BO & 0x1E) == 0x12) {
+    // No condition, the hidden cr0 keeps the target in Op2 like the others
+    op_cr (0);
+    op_hide_last ();
+    op_near (target);
+    return set ((BO & 0x02) ? PPC_bdz : PPC_bdnz, aux);
+  }
+  op_dec (BO);
+  op_crbit (BI);
+  op_near (target);
+  return set (PPC_bc, aux);
+}
+
+/* bclr and bcctr */
+static int
+ana_bcreg (uint32 w, bool ctr)
+{
+  int BO = RT (w);
+  int BI = RA (w);
+  uint16 aux = (ctr ? HL_AUX_CTR : HL_AUX_LR) | (w & 1 ? HL_AUX_LK : 0);
+  uint16 itype = 0;
+
+  if ((BO & 0x14) == 0x14) {
+    if (ctr)
+      return set ((w & 1) ? PPC_bctrl : PPC_bctr, aux);
+    return set ((w & 1) ? PPC_blrl : PPC_blr, aux);
+  }
+  if ((BO & 0x1C) == 0x0C)
+    itype = ctr ? branch_ctr_true[BI & 3] : branch_lr_true[BI & 3];
+  else if ((BO & 0x1C) == 0x04)
+    itype = ctr ? branch_ctr_false[BI & 3] : branch_lr_false[BI & 3];
+  if (itype != 0) {
+    op_cr (BI >> 2);
+    return set (itype, aux);
+  }
+  op_dec (BO);
+  op_crbit (BI);
+  return set (ctr ? PPC_bcctr : PPC_bclr, aux);
+}
+
+static int
+ana_rlwinm (uint32 w)
+{
+  int SH = RB (w);
+  int MB = RC (w);
+  int ME = XO5 (w);
+
+  op_gpr (RA (w));
+  op_gpr (RT (w));
+  if (MB == 0 && ME == 31) {
+    op_dec (SH);
+    return set_rc (PPC_rotlwi, w);
+  }
+  if (SH == 0 && ME == 31) {
+    op_dec (MB);
+    return set_rc (PPC_clrlwi, w);
+  }
+  if (SH == 0 && MB == 0) {
+    op_dec (31 - ME);
+    return set_rc (PPC_clrrwi, w);
+  }
+  if (MB == 0 && ME == 31 - SH) {
+    op_dec (SH);
+    return set_rc (PPC_slwi, w);
+  }
+  if (ME == 31 && SH == 32 - MB) {
+    op_dec (MB);
+    return set_rc (PPC_srwi, w);
+  }
+  if (ME == 31 - SH && MB + SH < 32) {
+    op_dec (MB + SH);
+    op_dec (SH);
+    return set_rc (PPC_clrlslwi, w);
+  }
+  if (MB == 0) {
+    op_dec (ME + 1);
+    op_dec (SH);
+    return set_rc (PPC_extlwi, w);
+  }
+  if (ME == 31 && SH >= 32 - MB) {
+    op_dec (32 - MB);
+    op_dec (SH - (32 - MB));
+    return set_rc (PPC_extrwi, w);
+  }
+  op_dec (SH);
+  op_dec (MB);
+  op_dec (ME);
+  return set_rc (PPC_rlwinm, w);
+}
+
+static int
+ana_rlwimi (uint32 w)
+{
+  int SH = RB (w);
+  int MB = RC (w);
+  int ME = XO5 (w);
+
+  op_gpr (RA (w));
+  op_gpr (RT (w));
+  if (ME >= MB && SH != 0 && SH == 32 - MB) {
+    op_dec (ME - MB + 1);
+    op_dec (MB);
+    return set_rc (PPC_inslwi, w);
+  }
+  if (ME >= MB && ME < 31 && SH == 31 - ME) {
+    op_dec (ME - MB + 1);
+    op_dec (MB);
+    return set_rc (PPC_insrwi, w);
+  }
+  op_dec (SH);
+  op_dec (MB);
+  op_dec (ME);
+  return set_rc (PPC_rlwimi, w);
+}
+
+/* MD and MDS forms */
+static int
+ana_rld (uint32 w)
+{
+  int SH = RB (w) | ((w & 2) << 4);
+  int MB = RC (w) | (w & 0x20);
+
+  op_gpr (RA (w));
+  op_gpr (RT (w));
+  if (((w >> 2) & 7) == 4) {
+    // MDS form, rotate by a register
+    op_gpr (RB (w));
+    if ((w & 2) == 0 && MB == 0)
+      return set_rc (PPC_rotld, w);
+    op_dec (MB);
+    return set_rc ((w & 2) ? PPC_rldcr : PPC_rldcl, w);
+  }
+  switch ((w >> 2) & 7) {
+    case 0: // rldicl
+      if (MB == 0) {
+        op_dec (SH);
+        return set_rc (PPC_rotldi, w);
+      }
+      if (SH == 0) {
+        op_dec (MB);
+        return set_rc (PPC_clrldi, w);
+      }
+      if (SH == 64 - MB) {
+        op_dec (MB);
+        return set_rc (PPC_srdi, w);
+      }
+      if (SH > 64 - MB) {
+        op_dec (64 - MB);
+        op_dec (SH - (64 - MB));
+        return set_rc (PPC_extrdi, w);
+      }
+      op_dec (SH);
+      op_dec (MB);
+      return set_rc (PPC_rldicl, w);
+    case 1: // rldicr, PPCJT wants the "2,61" of its jump tables raw
+      if (SH == 0) {
+        op_dec (63 - MB);
+        return set_rc (PPC_clrrdi, w);
+      }
+      op_dec (SH);
+      op_dec (MB);
+      return set_rc (PPC_rldicr, w);
+    case 2:
+      op_dec (SH);
+      op_dec (MB);
+      return set_rc (PPC_rldic, w);
+    case 3:
+      if (MB + SH < 64) {
+        op_dec (64 - SH - MB);
+        op_dec (MB);
+        return set_rc (PPC_insrdi, w);
+      }
+      op_dec (SH);
+      op_dec (MB);
+      return set_rc (PPC_rldimi, w);
+  }
+  return 0;
+}
+
+/* D-form loads and stores */
+static int
+ana_dform (uint32 w, uint16 itype, bool fpr)
+{
+  if (fpr)
+    op_fpr (RT (w));
+  else
+    op_gpr (RT (w));
+  op_displ (RA (w), SIMM (w));
+  return set (itype);
+}
+
+/* X-form loads and stores */
+static int
+ana_xform (uint32 w, uint16 itype, bool fpr = false)
+{
+  if (fpr)
+    op_fpr (RT (w));
+  else
+    op_gpr (RT (w));
+  op_gpr (RA (w));
+  op_gpr (RB (w));
+  return set_rc (itype, w);
+}
+
+/* rA, rS, rB logical and shift instructions */
+static int
+ana_logical (uint32 w, uint16 itype)
+{
+  op_gpr (RA (w));
+  op_gpr (RT (w));
+  op_gpr (RB (w));
+  return set_rc (itype, w);
+}
+
+static int
+ana_unary (uint32 w, uint16 itype)
+{
+  op_gpr (RA (w));
+  op_gpr (RT (w));
+  return set_rc (itype, w);
+}
+
+/* rD, rA, rB arithmetic instructions */
+static int
+ana_arith (uint32 w, uint16 itype, int nregs)
+{
+  op_gpr (RT (w));
+  op_gpr (RA (w));
+  if (nregs == 3)
+    op_gpr (RB (w));
+  return set_rc (itype, w, true);
+}
+
+static int
+ana_31_xo (uint32 w)
+{
+  switch (XO9 (w)) {
+    case 266: return ana_arith (w, PPC_add, 3);
+    case 10: return ana_arith (w, PPC_addc, 3);
+    case 138: return ana_arith (w, PPC_adde, 3);
+    case 234: return ana_arith (w, PPC_addme, 2);
+    case 202: return ana_arith (w, PPC_addze, 2);
+    case 489: return ana_arith (w, PPC_divd, 3);
+    case 457: return ana_arith (w, PPC_divdu, 3);
+    case 491: return ana_arith (w, PPC_divw, 3);
+    case 459: return ana_arith (w, PPC_divwu, 3);
+    case 73: return ana_arith (w, PPC_mulhd, 3);
+    case 9: return ana_arith (w, PPC_mulhdu, 3);
+    case 75: return ana_arith (w, PPC_mulhw, 3);
+    case 11: return ana_arith (w, PPC_mulhwu, 3);
+    case 233: return ana_arith (w, PPC_mulld, 3);
+    case 235: return ana_arith (w, PPC_mullw, 3);
+    case 104: return ana_arith (w, PPC_neg, 2);
+    case 40: return ana_arith (w, PPC_subf, 3);
+    case 8: return ana_arith (w, PPC_subfc, 3);
+    case 136: return ana_arith (w, PPC_subfe, 3);
+    case 232: return ana_arith (w, PPC_subfme, 2);
+    case 200: return ana_arith (w, PPC_subfze, 2);
+  }
+  return 0;
+}
+
+static int
+ana_spr (uint32 w, bool to)
+{
+  int spr = RA (w) | (RB (w) << 5);
+
+  op_gpr (RT (w));
+  switch (spr) {
+    case SPR_LR:
+      // Two operands, the way PPC2C's mflr and mtlr handlers read them
+      if (to) {
+        cmd.Operands[0].reg = HL_REG_LR;
+        op_gpr (RT (w));
+        return set (PPC_mtlr);
+      }
+      op_reg (HL_REG_LR);
+      return set (PPC_mflr);
+    case SPR_CTR:
+      return set (to ? PPC_mtctr : PPC_mfctr);
+    case SPR_XER:
+      return set (to ? PPC_mtxer : PPC_mfxer);
+  }
+  if (to) {
+    // mtspr SPR, rS
+    cmd.Operands[0].type = o_imm;
+    cmd.Operands[0].value = spr;
+    op_gpr (RT (w));
+    return set (PPC_mtspr);
+  }
+  op_imm (spr);
+  return set (PPC_mfspr);
+}
+
+static int
+ana_31 (uint32 w)
+{
+  switch (XO10 (w)) {
+    case 0:
+    case 32:
+      op_cr (RT (w) >> 2);
+      op_gpr (RA (w));
+      op_gpr (RB (w));
+      if (XO10 (w) == 0)
+        return set ((w & 0x00200000) ? PPC_cmpd : PPC_cmpw);
+      return set ((w & 0x00200000) ? PPC_cmpld : PPC_cmplw);
+    case 4:
+      if (RT (w) == 31 && RA (w) == 0 && RB (w) == 0)
+        return set (PPC_trap);
+      op_dec (RT (w));
+      op_gpr (RA (w));
+      op_gpr (RB (w));
+      return set (PPC_tw);
+    case 68:
+      op_dec (RT (w));
+      op_gpr (RA (w));
+      op_gpr (RB (w));
+      return set (PPC_td);
+    case 26: return ana_unary (w, PPC_cntlzw);
+    case 58: return ana_unary (w, PPC_cntlzd);
+    case 954: return ana_unary (w, PPC_extsb);
+    case 922: return ana_unary (w, PPC_extsh);
+    case 986: return ana_unary (w, PPC_extsw);
+    case 28: return ana_logical (w, PPC_and);
+    case 60: return ana_logical (w, PPC_andc);
+    case 284: return ana_logical (w, PPC_eqv);
+    case 476: return ana_logical (w, PPC_nand);
+    case 412: return ana_logical (w, PPC_orc);
+    case 316: return ana_logical (w, PPC_xor);
+    case 24: return ana_logical (w, PPC_slw);
+    case 27: return ana_logical (w, PPC_sld);
+    case 536: return ana_logical (w, PPC_srw);
+    case 539: return ana_logical (w, PPC_srd);
+    case 792: return ana_logical (w, PPC_sraw);
+    case 794: return ana_logical (w, PPC_srad);
+    case 444:
+      if (RT (w) == RB (w))
+        return ana_unary (w, PPC_mr);
+      return ana_logical (w, PPC_or);
+    case 124:
+      if (RT (w) == RB (w))
+        return ana_unary (w, PPC_not);
+      return ana_logical (w, PPC_nor);
+    case 824:
+      op_gpr (RA (w));
+      op_gpr (RT (w));
+      op_dec (RB (w));
+      return set_rc (PPC_srawi, w);
+    case 826:
+    case 827:
+      op_gpr (RA (w));
+      op_gpr (RT (w));
+      op_dec (RB (w) | ((w & 2) << 4));
+      return set_rc (PPC_sradi, w);
+
+    case 87: return ana_xform (w, PPC_lbzx);
+    case 119: return ana_xform (w, PPC_lbzux);
+    case 21: return ana_xform (w, PPC_ldx);
+    case 53: return ana_xform (w, PPC_ldux);
+    case 84: return ana_xform (w, PPC_ldarx);
+    case 279: return ana_xform (w, PPC_lhzx);
+    case 311: return ana_xform (w, PPC_lhzux);
+    case 343: return ana_xform (w, PPC_lhax);
+    case 375: return ana_xform (w, PPC_lhaux);
+    case 790: return ana_xform (w, PPC_lhbrx);
+    case 23: return ana_xform (w, PPC_lwzx);
+    case 55: return ana_xform (w, PPC_lwzux);
+    case 341: return ana_xform (w, PPC_lwax);
+    case 373: return ana_xform (w, PPC_lwaux);
+    case 20: return ana_xform (w, PPC_lwarx);
+    case 534: return ana_xform (w, PPC_lwbrx);
+    case 533: return ana_xform (w, PPC_lswx);
+    case 535: return ana_xform (w, PPC_lfsx, true);
+    case 567: return ana_xform (w, PPC_lfsux, true);
+    case 599: return ana_xform (w, PPC_lfdx, true);
+    case 631: return ana_xform (w, PPC_lfdux, true);
+    case 215: return ana_xform (w, PPC_stbx);
+    case 247: return ana_xform (w, PPC_stbux);
+    case 149: return ana_xform (w, PPC_stdx);
+    case 181: return ana_xform (w, PPC_stdux);
+    case 214: return ana_xform (w, PPC_stdcx);
+    case 407: return ana_xform (w, PPC_sthx);
+    case 439: return ana_xform (w, PPC_sthux);
+    case 918: return ana_xform (w, PPC_sthbrx);
+    case 151: return ana_xform (w, PPC_stwx);
+    case 183: return ana_xform (w, PPC_stwux);
+    case 150: return ana_xform (w, PPC_stwcx);
+    case 662: return ana_xform (w, PPC_stwbrx);
+    case 661: return ana_xform (w, PPC_stswx);
+    case 663: return ana_xform (w, PPC_stfsx, true);
+    case 695: return ana_xform (w, PPC_stfsux, true);
+    case 727: return ana_xform (w, PPC_stfdx, true);
+    case 759: return ana_xform (w, PPC_stfdux, true);
+    case 983: return ana_xform (w, PPC_stfiwx, true);
+    case 597:
+    case 725:
+      op_gpr (RT (w));
+      op_gpr (RA (w));
+      op_dec (RB (w));
+      return set (XO10 (w) == 597 ? PPC_lswi : PPC_stswi);
+
+    case 86: case 54: case 278: case 246: case 1014: case 982: case 470: case 758:
+      op_gpr (RA (w));
+      op_gpr (RB (w));
+      switch (XO10 (w)) {
+        case 86: return set (PPC_dcbf);
+        case 54: return set (PPC_dcbst);
+        case 278: return set (PPC_dcbt);
+        case 246: return set (PPC_dcbtst);
+        case 1014: return set (PPC_dcbz);
+        case 982: return set (PPC_icbi);
+        case 470: return set (PPC_dcbi);
+        default: return set (PPC_dcba);
+      }
+    case 598:
+      if (RT (w) & 3)
+        op_dec (RT (w) & 3);
+      return set (PPC_sync);
+    case 854: return set (PPC_eieio);
+    case 566: return set (PPC_tlbsync);
+
+    case 19:
+      op_gpr (RT (w));
+      return set (PPC_mfcr);
+    case 144:
+      if (((w >> 12) & 0xFF) == 0xFF) {
+        op_gpr (RT (w));
+        return set (PPC_mtcr);
+      }
+      op_imm ((w >> 12) & 0xFF);
+      op_gpr (RT (w));
+      return set (PPC_mtcrf);
+    case 339: return ana_spr (w, false);
+    case 467: return ana_spr (w, true);
+    case 371:
+      op_gpr (RT (w));
+      if ((RA (w) | (RB (w) << 5)) != TBR_TB)
+        op_imm (RA (w) | (RB (w) << 5));
+      return set (PPC_mftb);
+    case 512:
+      op_cr (RT (w) >> 2);
+      return set (PPC_mcrxr);
+  }
+  return ana_31_xo (w);
+}
+
+static int
+ana_19 (uint32 w)
+{
+  switch (XO10 (w)) {
+    case 16: return ana_bcreg (w, false);
+    case 528: return ana_bcreg (w, true);
+    case 0:
+      op_cr (RT (w) >> 2);
+      op_cr (RA (w) >> 2);
+      return set (PPC_mcrf);
+    case 150: return set (PPC_isync);
+    case 18: return set (PPC_rfid);
+    case 50: return set (PPC_rfi);
+    case 33: case 129: case 193: case 225: case 257: case 289: case 417: case 449:
+      op_dec (RT (w));
+      op_dec (RA (w));
+      op_dec (RB (w));
+      switch (XO10 (w)) {
+        case 33: return set (PPC_crnor);
+        case 129: return set (PPC_crandc);
+        case 193: return set (PPC_crxor);
+        case 225: return set (PPC_crnand);
+        case 257: return set (PPC_crand);
+        case 289: return set (PPC_creqv);
+        case 417: return set (PPC_crorc);
+        default: return set (PPC_cror);
+      }
+  }
+  return 0;
+}
+
+/* Floating point, primary opcodes 59 (single) and 63 (double) */
+static int
+ana_float (uint32 w, bool single)
+{
+  int xo = XO5 (w);
+
+  if (single || xo >= 18) {
+    switch (xo) {
+      case 18: case 20: case 21:
+        op_fpr (RT (w));
+        op_fpr (RA (w));
+        op_fpr (RB (w));
+        if (xo == 18)
+          return set_rc (single ? PPC_fdivs : PPC_fdiv, w);
+        if (xo == 20)
+          return set_rc (single ? PPC_fsubs : PPC_fsub, w);
+        return set_rc (single ? PPC_fadds : PPC_fadd, w);
+      case 25:
+        op_fpr (RT (w));
+        op_fpr (RA (w));
+        op_fpr (RC (w));
+        return set_rc (single ? PPC_fmuls : PPC_fmul, w);
+      case 22: case 24: case 26:
+        op_fpr (RT (w));
+        op_fpr (RB (w));
+        if (xo == 22)
+          return set_rc (single ? PPC_fsqrts : PPC_fsqrt, w);
+        if (xo == 24)
+          return single ? set_rc (PPC_fres, w) : 0;
+        return single ? 0 : set_rc (PPC_frsqrte, w);
+      case 23: case 28: case 29: case 30: case 31:
+        if (xo == 23 && single)
+          return 0;
+        op_fpr (RT (w));
+        op_fpr (RA (w));
+        op_fpr (RC (w));
+        op_fpr (RB (w));
+        switch (xo) {
+          case 23: return set_rc (PPC_fsel, w);
+          case 28: return set_rc (single ? PPC_fmsubs : PPC_fmsub, w);
+          case 29: return set_rc (single ? PPC_fmadds : PPC_fmadd, w);
+          case 30: return set_rc (single ? PPC_fnmsubs : PPC_fnmsub, w);
+          default: return set_rc (single ? PPC_fnmadds : PPC_fnmadd, w);
+        }
+    }
+    return 0;
+  }
+
+  switch (XO10 (w)) {
+    case 0:
+    case 32:
+      op_cr (RT (w) >> 2);
+      op_fpr (RA (w));
+      op_fpr (RB (w));
+      return set (XO10 (w) == 0 ? PPC_fcmpu : PPC_fcmpo);
+    case 12: case 14: case 15: case 814: case 815: case 846:
+    case 72: case 40: case 264: case 136:
+      op_fpr (RT (w));
+      op_fpr (RB (w));
+      switch (XO10 (w)) {
+        case 12: return set_rc (PPC_frsp, w);
+        case 14: return set_rc (PPC_fctiw, w);
+        case 15: return set_rc (PPC_fctiwz, w);
+        case 814: return set_rc (PPC_fctid, w);
+        case 815: return set_rc (PPC_fctidz, w);
+        case 846: return set_rc (PPC_fcfid, w);
+        case 72: return set_rc (PPC_fmr, w);
+        case 40: return set_rc (PPC_fneg, w);
+        case 264: return set_rc (PPC_fabs, w);
+        default: return set_rc (PPC_fnabs, w);
+      }
+    case 583:
+      op_fpr (RT (w));
+      return set_rc (PPC_mffs, w);
+    case 711:
+      op_imm ((w >> 17) & 0xFF);
+      op_fpr (RB (w));
+      return set_rc (PPC_mtfsf, w);
+    case 134:
+      op_cr (RT (w) >> 2);
+      op_dec ((w >> 12) & 0xF);
+      return set_rc (PPC_mtfsfi, w);
+    case 70:
+    case 38:
+      op_dec (RT (w));
+      return set_rc (XO10 (w) == 70 ? PPC_mtfsb0 : PPC_mtfsb1, w);
+    case 64:
+      op_cr (RT (w) >> 2);
+      op_cr (RA (w) >> 2);
+      return set (PPC_mcrfs);
+  }
+  return 0;
+}
+
+/* Decode the instruction at cmd.ea. Returns its size, 0 if it isn't one */
+int
+hl_ppc_ana (void)
+{
+  uint32 w;
+  sval_t displ;
+
+  if (!isLoaded (cmd.ea) || (cmd.ea & 3) != 0)
+    return 0;
+  w = get_long (cmd.ea);
+  nops = 0;
+
+  switch (OPCD (w)) {
+    case 2:
+    case 3:
+      op_dec (RT (w));
+      op_gpr (RA (w));
+      op_imm (SIMM (w));
+      return set (OPCD (w) == 2 ? PPC_tdi : PPC_twi);
+    case 7:
+    case 8:
+    case 12:
+    case 13:
+      op_gpr (RT (w));
+      op_gpr (RA (w));
+      op_imm (SIMM (w));
+      switch (OPCD (w)) {
+        case 7: return set (PPC_mulli);
+        case 8: return set (PPC_subfic);
+        case 12: return set (PPC_addic);
+        default: return set (PPC_addic, HL_AUX_RC);
+      }
+    case 10:
+    case 11:
+      op_cr (RT (w) >> 2);
+      op_gpr (RA (w));
+      if (OPCD (w) == 10) {
+        op_imm (UIMM (w));
+        return set ((w & 0x00200000) ? PPC_cmpldi : PPC_cmplwi);
+      }
+      op_imm (SIMM (w));
+      return set ((w & 0x00200000) ? PPC_cmpdi : PPC_cmpwi);
+    case 14:
+    case 15:
+      op_gpr (RT (w));
+      if (RA (w) == 0) {
+        op_imm (SIMM (w));
+        return set (OPCD (w) == 14 ? PPC_li : PPC_lis);
+      }
+      op_gpr (RA (w));
+      op_imm (SIMM (w));
+      return set (OPCD (w) == 14 ? PPC_addi : PPC_addis);
+    case 16:
+      return ana_bc (w);
+    case 17:
+      if (w & 2)
+        return set (PPC_sc);
+      return 0;
+    case 18:
+      displ = w & 0x03FFFFFC;
+      if (displ & 0x02000000)
+        displ -= 0x04000000;
+      op_near (branch_target (w, displ));
+      return set (PPC_b, (w & 1 ? HL_AUX_LK : 0) | (w & 2 ? HL_AUX_AA : 0));
+    case 19:
+      return ana_19 (w);
+    case 20:
+      return ana_rlwimi (w);
+    case 21:
+      return ana_rlwinm (w);
+    case 23:
+      op_gpr (RA (w));
+      op_gpr (RT (w));
+      op_gpr (RB (w));
+      if (RC (w) == 0 && XO5 (w) == 31)
+        return set_rc (PPC_rotlw, w);
+      op_dec (RC (w));
+      op_dec (XO5 (w));
+      return set_rc (PPC_rlwnm, w);
+    case 24:
+      if (w == 0x60000000)
+        return set (PPC_nop);
+      // Fall through
+    case 25:
+    case 26:
+    case 27:
+    case 28:
+    case 29:
+      op_gpr (RA (w));
+      op_gpr (RT (w));
+      op_imm (UIMM (w));
+      switch (OPCD (w)) {
+        case 24: return set (PPC_ori);
+        case 25: return set (PPC_oris);
+        case 26: return set (PPC_xori);
+        case 27: return set (PPC_xoris);
+        case 28: return set (PPC_andi, HL_AUX_RC);
+        default: return set (PPC_andis, HL_AUX_RC);
+      }
+    case 30:
+      return ana_rld (w);
+    case 31:
+      return ana_31 (w);
+    case 32: return ana_dform (w, PPC_lwz, false);
+    case 33: return ana_dform (w, PPC_lwzu, false);
+    case 34: return ana_dform (w, PPC_lbz, false);
+    case 35: return ana_dform (w, PPC_lbzu, false);
+    case 36: return ana_dform (w, PPC_stw, false);
+    case 37: return ana_dform (w, PPC_stwu, false);
+    case 38: return ana_dform (w, PPC_stb, false);
+    case 39: return ana_dform (w, PPC_stbu, false);
+    case 40: return ana_dform (w, PPC_lhz, false);
+    case 41: return ana_dform (w, PPC_lhzu, false);
+    case 42: return ana_dform (w, PPC_lha, false);
+    case 43: return ana_dform (w, PPC_lhau, false);
+    case 44: return ana_dform (w, PPC_sth, false);
+    case 45: return ana_dform (w, PPC_sthu, false);
+    case 46: return ana_dform (w, PPC_lmw, false);
+    case 47: return ana_dform (w, PPC_stmw, false);
+    case 48: return ana_dform (w, PPC_lfs, true);
+    case 49: return ana_dform (w, PPC_lfsu, true);
+    case 50: return ana_dform (w, PPC_lfd, true);
+    case 51: return ana_dform (w, PPC_lfdu, true);
+    case 52: return ana_dform (w, PPC_stfs, true);
+    case 53: return ana_dform (w, PPC_stfsu, true);
+    case 54: return ana_dform (w, PPC_stfd, true);
+    case 55: return ana_dform (w, PPC_stfdu, true);
+    case 58:
+    case 62:
+      // DS form, the low two bits select the instruction
+      op_gpr (RT (w));
+      op_displ (RA (w), SIMM (w & ~3));
+      switch ((OPCD (w) == 62 ? 4 : 0) | (w & 3)) {
+        case 0: return set (PPC_ld);
+        case 1: return set (PPC_ldu);
+        case 2: return set (PPC_lwa);
+        case 4: return set (PPC_std);
+        case 5: return set (PPC_stdu);
+      }
+      return 0;
+    case 59:
+      return ana_float (w, true);
+    case 63:
+      return ana_float (w, false);
+  }
+  return 0;
+}
+
+/* bl, bctrl and friends, but not "bcl 20,31,$+4", which only reads the PC */
+bool
+hl_ppc_is_call (void)
+{
+  if ((cmd.auxpref & HL_AUX_LK) == 0 || cmd.itype >= CUSTOM_CMD_ITYPE)
+    return false;
+  if (cmd.itype == PPC_b && cmd.Op1.addr == cmd.ea + 4)
+    return false;
+  return true;
+}
+
+/* The execution doesn't go on to the next instruction */
+bool
+hl_ppc_is_stop (void)
+{
+  if (cmd.itype >= CUSTOM_CMD_ITYPE || (cmd.auxpref & HL_AUX_LK) != 0)
+    return false;
+  switch (cmd.itype) {
+    case PPC_b:
+    case PPC_blr:
+    case PPC_bctr:
+    case PPC_rfi:
+    case PPC_rfid:
+    case PPC_trap:
+      return true;
+  }
+  return false;
+}
+
+bool
+hl_ppc_is_indirect_jump (void)
+{
+  return cmd.itype == PPC_bctr;
+}
+
+static bool
+is_branch (uint16 itype)
+{
+  return (itype >= PPC_b && itype <= PPC_bclr) ||
+      (itype >= PPC_blt && itype <= PPC_bnectr);
+}
+
+const char *
+hl_ppc_mnem (char *buf, size_t bufsize)
+{
+  if (cmd.itype == PPC_null || cmd.itype >= PPC_last)
+    return NULL;
+  qstrncpy (buf, mnemonics[cmd.itype], bufsize);
+  if (is_branch (cmd.itype) && cmd.itype != PPC_bctrl && cmd.itype != PPC_blrl) {
+    if (cmd.auxpref & HL_AUX_LK)
+      qstrncat (buf, "l", bufsize);
+    if (cmd.auxpref & HL_AUX_AA)
+      qstrncat (buf, "a", bufsize);
+  }
+  if (cmd.auxpref & HL_AUX_OE)
+    qstrncat (buf, "o", bufsize);
+  if (cmd.auxpref & HL_AUX_RC)
+    qstrncat (buf, ".", bufsize);
+  return buf;
+}
+
+static void
+out_reg_name (int reg)
+{
+  char buf[16];
+
+  if (reg == 1)
+    qstrncpy (buf, "%sp", sizeof(buf));
+  else if (reg == 2)
+    qstrncpy (buf, "%rtoc", sizeof(buf));
+  else if (reg < HL_REG_F0)
+    qsnprintf (buf, sizeof(buf), "%%r%d", reg);
+  else if (reg < HL_REG_CR0)
+    qsnprintf (buf, sizeof(buf), "%%f%d", reg - HL_REG_F0);
+  else if (reg < HL_REG_LR)
+    qsnprintf (buf, sizeof(buf), "cr%d", reg - HL_REG_CR0);
+  else if (reg == HL_REG_LR)
+    qstrncpy (buf, "LR", sizeof(buf));
+  else if (reg == HL_REG_CTR)
+    qstrncpy (buf, "CTR", sizeof(buf));
+  else
+    qstrncpy (buf, "XER", sizeof(buf));
+  out_register (buf);
+}
+
+/* Small numbers in decimal, the others in hex, like IDA */
+static void
+out_number (sval_t value)
+{
+  char buf[32];
+
+  if (value > -10 && value < 10)
+    qsnprintf (buf, sizeof(buf), "%d", (int) value);
+  else if (value < 0)
+    qsnprintf (buf, sizeof(buf), "-0x%llX", (unsigned long long) -value);
+  else
+    qsnprintf (buf, sizeof(buf), "0x%llX", (unsigned long long) value);
+  out_line (buf, COLOR_DEFAULT);
+}
+
+void
+hl_ppc_outop (op_t &x)
+{
+  char buf[MAXSTR];
+
+  switch (x.type) {
+    case o_reg:
+      out_reg_name (x.reg);
+      break;
+    case o_imm:
+      if (x.dtyp == dt_byte) {
+        qsnprintf (buf, sizeof(buf), "%d", (int) x.value);
+        out_line (buf, COLOR_DEFAULT);
+      } else {
+        out_number ((sval_t) x.value);
+      }
+      break;
+    case o_displ:
+      out_number ((sval_t) x.addr);
+      out_symbol ('(');
+      out_reg_name (x.reg);
+      out_symbol (')');
+      break;
+    case o_near:
+      if (get_name (cmd.ea, x.addr, buf, sizeof(buf)) == NULL)
+        qsnprintf (buf, sizeof(buf), "0x%a", x.addr);
+      out_line (buf, COLOR_SYMBOL);
+      break;
+    case o_crbit:
+      if (x.value >= 4)
+        qsnprintf (buf, sizeof(buf), "4*cr%d+%s", (int) (x.value >> 2), conditions[x.value & 3]);
+      else
+        qstrncpy (buf, conditions[x.value & 3], sizeof(buf));
+      out_line (buf, COLOR_DEFAULT);
+      break;
+  }
+}
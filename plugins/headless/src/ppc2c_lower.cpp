@@ -0,0 +1,100 @@
+/*
+ * ppc2c_lower.cpp -- Prints the C code of a PPC2C IR file, without IDA
+ *
+ * Copyright (C) Youness Alaoui (KaKaRoTo)
+ *
+ * This software is distributed under the terms of the GNU General Public
+ * License ("GPL") version 3, as published by the Free Software Foundation.
+ *
+ */
+
+/*
+ * PPC2C saves the functions it parsed when it runs with 2 as argument. The
+ * lowering only needs that file, the stand-in is only there for msg() and
+ * the string functions, its database stays empty. Every file is converted
+ * on its own, so a build runs as many of these as it has cores.
+ */
+
+#include "headless.hpp"
+#include "ppc2c_ir.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+static void
+usage (const char *program)
+{
+  fprintf (stderr,
+      "Usage: %s [options] file.ir\n"
+      "  -o path     Where the C code goes, stdout by default\n"
+      "  -q          Discard the C code, only time the lowering\n",
+      program);
+}
+
+int
+main (int argc, char *argv[])
+{
+  const char *output_path = NULL;
+  FILE *output = stdout;
+  bool quiet = false;
+  struct timespec start, end;
+  struct stat st;
+  void *data;
+  bool success;
+  int fd, c;
+
+  while ((c = getopt (argc, argv, "o:qh")) != -1) {
+    switch (c) {
+      case 'o':
+        output_path = optarg;
+        break;
+      case 'q':
+        quiet = true;
+        break;
+      default:
+        usage (argv[0]);
+        return 1;
+    }
+  }
+  if (optind != argc - 1) {
+    usage (argv[0]);
+    return 1;
+  }
+
+  fd = open (argv[optind], O_RDONLY);
+  if (fd < 0 || fstat (fd, &st) != 0 || st.st_size == 0) {
+    warning ("Can't read %s\n", argv[optind]);
+    return 1;
+  }
+  data = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close (fd);
+  if (data == MAP_FAILED) {
+    warning ("Can't map %s\n", argv[optind]);
+    return 1;
+  }
+
+  if (output_path != NULL) {
+    output = qfopen (output_path, "w");
+    if (output == NULL) {
+      warning ("Can't open %s for writing\n", output_path);
+      return 1;
+    }
+  }
+
+  hl_set_output (quiet ? NULL : output);
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  success = lower_ir ((const uchar *) data, st.st_size);
+  clock_gettime (CLOCK_MONOTONIC, &end);
+  fprintf (stderr, "%s: %llu bytes of C in %.3f ms\n", argv[optind],
+      (unsigned long long) hl_output_bytes (),
+      (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6);
+  hl_set_output (stderr);
+
+  munmap (data, st.st_size);
+  if (output != stdout)
+    qfclose (output);
+  return success ? 0 : 1;
+}